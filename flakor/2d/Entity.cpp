@@ -1,9 +1,17 @@
+#include <algorithm>
+#include <vector>
+
 #include "targetMacros.h"
 #include "2d/Entity.h"
 #include "base/lang/Str.h"
 #include "core/input/Touch.h"
 #include "core/input/OnTouchEvent.h"
 #include "math/GLMatrix.h"
+#include "core/opengl/renderer/Renderer.h"
+#include "core/opengl/renderer/CacheCommand.h"
+#include "core/input/TouchPool.h"
+#include "base/update/JobSystem.h"
+#include "2d/ModifierManager.h"
 
 #if FK_ENTITY_RENDER_SUBPIXEL
 #define RENDER_IN_SUBPIXEL
@@ -14,52 +22,82 @@
 FLAKOR_NS_BEGIN
 
 int Entity::globalOrderOfArrival = 1;
+unsigned int Entity::globalVisitOrder = 0;
+std::atomic<bool> Entity::globalSceneDirty(true);
 
 Entity::Entity(void)
 : position(PointZero)
 , contentSize(SizeZero)
+, anchorPoint(PointZero)
+, anchorPointInPixels(PointZero)
+// "whole screen" objects. like Scenes and Layers, should set relativeAnchorPoint to false
+, relativeAnchorPoint(false)
+, anchorPointAsCenter(true)
+, vertexZ(0.0f)
 , rotationX(0.0f)
 , rotationY(0.0f)
 , scaleX(1.0f)
 , scaleY(1.0f)
-, vertexZ(0.0f)
 , skewX(0.0f)
 , skewY(0.0f)
-, anchorPointInPixels(PointZero)
-, anchorPoint(PointZero)
-, additionalMatrix()
-, camera(NULL)	  
 , zOrder(0)
 , orderOfArrival(0)
-// children (lazy allocs)
-, children(NULL)
-, parent(NULL)
+, visitOrder(0)
 , tag(Entity::TAG_INVALID)
-// userData is always inited as null
-, userData(NULL)
-, cullingEnabled(true)
+, touchable(false)
+, touchEvent(NULL)
+, enabled(true)
 , running(false)
-, transformDirty(true)
-, inverseDirty(true)
-, additionalTransformDirty(false)
 , visible(true)
-, touchable(false)
-// "whole screen" objects. like Scenes and Layers, should set relativeAnchorPoint to false
-, relativeAnchorPoint(false)
 , childrenVisible(true)
+, cullingEnabled(true)
+, subtreeCullingEnabled(false)
+, updateThreadSafe(false)
 , childrenSortPending(false)
-, anchorPointAsCenter(true)
+, sortDirty(false)
+, reorderedChildren(0)
+, transformDirty(true)
+, additionalTransformDirty(false)
+, inverseDirty(true)
+, worldTransformDirty(true)
+, camera(NULL)	  
+// children (lazy allocs)
+, children(NULL)
+, parent(NULL)
+, additionalMatrix()
+, cacheAsTexture(false)
+, cacheDirty(false)
+, cacheCommand(NULL)
+, cacheVisitStart(0)
+, cacheVisitCount(0)
+, cacheVisitShift(0)
+, updateHandlers(NULL)
+, runningModifiers(0)
+, transformObserved(false)
+// userData is always inited as null
+, userData(NULL)
 //, scriptHandler(0)
 //, updateScriptHandler(0)
 {
+	// not drawn yet
+	globalSceneDirty = true;
 }
 
 Entity::~Entity(void)
 {
 	FKLOG("FLAKOR:deallocing");
+	if (runningModifiers > 0)
+	{
+		ModifierManager::getInstance()->cancel(this);
+	}
+	if (touchable)
+	{
+		TouchPool::getInstance()->removeEntity(this);
+	}
 	//unregisterScriptHandler
 	FK_SAFE_RELEASE(camera);
 	FK_SAFE_RELEASE(userObject);
+	FK_SAFE_DELETE(cacheCommand);
 }
 
 //overwrite this method for your own init action
@@ -101,14 +139,14 @@ String* Entity::toString() const
 void Entity::setPosition(const Point &position)
 {
 	this->position = position;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 void Entity::setPosition(float x, float y)
 {
 	this->position.x = x;
 	this->position.y = y;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 Point& Entity::getPosition()
@@ -125,7 +163,7 @@ void Entity::getPosition(float* x, float* y)
 void  Entity::setPositionX(float x)
 {
 	this->position.x = x;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getPositionX(void)
@@ -136,7 +174,7 @@ float Entity::getPositionX(void)
 void  Entity::setPositionY(float y)
 {
 	this->position.y = y;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getPositionY(void)
@@ -149,7 +187,7 @@ void Entity::setRelativeAnchorPoint(bool relative)
 	if(relativeAnchorPoint != relative)
 	{
 		relativeAnchorPoint = relative;
-		transformDirty = inverseDirty = true;
+		setTransformDirty();
 	}
 }
 
@@ -171,7 +209,10 @@ const Size& Entity::getContentSize() const
 
 void Entity::setContentSize(const Size& size)
 {
-	this->contentSize = contentSize;
+	this->contentSize = size;
+	setTransformDirty();
+	// a cached entity caches its content rect
+	markCacheDirty();
 }
 
 const Point& Entity::getAnchorPoint()
@@ -182,11 +223,13 @@ const Point& Entity::getAnchorPoint()
 void Entity::setAnchorPoint(const Point &point)
 {
 	anchorPoint = point;
+	setTransformDirty();
 }
 
 void Entity::setAnchorPointAsCenter(bool use)
 {
 	anchorPointAsCenter = use;
+	setTransformDirty();
 }
 
 bool Entity::isAnchorPointAsCenter() const
@@ -231,6 +274,7 @@ bool Entity::hasParent()
 void Entity::setParent(Entity *parent)
 {
 	this->parent = parent;
+	worldTransformDirty = true;
 }
 
 Entity* Entity::getParent()
@@ -241,6 +285,8 @@ Entity* Entity::getParent()
 void Entity::setVertexZ(float z)
 {
 	vertexZ = z;
+	worldTransformDirty = true;
+	markParentDirty();
 }
 
 float Entity::getVertexZ()
@@ -262,13 +308,13 @@ float Entity::getRotation()
 void Entity::setRotation(float rotation)
 {
 	rotationX = rotationY = rotation;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 void Entity::setRotationX(float x)
 {
 	rotationX = x;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getRotationX()
@@ -279,7 +325,7 @@ float Entity::getRotationX()
 void Entity::setRotationY(float y)
 {
 	rotationY = y;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getRotationY()
@@ -295,7 +341,7 @@ bool Entity::isScaled()
 void Entity::setScaleX(float x)
 {
 	scaleX = x;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getScaleX()
@@ -306,7 +352,7 @@ float Entity::getScaleX()
 void Entity::setScaleY(float y)
 {
 	scaleY = y;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getScaleY()
@@ -317,7 +363,7 @@ float Entity::getScaleY()
 void Entity::setScale(float scale)
 {
 	scaleX = scaleY = scale;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getScale()
@@ -330,7 +376,7 @@ void Entity::setScale(float x,float y)
 {
 	scaleX = x;
 	scaleY = y;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 bool Entity::isSkewed()
@@ -341,7 +387,7 @@ bool Entity::isSkewed()
 void Entity::setSkewX(float x)
 {
 	skewX = x;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getSkewX()
@@ -352,7 +398,7 @@ float Entity::getSkewX()
 void Entity::setSkewY(float y)
 {
 	skewY = y;
-	transformDirty = inverseDirty = true;
+	setTransformDirty();
 }
 
 float Entity::getSkewY()
@@ -364,6 +410,7 @@ float Entity::getSkewY()
 void Entity::setVisible(bool visible)
 {
 	this->visible = visible;
+	markParentDirty();
 }
 
 bool Entity::isVisible()
@@ -374,6 +421,7 @@ bool Entity::isVisible()
 void Entity::setChildrenVisible(bool visible)
 {
 	childrenVisible = visible;
+	markCacheDirty();
 }
 
 bool Entity::isChildrenVisible()
@@ -544,8 +592,9 @@ void Entity::removeAllChildren(bool cleanup)
 		Entity* child;
 		int count = children->count();
 		
-	    for(int i = 0;i<count;child = (Entity*)children->data->arr[i],i++)
+	    for(int i = 0;i<count;i++)
 		{
+			child = (Entity*)children->data->arr[i];
 			if (child)
 			{
 				// IMPORTANT:
@@ -567,6 +616,7 @@ void Entity::removeAllChildren(bool cleanup)
 		}
 
 		children->removeAllObjects();
+		markCacheDirty();
 	}
 }
 
@@ -574,45 +624,100 @@ void Entity::reorderChild(Entity * child, int zOrder)
 {
 	FKAssert(child != NULL,"Child must be non-nil!");
 	childrenSortPending = true;
+	markChildReordered(child);
 	child->setOrderOfArrival(globalOrderOfArrival++);
 	child->_setZOrder(zOrder);
 }
 
+void Entity::markChildReordered(Entity* child)
+{
+	markCacheDirty();
+	if(!child->sortDirty)
+	{
+		child->sortDirty = true;
+		reorderedChildren++;
+	}
+}
+
 void Entity::sortAllChildren()
 {
 	sortAllChildren(true);
 }
 
+bool Entity::compareChildOrder(const Entity* a, const Entity* b)
+{
+	return a->zOrder < b->zOrder
+		|| (a->zOrder == b->zOrder && a->orderOfArrival < b->orderOfArrival);
+}
+
 void Entity::sortAllChildren(bool immediate)
 {
-	if(immediate)
+	if(!immediate)
 	{
-		int i,j,length = children->data->num;
-		Entity **data=  (Entity **)children->data->arr;
-		Entity *tmp;
+		childrenSortPending = true;
+		return;
+	}
 
-		//insertion sort
-		for(i=1;i<length;i++)
-		{
-			tmp = data[i];
-			j=i-1;
+	if(children == NULL)
+	{
+		childrenSortPending = false;
+		reorderedChildren = 0;
+		return;
+	}
+
+	int i,length = children->data->num;
+	Entity **data=  (Entity **)children->data->arr;
+
+	// a few moved children are cheaper to reinsert than sorting everybody again
+	if(reorderedChildren > 0 && reorderedChildren * INCREMENTAL_SORT_RATIO <= length)
+	{
+		std::vector<Entity*> moved;
+		moved.reserve(reorderedChildren);
 
-			while(j>=0 && ((tmp->zOrder < data[j]->zOrder)  ||
-						(tmp->zOrder== data[j]->zOrder && tmp->orderOfArrival < data[j]->orderOfArrival ) ))
+		// take the moved children out, the rest stays sorted
+		int kept = 0;
+		for(i=0;i<length;i++)
+		{
+			if(data[i]->sortDirty)
+			{
+				data[i]->sortDirty = false;
+				moved.push_back(data[i]);
+			}
+			else
 			{
-				data[j+1] = data[j];
-				j--;
+				data[kept++] = data[i];
 			}
-			data[j+1] = tmp;
 		}
+		std::stable_sort(moved.begin(), moved.end(), compareChildOrder);
 
-		childrenSortPending = false;
+		// merge from the back, in place
+		int a = kept - 1;
+		int b = (int)moved.size() - 1;
+		int out = length - 1;
+		while(b >= 0)
+		{
+			if(a >= 0 && compareChildOrder(moved[b], data[a]))
+			{
+				data[out--] = data[a--];
+			}
+			else
+			{
+				data[out--] = moved[b--];
+			}
+		}
 	}
 	else
 	{
-		childrenSortPending = true;
+		// merge sort, (zOrder, orderOfArrival) is unique so stable is enough
+		std::stable_sort(data, data + length, compareChildOrder);
+		for(i=0;i<length;i++)
+		{
+			data[i]->sortDirty = false;
+		}
 	}
 
+	reorderedChildren = 0;
+	childrenSortPending = false;
 }
 
 int Entity::getTag() const
@@ -648,7 +753,7 @@ void Entity::setUserObject(Object *pUserObject)
 void Entity::setAddtionalMatrix(Matrix4& matrix)
 {
 	this->additionalMatrix = matrix;
-	transformDirty = true;
+	setTransformDirty();
 	additionalTransformDirty = true;
 }
 
@@ -661,6 +766,8 @@ Matrix4 Entity::getAddtionalMatrix()
 void Entity::setCamera(Camera* camera)
 {
 	this->camera = camera;
+	worldTransformDirty = true;
+	markParentDirty();
 }
 
 Camera* Entity::getCamera() const
@@ -680,6 +787,11 @@ bool Entity::isRunning()
 void Entity::onEnter()
 {
 	running = true;
+	// only entities on the stage are hit-tested
+	if (touchable)
+	{
+		TouchPool::getInstance()->registerEntity(this);
+	}
 
 	/* finish it later
 	   if (scriptType != scriptTypeNone)
@@ -721,6 +833,10 @@ void Entity::onExit()
 	//this->pauseSchedulerAndActions();
 
 	running = false;
+	if (touchable)
+	{
+		TouchPool::getInstance()->removeEntity(this);
+	}
 
 	arrayMakeObjectsPerformSelector(children, onExit, Entity*);
 
@@ -754,14 +870,34 @@ void Entity::onVisit(void)
 		return;
 	}
 
-    GLMode(GL_MODELVIEW);
-    GLPush();
+	this->updateWorldTransform();
 
-    this->transform();
-    
+	bool inside = this->isInsideViewport();
+	// the container promised its children stay inside its bounds
+	if(!inside && subtreeCullingEnabled)
+	{
+		return;
+	}
+
+	if(cacheAsTexture)
+	{
+		visitCached(inside);
+	}
+	else
+	{
+		visitChildren(inside);
+	}
+}
+
+void Entity::visitChildren(bool inside)
+{
 	if(children == NULL || children->count() <=0 || !this->childrenVisible)
 	{
-		this->draw();
+		visitOrder = ++globalVisitOrder;
+		if(inside)
+		{
+			this->draw();
+		}
 	}
 	else
 	{
@@ -773,7 +909,6 @@ void Entity::onVisit(void)
 		int i = 0;
 		Entity* child = NULL;
 
-        FKLOG("children count:%d",childCount);
 		//draw children behind this entity
 		for(;i<childCount;i++)
 		{
@@ -789,7 +924,11 @@ void Entity::onVisit(void)
 		}
 
 		//draw self
-		this->draw();
+		visitOrder = ++globalVisitOrder;
+		if(inside)
+		{
+			this->draw();
+		}
 
 		//draw children in font of this entity
 		for(;i<childCount;i++)
@@ -802,9 +941,125 @@ void Entity::onVisit(void)
 		}
 
 	}
-    
-    GLMode(GL_MODELVIEW);
-    GLPop();
+}
+
+void Entity::visitCached(bool inside)
+{
+	if(contentSize.width <= 0 || contentSize.height <= 0)
+	{
+		visitChildren(inside);
+		return;
+	}
+
+	if(cacheCommand == NULL)
+	{
+		cacheCommand = new CacheCommand();
+		cacheDirty = true;
+	}
+
+	bool capture = cacheDirty || !cacheCommand->isValid();
+	if(!inside && capture)
+	{
+		// render it once it shows up
+		return;
+	}
+
+	Renderer* renderer = Renderer::getInstance();
+	if(capture)
+	{
+		// children off screen now may scroll in later, cull against the cached rect instead
+		Rect visibleRect = renderer->getVisibleRect();
+		renderer->setVisibleRect(worldBounds);
+
+		cacheCommand->init(vertexZ, contentSize, worldMatrix);
+		renderer->beginCapture(cacheCommand);
+		cacheVisitStart = globalVisitOrder;
+		visitChildren(true);
+		cacheVisitCount = globalVisitOrder - cacheVisitStart;
+		cacheVisitShift = 0;
+		renderer->endCapture();
+		renderer->addCommand(cacheCommand);
+
+		renderer->setVisibleRect(visibleRect);
+		cacheDirty = false;
+	}
+	else
+	{
+		// the subtree is skipped, keep its visit order in line with the entities drawn around it
+		cacheVisitShift = globalVisitOrder - cacheVisitStart;
+		globalVisitOrder += cacheVisitCount;
+		// moving this entity reuses the texture, the children still need their world bounds for hit testing
+		updateChildrenWorldTransform();
+	}
+
+	if(inside)
+	{
+		cacheCommand->drawTexture(vertexZ, worldMatrix);
+	}
+}
+
+void Entity::setCacheAsTexture(bool cache)
+{
+	if(cacheAsTexture == cache)
+	{
+		return;
+	}
+
+	cacheAsTexture = cache;
+	cacheDirty = cache;
+	if(!cache)
+	{
+		FK_SAFE_DELETE(cacheCommand);
+	}
+	// the entities above see a different picture
+	markParentDirty();
+}
+
+bool Entity::isCacheAsTexture() const
+{
+	return cacheAsTexture;
+}
+
+void Entity::markCacheDirty()
+{
+	globalSceneDirty = true;
+	for(Entity* entity = this;entity != NULL;entity = entity->parent)
+	{
+		if(entity->cacheAsTexture)
+		{
+			// the caches above were marked with it
+			if(entity->cacheDirty)
+			{
+				return;
+			}
+			entity->cacheDirty = true;
+		}
+	}
+}
+
+void Entity::setTransformDirty()
+{
+	transformDirty = inverseDirty = true;
+	markParentDirty();
+}
+
+void Entity::markParentDirty()
+{
+	globalSceneDirty = true;
+	if(parent != NULL)
+	{
+		parent->markCacheDirty();
+	}
+}
+
+void Entity::markSceneDirty()
+{
+	globalSceneDirty = true;
+}
+
+bool Entity::clearSceneDirty()
+{
+	return globalSceneDirty.exchange(false);
 }
 
 /**
@@ -820,13 +1075,32 @@ void Entity::onDetached()
 
 }
 
+// at most this many jobs per parent, enough to keep 8 cores busy
+static const int MAX_UPDATE_JOBS = 16;
+
+struct UpdateRange
+{
+    Object** children;
+    int start;
+    int end;
+    float delta;
+};
+
+void Entity::updateThreadSafeChildren(void* data)
+{
+    UpdateRange* range = (UpdateRange*)data;
+    for(int i = range->start;i < range->end;i++)
+    {
+        Entity* child = (Entity *)range->children[i];
+        if(child && child->updateThreadSafe)
+        {
+            child->update(range->delta);
+        }
+    }
+}
+
 void Entity::update(float delta)
 {
-    GLMode(GL_MODELVIEW);
-    GLPush();
-    
-    this->transform();
-    
     if(children == NULL || children->count() <=0 || !this->childrenVisible)
     {
         this->onUpdate(delta);
@@ -840,15 +1114,70 @@ void Entity::update(float delta)
         int childCount = children->count();
         int i = 0;
         Entity* child = NULL;
-        
-        FKLOG("children count:%d",childCount);
-        //draw children behind this entity
-        for(;i<childCount;i++)
+
+        int safeCount = 0;
+        for(i = 0;i < childCount;i++)
+        {
+            child = (Entity *)children->data->arr[i];
+            if(child && child->updateThreadSafe)
+            {
+                safeCount++;
+            }
+        }
+
+        // spread the thread safe children over jobs with about the same number each
+        JobSystem* jobs = JobSystem::getInstance();
+        JobSystem::Counter counter;
+        UpdateRange ranges[MAX_UPDATE_JOBS];
+        bool parallel = safeCount >= 2 && jobs->getWorkerCount() > 0;
+        if(parallel)
+        {
+            int jobCount = MIN(safeCount, MIN(MAX_UPDATE_JOBS, (jobs->getWorkerCount() + 1) * 2));
+            int perJob = (safeCount + jobCount - 1) / jobCount;
+            int job = 0;
+            int taken = 0;
+            ranges[0].start = 0;
+            for(i = 0;i < childCount;i++)
+            {
+                child = (Entity *)children->data->arr[i];
+                if(child && child->updateThreadSafe && ++taken == perJob)
+                {
+                    ranges[job].end = i + 1;
+                    job++;
+                    taken = 0;
+                    if(job < jobCount)
+                    {
+                        ranges[job].start = i + 1;
+                    }
+                }
+            }
+            if(taken > 0)
+            {
+                ranges[job].end = childCount;
+                job++;
+            }
+
+            for(int j = 0;j < job;j++)
+            {
+                ranges[j].children = children->data->arr;
+                ranges[j].delta = delta;
+                jobs->run(Entity::updateThreadSafeChildren, &ranges[j], &counter);
+            }
+            // the jobs read the children array, onUpdate and the other children may change it
+            // (waiting runs queued jobs)
+            jobs->wait(&counter);
+        }
+
+        //update children behind this entity
+        for(i = 0;i<childCount;i++)
         {
             child = (Entity *)children->data->arr[i];
             if(child && child->zOrder < 0)
             {
-                child->update(delta);
+                if(!parallel || !child->updateThreadSafe)
+                {
+                    child->update(delta);
+                }
             }
             else
             {
@@ -858,21 +1187,26 @@ void Entity::update(float delta)
         
         this->onUpdate(delta);
         
-        //draw children in font of this entity
+        //update children in font of this entity
         for(;i<childCount;i++)
         {
             child = (Entity *)children->data->arr[i];
-            if(child)
+            if(child && (!parallel || !child->updateThreadSafe))
             {
                 child->update(delta);
             }
         }
-        
     }
-    
-    GLMode(GL_MODELVIEW);
-    GLPop();
+}
 
+void Entity::setUpdateThreadSafe(bool safe)
+{
+    updateThreadSafe = safe;
+}
+
+bool Entity::isUpdateThreadSafe() const
+{
+    return updateThreadSafe;
 }
 
 void Entity::setIngnoreUpdate(bool ignore)
@@ -888,15 +1222,32 @@ bool Entity::getIngnoreUpdate()
 
 void Entity::onUpdate(float delta)
 {
-    Matrix4 * mat = new Matrix4();
-    GLGet(GL_MODELVIEW,mat);
-    
-    
+    //overwrite to handle your own update action
 }
 
 void Entity::reset()
 {
-    
+	// back to the state of a fresh entity, keeps children and what init() set up (content size, anchor point)
+	if (runningModifiers > 0)
+	{
+		ModifierManager::getInstance()->cancel(this);
+	}
+	setPosition(PointZero);
+	setRotation(0.0f);
+	setScale(1.0f);
+	setSkewX(0.0f);
+	setSkewY(0.0f);
+	setVertexZ(0.0f);
+	setVisible(true);
+	setTag(Entity::TAG_INVALID);
+	setUserData(NULL);
+	setUserObject(NULL);
+	setTouchable(false);
+	ignoreUpdate = false;
+
+	Color white;
+	white.reset();
+	setColor(white);
 }
 
 void Entity::transform(void)
@@ -947,6 +1298,132 @@ void Entity::updateTransform(void)
 	arrayMakeObjectsPerformSelector(children, updateTransform, Entity*);
 }
 
+bool Entity::updateWorldTransform(void)
+{
+	if (!transformDirty && !worldTransformDirty && (camera == NULL || !camera->isDirty()))
+	{
+		return false;
+	}
+
+	Matrix4 local = this->entityToParentTransform();
+	// Update Z vertex manually
+	local[14] = vertexZ;
+
+	if (camera != NULL)
+	{
+		bool translate = (anchorPointInPixels.x != 0.0f || anchorPointInPixels.y != 0.0f);
+
+		if( translate )
+			local.postTranslate(RENDER_IN_SUBPIXEL(anchorPointInPixels.x), RENDER_IN_SUBPIXEL(anchorPointInPixels.y), 0);
+
+		local = local * camera->getLookupMatrix();
+
+		if( translate )
+			local.postTranslate(RENDER_IN_SUBPIXEL(-anchorPointInPixels.x), RENDER_IN_SUBPIXEL(-anchorPointInPixels.y), 0);
+	}
+
+	if (parent != NULL)
+	{
+		worldMatrix = parent->worldMatrix * local;
+	}
+	else
+	{
+		worldMatrix = local;
+	}
+	worldTransformDirty = false;
+
+	// AABB of the four corners of contentSize in world space
+	const float* m = worldMatrix.get();
+	float w = contentSize.width;
+	float h = contentSize.height;
+	float xs[4] = { m[12], m[0] * w + m[12], m[4] * h + m[12], m[0] * w + m[4] * h + m[12] };
+	float ys[4] = { m[13], m[1] * w + m[13], m[5] * h + m[13], m[1] * w + m[5] * h + m[13] };
+	float minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+	for(int i = 1;i < 4;i++)
+	{
+		minX = MIN(minX, xs[i]);
+		maxX = MAX(maxX, xs[i]);
+		minY = MIN(minY, ys[i]);
+		maxY = MAX(maxY, ys[i]);
+	}
+	worldBounds.setRect(minX, minY, maxX - minX, maxY - minY);
+
+	if (touchable)
+	{
+		TouchPool::getInstance()->updateEntity(this);
+	}
+
+	if (children != NULL)
+	{
+		int childCount = children->count();
+		for(int i = 0;i < childCount;i++)
+		{
+			((Entity *)children->data->arr[i])->worldTransformDirty = true;
+		}
+	}
+
+	return true;
+}
+
+void Entity::updateChildrenWorldTransform(void)
+{
+	if (children == NULL)
+	{
+		return;
+	}
+
+	int childCount = children->count();
+	for(int i = 0;i < childCount;i++)
+	{
+		Entity* child = (Entity *)children->data->arr[i];
+		// a clean child has a clean subtree, changes below it would have dirtied the cache
+		if (child->updateWorldTransform())
+		{
+			child->updateChildrenWorldTransform();
+		}
+	}
+}
+
+const Matrix4& Entity::getWorldMatrix() const
+{
+	return worldMatrix;
+}
+
+const Rect& Entity::getWorldBounds() const
+{
+	return worldBounds;
+}
+
+void Entity::setCullingEnabled(bool enabled)
+{
+	cullingEnabled = enabled;
+}
+
+bool Entity::isCullingEnabled() const
+{
+	return cullingEnabled;
+}
+
+void Entity::setSubtreeCullingEnabled(bool enabled)
+{
+	subtreeCullingEnabled = enabled;
+}
+
+bool Entity::isSubtreeCullingEnabled() const
+{
+	return subtreeCullingEnabled;
+}
+
+bool Entity::isInsideViewport()
+{
+	if(!cullingEnabled || contentSize.width <= 0 || contentSize.height <= 0)
+	{
+		return true;
+	}
+
+	return Renderer::getInstance()->checkVisibility(worldBounds);
+}
+
 void Entity::childrenAlloc(void)
 {
 	children = Array::createWithCapacity(4);
@@ -957,6 +1434,7 @@ void Entity::insertChild(Entity* child, int z)
 {
 	childrenSortPending = true;
 	fkArrayAppendObjectWithResize(children->data, child);
+	markChildReordered(child);
 	child->_setZOrder(z);
 }
 
@@ -973,8 +1451,14 @@ void Entity::detachChild(Entity *child, bool doCleanup)
 	}
 
 	child->setParent(NULL);
+	if(child->sortDirty)
+	{
+		child->sortDirty = false;
+		reorderedChildren--;
+	}
 
 	children->removeObject(child);
+	markCacheDirty();
 }
 
 Matrix4 Entity::entityToParentTransform(void)
@@ -1040,12 +1524,10 @@ Matrix4 Entity::entityToParentTransform(void)
 												0,0,0,1);
 				transformMatrix = skewMatrix*transformMatrix;
 
-				delete(&skewMatrix);			
-				
 				// adjust anchor point
 				if (!anchorPointInPixels.equals(PointZero))
 				{
-					transformMatrix = transformMatrix.translate(-anchorPointInPixels.x, -anchorPointInPixels.y,0);
+					transformMatrix.postTranslate(-anchorPointInPixels.x, -anchorPointInPixels.y,0);
 				}
 			}
 		}
@@ -1118,6 +1600,9 @@ Matrix4 Entity::entityToParentTransform(void)
 			additionalTransformDirty = false;
 		}
 
+		// batched sprites ask for the local matrix outside of onVisit(), the caches built on it are stale now
+		worldTransformDirty = true;
+		inverseDirty = true;
 		transformDirty = false;
 	}
 
@@ -1127,22 +1612,25 @@ Matrix4 Entity::entityToParentTransform(void)
 
 Matrix4 Entity::parentToEntityTransform(void)
 {
-		Matrix4* inverse = NULL;
-		if(transformDirty)
-		{
-			*inverse = this->entityToParentTransform().invert();
-		}
-		return *inverse;
+	if(transformDirty || inverseDirty)
+	{
+		inverseMatrix = this->entityToParentTransform();
+		inverseMatrix.invert();
+		inverseDirty = false;
+	}
+	return inverseMatrix;
 }
 
 Matrix4 Entity::entityToWorldTransform()
 {
-    Matrix4 t = this->entityToParentTransform();
-
-    for (Entity *p = parent; p != NULL; p = p->getParent())
-        t = t*(p->entityToParentTransform());
+	// bring the ancestors up to date first, outside of onVisit() they may be stale
+	if (parent != NULL)
+	{
+		parent->entityToWorldTransform();
+	}
+	this->updateWorldTransform();
 
-    return t;
+	return worldMatrix;
 }
 
 Matrix4 Entity::worldToEntityTransform(void)
@@ -1197,36 +1685,43 @@ Point Entity::convertTouchToEntitySpaceAR(Touch *touch)
 void Entity::setColor(const Color& color)
 {
 	this->color = color;
+	markCacheDirty();
 }
 
 void Entity::setColor(float red,float green,float blue)
 {
 	this->color.setColor(red,green,blue);
+	markCacheDirty();
 }
 
 void Entity::setColor(float red,float green,float blue,float alpha)
 {
 	this->color.setColor(red,green,blue,alpha);
+	markCacheDirty();
 }
 
 void Entity::setRed(float red)
 {
 	this->color.red = red;
+	markCacheDirty();
 }
 
 void Entity::setGreen(float green)
 {
 	this->color.green = green;
+	markCacheDirty();
 }
 
 void Entity::setBlue(float blue)
 {
 	this->color.blue = blue;
+	markCacheDirty();
 }
 
 void Entity::setAlpha(float alpha)
 {
 	this->color.alpha = alpha;
+	markCacheDirty();
 }
 
 Color& Entity::getColor()
@@ -1257,14 +1752,23 @@ float Entity::getAlpha()
 
 void Entity::setTouchable(bool able)
 {
+    if(touchable == able)
+    {
+        return;
+    }
+
     touchable = able;
     if(able)
     {
-        //Engine::getInstance()->touchPool->registerEntity(this);
+        // registered once it enters the stage otherwise
+        if(running)
+        {
+            TouchPool::getInstance()->registerEntity(this);
+        }
     }
     else
     {
-        //Engine::getInstance()->touchPool->removeEntity(this);
+        TouchPool::getInstance()->removeEntity(this);
     }
 }
 
@@ -1273,6 +1777,20 @@ bool Entity::isTouchable()
     return touchable;
 }
 
+unsigned int Entity::getVisitOrder() const
+{
+    // cached subtrees are not visited, their orders move with the cache
+    unsigned int order = visitOrder;
+    for(const Entity* entity = this;entity != NULL;entity = entity->parent)
+    {
+        if(entity->cacheAsTexture)
+        {
+            order += entity->cacheVisitShift;
+        }
+    }
+    return order;
+}
+
 bool Entity::dispatchTouchTrigger(TouchTrigger* trigger)
 {
     bool result = false;
@@ -1,6 +1,8 @@
 #ifndef _FK_ENTITY_H_
 #define _FK_ENTITY_H_
 
+#include <atomic>
+
 #include "base/interface/IUpdatable.h"
 #include "base/interface/IColorable.h"
 #include "base/element/Element.h"
@@ -17,6 +19,7 @@ class Camera;
 class Touch;
 class String;
 class OnTouchEvent;
+class CacheCommand;
 
 enum EntityState {
 	EntityOnEnter,
@@ -37,9 +40,21 @@ typedef enum {
  */
 class Entity : public Object,public IColorable,public IUpdatable
 {
+	// tweens write the transform fields directly
+	friend class ModifierManager;
+
 	protected:
 		static int globalOrderOfArrival;
+		static unsigned int globalVisitOrder;
+		/** set by every change that shows on screen, the engine skips frames while it stays false */
+		static std::atomic<bool> globalSceneDirty;
+		/** JobSystem job, updates the thread safe children in a range, see update() */
+		static void updateThreadSafeChildren(void* data);
+		/** (zOrder, orderOfArrival) order used by sortAllChildren() */
+		static bool compareChildOrder(const Entity* a, const Entity* b);
         static const int TAG_INVALID = -1;
+        /** sortAllChildren() reinserts the moved children when at most 1/16 of them moved */
+        static const int INCREMENTAL_SORT_RATIO = 16;
     
 		//相对于父类的位置坐标
 		Point position;
@@ -91,6 +106,7 @@ class Entity : public Object,public IColorable,public IUpdatable
 		///在父元素排序使用的Z值
 		int zOrder;//localZOrder
 		int orderOfArrival;            ///< used to preserve sequence while sorting children with the same localZOrder
+		unsigned int visitOrder;       ///< stamped in onVisit, a larger value is drawn later (on top)
 		/**
 		 *标签
 		 */
@@ -127,13 +143,21 @@ class Entity : public Object,public IColorable,public IUpdatable
         bool childrenVisible;
     
 		/**
-		 *是否剪裁
+		 *是否剪裁，在屏幕外时不调用draw()
 		 */
 		bool cullingEnabled;
+		/**
+		 *是否剪裁整个子树，只有当子元素都在contentSize范围内时才应该打开
+		 */
+		bool subtreeCullingEnabled;
 		/**
 		 *是否忽略更新
 		 */
 		bool ignoreUpdate;
+		/**
+		 *onUpdate及整个子树可以和兄弟节点并行更新
+		 */
+		bool updateThreadSafe;
 		
 		/**
 		 *子元素忽略更新
@@ -143,6 +167,14 @@ class Entity : public Object,public IColorable,public IUpdatable
 		 *子元素是否等待排序
 		 */
 		bool childrenSortPending;
+		/**
+		 *z值改变后还没有排序，父元素只需重新插入这些子元素
+		 */
+		bool sortDirty;
+		/**
+		 *sortDirty的子元素个数
+		 */
+		int reorderedChildren;
 
         /**
          *矩阵变换是否过期
@@ -150,6 +182,10 @@ class Entity : public Object,public IColorable,public IUpdatable
 		bool transformDirty;
 		bool additionalTransformDirty;
 		bool inverseDirty;
+		/**
+		 *世界矩阵是否过期，父元素的世界矩阵改变时会把子元素置为过期
+		 */
+		bool worldTransformDirty;
 		/**
 		 *相机，默认不起作用
 		 */
@@ -173,12 +209,42 @@ class Entity : public Object,public IColorable,public IUpdatable
 		Matrix4 inverseMatrix;
 		Matrix4 transformMatrix;
 		Matrix4 additionalMatrix;
+		/**
+		 *缓存的世界矩阵 = 父元素世界矩阵 * transformMatrix，只在过期时重新计算
+		 */
+		Matrix4 worldMatrix;
+		/**
+		 *世界坐标系下的包围盒(AABB)，随世界矩阵一起更新
+		 */
+		Rect worldBounds;
+		/**
+		 *把子树渲染到纹理中缓存，之后每帧只画一个四边形
+		 */
+		bool cacheAsTexture;
+		/**
+		 *缓存的纹理过期，下次onVisit时重新渲染子树，并行更新的子树也会标记共同的祖先
+		 */
+		std::atomic<bool> cacheDirty;
+		CacheCommand* cacheCommand;
+		/**
+		 *上次渲染子树时visitOrder的起点和个数，跳过子树时用来平移子元素的visitOrder
+		 */
+		unsigned int cacheVisitStart;
+		unsigned int cacheVisitCount;
+		unsigned int cacheVisitShift;
 
         /**
           *updatehandler and modifier
           */
         Array* updateHandlers;
-        Array* entityModifiers;
+        /**
+          *ModifierManager里还在运行的tween个数
+          */
+        int runningModifiers;
+        /**
+          *子类的变换setter有额外工作（SpriteBatch里的Sprite），tween就调用setter而不直接写字段
+          */
+        bool transformObserved;
 
 		//用户自定义数据指针
 		void* userData;
@@ -576,6 +642,14 @@ class Entity : public Object,public IColorable,public IUpdatable
 		 */
 		virtual void reorderChild(Entity * child, int zOrder);
 		virtual void sortAllChildren();
+		/**
+		 * Sorts the children by (zOrder, orderOfArrival).
+		 * When only a few children moved through reorderChild() or were added since the last sort,
+		 * they are taken out, sorted and merged back in O(n + k log k).
+		 * Otherwise the whole array is merge sorted in O(n log n).
+		 *
+		 * @param immediate sort now, or only mark the children to be sorted before the next visit
+		 */
 		virtual void sortAllChildren(bool immediate);
 
 		/**
@@ -757,13 +831,28 @@ class Entity : public Object,public IColorable,public IUpdatable
         void setIngnoreUpdate(bool ignore);
         bool getIngnoreUpdate();
     
+        /**
+         * Marks the subtree as safe to update on a worker thread, in parallel with its siblings.
+         * Only set it when onUpdate of this entity and of all its descendants touches nothing
+         * but the subtree itself. The thread safe children are done before the other children
+         * and onUpdate() of the parent run, those may add or remove children. Default is false.
+         */
+        void setUpdateThreadSafe(bool safe);
+        bool isUpdateThreadSafe() const;
+
         /*
          * Update method will be called automatically every frame in update thread
          * Visits this entity's children ,update & draw them recursively.
+         * Children marked thread safe are spread over JobSystem, the others run in order on the calling thread.
          */
         virtual void update(float delta);
     
         void onUpdate(float delta) override;
+        /**
+         * Restores position, rotation, scale, skew, vertexZ, visibility, color, tag and user data to their defaults.
+         * Children, content size, anchor point and GL resources are kept, EntityPool calls it when an entity is recycled.
+         * Subclasses that keep more per-spawn state should override it and call Entity::reset().
+         */
         void reset() override;
 
 		virtual void onAttached();
@@ -789,6 +878,68 @@ class Entity : public Object,public IColorable,public IUpdatable
 		 */
 		virtual void updateTransform(void);
 
+		/**
+		 * Recomputes the cached world matrix if this entity or one of its ancestors changed.
+		 * When it is recomputed the direct children are marked dirty, so static subtrees cost nothing.
+		 *
+		 * @return true if the world matrix was recomputed.
+		 */
+		bool updateWorldTransform(void);
+
+		/**
+		 * Returns the cached world matrix. It is refreshed in onVisit(), so it is valid inside draw().
+		 */
+		const Matrix4& getWorldMatrix() const;
+
+		/**
+		 * Returns the world space axis aligned bounding box of (0, 0, contentSize).
+		 * It is refreshed with the world matrix.
+		 */
+		const Rect& getWorldBounds() const;
+
+		/**
+		 * Sets whether draw() is skipped when the entity is off screen. Default is true.
+		 * Entities with an empty contentSize are never culled, their extent is unknown.
+		 */
+		virtual void setCullingEnabled(bool enabled);
+		virtual bool isCullingEnabled() const;
+
+		/**
+		 * Sets whether the whole subtree is skipped when the entity is off screen. Default is false.
+		 * Only turn it on for containers whose children stay inside their contentSize, e.g. a tile chunk.
+		 */
+		virtual void setSubtreeCullingEnabled(bool enabled);
+		virtual bool isSubtreeCullingEnabled() const;
+
+		/**
+		 * Returns whether the world bounds intersect the visible rect of Renderer.
+		 * Always true when culling is disabled.
+		 */
+		virtual bool isInsideViewport();
+
+		/**
+		 * Renders the subtree once into a texture and draws that single quad until the cache is dirty. Default is false.
+		 * Meant for static HUDs and backgrounds. Only (0, 0, contentSize) is cached, set a content size that covers the children.
+		 * Changing a descendant through the Entity and Sprite setters marks the cache dirty, moving or scaling
+		 * this entity itself reuses the texture. The cache is rendered again after a GL context loss.
+		 */
+		virtual void setCacheAsTexture(bool cache);
+		virtual bool isCacheAsTexture() const;
+
+		/**
+		 * Re-render every ancestor (this entity included) that caches as texture.
+		 * Call it when the entity looks different through something the setters don't see, e.g. quads written by hand.
+		 */
+		void markCacheDirty();
+
+		/**
+		 * Request a redraw of the next frame. The setters call it already, call it for changes they don't see,
+		 * e.g. a shader animated by time. When no entity changed, the engine skips clear, visit and swap.
+		 */
+		static void markSceneDirty();
+		/** returns whether something changed since the last call, and starts a new frame. Called by the engine */
+		static bool clearSceneDirty();
+
         void setColor(const Color& color) override;
         void setColor(float red,float green,float blue) override;
         void setColor(float red,float green,float blue,float alpha) override;
@@ -803,8 +954,11 @@ class Entity : public Object,public IColorable,public IUpdatable
         float getAlpha() override;
 
         //handle Touch Trigger
+        /** touchable entities are registered in TouchPool, which hit tests them by world bounds */
         void setTouchable(bool able);
         bool isTouchable();
+        /** draw order of the last frame, used to find the top-most entity under a touch */
+        unsigned int getVisitOrder() const;
 
         virtual bool onTouchTrigger(TouchTrigger* trigger);
         virtual bool  dispatchTouchTrigger(TouchTrigger* trigger);
@@ -815,11 +969,24 @@ class Entity : public Object,public IColorable,public IUpdatable
 
 		/// helper that reorder a child
 		void insertChild(Entity* child, int z);
+		/** flags the child for the incremental path of sortAllChildren() */
+		void markChildReordered(Entity* child);
 
 		/// Removes a child, call child->onExit(), do cleanup, remove it from children array.
 		void detachChild(Entity *child, bool doCleanup);
 
+		/** flags the local transform and the caches of the ancestors dirty */
+		void setTransformDirty();
+		/** a change of this entity that its own cache doesn't hold: marks the scene and the caches above dirty */
+		void markParentDirty();
+		/** draws the children behind, self and the children in front */
+		void visitChildren(bool inside);
+		/** draws the cached texture, rendering the subtree into it first when needed */
+		void visitCached(bool inside);
+		/** refreshes the world matrices of a subtree that is not visited */
+		void updateChildrenWorldTransform(void);
 
+	public:
 		/** 
 		 * Returns the matrix that transform the entity's (local) space coordinates into the parent's space coordinates.
 		 * The matrix is in Pixels.
@@ -0,0 +1,171 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#ifndef _FK_ENTITY_POOL_H_
+#define _FK_ENTITY_POOL_H_
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include "2d/Entity.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+/** EntityPool keeps entities of one type alive between spawns.
+ *
+ * Spawning through obtain() and despawning through recycle() skips the allocation,
+ * the autorelease and the init of the entity, so whatever init set up (texture, GL program,
+ * quad, children) is reused as is. recycle() detaches the entity and calls Entity::reset().
+ *
+ * The pool holds one reference on every entity it created, in use or not, and releases them
+ * when it is destroyed. An entity removed from its parent without recycle() therefore stays
+ * alive until then; recycle it instead.
+ * Entities are neither created nor recycled thread safe, use the pool from the update thread.
+ *
+ * @code
+ * EntityPool<Sprite> pipes([tex]() { return Sprite::createWithTexture(tex); }, 8);
+ * Sprite* pipe = pipes.obtain();
+ * layer->addChild(pipe);
+ * ...
+ * pipes.recycle(pipe);
+ * @endcode
+ */
+template <class T>
+class EntityPool
+{
+    public:
+        /** returns an autoreleased entity, like T::create() */
+        typedef std::function<T*()> Creator;
+
+        /** entities made by T::create() */
+        explicit EntityPool(int capacity = 0)
+        : _creator([]() { return T::create(); })
+        {
+            prefill(capacity);
+        }
+
+        EntityPool(const Creator& creator, int capacity = 0)
+        : _creator(creator)
+        {
+            prefill(capacity);
+        }
+
+        ~EntityPool()
+        {
+            for (size_t i = 0; i < _entities.size(); i++)
+            {
+                _entities[i]->release();
+            }
+        }
+
+        /** creates entities until count of them are free, call it while loading rather than in the first spawn */
+        void prefill(int count)
+        {
+            while ((int)_free.size() < count)
+            {
+                T* entity = create();
+                if (entity == nullptr)
+                {
+                    return;
+                }
+                _free.push_back(entity);
+            }
+        }
+
+        /** a free entity, or a new one when none is left. It isn't autoreleased, the pool keeps it */
+        T* obtain()
+        {
+            if (_free.empty())
+            {
+                return create();
+            }
+            T* entity = _free.back();
+            _free.pop_back();
+            return entity;
+        }
+
+        /** detaches the entity from its parent, resets it and makes it free for obtain() */
+        void recycle(T* entity)
+        {
+            FKAssert(entity != nullptr, "EntityPool: entity must be non-nil");
+            FKAssert(std::find(_free.begin(), _free.end(), entity) == _free.end(), "EntityPool: entity recycled twice");
+
+            Entity* parent = entity->getParent();
+            if (parent != nullptr)
+            {
+                parent->removeChild(entity, true);
+            }
+            entity->reset();
+            _free.push_back(entity);
+        }
+
+        /** releases free entities until at most keep of them are left */
+        void trim(int keep = 0)
+        {
+            while ((int)_free.size() > keep)
+            {
+                T* entity = _free.back();
+                _free.pop_back();
+                _entities.erase(std::find(_entities.begin(), _entities.end(), entity));
+                entity->release();
+            }
+        }
+
+        inline int getFreeCount() const { return (int)_free.size(); }
+        /** free and in use */
+        inline int getCount() const { return (int)_entities.size(); }
+
+    protected:
+        T* create()
+        {
+            T* entity = _creator();
+            if (entity != nullptr)
+            {
+                entity->retain();
+                _entities.push_back(entity);
+            }
+            return entity;
+        }
+
+        Creator _creator;
+        std::vector<T*> _entities;
+        std::vector<T*> _free;
+
+    private:
+        EntityPool(const EntityPool&);
+        EntityPool& operator=(const EntityPool&);
+};
+
+// end of entity group
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,299 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <math.h>
+
+#include "macros.h"
+#include "base/lang/Str.h"
+#include "2d/InstancedSprites.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/renderer/Renderer.h"
+
+FLAKOR_NS_BEGIN
+
+InstancedSprites* InstancedSprites::createWithTexture(Texture2D* tex, int capacity/* = DEFAULT_CAPACITY*/)
+{
+    InstancedSprites *sprites = new (std::nothrow) InstancedSprites();
+    if (sprites && sprites->initWithTexture(tex, capacity))
+    {
+        sprites->autorelease();
+        return sprites;
+    }
+    FK_SAFE_DELETE(sprites);
+    return nullptr;
+}
+
+InstancedSprites* InstancedSprites::create(const std::string& fileImage, int capacity/* = DEFAULT_CAPACITY*/)
+{
+    InstancedSprites *sprites = new (std::nothrow) InstancedSprites();
+    if (sprites && sprites->initWithFile(fileImage, capacity))
+    {
+        sprites->autorelease();
+        return sprites;
+    }
+    FK_SAFE_DELETE(sprites);
+    return nullptr;
+}
+
+InstancedSprites::InstancedSprites()
+: _texture(nullptr)
+, _blendFunc(BlendFunc::ALPHA_PREMULTIPLIED)
+, _instancedProgram(nullptr)
+, _glProgram(nullptr)
+, _dirty(true)
+{
+}
+
+InstancedSprites::~InstancedSprites()
+{
+    FK_SAFE_RELEASE(_texture);
+}
+
+bool InstancedSprites::initWithTexture(Texture2D *tex, int capacity/* = DEFAULT_CAPACITY*/)
+{
+    FKAssert(tex != nullptr, "InstancedSprites: texture must be non-nil");
+    FKAssert(capacity >= 0, "Capacity must be >= 0");
+
+    if (!Entity::init())
+    {
+        return false;
+    }
+
+    setTexture(tex);
+    _instances.reserve(capacity);
+
+    // the programs are shared, the fallback one with sprites so it merges with them
+    _instancedProgram = ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED);
+    _glProgram = ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR);
+    return true;
+}
+
+bool InstancedSprites::initWithFile(const std::string& fileImage, int capacity/* = DEFAULT_CAPACITY*/)
+{
+    FKAssert(fileImage.size()>0, "Invalid filename for InstancedSprites");
+
+    // shared with every entity created from the same file, preloaded textures are found there too
+    Texture2D *texture = TextureManager::getInstance()->loadTexture(fileImage);
+    if (texture == nullptr)
+    {
+        return false;
+    }
+
+    return initWithTexture(texture, capacity);
+}
+
+void InstancedSprites::makeInstance(SpriteInstance* instance, const Point& position, const Size& size,
+        float rotation, const Rect& textureRect, const Color& color) const
+{
+    // clockwise like Entity
+    float radians = -FK_DEGREES_TO_RADIANS(rotation);
+    float c = cosf(radians);
+    float s = sinf(radians);
+
+    instance->a = c * size.width;
+    instance->b = s * size.width;
+    instance->c = -s * size.height;
+    instance->d = c * size.height;
+    // the center of the unit quad lands on position
+    instance->tx = position.x - (instance->a + instance->c) * 0.5f;
+    instance->ty = position.y - (instance->b + instance->d) * 0.5f;
+
+    float atlasWidth = (float)_texture->getPixelsWidth();
+    float atlasHeight = (float)_texture->getPixelsHeight();
+    float left = textureRect.origin.x / atlasWidth;
+    float right = (textureRect.origin.x + textureRect.size.width) / atlasWidth;
+    float top = textureRect.origin.y / atlasHeight;
+    float bottom = (textureRect.origin.y + textureRect.size.height) / atlasHeight;
+    instance->uvOrigin.u = left;
+    instance->uvOrigin.v = bottom;
+    instance->uvSize.u = right - left;
+    instance->uvSize.v = top - bottom;
+
+    // special opacity for premultiplied textures
+    float alpha = color.alpha;
+    float factor = _texture->hasPremultipliedAlpha() ? alpha : 1.0f;
+    instance->color.r = (GLubyte)(color.red * factor * 255.0f);
+    instance->color.g = (GLubyte)(color.green * factor * 255.0f);
+    instance->color.b = (GLubyte)(color.blue * factor * 255.0f);
+    instance->color.a = (GLubyte)(alpha * 255.0f);
+}
+
+int InstancedSprites::addInstance(const SpriteInstance& instance)
+{
+    _instances.push_back(instance);
+    markDirty();
+    return (int)_instances.size() - 1;
+}
+
+int InstancedSprites::addInstance(const Point& position, const Size& size, float rotation, const Rect& textureRect, const Color& color)
+{
+    SpriteInstance instance;
+    makeInstance(&instance, position, size, rotation, textureRect, color);
+    return addInstance(instance);
+}
+
+void InstancedSprites::setInstance(int index, const SpriteInstance& instance)
+{
+    FKAssert(index >= 0 && index < (int)_instances.size(), "InstancedSprites: index out of range");
+
+    _instances[index] = instance;
+    markDirty();
+}
+
+void InstancedSprites::removeInstance(int index)
+{
+    FKAssert(index >= 0 && index < (int)_instances.size(), "InstancedSprites: index out of range");
+
+    _instances[index] = _instances.back();
+    _instances.pop_back();
+    markDirty();
+}
+
+void InstancedSprites::removeAllInstances()
+{
+    _instances.clear();
+    markDirty();
+}
+
+void InstancedSprites::updateQuads()
+{
+    int count = (int)_instances.size();
+    _quads.resize(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        const SpriteInstance& in = _instances[i];
+        V3F_C4F_T2F_Quad& quad = _quads[i];
+
+        Color4F color4 = { in.color.r / 255.0f, in.color.g / 255.0f, in.color.b / 255.0f, in.color.a / 255.0f };
+        quad.bl.colors = color4;
+        quad.br.colors = color4;
+        quad.tl.colors = color4;
+        quad.tr.colors = color4;
+
+        quad.bl.vertices.x = in.tx;
+        quad.bl.vertices.y = in.ty;
+        quad.br.vertices.x = in.a + in.tx;
+        quad.br.vertices.y = in.b + in.ty;
+        quad.tl.vertices.x = in.c + in.tx;
+        quad.tl.vertices.y = in.d + in.ty;
+        quad.tr.vertices.x = in.a + in.c + in.tx;
+        quad.tr.vertices.y = in.b + in.d + in.ty;
+        quad.bl.vertices.z = quad.br.vertices.z = quad.tl.vertices.z = quad.tr.vertices.z = 0.0f;
+
+        quad.bl.texCoords = in.uvOrigin;
+        quad.br.texCoords.u = in.uvOrigin.u + in.uvSize.u;
+        quad.br.texCoords.v = in.uvOrigin.v;
+        quad.tl.texCoords.u = in.uvOrigin.u;
+        quad.tl.texCoords.v = in.uvOrigin.v + in.uvSize.v;
+        quad.tr.texCoords.u = in.uvOrigin.u + in.uvSize.u;
+        quad.tr.texCoords.v = in.uvOrigin.v + in.uvSize.v;
+    }
+}
+
+void InstancedSprites::draw(void)
+{
+    if (_instances.empty())
+    {
+        return;
+    }
+
+    // upload the texture if needed, this also marks it used for TextureManager
+    _texture->loadGL();
+
+    if (_instancedProgram != nullptr && InstanceCommand::isSupported())
+    {
+        if (_dirty)
+        {
+            _instanceCommand.setDirty();
+            _dirty = false;
+        }
+        _instanceCommand.init(vertexZ, _texture->getTextureID(), _instancedProgram, _blendFunc,
+                _instances.data(), (int)_instances.size(), worldMatrix);
+        Renderer::getInstance()->addCommand(&_instanceCommand);
+    }
+    else
+    {
+        // GLES2: expand once per change, Renderer splits big commands across batches
+        if (_dirty)
+        {
+            updateQuads();
+            _dirty = false;
+        }
+        _quadCommand.init(vertexZ, _texture->getTextureID(), _glProgram, _blendFunc,
+                _quads.data(), (int)_quads.size(), worldMatrix);
+        Renderer::getInstance()->addCommand(&_quadCommand);
+    }
+}
+
+void InstancedSprites::updateBlendFunc()
+{
+    if (! _texture->hasPremultipliedAlpha())
+    {
+        _blendFunc = BlendFunc::ALPHA_NON_PREMULTIPLIED;
+    }
+    else
+    {
+        _blendFunc = BlendFunc::ALPHA_PREMULTIPLIED;
+    }
+}
+
+// ITexture protocol
+void InstancedSprites::setBlendFunc(const BlendFunc &blendFunc)
+{
+    _blendFunc = blendFunc;
+}
+
+const BlendFunc& InstancedSprites::getBlendFunc() const
+{
+    return _blendFunc;
+}
+
+Texture2D* InstancedSprites::getTexture() const
+{
+    return _texture;
+}
+
+void InstancedSprites::setTexture(Texture2D *texture)
+{
+    FKAssert(texture != nullptr, "InstancedSprites: texture must be non-nil");
+
+    if (_texture != texture)
+    {
+        FK_SAFE_RETAIN(texture);
+        FK_SAFE_RELEASE(_texture);
+        _texture = texture;
+    }
+    updateBlendFunc();
+}
+
+String* InstancedSprites::toString() const
+{
+    return String::createWithFormat("<InstancedSprites | Tag = %d, Instances = %d>", tag, (int)_instances.size());
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,152 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#ifndef _FK_INSTANCED_SPRITES_H_
+#define _FK_INSTANCED_SPRITES_H_
+
+#include <vector>
+#include <string>
+
+#include "2d/Entity.h"
+#include "base/interface/ITexture.h"
+#include "core/opengl/renderer/InstanceCommand.h"
+#include "core/opengl/renderer/QuadCommand.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+class Texture2D;
+class GLProgram;
+
+/** InstancedSprites draws a crowd of lightweight sprites that share one texture.
+ *
+ * The sprites are not entities, they are SpriteInstance records (transform, texture rect, color)
+ * kept in one array, so tens of thousands of them cost no tree walk and no per sprite object.
+ *
+ * With OpenGL ES 3 they are drawn by one glDrawArraysInstanced (see InstanceCommand)
+ * and the CPU never builds quads. Without it the instances are expanded into quads once
+ * after each change and drawn through the batched QuadCommand path of Renderer.
+ *
+ * The instances are in entity space. Modify them with setInstance(), or write getInstances()
+ * directly and call markDirty() once per frame, which suits particle-like updates.
+ */
+class FK_DLL InstancedSprites : public Entity, public ITexture
+{
+    static const int DEFAULT_CAPACITY = 256;
+
+public:
+    /** Creates an InstancedSprites with a texture2d and an initial capacity of instances.
+     *
+     * @param tex A texture2d.
+     * @param capacity Instances reserved up front.
+     * @return Return an autorelease object.
+     */
+    static InstancedSprites* createWithTexture(Texture2D* tex, int capacity = DEFAULT_CAPACITY);
+
+    /** Creates an InstancedSprites with a file image (.png, .jpeg, .pvr, etc).
+     * The file will be loaded using the ResourceManager.
+     *
+     * @param fileImage A file image (.png, .jpeg, .pvr, etc).
+     * @param capacity Instances reserved up front.
+     * @return Return an autorelease object.
+     */
+    static InstancedSprites* create(const std::string& fileImage, int capacity = DEFAULT_CAPACITY);
+
+    /** Fills an instance centered at position.
+     *
+     * @param instance The instance to fill.
+     * @param position Center of the sprite, in entity space.
+     * @param size Size of the sprite.
+     * @param rotation Clockwise rotation in degrees, like Entity.
+     * @param textureRect Rect of the texture in pixels, origin at the top left like Sprite.
+     * @param color Vertex color.
+     */
+    void makeInstance(SpriteInstance* instance, const Point& position, const Size& size,
+            float rotation, const Rect& textureRect, const Color& color) const;
+
+    /** Appends an instance and returns its index. */
+    int addInstance(const SpriteInstance& instance);
+    int addInstance(const Point& position, const Size& size, float rotation, const Rect& textureRect, const Color& color);
+
+    /** Replaces the instance at index. */
+    void setInstance(int index, const SpriteInstance& instance);
+
+    /** Removes the instance at index, the last instance is moved into its place. */
+    void removeInstance(int index);
+    void removeAllInstances();
+
+    inline int getInstanceCount() const { return (int)_instances.size(); }
+
+    /** Instances for direct writes, call markDirty() after writing. */
+    inline SpriteInstance* getInstances() { return _instances.data(); }
+    inline void markDirty() { _dirty = true; markCacheDirty(); }
+
+    //
+    // Overrides
+    //
+    // ITexture
+    virtual Texture2D* getTexture() const override;
+    virtual void setTexture(Texture2D *texture) override;
+    virtual void setBlendFunc(const BlendFunc &blendFunc) override;
+    virtual const BlendFunc& getBlendFunc() const override;
+
+    // Entity
+    virtual void draw(void) override;
+    virtual String* toString() const override;
+
+protected:
+    InstancedSprites();
+    virtual ~InstancedSprites();
+
+    bool initWithTexture(Texture2D *tex, int capacity = DEFAULT_CAPACITY);
+    bool initWithFile(const std::string& fileImage, int capacity = DEFAULT_CAPACITY);
+
+    /** GLES2 path: turn every instance into a quad */
+    void updateQuads();
+    void updateBlendFunc();
+
+    Texture2D* _texture;
+    BlendFunc _blendFunc;
+    GLProgram* _instancedProgram;
+    GLProgram* _glProgram;
+
+    std::vector<SpriteInstance> _instances;
+    bool _dirty;
+
+    InstanceCommand _instanceCommand;
+    // fallback without instancing
+    std::vector<V3F_C4F_T2F_Quad> _quads;
+    QuadCommand _quadCommand;
+};
+
+// end of entity group
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,307 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#include <string.h>
+
+#include "macros.h"
+#include "base/lang/Str.h"
+#include "2d/Label.h"
+#include "core/opengl/texture/FontAtlas.h"
+#include "core/opengl/texture/TextureAtlas.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/renderer/Renderer.h"
+
+FLAKOR_NS_BEGIN
+
+/** decode UTF-8 into codepoints, invalid bytes become U+FFFD */
+static void decodeUTF8(const std::string& text, std::vector<unsigned int>& codepoints)
+{
+    codepoints.clear();
+
+    const unsigned char* s = (const unsigned char*)text.data();
+    const unsigned char* end = s + text.size();
+    while (s < end)
+    {
+        unsigned int c = *s++;
+        int extra = 0;
+        if (c >= 0xF8)
+        {
+            c = 0xFFFD;
+        }
+        else if (c >= 0xF0)
+        {
+            c &= 0x07;
+            extra = 3;
+        }
+        else if (c >= 0xE0)
+        {
+            c &= 0x0F;
+            extra = 2;
+        }
+        else if (c >= 0xC0)
+        {
+            c &= 0x1F;
+            extra = 1;
+        }
+        else if (c >= 0x80)
+        {
+            c = 0xFFFD;
+        }
+
+        for (; extra > 0; extra--)
+        {
+            if (s == end || (*s & 0xC0) != 0x80)
+            {
+                c = 0xFFFD;
+                break;
+            }
+            c = (c << 6) | (*s++ & 0x3F);
+        }
+        codepoints.push_back(c);
+    }
+}
+
+Label* Label::create(FontAtlas* fontAtlas, const std::string& text/* = ""*/)
+{
+    Label *label = new (std::nothrow) Label();
+    if (label && label->initWithFontAtlas(fontAtlas, text))
+    {
+        label->autorelease();
+        return label;
+    }
+    FK_SAFE_DELETE(label);
+    return nullptr;
+}
+
+Label::Label()
+: _fontAtlas(nullptr)
+, _textColor(Color::WHITE)
+, _blendFunc(BlendFunc::ALPHA_NON_PREMULTIPLIED)
+, _glProgram(nullptr)
+, _quads(nullptr)
+{
+}
+
+Label::~Label()
+{
+    // the quads hold the texture of the font atlas, release them first
+    FK_SAFE_RELEASE(_quads);
+    FK_SAFE_RELEASE(_fontAtlas);
+}
+
+bool Label::initWithFontAtlas(FontAtlas* fontAtlas, const std::string& text)
+{
+    FKAssert(fontAtlas != nullptr, "Label: fontAtlas must be non-nil");
+
+    if (!Entity::init())
+    {
+        return false;
+    }
+
+    _quads = TextureAtlas::create(fontAtlas->getTexture(), MAX((int)text.size(), 1));
+    if (_quads == nullptr)
+    {
+        return false;
+    }
+    _quads->retain();
+
+    fontAtlas->retain();
+    _fontAtlas = fontAtlas;
+
+    // the texture holds coverage or distance in alpha, the shaders turn it into a non premultiplied color
+    _glProgram = ShaderCache::getInstance()->getGLProgram(fontAtlas->isDistanceField() ?
+            GLProgram::SHADER_NAME_LABEL_DISTANCEFIELD_NORMAL : GLProgram::SHADER_NAME_LABEL_NORMAL);
+
+    setString(text);
+    return true;
+}
+
+void Label::setString(const std::string& text)
+{
+    if (_text == text && !_layout.empty())
+    {
+        return;
+    }
+
+    // assign() keeps the buffer when it is big enough
+    _text.assign(text);
+    updateLayout(false);
+}
+
+void Label::setTextColor(const Color& color)
+{
+    _textColor = color;
+    updateLayout(true);
+}
+
+void Label::updateLayout(bool force)
+{
+    decodeUTF8(_text, _codepoints);
+
+    int count = MIN((int)_codepoints.size(), (int)TextureAtlas::MAX_CAPACITY);
+    int oldCount = (int)_layout.size();
+    if (count > _quads->getCapacity())
+    {
+        _quads->resizeCapacity(MIN(MAX(count, _quads->getCapacity() * 4 / 3), (int)TextureAtlas::MAX_CAPACITY));
+        // the quads are kept, the GL buffer is reallocated in next draw
+    }
+
+    int lines = 1;
+    for (int i = 0; i < count; i++)
+    {
+        lines += _codepoints[i] == '\n';
+    }
+
+    float lineHeight = _fontAtlas->getLineHeight();
+    float baseline = lines * lineHeight - _fontAtlas->getAscender();
+    float x = 0.f;
+    float width = 0.f;
+    unsigned int previous = 0;
+
+    _layout.resize(count);
+    V3F_C4F_T2F_Quad quad;
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int codepoint = _codepoints[i];
+        GlyphLayout next;
+        next.codepoint = codepoint;
+
+        if (codepoint == '\n')
+        {
+            width = MAX(width, x);
+            next.x = x;
+            next.y = baseline;
+            x = 0.f;
+            baseline -= lineHeight;
+            previous = 0;
+        }
+        else
+        {
+            if (previous != 0)
+            {
+                x += _fontAtlas->getKerning(previous, codepoint);
+            }
+            next.x = x;
+            next.y = baseline;
+
+            const FontAtlas::Glyph* glyph = _fontAtlas->getGlyph(codepoint);
+            if (glyph != nullptr)
+            {
+                x += glyph->advance;
+            }
+            previous = codepoint;
+        }
+
+        // the same character at the same place keeps its quad
+        GlyphLayout& old = _layout[i];
+        if (force || i >= oldCount || old.codepoint != next.codepoint || old.x != next.x || old.y != next.y)
+        {
+            old = next;
+            makeQuad(next, &quad);
+            _quads->updateQuad(&quad, i);
+        }
+    }
+    width = MAX(width, x);
+
+    if (_quads->getTotalQuads() > count)
+    {
+        _quads->removeQuadsAtIndex(count, _quads->getTotalQuads() - count);
+    }
+
+    setContentSize(SizeMake(width, lines * lineHeight));
+    markCacheDirty();
+}
+
+void Label::makeQuad(const GlyphLayout& layout, V3F_C4F_T2F_Quad* quad)
+{
+    const FontAtlas::Glyph* glyph = layout.codepoint == '\n' ? nullptr : _fontAtlas->getGlyph(layout.codepoint);
+    if (glyph == nullptr || glyph->width <= 0.f)
+    {
+        // blanks keep a quad with no area so that quad i stays character i
+        memset(quad, 0, sizeof(*quad));
+        return;
+    }
+
+    float left = layout.x + glyph->x;
+    float bottom = layout.y + glyph->y;
+    float right = left + glyph->width;
+    float top = bottom + glyph->height;
+
+    quad->bl.vertices.x = left;
+    quad->bl.vertices.y = bottom;
+    quad->br.vertices.x = right;
+    quad->br.vertices.y = bottom;
+    quad->tl.vertices.x = left;
+    quad->tl.vertices.y = top;
+    quad->tr.vertices.x = right;
+    quad->tr.vertices.y = top;
+    quad->bl.vertices.z = quad->br.vertices.z = quad->tl.vertices.z = quad->tr.vertices.z = 0.0f;
+
+    quad->bl.texCoords.u = glyph->u0;
+    quad->bl.texCoords.v = glyph->v1;
+    quad->br.texCoords.u = glyph->u1;
+    quad->br.texCoords.v = glyph->v1;
+    quad->tl.texCoords.u = glyph->u0;
+    quad->tl.texCoords.v = glyph->v0;
+    quad->tr.texCoords.u = glyph->u1;
+    quad->tr.texCoords.v = glyph->v0;
+
+    Color4F color = { _textColor.red, _textColor.green, _textColor.blue, _textColor.alpha };
+    quad->bl.colors = quad->br.colors = quad->tl.colors = quad->tr.colors = color;
+}
+
+void Label::draw(void)
+{
+    if (_quads->getTotalQuads() == 0)
+    {
+        return;
+    }
+
+    // glyphs added since the last frame, usually nothing
+    _fontAtlas->uploadGL();
+
+    _batchCommand.init(vertexZ, _glProgram, _blendFunc, _quads, worldMatrix);
+    Renderer::getInstance()->addCommand(&_batchCommand);
+}
+
+// IBlendFunc protocol
+void Label::setBlendFunc(const BlendFunc &blendFunc)
+{
+    _blendFunc = blendFunc;
+    markCacheDirty();
+}
+
+const BlendFunc& Label::getBlendFunc() const
+{
+    return _blendFunc;
+}
+
+String* Label::toString() const
+{
+    return String::createWithFormat("<Label | Tag = %d, Text = %s>", tag, _text.c_str());
+}
+
+FLAKOR_NS_END
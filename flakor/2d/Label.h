@@ -0,0 +1,127 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#ifndef _FK_LABEL_H_
+#define _FK_LABEL_H_
+
+#include <vector>
+#include <string>
+
+#include "2d/Entity.h"
+#include "base/interface/ITexture.h"
+#include "core/opengl/renderer/BatchCommand.h"
+#include "core/opengl/renderer/RenderTypes.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+class FontAtlas;
+class TextureAtlas;
+class GLProgram;
+
+/** Label draws a UTF-8 string with the glyphs of a FontAtlas, one quad per character, in one draw call.
+ *
+ * The layout of every character (codepoint and pen position) is kept. setString() lays the new text out
+ * and only rewrites the quads whose character or position changed, the TextureAtlas then uploads
+ * just that range: a score that ticks every frame touches a digit or two and no texture.
+ * The string, the layout and the quads reuse their memory.
+ *
+ * '\n' starts a new line, lines are left aligned. A distance field FontAtlas is drawn with the
+ * distance field shader, it stays sharp when the label is scaled.
+ */
+class FK_DLL Label : public Entity, public IBlendFunc
+{
+public:
+    /** Creates a Label.
+     *
+     * @param fontAtlas Glyphs and metrics, it is retained.
+     * @param text UTF-8 text.
+     * @return Return an autorelease object.
+     */
+    static Label* create(FontAtlas* fontAtlas, const std::string& text = "");
+
+    /** Changes the text, the characters that didn't move keep their quads. */
+    void setString(const std::string& text);
+    inline const std::string& getString() const { return _text; }
+
+    void setTextColor(const Color& color);
+    inline const Color& getTextColor() const { return _textColor; }
+
+    inline FontAtlas* getFontAtlas() const { return _fontAtlas; }
+
+    //
+    // Overrides
+    //
+    // IBlendFunc
+    virtual void setBlendFunc(const BlendFunc &blendFunc) override;
+    virtual const BlendFunc& getBlendFunc() const override;
+
+    // Entity
+    virtual void draw(void) override;
+    virtual String* toString() const override;
+
+protected:
+    /** what a quad shows, compared to find the quads that must be rewritten */
+    struct GlyphLayout
+    {
+        unsigned int codepoint;
+        float x;
+        float y;
+    };
+
+    Label();
+    virtual ~Label();
+
+    bool initWithFontAtlas(FontAtlas* fontAtlas, const std::string& text);
+
+    /** lay _text out, force rewrites every quad */
+    void updateLayout(bool force);
+    void makeQuad(const GlyphLayout& layout, V3F_C4F_T2F_Quad* quad);
+
+    FontAtlas* _fontAtlas;
+    std::string _text;
+    Color _textColor;
+    BlendFunc _blendFunc;
+    GLProgram* _glProgram;
+
+    /** decoded _text, kept to reuse its memory */
+    std::vector<unsigned int> _codepoints;
+    /** one per codepoint, index i is quad i */
+    std::vector<GlyphLayout> _layout;
+
+    TextureAtlas* _quads;
+    BatchCommand _batchCommand;
+};
+
+// end of entity group
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
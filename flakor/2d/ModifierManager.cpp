@@ -0,0 +1,572 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#include <math.h>
+
+#include "targetMacros.h"
+#include "2d/ModifierManager.h"
+
+FLAKOR_NS_BEGIN
+
+// MARK: ModifierBuilder
+
+ModifierBuilder::ModifierBuilder(ModifierManager* manager, Entity* target, unsigned int group)
+: _manager(manager)
+, _target(target)
+, _group(group)
+, _cursor(0.f)
+, _end(0.f)
+, _last(0)
+{
+}
+
+ModifierBuilder& ModifierBuilder::add(int property, int mode, float duration, float x, float y, Ease ease)
+{
+    ModifierManager::Tween tween;
+    tween.target = _target;
+    tween.id = 0;
+    tween.group = _group;
+    tween.delay = _cursor;
+    tween.elapsed = 0.f;
+    tween.duration = MAX(duration, 0.f);
+    tween.from[0] = tween.from[1] = 0.f;
+    tween.to[0] = x;
+    tween.to[1] = y;
+    tween.callback = nullptr;
+    tween.callbackData = nullptr;
+    tween.property = (unsigned char)property;
+    tween.mode = (unsigned char)mode;
+    tween.ease = (unsigned char)ease;
+    tween.started = false;
+
+    unsigned int id = _manager->add(tween);
+    float end = _cursor + tween.duration;
+    if (_last == 0 || end >= _end)
+    {
+        _end = end;
+        _last = id;
+    }
+    return *this;
+}
+
+ModifierBuilder& ModifierBuilder::moveTo(float duration, const Point& position, Ease ease)
+{
+    return add(ModifierManager::POSITION, ModifierManager::TO, duration, position.x, position.y, ease);
+}
+
+ModifierBuilder& ModifierBuilder::moveBy(float duration, const Point& delta, Ease ease)
+{
+    return add(ModifierManager::POSITION, ModifierManager::BY, duration, delta.x, delta.y, ease);
+}
+
+ModifierBuilder& ModifierBuilder::scaleTo(float duration, float scaleX, float scaleY, Ease ease)
+{
+    return add(ModifierManager::SCALE, ModifierManager::TO, duration, scaleX, scaleY, ease);
+}
+
+ModifierBuilder& ModifierBuilder::scaleBy(float duration, float deltaX, float deltaY, Ease ease)
+{
+    return add(ModifierManager::SCALE, ModifierManager::BY, duration, deltaX, deltaY, ease);
+}
+
+ModifierBuilder& ModifierBuilder::rotateTo(float duration, float rotation, Ease ease)
+{
+    return add(ModifierManager::ROTATION, ModifierManager::TO, duration, rotation, rotation, ease);
+}
+
+ModifierBuilder& ModifierBuilder::rotateBy(float duration, float delta, Ease ease)
+{
+    return add(ModifierManager::ROTATION, ModifierManager::BY, duration, delta, delta, ease);
+}
+
+ModifierBuilder& ModifierBuilder::fadeTo(float duration, float alpha, Ease ease)
+{
+    return add(ModifierManager::ALPHA, ModifierManager::TO, duration, alpha, alpha, ease);
+}
+
+ModifierBuilder& ModifierBuilder::delay(float seconds)
+{
+    // the wait is a record of its own, so a trailing delay moves _last and onFinished() with it
+    add(ModifierManager::WAIT, ModifierManager::TO, seconds, 0.f, 0.f, Ease::LINEAR);
+    _cursor += MAX(seconds, 0.f);
+    return *this;
+}
+
+ModifierBuilder& ModifierBuilder::then()
+{
+    _cursor = _end;
+    return *this;
+}
+
+ModifierBuilder& ModifierBuilder::onFinished(ModifierCallback callback, void* data)
+{
+    ModifierManager::Tween* tween = _manager->find(_last);
+    if (tween != nullptr)
+    {
+        tween->callback = callback;
+        tween->callbackData = data;
+    }
+    return *this;
+}
+
+// MARK: ModifierManager
+
+ModifierManager* ModifierManager::s_sharedModifierManager = nullptr;
+
+ModifierManager* ModifierManager::getInstance()
+{
+    if (s_sharedModifierManager == nullptr)
+    {
+        s_sharedModifierManager = new (std::nothrow) ModifierManager();
+    }
+    return s_sharedModifierManager;
+}
+
+void ModifierManager::destroyInstance()
+{
+    FK_SAFE_DELETE(s_sharedModifierManager);
+}
+
+ModifierManager::ModifierManager()
+: _tweens()
+, _pending()
+, _finished()
+, _customs()
+, _serial(0)
+, _count(0)
+, _updating(false)
+{
+    _tweens.reserve(256);
+}
+
+ModifierManager::~ModifierManager()
+{
+    reset();
+}
+
+ModifierBuilder ModifierManager::modify(Entity* target)
+{
+    FKAssert(target != nullptr, "ModifierManager: target can't be NULL");
+    return ModifierBuilder(this, target, ++_serial);
+}
+
+unsigned int ModifierManager::add(const Tween& tween)
+{
+    std::vector<Tween>& tweens = _updating ? _pending : _tweens;
+    tweens.push_back(tween);
+    tweens.back().id = ++_serial;
+    tween.target->runningModifiers++;
+    _count++;
+    return tweens.back().id;
+}
+
+ModifierManager::Tween* ModifierManager::find(unsigned int id)
+{
+    // builders look up what they just added, search from the back
+    std::vector<Tween>* lists[2] = { &_pending, &_tweens };
+    for (int l = 0; l < 2; l++)
+    {
+        std::vector<Tween>& tweens = *lists[l];
+        for (int i = (int)tweens.size() - 1; i >= 0; i--)
+        {
+            if (tweens[i].id == id && tweens[i].target != nullptr)
+            {
+                return &tweens[i];
+            }
+        }
+    }
+    return nullptr;
+}
+
+void ModifierManager::addModifier(IModifier<Entity*>* modifier, Entity* target)
+{
+    FKAssert(modifier != nullptr && target != nullptr, "ModifierManager: modifier and target can't be NULL");
+    Custom custom = { modifier, target };
+    _customs.push_back(custom);
+    target->runningModifiers++;
+}
+
+void ModifierManager::removeModifier(IModifier<Entity*>* modifier)
+{
+    for (size_t i = 0; i < _customs.size(); i++)
+    {
+        if (_customs[i].modifier == modifier && _customs[i].target != nullptr)
+        {
+            _customs[i].target->runningModifiers--;
+            _customs[i].target = nullptr;
+        }
+    }
+}
+
+void ModifierManager::cancel(unsigned int group)
+{
+    std::vector<Tween>* lists[2] = { &_tweens, &_pending };
+    for (int l = 0; l < 2; l++)
+    {
+        std::vector<Tween>& tweens = *lists[l];
+        for (size_t i = 0; i < tweens.size(); i++)
+        {
+            Tween& tween = tweens[i];
+            if (tween.group == group && tween.target != nullptr)
+            {
+                tween.target->runningModifiers--;
+                tween.target = nullptr;
+                _count--;
+            }
+        }
+    }
+}
+
+void ModifierManager::cancel(Entity* target)
+{
+    if (target == nullptr || target->runningModifiers <= 0)
+    {
+        return;
+    }
+
+    std::vector<Tween>* lists[2] = { &_tweens, &_pending };
+    for (int l = 0; l < 2; l++)
+    {
+        std::vector<Tween>& tweens = *lists[l];
+        for (size_t i = 0; i < tweens.size(); i++)
+        {
+            if (tweens[i].target == target)
+            {
+                tweens[i].target = nullptr;
+                _count--;
+            }
+        }
+    }
+    for (size_t i = 0; i < _customs.size(); i++)
+    {
+        if (_customs[i].target == target)
+        {
+            _customs[i].target = nullptr;
+        }
+    }
+    target->runningModifiers = 0;
+}
+
+void ModifierManager::reset()
+{
+    for (size_t i = 0; i < _tweens.size(); i++)
+    {
+        cancel(_tweens[i].target);
+    }
+    for (size_t i = 0; i < _pending.size(); i++)
+    {
+        cancel(_pending[i].target);
+    }
+    for (size_t i = 0; i < _customs.size(); i++)
+    {
+        cancel(_customs[i].target);
+    }
+    // keep the storage, the next scene tweens as much
+    _tweens.clear();
+    _pending.clear();
+    _finished.clear();
+    _customs.clear();
+    _count = 0;
+}
+
+float ModifierManager::ease(Ease ease, float t)
+{
+    switch (ease)
+    {
+        case Ease::LINEAR:
+            return t;
+        case Ease::QUAD_IN:
+            return t * t;
+        case Ease::QUAD_OUT:
+            return t * (2.f - t);
+        case Ease::QUAD_IN_OUT:
+            return t < 0.5f ? 2.f * t * t : -1.f + (4.f - 2.f * t) * t;
+        case Ease::CUBIC_IN:
+            return t * t * t;
+        case Ease::CUBIC_OUT:
+        {
+            float f = t - 1.f;
+            return f * f * f + 1.f;
+        }
+        case Ease::CUBIC_IN_OUT:
+        {
+            if (t < 0.5f)
+            {
+                return 4.f * t * t * t;
+            }
+            float f = 2.f * t - 2.f;
+            return 0.5f * f * f * f + 1.f;
+        }
+        case Ease::SINE_IN:
+            return 1.f - cosf(t * (float)M_PI_2);
+        case Ease::SINE_OUT:
+            return sinf(t * (float)M_PI_2);
+        case Ease::SINE_IN_OUT:
+            return 0.5f * (1.f - cosf(t * (float)M_PI));
+        case Ease::BACK_IN:
+        {
+            const float s = 1.70158f;
+            return t * t * ((s + 1.f) * t - s);
+        }
+        case Ease::BACK_OUT:
+        {
+            const float s = 1.70158f;
+            float f = t - 1.f;
+            return f * f * ((s + 1.f) * f + s) + 1.f;
+        }
+        case Ease::ELASTIC_OUT:
+        {
+            if (t <= 0.f || t >= 1.f)
+            {
+                return t;
+            }
+            const float period = 0.3f;
+            return powf(2.f, -10.f * t) * sinf((t - period / 4.f) * (2.f * (float)M_PI) / period) + 1.f;
+        }
+        case Ease::BOUNCE_OUT:
+        {
+            if (t < 1.f / 2.75f)
+            {
+                return 7.5625f * t * t;
+            }
+            else if (t < 2.f / 2.75f)
+            {
+                t -= 1.5f / 2.75f;
+                return 7.5625f * t * t + 0.75f;
+            }
+            else if (t < 2.5f / 2.75f)
+            {
+                t -= 2.25f / 2.75f;
+                return 7.5625f * t * t + 0.9375f;
+            }
+            t -= 2.625f / 2.75f;
+            return 7.5625f * t * t + 0.984375f;
+        }
+    }
+    return t;
+}
+
+void ModifierManager::start(Tween& tween)
+{
+    Entity* target = tween.target;
+    switch (tween.property)
+    {
+        case POSITION:
+            tween.from[0] = target->position.x;
+            tween.from[1] = target->position.y;
+            break;
+        case SCALE:
+            tween.from[0] = target->scaleX;
+            tween.from[1] = target->scaleY;
+            break;
+        case ROTATION:
+            tween.from[0] = tween.from[1] = target->rotationX;
+            break;
+        case ALPHA:
+            tween.from[0] = tween.from[1] = target->color.alpha;
+            break;
+        case WAIT:
+            break;
+    }
+    if (tween.mode == BY)
+    {
+        tween.to[0] += tween.from[0];
+        tween.to[1] += tween.from[1];
+    }
+    tween.started = true;
+}
+
+void ModifierManager::apply(Tween& tween, float k)
+{
+    Entity* target = tween.target;
+    float x = tween.from[0] + (tween.to[0] - tween.from[0]) * k;
+    float y = tween.from[1] + (tween.to[1] - tween.from[1]) * k;
+
+    switch (tween.property)
+    {
+        case POSITION:
+            if (target->transformObserved)
+            {
+                target->setPosition(x, y);
+            }
+            else
+            {
+                target->position.x = x;
+                target->position.y = y;
+                target->setTransformDirty();
+            }
+            break;
+        case SCALE:
+            if (target->transformObserved)
+            {
+                target->setScale(x, y);
+            }
+            else
+            {
+                target->scaleX = x;
+                target->scaleY = y;
+                target->setTransformDirty();
+            }
+            break;
+        case ROTATION:
+            if (target->transformObserved)
+            {
+                target->setRotation(x);
+            }
+            else
+            {
+                target->rotationX = target->rotationY = x;
+                target->setTransformDirty();
+            }
+            break;
+        case ALPHA:
+            // sprites copy the color into their quads
+            target->setAlpha(x);
+            break;
+        case WAIT:
+            break;
+    }
+}
+
+void ModifierManager::onUpdate(float delta)
+{
+    _updating = true;
+
+    // one pass: step the live records and compact them towards the front, order stays so that
+    // a step of a sequence starts from the values the step before wrote in the same frame
+    size_t count = _tweens.size();
+    size_t alive = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        Tween& tween = _tweens[i];
+        if (tween.target == nullptr)
+        {
+            continue;
+        }
+
+        float step = delta;
+        if (tween.delay > 0.f)
+        {
+            tween.delay -= delta;
+            if (tween.delay > 0.f)
+            {
+                if (alive != i)
+                {
+                    _tweens[alive] = tween;
+                }
+                alive++;
+                continue;
+            }
+            // the part of the frame after the delay ran out
+            step = -tween.delay;
+            tween.delay = 0.f;
+        }
+
+        if (!tween.started)
+        {
+            start(tween);
+        }
+
+        tween.elapsed += step;
+        float progress = tween.duration > 0.f ? MIN(tween.elapsed / tween.duration, 1.f) : 1.f;
+        apply(tween, ease((Ease)tween.ease, progress));
+
+        if (progress >= 1.f)
+        {
+            tween.target->runningModifiers--;
+            _count--;
+            if (tween.callback != nullptr)
+            {
+                _finished.push_back(tween);
+            }
+            continue;
+        }
+
+        if (alive != i)
+        {
+            _tweens[alive] = tween;
+        }
+        alive++;
+    }
+    _tweens.resize(alive);
+
+    _updating = false;
+
+    updateCustom(delta);
+
+    // callbacks may add or cancel tweens, run them on the compacted list
+    for (size_t i = 0; i < _finished.size(); i++)
+    {
+        _finished[i].callback(_finished[i].target, _finished[i].callbackData);
+    }
+    _finished.clear();
+
+    if (!_pending.empty())
+    {
+        for (size_t i = 0; i < _pending.size(); i++)
+        {
+            if (_pending[i].target != nullptr)
+            {
+                _tweens.push_back(_pending[i]);
+            }
+        }
+        _pending.clear();
+    }
+}
+
+void ModifierManager::updateCustom(float delta)
+{
+    if (_customs.empty())
+    {
+        return;
+    }
+
+    // custom modifiers may add others while they update, go by index
+    size_t alive = 0;
+    for (size_t i = 0; i < _customs.size(); i++)
+    {
+        Custom custom = _customs[i];
+        if (custom.target == nullptr)
+        {
+            continue;
+        }
+
+        custom.modifier->onUpdate(delta, custom.target);
+        if (_customs[i].target == nullptr)
+        {
+            // removed itself
+            continue;
+        }
+        if (custom.modifier->isFinished() && custom.modifier->isAutoUnregisterWhenFinished())
+        {
+            custom.target->runningModifiers--;
+            continue;
+        }
+        _customs[alive++] = custom;
+    }
+    _customs.resize(alive);
+}
+
+FLAKOR_NS_END
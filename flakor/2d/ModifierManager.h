@@ -0,0 +1,233 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#ifndef _FK_MODIFIER_MANAGER_H_
+#define _FK_MODIFIER_MANAGER_H_
+
+#include <vector>
+
+#include "2d/Entity.h"
+#include "base/interface/IModifier.h"
+#include "base/interface/IUpdatable.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+/** easing curves of the pooled tweens */
+enum class Ease
+{
+    LINEAR,
+    QUAD_IN,
+    QUAD_OUT,
+    QUAD_IN_OUT,
+    CUBIC_IN,
+    CUBIC_OUT,
+    CUBIC_IN_OUT,
+    SINE_IN,
+    SINE_OUT,
+    SINE_IN_OUT,
+    BACK_IN,
+    BACK_OUT,
+    ELASTIC_OUT,
+    BOUNCE_OUT,
+};
+
+/** called on the update thread after the last tween of a group finished */
+typedef void (*ModifierCallback)(Entity* target, void* data);
+
+class ModifierManager;
+
+/** ModifierBuilder queues the tweens of one entity, see ModifierManager::modify().
+ *
+ * Tweens added one after the other run in parallel, then() starts a new step of the
+ * sequence once everything added so far is done. All tweens of a builder share one group,
+ * getGroup() cancels them together.
+ */
+class FK_DLL ModifierBuilder
+{
+public:
+    ModifierBuilder& moveTo(float duration, const Point& position, Ease ease = Ease::LINEAR);
+    ModifierBuilder& moveBy(float duration, const Point& delta, Ease ease = Ease::LINEAR);
+    ModifierBuilder& scaleTo(float duration, float scaleX, float scaleY, Ease ease = Ease::LINEAR);
+    ModifierBuilder& scaleBy(float duration, float deltaX, float deltaY, Ease ease = Ease::LINEAR);
+    /** rotation in degrees, X and Y together like Entity::setRotation() */
+    ModifierBuilder& rotateTo(float duration, float rotation, Ease ease = Ease::LINEAR);
+    ModifierBuilder& rotateBy(float duration, float delta, Ease ease = Ease::LINEAR);
+    ModifierBuilder& fadeTo(float duration, float alpha, Ease ease = Ease::LINEAR);
+
+    /** waits before the next tween of the current step, a trailing delay holds back onFinished() */
+    ModifierBuilder& delay(float seconds);
+    /** the following tweens start when all tweens added so far are finished */
+    ModifierBuilder& then();
+    /** callback when the group is done, not called when it is cancelled */
+    ModifierBuilder& onFinished(ModifierCallback callback, void* data = nullptr);
+
+    inline unsigned int getGroup() const { return _group; }
+    /** seconds until the whole group is done */
+    inline float getDuration() const { return _end; }
+
+protected:
+    friend class ModifierManager;
+    ModifierBuilder(ModifierManager* manager, Entity* target, unsigned int group);
+
+    ModifierBuilder& add(int property, int mode, float duration, float x, float y, Ease ease);
+
+    ModifierManager* _manager;
+    Entity* _target;
+    unsigned int _group;
+    /** start of the next tween in the current step */
+    float _cursor;
+    /** end of the latest tween */
+    float _end;
+    /** the tween ending last carries the callback of the group */
+    unsigned int _last;
+};
+
+/** ModifierManager steps every move/scale/rotate/fade tween of the game in one pass.
+ *
+ * A tween is a plain record in one contiguous vector, not an object: onUpdate() loops over
+ * the records, eases with a switch and writes the Entity fields directly, followed by the
+ * dirty flags the setters would set. Finished and cancelled records are compacted in the
+ * same pass and the vector keeps its storage, so a running game doesn't allocate per tween.
+ * Entities that have to see every change (sprites in a SpriteBatch) are driven through
+ * their virtual setters, alpha always goes through setAlpha().
+ *
+ * Custom IModifier objects can be added as well, they are stepped after the pooled tweens.
+ *
+ * Tweens don't retain their entity, destroying or reset() of the entity cancels them.
+ * Use the manager from the update thread only.
+ *
+ * @code
+ * ModifierManager::getInstance()->modify(button)
+ *     .scaleTo(0.1f, 1.2f, 1.2f, Ease::QUAD_OUT)
+ *     .fadeTo(0.1f, 1.f)
+ *     .then()
+ *     .scaleTo(0.2f, 1.f, 1.f, Ease::BACK_OUT);
+ * @endcode
+ */
+class FK_DLL ModifierManager : public IUpdatable
+{
+public:
+    static ModifierManager* getInstance();
+    static void destroyInstance();
+
+    /** starts tweens on target, they begin in the next onUpdate() */
+    ModifierBuilder modify(Entity* target);
+
+    /** steps custom modifier on target every frame until it is finished, it isn't owned */
+    void addModifier(IModifier<Entity*>* modifier, Entity* target);
+    void removeModifier(IModifier<Entity*>* modifier);
+
+    /** stops the tweens of a group where they are, no callback */
+    void cancel(unsigned int group);
+    /** stops every tween and custom modifier of target */
+    void cancel(Entity* target);
+
+    /** tweens queued or running */
+    inline int getCount() const { return _count; }
+
+    /** steps everything by delta seconds */
+    void onUpdate(float delta) override;
+    /** drops every tween and custom modifier */
+    void reset() override;
+
+    /** eases progress 0..1 */
+    static float ease(Ease ease, float progress);
+
+protected:
+    friend class ModifierBuilder;
+
+    enum Property
+    {
+        POSITION,
+        SCALE,
+        ROTATION,
+        ALPHA,
+        WAIT,       // writes nothing, holds the end of a step for delay()
+    };
+
+    enum Mode
+    {
+        TO,
+        BY,
+    };
+
+    struct Tween
+    {
+        /** NULL once cancelled, removed in the next pass */
+        Entity* target;
+        unsigned int id;
+        unsigned int group;
+        /** seconds left before it starts */
+        float delay;
+        float elapsed;
+        float duration;
+        float from[2];
+        float to[2];
+        ModifierCallback callback;
+        void* callbackData;
+        unsigned char property;
+        unsigned char mode;
+        unsigned char ease;
+        bool started;
+    };
+
+    struct Custom
+    {
+        IModifier<Entity*>* modifier;
+        Entity* target;
+    };
+
+    ModifierManager();
+    ~ModifierManager();
+
+    unsigned int add(const Tween& tween);
+    Tween* find(unsigned int id);
+    /** captures the start values, a BY tween becomes a TO tween from there */
+    void start(Tween& tween);
+    void apply(Tween& tween, float k);
+    void updateCustom(float delta);
+
+    std::vector<Tween> _tweens;
+    /** tweens added while onUpdate() runs, appended after the pass */
+    std::vector<Tween> _pending;
+    std::vector<Tween> _finished;
+    std::vector<Custom> _customs;
+    unsigned int _serial;
+    int _count;
+    bool _updating;
+
+    static ModifierManager* s_sharedModifierManager;
+};
+
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
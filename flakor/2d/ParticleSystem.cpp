@@ -0,0 +1,603 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "base/lang/Str.h"
+#include "base/update/JobSystem.h"
+#include "2d/ParticleSystem.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureAtlas.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/renderer/Renderer.h"
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+#include "base/config/cpu-features.h"
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__)
+#define FK_PARTICLES_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE__) || defined(__x86_64__)
+#define FK_PARTICLES_SSE 1
+#include <xmmintrin.h>
+#endif
+
+FLAKOR_NS_BEGIN
+
+// MARK: kernels
+// streams are padded to a multiple of 4 floats, the SIMD kernels never need a scalar tail
+
+struct ParticleKernels
+{
+    const char* name;
+    /** vel += accel * dt, pos += vel * dt */
+    void (*integrate)(float* pos, float* vel, float accel, float dt, int count);
+    /** values += deltas * dt */
+    void (*advance)(float* values, const float* deltas, float dt, int count);
+    /** values += amount */
+    void (*add)(float* values, float amount, int count);
+};
+
+static void integrateScalar(float* pos, float* vel, float accel, float dt, int count)
+{
+    float dv = accel * dt;
+    for (int i = 0; i < count; i++)
+    {
+        vel[i] += dv;
+        pos[i] += vel[i] * dt;
+    }
+}
+
+static void advanceScalar(float* values, const float* deltas, float dt, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        values[i] += deltas[i] * dt;
+    }
+}
+
+static void addScalar(float* values, float amount, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        values[i] += amount;
+    }
+}
+
+static const ParticleKernels s_scalarKernels = { "scalar", integrateScalar, advanceScalar, addScalar };
+
+#if FK_PARTICLES_NEON
+static void integrateNEON(float* pos, float* vel, float accel, float dt, int count)
+{
+    float32x4_t dv = vdupq_n_f32(accel * dt);
+    float32x4_t t = vdupq_n_f32(dt);
+    for (int i = 0; i < count; i += 4)
+    {
+        float32x4_t v = vaddq_f32(vld1q_f32(vel + i), dv);
+        vst1q_f32(vel + i, v);
+        vst1q_f32(pos + i, vmlaq_f32(vld1q_f32(pos + i), v, t));
+    }
+}
+
+static void advanceNEON(float* values, const float* deltas, float dt, int count)
+{
+    float32x4_t t = vdupq_n_f32(dt);
+    for (int i = 0; i < count; i += 4)
+    {
+        vst1q_f32(values + i, vmlaq_f32(vld1q_f32(values + i), vld1q_f32(deltas + i), t));
+    }
+}
+
+static void addNEON(float* values, float amount, int count)
+{
+    float32x4_t a = vdupq_n_f32(amount);
+    for (int i = 0; i < count; i += 4)
+    {
+        vst1q_f32(values + i, vaddq_f32(vld1q_f32(values + i), a));
+    }
+}
+
+static const ParticleKernels s_simdKernels = { "neon", integrateNEON, advanceNEON, addNEON };
+#elif FK_PARTICLES_SSE
+static void integrateSSE(float* pos, float* vel, float accel, float dt, int count)
+{
+    __m128 dv = _mm_set1_ps(accel * dt);
+    __m128 t = _mm_set1_ps(dt);
+    for (int i = 0; i < count; i += 4)
+    {
+        __m128 v = _mm_add_ps(_mm_loadu_ps(vel + i), dv);
+        _mm_storeu_ps(vel + i, v);
+        _mm_storeu_ps(pos + i, _mm_add_ps(_mm_loadu_ps(pos + i), _mm_mul_ps(v, t)));
+    }
+}
+
+static void advanceSSE(float* values, const float* deltas, float dt, int count)
+{
+    __m128 t = _mm_set1_ps(dt);
+    for (int i = 0; i < count; i += 4)
+    {
+        _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), _mm_mul_ps(_mm_loadu_ps(deltas + i), t)));
+    }
+}
+
+static void addSSE(float* values, float amount, int count)
+{
+    __m128 a = _mm_set1_ps(amount);
+    for (int i = 0; i < count; i += 4)
+    {
+        _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), a));
+    }
+}
+
+static const ParticleKernels s_simdKernels = { "sse", integrateSSE, advanceSSE, addSSE };
+#endif
+
+static const ParticleKernels* selectKernels()
+{
+#if FK_PARTICLES_NEON || FK_PARTICLES_SSE
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+    // armeabi-v7a doesn't promise NEON, arm64 and the x86 ABIs always have their SIMD unit
+    AndroidCpuFamily family = android_getCpuFamily();
+    uint64_t features = android_getCpuFeatures();
+    bool simd = family == ANDROID_CPU_FAMILY_ARM64 || family == ANDROID_CPU_FAMILY_X86 || family == ANDROID_CPU_FAMILY_X86_64
+            || (family == ANDROID_CPU_FAMILY_ARM && (features & ANDROID_CPU_ARM_FEATURE_NEON) != 0);
+    if (!simd)
+    {
+        return &s_scalarKernels;
+    }
+#endif
+    return &s_simdKernels;
+#else
+    return &s_scalarKernels;
+#endif
+}
+
+static const ParticleKernels* kernels()
+{
+    static const ParticleKernels* s_kernels = selectKernels();
+    return s_kernels;
+}
+
+const char* ParticleSystem::getKernelName()
+{
+    return kernels()->name;
+}
+
+// MARK: ParticleSystem
+
+ParticleSystem* ParticleSystem::createWithTexture(Texture2D* tex, int totalParticles)
+{
+    ParticleSystem *system = new (std::nothrow) ParticleSystem();
+    if (system && system->initWithTexture(tex, totalParticles))
+    {
+        system->autorelease();
+        return system;
+    }
+    FK_SAFE_DELETE(system);
+    return nullptr;
+}
+
+ParticleSystem* ParticleSystem::create(const std::string& fileImage, int totalParticles)
+{
+    ParticleSystem *system = new (std::nothrow) ParticleSystem();
+    if (system && system->initWithFile(fileImage, totalParticles))
+    {
+        system->autorelease();
+        return system;
+    }
+    FK_SAFE_DELETE(system);
+    return nullptr;
+}
+
+ParticleSystem::ParticleSystem()
+: _texture(nullptr)
+, _blendFunc(BlendFunc::ALPHA_PREMULTIPLIED)
+, _glProgram(nullptr)
+, _totalParticles(0)
+, _particleCount(0)
+, _block(nullptr)
+, _active(true)
+, _quadsDirty(false)
+, _elapsed(0.0f)
+, _emitCounter(0.0f)
+, _seed(0x9E3779B9u)
+, _duration(-1.0f)
+, _emissionRate(0.0f)
+, _life(1.0f), _lifeVar(0.0f)
+, _speed(0.0f), _speedVar(0.0f)
+, _angle(90.0f), _angleVar(0.0f)
+, _posVar(PointZero)
+, _gravity(PointZero)
+, _startSize(8.0f), _endSize(8.0f), _sizeVar(0.0f)
+, _startColor(Color::WHITE)
+, _endColor(Color::WHITE)
+{
+    memset(_streams, 0, sizeof(_streams));
+}
+
+ParticleSystem::~ParticleSystem()
+{
+    for (size_t i = 0; i < _pages.size(); i++)
+    {
+        FK_SAFE_RELEASE(_pages[i]);
+    }
+    free(_block);
+    FK_SAFE_RELEASE(_texture);
+}
+
+bool ParticleSystem::initWithTexture(Texture2D *tex, int totalParticles)
+{
+    FKAssert(tex != nullptr, "ParticleSystem: texture must be non-nil");
+    FKAssert(totalParticles > 0, "ParticleSystem: totalParticles must be > 0");
+
+    if (!Entity::init())
+    {
+        return false;
+    }
+
+    int stride = (totalParticles + 3) & ~3;
+    _block = (float *)calloc(stride * STREAM_COUNT, sizeof(float));
+    if (_block == nullptr)
+    {
+        return false;
+    }
+    for (int i = 0; i < STREAM_COUNT; i++)
+    {
+        _streams[i] = _block + i * stride;
+    }
+    _totalParticles = totalParticles;
+
+    setTexture(tex);
+    _glProgram = ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR);
+    _emissionRate = totalParticles / _life;
+    return true;
+}
+
+bool ParticleSystem::initWithFile(const std::string& fileImage, int totalParticles)
+{
+    FKAssert(fileImage.size()>0, "Invalid filename for ParticleSystem");
+
+    // shared with every entity created from the same file, preloaded textures are found there too
+    Texture2D *texture = TextureManager::getInstance()->loadTexture(fileImage);
+    if (texture == nullptr)
+    {
+        return false;
+    }
+
+    return initWithTexture(texture, totalParticles);
+}
+
+void ParticleSystem::emit(int count)
+{
+    for (int i = 0; i < count && _particleCount < _totalParticles; i++)
+    {
+        spawnParticle();
+    }
+    _quadsDirty = true;
+    markCacheDirty();
+}
+
+void ParticleSystem::resetSystem()
+{
+    _active = true;
+    _elapsed = 0.0f;
+    _emitCounter = 0.0f;
+    _particleCount = 0;
+    _quadsDirty = true;
+    markCacheDirty();
+}
+
+void ParticleSystem::stopSystem()
+{
+    _active = false;
+    _elapsed = _duration;
+    _emitCounter = 0.0f;
+}
+
+void ParticleSystem::spawnParticle()
+{
+    int i = _particleCount++;
+    float** s = _streams;
+
+    float life = MAX(_life + _lifeVar * randomMinus1To1(), 0.001f);
+    float angle = FK_DEGREES_TO_RADIANS(_angle + _angleVar * randomMinus1To1());
+    float speed = _speed + _speedVar * randomMinus1To1();
+    float size = MAX(_startSize + _sizeVar * randomMinus1To1(), 0.0f);
+
+    s[POS_X][i] = _posVar.x * randomMinus1To1();
+    s[POS_Y][i] = _posVar.y * randomMinus1To1();
+    s[VEL_X][i] = cosf(angle) * speed;
+    s[VEL_Y][i] = sinf(angle) * speed;
+    s[LIFE][i] = life;
+
+    // linear from start to end over the life, the kernels just add delta * dt
+    float inverseLife = 1.0f / life;
+    s[SIZE][i] = size;
+    s[SIZE_DELTA][i] = (_endSize - size) * inverseLife;
+    s[COLOR_R][i] = _startColor.red;
+    s[COLOR_G][i] = _startColor.green;
+    s[COLOR_B][i] = _startColor.blue;
+    s[COLOR_A][i] = _startColor.alpha;
+    s[DELTA_R][i] = (_endColor.red - _startColor.red) * inverseLife;
+    s[DELTA_G][i] = (_endColor.green - _startColor.green) * inverseLife;
+    s[DELTA_B][i] = (_endColor.blue - _startColor.blue) * inverseLife;
+    s[DELTA_A][i] = (_endColor.alpha - _startColor.alpha) * inverseLife;
+}
+
+void ParticleSystem::removeDead()
+{
+    float** s = _streams;
+    int i = 0;
+    while (i < _particleCount)
+    {
+        if (s[LIFE][i] > 0.0f)
+        {
+            i++;
+            continue;
+        }
+
+        // the last particle takes its place, order doesn't matter for additive or same-texture particles
+        int last = --_particleCount;
+        for (int k = 0; k < STREAM_COUNT; k++)
+        {
+            s[k][i] = s[k][last];
+        }
+    }
+}
+
+void ParticleSystem::onUpdate(float delta)
+{
+    if (_particleCount == 0 && !_active)
+    {
+        return;
+    }
+
+    int count = (_particleCount + 3) & ~3;
+    if (_particleCount > 0)
+    {
+        const ParticleKernels* k = kernels();
+        float** s = _streams;
+        k->integrate(s[POS_X], s[VEL_X], _gravity.x, delta, count);
+        k->integrate(s[POS_Y], s[VEL_Y], _gravity.y, delta, count);
+        k->add(s[LIFE], -delta, count);
+        k->advance(s[SIZE], s[SIZE_DELTA], delta, count);
+        k->advance(s[COLOR_R], s[DELTA_R], delta, count);
+        k->advance(s[COLOR_G], s[DELTA_G], delta, count);
+        k->advance(s[COLOR_B], s[DELTA_B], delta, count);
+        k->advance(s[COLOR_A], s[DELTA_A], delta, count);
+        removeDead();
+    }
+
+    if (_active && _emissionRate > 0.0f)
+    {
+        _emitCounter += delta * _emissionRate;
+        while (_emitCounter >= 1.0f && _particleCount < _totalParticles)
+        {
+            spawnParticle();
+            _emitCounter -= 1.0f;
+        }
+        // don't save up births while the system is full
+        if (_particleCount == _totalParticles)
+        {
+            _emitCounter = MIN(_emitCounter, 1.0f);
+        }
+
+        _elapsed += delta;
+        if (_duration >= 0.0f && _elapsed >= _duration)
+        {
+            stopSystem();
+        }
+    }
+
+    _quadsDirty = true;
+    markCacheDirty();
+}
+
+void ParticleSystem::fillQuads(int start, int end, V3F_C4F_T2F_Quad* quads) const
+{
+    float* const* s = _streams;
+    bool premultiplied = _texture->hasPremultipliedAlpha();
+
+    for (int i = start; i < end; i++)
+    {
+        V3F_C4F_T2F_Quad& quad = quads[i - start];
+
+        float half = MAX(s[SIZE][i], 0.0f) * 0.5f;
+        float x = s[POS_X][i];
+        float y = s[POS_Y][i];
+        quad.bl.vertices.x = x - half;
+        quad.bl.vertices.y = y - half;
+        quad.br.vertices.x = x + half;
+        quad.br.vertices.y = y - half;
+        quad.tl.vertices.x = x - half;
+        quad.tl.vertices.y = y + half;
+        quad.tr.vertices.x = x + half;
+        quad.tr.vertices.y = y + half;
+        quad.bl.vertices.z = quad.br.vertices.z = quad.tl.vertices.z = quad.tr.vertices.z = 0.0f;
+
+        Color4F color;
+        color.a = MIN(MAX(s[COLOR_A][i], 0.0f), 1.0f);
+        // special opacity for premultiplied textures
+        float factor = premultiplied ? color.a : 1.0f;
+        color.r = MIN(MAX(s[COLOR_R][i], 0.0f), 1.0f) * factor;
+        color.g = MIN(MAX(s[COLOR_G][i], 0.0f), 1.0f) * factor;
+        color.b = MIN(MAX(s[COLOR_B][i], 0.0f), 1.0f) * factor;
+        quad.bl.colors = quad.br.colors = quad.tl.colors = quad.tr.colors = color;
+
+        // the whole texture, v goes down like the image rows
+        quad.bl.texCoords.u = 0.0f;
+        quad.bl.texCoords.v = 1.0f;
+        quad.br.texCoords.u = 1.0f;
+        quad.br.texCoords.v = 1.0f;
+        quad.tl.texCoords.u = 0.0f;
+        quad.tl.texCoords.v = 0.0f;
+        quad.tr.texCoords.u = 1.0f;
+        quad.tr.texCoords.v = 0.0f;
+    }
+}
+
+struct ParticlePage
+{
+    const ParticleSystem* system;
+    TextureAtlas* atlas;
+    int start;
+    int end;
+};
+
+void ParticleSystem::fillPage(void* data)
+{
+    ParticlePage* page = (ParticlePage*)data;
+    page->system->fillQuads(page->start, page->end, page->atlas->getQuads());
+    page->atlas->setTotalQuads(page->end - page->start);
+}
+
+void ParticleSystem::draw(void)
+{
+    if (_particleCount == 0)
+    {
+        return;
+    }
+
+    const int pageSize = TextureAtlas::MAX_CAPACITY;
+    int pageCount = (_particleCount + pageSize - 1) / pageSize;
+
+    if (_quadsDirty)
+    {
+        while ((int)_pages.size() < pageCount)
+        {
+            int capacity = MIN(_totalParticles - (int)_pages.size() * pageSize, pageSize);
+            TextureAtlas* atlas = TextureAtlas::create(_texture, capacity);
+            if (atlas == nullptr)
+            {
+                return;
+            }
+            atlas->retain();
+            _pages.push_back(atlas);
+            _commands.push_back(BatchCommand());
+        }
+
+        std::vector<ParticlePage> work(pageCount);
+        for (int i = 0; i < pageCount; i++)
+        {
+            work[i].system = this;
+            work[i].atlas = _pages[i];
+            work[i].start = i * pageSize;
+            work[i].end = MIN(_particleCount, (i + 1) * pageSize);
+        }
+
+        // one page per job, the last one on this thread
+        JobSystem* jobs = JobSystem::getInstance();
+        JobSystem::Counter counter;
+        bool parallel = pageCount > 1 && jobs->getWorkerCount() > 0;
+        for (int i = 0; i < pageCount; i++)
+        {
+            if (parallel && i < pageCount - 1)
+            {
+                jobs->run(fillPage, &work[i], &counter);
+            }
+            else
+            {
+                fillPage(&work[i]);
+            }
+        }
+        if (parallel)
+        {
+            jobs->wait(&counter);
+        }
+
+        _quadsDirty = false;
+    }
+
+    // upload the texture if needed, the draw calls themselves are issued by Renderer
+    _texture->loadGL();
+
+    Renderer* renderer = Renderer::getInstance();
+    for (int i = 0; i < pageCount; i++)
+    {
+        _commands[i].init(vertexZ, _glProgram, _blendFunc, _pages[i], worldMatrix);
+        renderer->addCommand(&_commands[i]);
+    }
+}
+
+void ParticleSystem::updateBlendFunc()
+{
+    if (! _texture->hasPremultipliedAlpha())
+    {
+        _blendFunc = BlendFunc::ALPHA_NON_PREMULTIPLIED;
+    }
+    else
+    {
+        _blendFunc = BlendFunc::ALPHA_PREMULTIPLIED;
+    }
+}
+
+// ITexture protocol
+void ParticleSystem::setBlendFunc(const BlendFunc &blendFunc)
+{
+    _blendFunc = blendFunc;
+    markCacheDirty();
+}
+
+const BlendFunc& ParticleSystem::getBlendFunc() const
+{
+    return _blendFunc;
+}
+
+Texture2D* ParticleSystem::getTexture() const
+{
+    return _texture;
+}
+
+void ParticleSystem::setTexture(Texture2D *texture)
+{
+    FKAssert(texture != nullptr, "ParticleSystem: texture must be non-nil");
+
+    if (_texture != texture)
+    {
+        FK_SAFE_RETAIN(texture);
+        FK_SAFE_RELEASE(_texture);
+        _texture = texture;
+        for (size_t i = 0; i < _pages.size(); i++)
+        {
+            _pages[i]->setTexture(texture);
+        }
+        _quadsDirty = true;
+        markCacheDirty();
+    }
+    updateBlendFunc();
+}
+
+String* ParticleSystem::toString() const
+{
+    return String::createWithFormat("<ParticleSystem | Tag = %d, Particles = %d / %d>", tag, _particleCount, _totalParticles);
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,196 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#ifndef _FK_PARTICLE_SYSTEM_H_
+#define _FK_PARTICLE_SYSTEM_H_
+
+#include <vector>
+#include <string>
+
+#include "2d/Entity.h"
+#include "base/interface/ITexture.h"
+#include "core/opengl/renderer/BatchCommand.h"
+#include "core/opengl/renderer/RenderTypes.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+class Texture2D;
+class TextureAtlas;
+class GLProgram;
+
+/** ParticleSystem emits and simulates many small textured quads without an entity per particle.
+ *
+ * Particles are stored as structure of arrays: one float array per attribute (position, velocity,
+ * life, size, color and their deltas), so onUpdate() runs over contiguous floats with SSE or NEON
+ * kernels, picked once at runtime (cpu-features on Android). Dead particles are replaced by the last one.
+ *
+ * draw() expands the live particles into quads, in pages of TextureAtlas::MAX_CAPACITY quads.
+ * Each page is one TextureAtlas and one BatchCommand, big systems fill their pages on JobSystem.
+ * The quads are only rebuilt after an update.
+ *
+ * Particles live in entity space, they move with the system.
+ */
+class FK_DLL ParticleSystem : public Entity, public ITexture
+{
+public:
+    /** Creates a ParticleSystem with a texture2d.
+     *
+     * @param tex A texture2d, each particle draws all of it.
+     * @param totalParticles Most particles alive at once.
+     * @return Return an autorelease object.
+     */
+    static ParticleSystem* createWithTexture(Texture2D* tex, int totalParticles);
+
+    /** Creates a ParticleSystem with a file image (.png, .jpeg, .pvr, etc).
+     * The file will be loaded using the ResourceManager.
+     *
+     * @return Return an autorelease object.
+     */
+    static ParticleSystem* create(const std::string& fileImage, int totalParticles);
+
+    /** name of the update kernels in use: "neon", "sse" or "scalar" */
+    static const char* getKernelName();
+
+    /** emit count particles now, ignoring the emission rate */
+    void emit(int count);
+    /** kill every particle */
+    void resetSystem();
+    /** stop emitting, the live particles finish their life */
+    void stopSystem();
+
+    inline bool isActive() const { return _active; }
+    inline int getParticleCount() const { return _particleCount; }
+    inline int getTotalParticles() const { return _totalParticles; }
+
+    /** seconds the system emits, -1 for ever */
+    inline void setDuration(float duration) { _duration = duration; }
+    /** particles per second */
+    inline void setEmissionRate(float rate) { _emissionRate = rate; }
+    /** seconds a particle lives */
+    inline void setLife(float life, float variance = 0.0f) { _life = life; _lifeVar = variance; }
+    /** speed in points per second */
+    inline void setSpeed(float speed, float variance = 0.0f) { _speed = speed; _speedVar = variance; }
+    /** direction in degrees, counter clockwise from the x axis */
+    inline void setAngle(float angle, float variance = 0.0f) { _angle = angle; _angleVar = variance; }
+    /** particles are born in (0, 0) plus or minus variance */
+    inline void setPositionVariance(const Point& variance) { _posVar = variance; }
+    inline void setGravity(const Point& gravity) { _gravity = gravity; }
+    /** size in points at birth and at death */
+    inline void setSize(float startSize, float endSize, float variance = 0.0f) { _startSize = startSize; _endSize = endSize; _sizeVar = variance; }
+    /** color at birth and at death */
+    inline void setColors(const Color& startColor, const Color& endColor) { _startColor = startColor; _endColor = endColor; }
+
+    //
+    // Overrides
+    //
+    // ITexture
+    virtual Texture2D* getTexture() const override;
+    virtual void setTexture(Texture2D *texture) override;
+    virtual void setBlendFunc(const BlendFunc &blendFunc) override;
+    virtual const BlendFunc& getBlendFunc() const override;
+
+    // Entity
+    virtual void onUpdate(float delta) override;
+    virtual void draw(void) override;
+    virtual String* toString() const override;
+
+protected:
+    /** one float array each, in this order */
+    enum Stream
+    {
+        POS_X, POS_Y, VEL_X, VEL_Y,
+        LIFE,
+        SIZE, SIZE_DELTA,
+        COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+        DELTA_R, DELTA_G, DELTA_B, DELTA_A,
+        STREAM_COUNT
+    };
+
+    ParticleSystem();
+    virtual ~ParticleSystem();
+
+    bool initWithTexture(Texture2D *tex, int totalParticles);
+    bool initWithFile(const std::string& fileImage, int totalParticles);
+
+    void spawnParticle();
+    /** kill the particles whose life is over */
+    void removeDead();
+    /** write the quads of particles [start, end) */
+    void fillQuads(int start, int end, V3F_C4F_T2F_Quad* quads) const;
+    static void fillPage(void* data);
+    void updateBlendFunc();
+
+    /** uniform in [0, 1), xorshift so it is cheap and per system */
+    inline float random01()
+    {
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return (_seed >> 8) * (1.0f / 16777216.0f);
+    }
+    inline float randomMinus1To1() { return random01() * 2.0f - 1.0f; }
+
+    Texture2D* _texture;
+    BlendFunc _blendFunc;
+    GLProgram* _glProgram;
+
+    int _totalParticles;
+    int _particleCount;
+    /** one block, every stream is _totalParticles rounded up to 4 floats */
+    float* _block;
+    float* _streams[STREAM_COUNT];
+
+    bool _active;
+    bool _quadsDirty;
+    float _elapsed;
+    float _emitCounter;
+    unsigned int _seed;
+
+    float _duration;
+    float _emissionRate;
+    float _life, _lifeVar;
+    float _speed, _speedVar;
+    float _angle, _angleVar;
+    Point _posVar;
+    Point _gravity;
+    float _startSize, _endSize, _sizeVar;
+    Color _startColor;
+    Color _endColor;
+
+    std::vector<TextureAtlas*> _pages;
+    std::vector<BatchCommand> _commands;
+};
+
+// end of entity group
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,256 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#include "targetMacros.h"
+#include "2d/SceneTransition.h"
+#include "2d/Scene.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/DynamicAtlas.h"
+#include "core/opengl/texture/TextureUploader.h"
+#include "core/resource/Image.h"
+#include "core/resource/ResourceManager.h"
+
+FLAKOR_NS_BEGIN
+
+SceneTransition* SceneTransition::create(const std::vector<std::string>& manifest, const SceneFactory& factory)
+{
+    SceneTransition* transition = new (std::nothrow) SceneTransition();
+    if (transition && transition->init(manifest, factory))
+    {
+        transition->autorelease();
+        return transition;
+    }
+    FK_SAFE_DELETE(transition);
+    return nullptr;
+}
+
+SceneTransition::SceneTransition()
+: _entries()
+, _decoded()
+, _factory(nullptr)
+, _scene(nullptr)
+, _decodedCount(0)
+, _uploadedCount(0)
+, _waiting(0)
+{
+}
+
+SceneTransition::~SceneTransition()
+{
+    FK_SAFE_RELEASE(_scene);
+}
+
+bool SceneTransition::init(const std::vector<std::string>& manifest, const SceneFactory& factory)
+{
+    FKAssert(factory, "SceneTransition: factory can't be empty");
+    _factory = factory;
+
+    _entries.resize(manifest.size());
+    _decoded.reserve(manifest.size());
+    for (size_t i = 0; i < manifest.size(); i++)
+    {
+        Entry& entry = _entries[i];
+        entry.uri = manifest[i];
+        entry.image = nullptr;
+        entry.decoded = false;
+        entry.uploaded = false;
+    }
+
+    TextureManager* textures = TextureManager::getInstance();
+    DynamicAtlas* atlas = DynamicAtlas::getInstance();
+    ResourceManager* resources = ResourceManager::thisManager();
+    for (size_t i = 0; i < _entries.size(); i++)
+    {
+        Entry& entry = _entries[i];
+        if (textures->getTexture(entry.uri) != nullptr || atlas->getRegion(entry.uri) != nullptr)
+        {
+            // the running scene uses it too
+            entry.decoded = entry.uploaded = true;
+            _decodedCount++;
+            _uploadedCount++;
+            continue;
+        }
+
+        entry.image = dynamic_cast<Image*>(resources->createResource(entry.uri.c_str(), ResourceManager::IMAGE_NAME));
+        if (entry.image == nullptr)
+        {
+            FKLOG("SceneTransition: no loader for %s", entry.uri.c_str());
+            entry.decoded = entry.uploaded = true;
+            _decodedCount++;
+            _uploadedCount++;
+            continue;
+        }
+        if (entry.image->getData() != nullptr)
+        {
+            entry.decoded = true;
+            _decodedCount++;
+            _decoded.push_back((int)i);
+            continue;
+        }
+
+        // decoded on a loader thread, the callback comes back on the GL thread
+        Image* image = entry.image;
+        int index = (int)i;
+        image->setCallback([this, image, index](Resource*) {
+            this->onDecoded(image, index);
+        });
+        waitForCallback();
+        image->load(true);
+    }
+
+    // keep frames coming while the loaders work, updateGL() runs from render()
+    Entity::markSceneDirty();
+    return true;
+}
+
+void SceneTransition::onDecoded(Image* image, int index)
+{
+    // the closure calling us is destroyed here, touch nothing of it after
+    image->setCallback(nullptr);
+
+    Entry& entry = _entries[index];
+    entry.decoded = true;
+    _decodedCount++;
+    _decoded.push_back(index);
+
+    callbackDone();
+}
+
+void SceneTransition::onUploaded(int index)
+{
+    _entries[index].uploaded = true;
+    _uploadedCount++;
+}
+
+void SceneTransition::waitForCallback()
+{
+    if (_waiting++ == 0)
+    {
+        retain();
+    }
+}
+
+void SceneTransition::callbackDone()
+{
+    if (--_waiting == 0)
+    {
+        release();
+    }
+}
+
+float SceneTransition::getProgress() const
+{
+    if (_entries.empty())
+    {
+        return _scene != nullptr ? 1.f : 0.f;
+    }
+    return (_decodedCount + _uploadedCount) / (2.f * _entries.size());
+}
+
+bool SceneTransition::updateGL()
+{
+    if (_scene != nullptr)
+    {
+        return true;
+    }
+    if (!_factory)
+    {
+        // the factory failed before
+        return false;
+    }
+
+    // queue what arrived, TextureUploader spreads the uploads over the frames
+    TextureManager* textures = TextureManager::getInstance();
+    TextureUploader* uploader = TextureUploader::getInstance();
+    DynamicAtlas* atlas = DynamicAtlas::getInstance();
+    for (size_t i = 0; i < _decoded.size(); i++)
+    {
+        int index = _decoded[i];
+        Entry& entry = _entries[index];
+
+        Image* image = entry.image;
+        if (image->getData() == nullptr)
+        {
+            FKLOG("SceneTransition: can't decode %s", entry.uri.c_str());
+            onUploaded(index);
+            continue;
+        }
+        if (textures->getTexture(entry.uri) != nullptr || atlas->getRegion(entry.uri) != nullptr)
+        {
+            // created by the running scene in the meantime
+            onUploaded(index);
+            continue;
+        }
+        if (atlas->addImage(entry.uri, image) != nullptr)
+        {
+            // copied into its page by Renderer::render() of this frame
+            onUploaded(index);
+            continue;
+        }
+
+        Texture2D* texture = new (std::nothrow) Texture2D();
+        if (texture == nullptr)
+        {
+            onUploaded(index);
+            continue;
+        }
+        textures->addTexture(entry.uri, texture);
+        if (texture->initWithImage(image))
+        {
+            waitForCallback();
+            uploader->upload(texture, [this, index](Texture2D*) {
+                this->onUploaded(index);
+                // may release the transition, nothing after this
+                this->callbackDone();
+            });
+        }
+        else
+        {
+            onUploaded(index);
+        }
+        texture->release();
+    }
+    _decoded.clear();
+
+    if (_uploadedCount < (int)_entries.size())
+    {
+        Entity::markSceneDirty();
+        return false;
+    }
+
+    // everything is on the GPU, entities of the next scene find their textures in TextureManager
+    _scene = _factory();
+    FK_SAFE_RETAIN(_scene);
+    _factory = nullptr;
+    if (_scene == nullptr)
+    {
+        FKLOG("SceneTransition: factory didn't create a scene");
+    }
+    Entity::markSceneDirty();
+    return _scene != nullptr;
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,126 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#ifndef _FK_SCENE_TRANSITION_H_
+#define _FK_SCENE_TRANSITION_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "base/lang/Object.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+class Scene;
+class Image;
+
+/** SceneTransition builds the next scene once its images are decoded and on the GPU.
+ *
+ * The manifest lists the image uris the next scene creates its entities from. create() queues them
+ * on the loader threads of ResourceManager, the running scene keeps updating and drawing meanwhile.
+ * Every frame updateGL() packs small decoded images into DynamicAtlas, and turns the others into
+ * textures queued on TextureUploader, which uploads them within its budget of bytes per frame.
+ * The textures go into TextureManager right away, so Sprite::create() and friends with the same
+ * uri find them, or their region, without loading.
+ * When everything is uploaded updateGL() calls the factory and returns true, swap to getScene() then.
+ *
+ * @code
+ * // MainGame::render(), on the GL thread
+ * if (transition != nullptr && transition->updateGL())
+ * {
+ *     setScene(transition->getScene());
+ *     FK_SAFE_RELEASE_NULL(transition);
+ * }
+ * runningScene->onVisit();
+ * @endcode
+ */
+class FK_DLL SceneTransition : public Object
+{
+public:
+    typedef std::function<Scene*()> SceneFactory;
+
+    /** Creates a transition and starts loading.
+     *
+     * @param manifest Image uris the next scene uses, written like the scene writes them.
+     * @param factory  Creates the next scene on the GL thread once everything is uploaded.
+     * @return Return an autorelease object.
+     */
+    static SceneTransition* create(const std::vector<std::string>& manifest, const SceneFactory& factory);
+
+    virtual ~SceneTransition();
+
+    bool init(const std::vector<std::string>& manifest, const SceneFactory& factory);
+
+    /** 0 to 1, decoding and uploading count half each */
+    float getProgress() const;
+    inline bool isReady() const { return _scene != nullptr; }
+    /** the scene made by the factory, NULL until updateGL() returned true */
+    inline Scene* getScene() const { return _scene; }
+
+GL_METHOD:
+    /** queues what was decoded for upload, true once the next scene is created */
+    bool updateGL();
+
+protected:
+    SceneTransition();
+
+    /** loader callback, on the GL thread through Scheduler */
+    void onDecoded(Image* image, int index);
+    /** counts the entry as uploaded */
+    void onUploaded(int index);
+    /** keeps the transition alive until every callback came */
+    void waitForCallback();
+    void callbackDone();
+
+    struct Entry
+    {
+        std::string uri;
+        Image* image;
+        bool decoded;
+        bool uploaded;
+    };
+
+    std::vector<Entry> _entries;
+    /** entries decoded but not queued for upload yet, in the order they arrived */
+    std::vector<int> _decoded;
+    SceneFactory _factory;
+    Scene* _scene;
+    int _decodedCount;
+    int _uploadedCount;
+    /** loader and uploader callbacks still to come, the transition stays alive until then */
+    int _waiting;
+};
+
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
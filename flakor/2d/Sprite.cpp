@@ -6,12 +6,17 @@ http://www.flakor.org
 
 #include "base/lang/Str.h"
 #include "2d/Sprite.h"
+#include "2d/SpriteBatch.h"
 #include "base/element/Element.h"
 #include "core/resource/Image.h"
 #include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureAtlas.h"
 #include "core/opengl/shader/Shaders.h"
 #include "core/opengl/GLProgram.h"
-#include "core/resource/ResourceManager.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/renderer/Renderer.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/TextureRegion.h"
 
 FLAKOR_NS_BEGIN
 
@@ -46,6 +51,18 @@ Sprite* Sprite::createWithTexture(Texture2D *texture, const Rect& rect, bool rot
     return nullptr;
 }
 
+Sprite* Sprite::createWithTextureRegion(TextureRegion *region)
+{
+    Sprite *sprite = new (std::nothrow) Sprite();
+    if (sprite && sprite->initWithTextureRegion(region))
+    {
+        sprite->autorelease();
+        return sprite;
+    }
+    FK_SAFE_DELETE(sprite);
+    return nullptr;
+}
+
 Sprite* Sprite::create(const std::string& filename)
 {
     Sprite *sprite = new (std::nothrow) Sprite();
@@ -103,22 +120,27 @@ bool Sprite::initWithTexture(Texture2D *texture, const Rect& rect)
     return initWithTexture(texture, rect, false);
 }
 
+bool Sprite::initWithTextureRegion(TextureRegion *region)
+{
+    FKAssert(region != nullptr, "Invalid region for sprite");
+
+    if (initWithTexture(region->getTexture(), region->getRect(), region->isRotated()))
+    {
+        setTextureRegion(region);
+        return true;
+    }
+    return false;
+}
+
 bool Sprite::initWithFile(const std::string& filename)
 {
     FKAssert(filename.size()>0, "Invalid filename for sprite");
 
-    Texture2D *texture = new Texture2D();
-		FKLOG("create image here");
-	Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource(filename.c_str(),ResourceManager::IMAGE_NAME));
-	image->load(false);
-
-	texture->initWithImage(image);
-    if (texture)
+    // preloaded textures are taken from the cache, small images share a page of DynamicAtlas
+    TextureRegion *region = TextureManager::getInstance()->loadRegion(filename);
+    if (region)
     {
-        Rect rect = RectZero;
-        rect.size = texture->getContentSize();
-        FKLOG("Sprite size:w %f,h %f",rect.size.width,rect.size.height);
-        return initWithTexture(texture, rect);
+        return initWithTextureRegion(region);
     }
 
     // don't release here.
@@ -131,14 +153,19 @@ bool Sprite::initWithFile(const std::string &filename, const Rect& rect)
 {
     FKAssert(filename.size()>0, "Invalid filename");
 
-    Texture2D *texture = new Texture2D();
-	Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource(filename.c_str(),ResourceManager::IMAGE_NAME));
-	image->load(false);
-	texture->initWithImage(image);
-
-    if (texture)
+    TextureRegion *region = TextureManager::getInstance()->loadRegion(filename);
+    if (region)
     {
-        return initWithTexture(texture, rect);
+        // rect counts from the corner of the image, wherever the region lies in its texture
+        Rect inTexture = rect;
+        inTexture.origin.x += region->getRect().origin.x;
+        inTexture.origin.y += region->getRect().origin.y;
+        if (initWithTexture(region->getTexture(), inTexture))
+        {
+            setTextureRegion(region);
+            return true;
+        }
+        return false;
     }
 
     // don't release here.
@@ -153,7 +180,7 @@ bool Sprite::initWithTexture(Texture2D *texture, const Rect& rect, bool rotated)
     bool result;
     if (Entity::init())
     {
-        //_batchNode = nullptr;
+        _batchNode = nullptr;
         
         _recursiveDirty = false;
         setDirty(false);
@@ -170,19 +197,11 @@ bool Sprite::initWithTexture(Texture2D *texture, const Rect& rect, bool rotated)
         // zwoptex default values
         _offsetPosition = Point(0.f, 0.f);
 
-        // add vbo 3+4+2
-        _vbo = VBO::create(VERTEX_SIZE,VERTICES_PER_SPRITE);
-		struct VBOAttribute *attributes[3] = {
-        	new VBOAttribute(GLProgram::ATTRIBUTE_NAME_POSITION,GLProgram::VERTEX_ATTRIB_POSITION,0,3,GL_FLOAT,false),
-        	new VBOAttribute(GLProgram::ATTRIBUTE_NAME_COLOR,GLProgram::VERTEX_ATTRIB_COLOR,3*sizeof(float),4,GL_FLOAT,false),
-        	new VBOAttribute(GLProgram::ATTRIBUTE_NAME_TEX_COORD,GLProgram::VERTEX_ATTRIB_TEX_COORD,7*sizeof(float),2,GL_FLOAT,false)
-    	};
-		_vbo->setAttributes(attributes,3);
-        
+        // clean the Quad
+        memset(&_quad, 0, sizeof(_quad));
 
-        GLProgram* program = GLProgram::createWithByteArrays(Shader::PositionTextureColor_vert,Shader::PositionTextureColor_frag);
-        // shader state
-        setGLProgram(program);
+        // shader state, shared by all sprites so that Renderer can batch them
+        setGLProgram(ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR));
 
         // update texture (calls updateBlendFunc)
         setTexture(texture);
@@ -190,7 +209,7 @@ bool Sprite::initWithTexture(Texture2D *texture, const Rect& rect, bool rotated)
 
         // by default use "Self Render".
         // if the sprite is added to a batchnode, then it will automatically switch to "batchnode Render"
-        //setBatchNode(nullptr);
+        setBatchNode(nullptr);
         result = true;
     }
     else
@@ -204,9 +223,12 @@ bool Sprite::initWithTexture(Texture2D *texture, const Rect& rect, bool rotated)
 
 Sprite::Sprite(void)
 : _shouldBeHidden(false)
+, _textureAtlas(nullptr)
+, _atlasIndex(INDEX_NOT_INITIALIZED)
+, _batchNode(nullptr)
 , _texture(nullptr)
+, _textureRegion(nullptr)
 , _insideBounds(true)
-//, _batchNode(nullptr)
 {
 #if FK_SPRITE_DEBUG_DRAW
     _debugDrawNode = DrawEntity::create();
@@ -217,6 +239,7 @@ Sprite::Sprite(void)
 
 Sprite::~Sprite(void)
 {
+    FK_SAFE_RELEASE(_textureRegion);
     FK_SAFE_RELEASE(_texture);
 }
 
@@ -247,16 +270,23 @@ static unsigned char fk_2x2_white_image[] = {
 // MARK: texture
 void Sprite::setTexture(const std::string &filename)
 {
-    Texture2D *texture = new Texture2D();
-	Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource(filename.c_str(),ResourceManager::IMAGE_NAME));
-	image->load(false);
-	texture->initWithImage(image);
+    TextureRegion *region = TextureManager::getInstance()->loadRegion(filename);
+    if (region == nullptr)
+    {
+        return;
+    }
 
-    setTexture(texture);
+    setTexture(region->getTexture());
+    setTextureRect(region->getRect(), region->isRotated(), region->getRect().size);
+    setTextureRegion(region);
+}
 
-    Rect rect = RectZero;
-    rect.size = texture->getContentSize();
-    setTextureRect(rect);
+void Sprite::setTextureRegion(TextureRegion *region)
+{
+    // keeps the slot of a DynamicAtlas page from being evicted while the sprite shows it
+    FK_SAFE_RETAIN(region);
+    FK_SAFE_RELEASE(_textureRegion);
+    _textureRegion = region;
 }
 
 void Sprite::setTexture(Texture2D *texture)
@@ -289,6 +319,8 @@ void Sprite::setTexture(Texture2D *texture)
         FK_SAFE_RETAIN(texture);
         FK_SAFE_RELEASE(_texture);
         _texture = texture;
+        // the region belonged to the old texture
+        FK_SAFE_RELEASE_NULL(_textureRegion);
 		
 		updateColor();
         updateBlendFunc();
@@ -338,13 +370,16 @@ void Sprite::setTextureRect(const Rect& rect, bool rotated, const Size& untrimme
 	*/
 
 	//leftB rightTop;
-	float vertexs[] = {x1,y1,0,
-					   x2,y1,0,
-					   x1,y2,0,
-					   x2,y2,0};
-	//{ -0.5,-0.5,0,0.5,-0.5,0,-0.5,0.5,0,0.5,0.5,0};
-	_vbo->updateData(VERTEX_INDEX,3,vertexs);
-	
+	_quad.bl.vertices.x = x1; _quad.bl.vertices.y = y1; _quad.bl.vertices.z = 0;
+	_quad.br.vertices.x = x2; _quad.br.vertices.y = y1; _quad.br.vertices.z = 0;
+	_quad.tl.vertices.x = x1; _quad.tl.vertices.y = y2; _quad.tl.vertices.z = 0;
+	_quad.tr.vertices.x = x2; _quad.tr.vertices.y = y2; _quad.tr.vertices.z = 0;
+
+    // rendering using batch node: the quad in the atlas is refreshed in next updateTransform()
+    if (_batchNode)
+    {
+        setDirty(true);
+    }
 }
 
 // override this method to generate "double scale" sprites
@@ -400,20 +435,14 @@ void Sprite::setTextureCoords(Rect rect)
             FK_SWAP(left, right, float);
         }
 
-        /*_quad.bl.texCoords.u = left;
+        _quad.bl.texCoords.u = left;
         _quad.bl.texCoords.v = top;
         _quad.br.texCoords.u = left;
         _quad.br.texCoords.v = bottom;
         _quad.tl.texCoords.u = right;
         _quad.tl.texCoords.v = top;
         _quad.tr.texCoords.u = right;
-        _quad.tr.texCoords.v = bottom;*/
-
-		float texCoords[] = {left,top,
-							left,bottom,
-							right,top,
-							right,bottom};
-		_vbo->updateData(TEXTURECOORDINATES_INDEX,2,texCoords);
+        _quad.tr.texCoords.v = bottom;
     }
     else
     {
@@ -439,13 +468,14 @@ void Sprite::setTextureCoords(Rect rect)
             FK_SWAP(top,bottom,float);
         }
 
-		
-        float texCoords[] = {0.f,1.f,
-            1.f,1.f,
-            0.f,0.f,
-            1.f,0.f};
-
-        _vbo->updateData(TEXTURECOORDINATES_INDEX,2,texCoords);
+        _quad.bl.texCoords.u = left;
+        _quad.bl.texCoords.v = bottom;
+        _quad.br.texCoords.u = right;
+        _quad.br.texCoords.v = bottom;
+        _quad.tl.texCoords.u = left;
+        _quad.tl.texCoords.v = top;
+        _quad.tr.texCoords.u = right;
+        _quad.tr.texCoords.v = top;
     }
 
 	FKLOG("Sprite updateTexCoords!");
@@ -455,38 +485,55 @@ void Sprite::setTextureCoords(Rect rect)
 
 void Sprite::updateTransform(void)
 {
-    //FKASSERT(_batchNode, "updateTransform is only valid when Sprite is being rendered using an SpriteBatchNode");
+    // self rendering sprites send their quad to Renderer in draw()
+    if (_batchNode == nullptr)
+    {
+        return;
+    }
 
     // recalculate matrix only if it is dirty
-    if( isDirty() ) 
-	{
+    if( isDirty() )
+    {
+        bool parentIsBatch = (parent == static_cast<Entity*>(_batchNode));
 
-        // If it is not visible, or one of its ancestors is not visible, then do nothing:
-        if( !visible || ( parent && static_cast<Sprite*>(parent)->visible == false) )
+        // If it is not visible, or one of its ancestors is not visible, then write an empty quad
+        _shouldBeHidden = !visible || ( !parentIsBatch && static_cast<Sprite*>(parent)->_shouldBeHidden );
+
+        // _quad keeps the vertices in sprite space, the atlas gets them in batch space
+        V3F_C4F_T2F_Quad quad = _quad;
+
+        if( _shouldBeHidden )
         {
-      
+            Vertex3F zero = {0, 0, 0};
+            quad.bl.vertices = quad.br.vertices = quad.tl.vertices = quad.tr.vertices = zero;
         }
         else
         {
+            if (parentIsBatch)
+            {
+                _transformToBatch = entityToParentTransform();
+            }
+            else
+            {
+                _transformToBatch = static_cast<Sprite*>(parent)->_transformToBatch * entityToParentTransform();
+            }
 
             //
             // calculate the Quad based on the Affine Matrix
             //
-			/*
-            Size &size = _rect.size;
-
-            float x1 = _offsetPosition.x;
-            float y1 = _offsetPosition.y;
-
-            float x2 = x1 + size.width;
-            float y2 = y1 + size.height;
-            float x = _transformToBatch.m[12];
-            float y = _transformToBatch.m[13];
-
-            float cr = _transformToBatch.m[0];
-            float sr = _transformToBatch.m[1];
-            float cr2 = _transformToBatch.m[5];
-            float sr2 = -_transformToBatch.m[4];
+            const float* m = _transformToBatch.get();
+
+            float x1 = _quad.bl.vertices.x;
+            float y1 = _quad.bl.vertices.y;
+            float x2 = _quad.tr.vertices.x;
+            float y2 = _quad.tr.vertices.y;
+            float x = m[12];
+            float y = m[13];
+
+            float cr = m[0];
+            float sr = m[1];
+            float cr2 = m[5];
+            float sr2 = -m[4];
             float ax = x1 * cr - y1 * sr2 + x;
             float ay = x1 * sr + y1 * cr2 + y;
 
@@ -499,31 +546,25 @@ void Sprite::updateTransform(void)
             float dx = x1 * cr - y2 * sr2 + x;
             float dy = x1 * sr + y2 * cr2 + y;
 
-            _quad.bl.vertices = Vec3( RENDER_IN_SUBPIXEL(ax), RENDER_IN_SUBPIXEL(ay), _positionZ );
-            _quad.br.vertices = Vec3( RENDER_IN_SUBPIXEL(bx), RENDER_IN_SUBPIXEL(by), _positionZ );
-            _quad.tl.vertices = Vec3( RENDER_IN_SUBPIXEL(dx), RENDER_IN_SUBPIXEL(dy), _positionZ );
-            _quad.tr.vertices = Vec3( RENDER_IN_SUBPIXEL(cx), RENDER_IN_SUBPIXEL(cy), _positionZ );
-			*/        
-		}
+            quad.bl.vertices.x = RENDER_IN_SUBPIXEL(ax); quad.bl.vertices.y = RENDER_IN_SUBPIXEL(ay); quad.bl.vertices.z = vertexZ;
+            quad.br.vertices.x = RENDER_IN_SUBPIXEL(bx); quad.br.vertices.y = RENDER_IN_SUBPIXEL(by); quad.br.vertices.z = vertexZ;
+            quad.tl.vertices.x = RENDER_IN_SUBPIXEL(dx); quad.tl.vertices.y = RENDER_IN_SUBPIXEL(dy); quad.tl.vertices.z = vertexZ;
+            quad.tr.vertices.x = RENDER_IN_SUBPIXEL(cx); quad.tr.vertices.y = RENDER_IN_SUBPIXEL(cy); quad.tr.vertices.z = vertexZ;
+        }
 
-        // MARMALADE CHANGE: ADDED CHECK FOR nullptr, TO PERMIT SPRITES WITH NO BATCH NODE / TEXTURE ATLAS
-        /*if (_textureAtlas)
-		{
-            _textureAtlas->updateQuad(&_quad, _atlasIndex);
-        }*/
+        if (_textureAtlas)
+        {
+            _textureAtlas->updateQuad(&quad, _atlasIndex);
+        }
 
         _recursiveDirty = false;
         setDirty(false);
     }
 
-    // MARMALADE CHANGED
+    // the batch doesn't visit its sprites, keep the world bounds and the touch entry up to date here
+    this->updateWorldTransform();
+
     // recursively iterate over children
-	/* if( _hasChildren )
-    {
-        // MARMALADE: CHANGED TO USE Node*
-        // NOTE THAT WE HAVE ALSO DEFINED virtual Entity::updateTransform()
-        arrayMakeObjectsPerformSelector(_children, updateTransform, Sprite*);
-    }*/
     Entity::updateTransform();
 }
 
@@ -541,28 +582,17 @@ void Sprite::draw()
     }
 	*/
 
-    FKLOG("in sprite draw");
-    
-	_glProgram->use();
-	_vbo->onBufferData();
-    _texture->loadGL();
-	_texture->bindGL();
-    
-    if (_blendFunc.src == GL_ONE && _blendFunc.dst == GL_ZERO)
-    {
-        glDisable(GL_BLEND);
-    }
-    else
+    // the batch node draws the whole atlas at once
+    if (_texture == nullptr || _batchNode)
     {
-        glEnable(GL_BLEND);
-        glBlendFunc(_blendFunc.src, _blendFunc.dst);
+        return;
     }
-    
-	_vbo->enableAndPointer();
-	_glProgram->setUniformsForBuiltins();
 
-	_vbo->draw(GL_TRIANGLE_STRIP,4);
+    // upload the texture if needed, the draw call itself is issued by Renderer
+    _texture->loadGL();
 
+    _quadCommand.init(vertexZ, _texture->getTextureID(), _glProgram, _blendFunc, &_quad, 1, worldMatrix);
+    Renderer::getInstance()->addCommand(&_quadCommand);
 }
 
 // MARK: visit, draw, transform
@@ -571,23 +601,18 @@ void Sprite::addChild(Entity *child, int zOrder, int tag)
 {
     FKAssert(child != nullptr, "Argument must be non-nullptr");
 
-	/*
+    //Entity sets the parent, the batch node needs it to compute the atlas order
+    Entity::addChild(child, zOrder, tag);
+
     if (_batchNode)
     {
         Sprite* childSprite = dynamic_cast<Sprite*>(child);
-        FKAssert( childSprite, "Sprite only supports Sprites as children when using SpriteBatchNode");
-        FKAssert(childSprite->getTexture()->getName() == _textureAtlas->getTexture()->getName(), "");
+        FKAssert( childSprite, "Sprite only supports Sprites as children when using SpriteBatch");
+        FKAssert(childSprite->getTexture()->getTextureID() == _textureAtlas->getTexture()->getTextureID(), "Sprite is not using the same texture as its SpriteBatch");
         //put it in descendants array of batch node
         _batchNode->appendChild(childSprite);
-
-        if (!_reorderChildDirty)
-        {
-            setReorderChildDirtyRecursively();
-        }
-    }*/
- 
-    //Entity already sets isReorderChildDirty_ so this needs to be after batchNode check
-    Entity::addChild(child, zOrder, tag);
+        setReorderChildDirtyRecursively();
+    }
 }
 
 /*void Sprite::addChild(Entity *child, int zOrder, const std::string &name)
@@ -597,7 +622,7 @@ void Sprite::addChild(Entity *child, int zOrder, int tag)
     if (_batchNode)
     {
         Sprite* childSprite = dynamic_cast<Sprite*>(child);
-        FKAssert( childSprite, "CCSprite only supports Sprites as children when using SpriteBatchNode");
+        FKAssert( childSprite, "CCSprite only supports Sprites as children when using SpriteBatch");
         FKAssert(childSprite->getTexture()->getName() == _textureAtlas->getTexture()->getName(), "");
         //put it in descendants array of batch node
         _batchNode->appendChild(childSprite);
@@ -616,37 +641,38 @@ void Sprite::reorderChild(Entity *child, int zOrder)
     FKAssert(child != nullptr, "child must be non null");
     FKAssert(children->containsObject(child), "child does not belong to this");
 
-    /*if( _batchNode && ! _reorderChildDirty)
+    Entity::reorderChild(child, zOrder);
+
+    if( _batchNode )
     {
         setReorderChildDirtyRecursively();
-        _batchNode->reorderBatch(true);
-    }*/
-
-    Entity::reorderChild(child, zOrder);
+    }
 }
 
 void Sprite::removeChild(Entity *child, bool cleanup)
 {
-    /*if (_batchNode)
+    if (_batchNode && child != nullptr && children->containsObject(child))
     {
-        _batchNode->removeSpriteFromAtlas((Sprite*)(child));
-    }*/
+        _batchNode->removeSpriteFromAtlas(static_cast<Sprite*>(child));
+    }
 
     Entity::removeChild(child, cleanup);
 }
 
 void Sprite::removeAllChildren(bool cleanup)
 {
-    /*if (_batchNode)
+    if (_batchNode && children != nullptr)
     {
-        for(const auto &child : _children) {
+        Object* child;
+        FK_ARRAY_FOREACH(children, child)
+        {
             Sprite* sprite = dynamic_cast<Sprite*>(child);
             if (sprite)
             {
                 _batchNode->removeSpriteFromAtlas(sprite);
             }
         }
-    }*/
+    }
 
     Entity::removeAllChildren(cleanup);
 }
@@ -670,7 +696,7 @@ void Sprite::sortAllChildren()
 */
 //
 // Entity property overloads
-// used only when parent is SpriteBatchNode
+// used only when parent is SpriteBatch
 //
 
 void Sprite::setReorderChildDirtyRecursively(void)
@@ -680,12 +706,18 @@ void Sprite::setReorderChildDirtyRecursively(void)
     {
         childrenSortPending = true;
         Entity* entity = static_cast<Entity*>(parent);
-        while (entity)// && node != _batchNode)
+        while (entity && entity != _batchNode)
         {
             static_cast<Sprite*>(entity)->setReorderChildDirtyRecursively();
             entity=entity->getParent();
         }
     }
+
+    // the atlas order follows the children order, let the batch node rebuild it
+    if (_batchNode)
+    {
+        _batchNode->reorderBatch(true);
+    }
 }
 
 void Sprite::setDirtyRecursively(bool bValue)
@@ -809,6 +841,16 @@ bool Sprite::isFlippedY(void) const
     return _flippedY;
 }
 
+void Sprite::reset()
+{
+    Entity::reset();
+
+    setFlippedX(false);
+    setFlippedY(false);
+    _insideBounds = true;
+    updateColor();
+}
+
 //
 // MARK: RGBA protocol
 //
@@ -828,15 +870,19 @@ void Sprite::updateColor(void)
 		blue *= alpha;
     }
 
-	float colors[] = {red,green,blue,alpha,
-					red,green,blue,alpha,
-					red,green,blue,alpha,
-					red,green,blue,alpha};
+	Color4F color4 = {red,green,blue,alpha};
+	_quad.bl.colors = color4;
+	_quad.br.colors = color4;
+	_quad.tl.colors = color4;
+	_quad.tr.colors = color4;
 
-	FKLOG("Sprite color:r %.4f,g %.4f,b %.4f,a %.4f",red,green,blue,alpha);
-	_vbo->updateData(COLOR_INDEX,4,colors);
-    // self render
-    // do nothing
+    // renders using batch node
+    if (_batchNode)
+    {
+        setDirty(true);
+    }
+    // self render: redraw the caches that hold this sprite
+    markCacheDirty();
 
 }
 
@@ -854,16 +900,11 @@ bool Sprite::isOpacityModifyRGB(void) const
     return _opacityModifyRGB;
 }
 
-/*
-SpriteBatchNode* Sprite::getBatchNode()
+void Sprite::setBatchNode(SpriteBatch *spriteBatch)
 {
-    return _batchNode;
-}
-
-
-void Sprite::setBatchNode(SpriteBatchNode *spriteBatchNode)
-{
-    _batchNode = spriteBatchNode; // weak reference
+    _batchNode = spriteBatch; // weak reference
+    // the quad in the atlas follows the setters, tweens have to go through them
+    transformObserved = (_batchNode != nullptr);
 
     // self render
     if( ! _batchNode ) {
@@ -871,29 +912,22 @@ void Sprite::setBatchNode(SpriteBatchNode *spriteBatchNode)
         setTextureAtlas(nullptr);
         _recursiveDirty = false;
         setDirty(false);
-
-        float x1 = _offsetPosition.x;
-        float y1 = _offsetPosition.y;
-        float x2 = x1 + _rect.size.width;
-        float y2 = y1 + _rect.size.height;
-        _quad.bl.vertices = Vec3( x1, y1, 0 );
-        _quad.br.vertices = Vec3( x2, y1, 0 );
-        _quad.tl.vertices = Vec3( x1, y2, 0 );
-        _quad.tr.vertices = Vec3( x2, y2, 0 );
-
+        // _quad always keeps the vertices in sprite space, nothing to restore
     } else {
 
         // using batch
-        _transformToBatch = Mat4::IDENTITY;
+        _transformToBatch = Matrix4();
         setTextureAtlas(_batchNode->getTextureAtlas()); // weak ref
+        _recursiveDirty = true;
+        setDirty(true);
     }
 }
-*/
+
 // MARK: Texture protocol
 
 void Sprite::updateBlendFunc(void)
 {
-    //FKAssert(! _batchNode, "Sprite: updateBlendFunc doesn't work when the sprite is rendered using a SpriteBatchNode");
+    //FKAssert(! _batchNode, "Sprite: updateBlendFunc doesn't work when the sprite is rendered using a SpriteBatch");
 
     // it is possible to have an untextured sprite
     if (! _texture || ! _texture->hasPremultipliedAlpha())
@@ -911,9 +945,9 @@ void Sprite::updateBlendFunc(void)
 String* Sprite::toString() const
 {
     int texture_id = -1;
-    /*if( _batchNode )
-        texture_id = _batchNode->getTextureAtlas()->getTexture()->getName();
-    else*/
+    if( _batchNode )
+        texture_id = _batchNode->getTextureAtlas()->getTexture()->getTextureID();
+    else
         texture_id = _texture->getTextureID();
     return String::createWithFormat("<Sprite | Tag = %d, TextureID = %d>", tag, texture_id );
 }
@@ -12,7 +12,7 @@ http://www.feike.org for chinese
 #include "base/lang/Object.h"
 #include "base/interface/ITexture.h"
 #include "2d/Entity.h"
-#include "core/opengl/vbo/VBO.h"
+#include "core/opengl/renderer/QuadCommand.h"
 
 FLAKOR_NS_BEGIN
 
@@ -22,6 +22,9 @@ class Rect;
 class Size;
 class Texture2D;
 class GLProgram;
+class TextureRegion;
+class TextureAtlas;
+class SpriteBatch;
 class String;
 
 /**
@@ -40,11 +43,11 @@ class String;
  *  - Use the same blending function for all your sprites
  *  - ...and the Renderer will automatically "batch" your sprites (will draw all of them in one OpenGL call).
  *
- *  To gain an additional 5% ~ 10% more in the rendering, you can parent your sprites into a `SpriteBatchNode`.
+ *  To gain an additional 5% ~ 10% more in the rendering, you can parent your sprites into a `SpriteBatch`.
  *  But doing so carries the following limitations:
  *
- *  - The Alias/Antialias property belongs to `SpriteBatchNode`, so you can't individually set the aliased property.
- *  - The Blending function property belongs to `SpriteBatchNode`, so you can't individually set the blending function property.
+ *  - The Alias/Antialias property belongs to `SpriteBatch`, so you can't individually set the aliased property.
+ *  - The Blending function property belongs to `SpriteBatch`, so you can't individually set the blending function property.
  *  - `ParallaxNode` is not supported, but can be simulated with a "proxy" sprite.
  *  - Sprites can only have other Sprites (or subclasses of Sprite) as children.
  *
@@ -59,12 +62,19 @@ protected:
     bool                _shouldBeHidden;    /// should not be drawn because one of the ancestors is not visible
     Matrix4             _transformToBatch;
 
+    //
+    // Data used when the sprite is rendered using a SpriteBatch
+    //
+    TextureAtlas*       _textureAtlas;      /// SpriteBatch texture atlas (weak reference)
+    int                 _atlasIndex;        /// Absolute (real) Index on the SpriteSheet
+    SpriteBatch*        _batchNode;         /// Used batch node (weak reference)
+
     //
     // Data used when the sprite is self-rendered
     //
     BlendFunc        _blendFunc;            /// It's required for TextureProtocol inheritance
     Texture2D*       _texture;              /// Texture2D object that is used to render the sprite
-    //QuadCommand      _quadCommand;          /// quad command
+    QuadCommand      _quadCommand;          /// quad command
 	TextureRegion*   _textureRegion;
 #if FK_SPRITE_DEBUG_DRAW
     DrawNode *_debugDrawNode;
@@ -82,7 +92,7 @@ protected:
     Point _unflippedOffsetPositionFromCenter;
 
     // vertex coords, texture coords and color info
-	VBO* _vbo;
+    V3F_C4F_T2F_Quad _quad;
 
 	GLProgram* _glProgram;
     // opacity and RGB protocol
@@ -161,9 +171,9 @@ public:
     static Sprite* createWithTexture(Texture2D *texture, const Rect& rect, bool rotated=false);
 
 	/**
-     * Creates a sprite with an sprite frame.
+     * Creates a sprite with a texture region.
      *
-     * @param   spriteFrame    A sprite frame which involves a texture and a rect.
+     * @param   region    A texture region which involves a texture and a rect, like the ones of DynamicAtlas.
      * @return  An autoreleased sprite object.
      */
     static Sprite* createWithTextureRegion(TextureRegion *region);
@@ -171,7 +181,8 @@ public:
     /// @}  end of creators group
 
     /**
-     * Updates the quad according the rotation, position, scale values.
+     * Updates the quad in the SpriteBatch's atlas according the rotation, position, scale values.
+     * Only valid when the sprite is rendered by a SpriteBatch, it does nothing otherwise.
      */
     virtual void updateTransform(void);
 
@@ -189,6 +200,11 @@ public:
      */
     virtual void setTexture(Texture2D *texture) override;
 
+    /** keeps region while the sprite shows it, setTexture() with another texture drops it */
+    void setTextureRegion(TextureRegion *region);
+    /** the region the sprite was created from, or NULL */
+    inline TextureRegion* getTextureRegion(void) const { return _textureRegion; }
+
     /** returns the Texture2D object used by the sprite */
     virtual Texture2D* getTexture(void) const override;
 
@@ -229,11 +245,46 @@ public:
     virtual void setDirty(bool dirty) { _dirty = dirty; }
 
     /**
-     * Returns the vbo (tex coords, vertex coords and color) information.
+     * Returns the batch node object if this sprite is rendered by SpriteBatch.
+     *
+     * @return The SpriteBatch object if this sprite is rendered by SpriteBatch,
+     *         nullptr if the sprite isn't used batch node.
+     */
+    inline SpriteBatch* getBatchNode(void) const { return _batchNode; }
+
+    /**
+     * Sets the batch node to sprite.
+     * @warning This method is not recommended for game developers. Sample code for using batch node
+     * @code
+     * SpriteBatch *batch = SpriteBatch::create("Images/grossini_dance_atlas.png", 15);
+     * Sprite *sprite = Sprite::createWithTexture(batch->getTexture(), Rect(0, 0, 57, 57));
+     * batch->addChild(sprite);
+     * layer->addChild(batch);
+     * @endcode
+     */
+    virtual void setBatchNode(SpriteBatch *spriteBatch);
+
+    /** Returns the index used on the TextureAtlas. */
+    inline int getAtlasIndex(void) const { return _atlasIndex; }
+
+    /**
+     * Sets the index used on the TextureAtlas.
+     * @warning Don't modify this value unless you know what you are doing.
+     */
+    inline void setAtlasIndex(int atlasIndex) { _atlasIndex = atlasIndex; }
+
+    /** Gets the weak reference of the TextureAtlas when the sprite is rendered using via SpriteBatch. */
+    inline TextureAtlas* getTextureAtlas(void) const { return _textureAtlas; }
+
+    /** Sets the weak reference of the TextureAtlas when the sprite is rendered using via SpriteBatch. */
+    inline void setTextureAtlas(TextureAtlas *textureAtlas) { _textureAtlas = textureAtlas; }
+
+    /**
+     * Returns the quad (tex coords, vertex coords and color) information.
      * @js  NA
      * @lua NA
      */
-    inline VBO* getVBO(void) { return _vbo; } const
+    inline const V3F_C4F_T2F_Quad& getQuad(void) const { return _quad; }
 
 	inline void setGLProgram(GLProgram* program) { _glProgram = program; } const
 	
@@ -303,7 +354,7 @@ public:
     *In lua: local setBlendFunc(local src, local dst)
     *@endcode
     */
-    inline void setBlendFunc(const BlendFunc &blendFunc) override { _blendFunc = blendFunc; }
+    inline void setBlendFunc(const BlendFunc &blendFunc) override { _blendFunc = blendFunc; markCacheDirty(); }
     /**
     * @js  NA
     * @lua NA
@@ -342,6 +393,8 @@ public:
     //virtual void setRelativeAnchorPoint(bool relative) override;
     virtual void setVisible(bool bVisible) override;
     virtual void draw() override;
+    /** also unflips the sprite and refreshes the quad color, texture, rect and command are kept for reuse */
+    virtual void reset() override;
     //virtual void setOpacityModifyRGB(bool modify) override;
     //virtual bool isOpacityModifyRGB(void) const override;
     /// @}
@@ -391,6 +444,14 @@ protected:
     virtual bool initWithTexture(Texture2D *texture, const Rect& rect, bool rotated);
 
 
+    /**
+     * Initializes a sprite with a texture region, the rect used is the rect of the region.
+     *
+     * @param   region    A texture region, it is retained while the sprite shows it.
+     * @return  true if the sprite is initialized properly, false otherwise.
+     */
+    virtual bool initWithTextureRegion(TextureRegion *region);
+
     /**
      * Initializes a sprite with an image filename.
      *
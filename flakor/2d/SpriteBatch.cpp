@@ -22,8 +22,16 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ****************************************************************************/
 
+#include "macros.h"
+#include "base/lang/Str.h"
 #include "2d/SpriteBatch.h"
 #include "2d/Sprite.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureAtlas.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/renderer/Renderer.h"
 
 
 FLAKOR_NS_BEGIN
@@ -32,487 +40,325 @@ FLAKOR_NS_BEGIN
 * creation with Texture2D
 */
 
-SpriteBatch* SpriteBatch::createWithTexture(Texture2D* tex, ssize_t capacity/* = DEFAULT_CAPACITY*/)
+SpriteBatch* SpriteBatch::createWithTexture(Texture2D* tex, int capacity/* = DEFAULT_CAPACITY*/)
 {
     SpriteBatch *batchNode = new (std::nothrow) SpriteBatch();
-    batchNode->initWithTexture(tex, capacity);
-    batchNode->autorelease();
-
-    return batchNode;
+    if (batchNode && batchNode->initWithTexture(tex, capacity))
+    {
+        batchNode->autorelease();
+        return batchNode;
+    }
+    FK_SAFE_DELETE(batchNode);
+    return nullptr;
 }
 
 /*
 * creation with File Image
 */
 
-SpriteBatch* SpriteBatch::create(const std::string& fileImage, ssize_t capacity/* = DEFAULT_CAPACITY*/)
+SpriteBatch* SpriteBatch::create(const std::string& fileImage, int capacity/* = DEFAULT_CAPACITY*/)
 {
     SpriteBatch *batchNode = new (std::nothrow) SpriteBatch();
-    batchNode->initWithFile(fileImage, capacity);
-    batchNode->autorelease();
-
-    return batchNode;
+    if (batchNode && batchNode->initWithFile(fileImage, capacity))
+    {
+        batchNode->autorelease();
+        return batchNode;
+    }
+    FK_SAFE_DELETE(batchNode);
+    return nullptr;
 }
 
 /*
 * init with Texture2D
 */
-bool SpriteBatch::initWithTexture(Texture2D *tex, ssize_t capacity/* = DEFAULT_CAPACITY*/)
+bool SpriteBatch::initWithTexture(Texture2D *tex, int capacity/* = DEFAULT_CAPACITY*/)
 {
-    FKASSERT(capacity>=0, "Capacity must be >= 0");
-    
-    _blendFunc = BlendFunc::ALPHA_PREMULTIPLIED;
-    if(!tex->hasPremultipliedAlpha())
+    FKAssert(tex != nullptr, "SpriteBatch: texture must be non-nil");
+    FKAssert(capacity>=0, "Capacity must be >= 0");
+
+    if (!Entity::init())
     {
-        _blendFunc = BlendFunc::ALPHA_NON_PREMULTIPLIED;
+        return false;
     }
-    _textureAtlas = new (std::nothrow) TextureAtlas();
 
     if (capacity == 0)
     {
         capacity = DEFAULT_CAPACITY;
     }
-    
-    _textureAtlas->initWithTexture(tex, capacity);
 
-    updateBlendFunc();
+    FK_SAFE_RELEASE(_textureAtlas);
+    _textureAtlas = new (std::nothrow) TextureAtlas();
+    if (_textureAtlas == nullptr || !_textureAtlas->initWithTexture(tex, capacity))
+    {
+        return false;
+    }
 
-    _children.reserve(capacity);
+    updateBlendFunc();
 
     _descendants.reserve(capacity);
-    
-    setGLProgramState(GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR));
-    return true;
-}
 
-bool SpriteBatch::init()
-{
-    Texture2D * texture = new (std::nothrow) Texture2D();
-    texture->autorelease();
-    return this->initWithTexture(texture, 0);
+    // the same program as self rendered sprites
+    _glProgram = ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR);
+    return true;
 }
 
 /*
 * init with FileImage
 */
-bool SpriteBatch::initWithFile(const std::string& fileImage, ssize_t capacity/* = DEFAULT_CAPACITY*/)
+bool SpriteBatch::initWithFile(const std::string& fileImage, int capacity/* = DEFAULT_CAPACITY*/)
 {
-    Texture2D *texture2D = Director::getInstance()->getTextureCache()->addImage(fileImage);
-    return initWithTexture(texture2D, capacity);
+    FKAssert(fileImage.size()>0, "Invalid filename for SpriteBatch");
+
+    // shared with every entity created from the same file, preloaded textures are found there too
+    Texture2D *texture = TextureManager::getInstance()->loadTexture(fileImage);
+    if (texture == nullptr)
+    {
+        return false;
+    }
+
+    return initWithTexture(texture, capacity);
 }
 
 SpriteBatch::SpriteBatch()
 : _textureAtlas(nullptr)
+, _blendFunc(BlendFunc::ALPHA_PREMULTIPLIED)
+, _glProgram(nullptr)
+, _reorderPending(false)
 {
 }
 
 SpriteBatch::~SpriteBatch()
 {
-    CC_SAFE_RELEASE(_textureAtlas);
+    // children may outlive the batch, don't leave them with a dangling atlas
+    for (auto it = _descendants.begin(); it != _descendants.end(); ++it)
+    {
+        (*it)->setBatchNode(nullptr);
+    }
+    FK_SAFE_RELEASE(_textureAtlas);
 }
 
 // override visit
 // don't call visit on it's children
-void SpriteBatch::visit(Renderer *renderer, const Mat4 &parentTransform, uint32_t parentFlags)
+void SpriteBatch::onVisit(void)
 {
-    CC_PROFILER_START_CATEGORY(kProfilerCategoryBatchSprite, "CCSpriteBatch - visit");
-
     // CAREFUL:
-    // This visit is almost identical to CocosNode#visit
+    // This visit is almost identical to Entity#onVisit
     // with the exception that it doesn't call visit on it's children
     //
-    // The alternative is to have a void Sprite#visit, but
+    // The alternative is to have a void Sprite#onVisit, but
     // although this is less maintainable, is faster
     //
-    if (! _visible || !isVisitableByVisitingCamera())
+    if (!visible)
     {
         return;
     }
 
-    sortAllChildren();
-
-    uint32_t flags = processParentFlags(parentTransform, parentFlags);
+    this->updateWorldTransform();
 
-    // IMPORTANT:
-    // To ease the migration to v3.0, we still support the Mat4 stack,
-    // but it is deprecated and your code should not rely on it
-    Director* director = Director::getInstance();
-    director->pushMatrix(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW);
-    director->loadMatrix(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW, _modelViewTransform);
-
-    draw(renderer, _modelViewTransform, flags);
+    if (!this->childrenVisible)
+    {
+        return;
+    }
 
-    director->popMatrix(MATRIX_STACK_TYPE::MATRIX_STACK_MODELVIEW);
-    // FIX ME: Why need to set _orderOfArrival to 0??
-    // Please refer to https://github.com/cocos2d/cocos2d-x/pull/6920
-//    setOrderOfArrival(0);
+    if (this->childrenSortPending || _reorderPending)
+    {
+        sortAllChildren(true);
+    }
 
-    CC_PROFILER_STOP_CATEGORY(kProfilerCategoryBatchSprite, "CCSpriteBatch - visit");
+    this->draw();
 }
 
-void SpriteBatch::addChild(Node *child, int zOrder, int tag)
+void SpriteBatch::addChild(Entity *child, int zOrder, int tag)
 {
-    CCASSERT(child != nullptr, "child should not be null");
-    CCASSERT(dynamic_cast<Sprite*>(child) != nullptr, "CCSpriteBatch only supports Sprites as children");
+    FKAssert(child != nullptr, "child should not be null");
+    FKAssert(dynamic_cast<Sprite*>(child) != nullptr, "SpriteBatch only supports Sprites as children");
     Sprite *sprite = static_cast<Sprite*>(child);
     // check Sprite is using the same texture id
-    CCASSERT(sprite->getTexture()->getName() == _textureAtlas->getTexture()->getName(), "CCSprite is not using the same texture id");
+    FKAssert(sprite->getTexture()->getTextureID() == _textureAtlas->getTexture()->getTextureID(), "Sprite is not using the same texture id");
 
-    Node::addChild(child, zOrder, tag);
-
-    appendChild(sprite);
-}
+    Entity::addChild(child, zOrder, tag);
 
-void SpriteBatch::addChild(Node * child, int zOrder, const std::string &name)
-{
-    CCASSERT(child != nullptr, "child should not be null");
-    CCASSERT(dynamic_cast<Sprite*>(child) != nullptr, "CCSpriteBatch only supports Sprites as children");
-    Sprite *sprite = static_cast<Sprite*>(child);
-    // check Sprite is using the same texture id
-    CCASSERT(sprite->getTexture()->getName() == _textureAtlas->getTexture()->getName(), "CCSprite is not using the same texture id");
-    
-    Node::addChild(child, zOrder, name);
-    
     appendChild(sprite);
 }
 
 // override reorderChild
-void SpriteBatch::reorderChild(Node *child, int zOrder)
+void SpriteBatch::reorderChild(Entity *child, int zOrder)
 {
-    CCASSERT(child != nullptr, "the child should not be null");
-    CCASSERT(_children.contains(child), "Child doesn't belong to Sprite");
+    FKAssert(child != nullptr, "the child should not be null");
+    FKAssert(children->containsObject(child), "Child doesn't belong to SpriteBatch");
 
-    if (zOrder == child->getLocalZOrder())
-    {
-        return;
-    }
-
-    //set the z-order and sort later
-    Node::reorderChild(child, zOrder);
+    // Entity::setZOrder() stored the new z before it got here, the atlas order is checked when sorting
+    Entity::reorderChild(child, zOrder);
+    _reorderPending = true;
 }
 
 // override remove child
-void SpriteBatch::removeChild(Node *child, bool cleanup)
+void SpriteBatch::removeChild(Entity *child, bool cleanup)
 {
     Sprite *sprite = static_cast<Sprite*>(child);
 
     // explicit null handling
-    if (sprite == nullptr)
+    if (sprite == nullptr || children == nullptr || !children->containsObject(sprite))
     {
         return;
     }
 
-    CCASSERT(_children.contains(sprite), "sprite batch node should contain the child");
-
     // cleanup before removing
     removeSpriteFromAtlas(sprite);
 
-    Node::removeChild(sprite, cleanup);
+    Entity::removeChild(sprite, cleanup);
 }
 
-void SpriteBatch::removeChildAtIndex(ssize_t index, bool doCleanup)
+void SpriteBatch::removeChildAtIndex(int index, bool doCleanup)
 {
-    CCASSERT(index>=0 && index < _children.size(), "Invalid index");
-    removeChild(_children.at(index), doCleanup);
+    FKAssert(index>=0 && index < (int)children->count(), "Invalid index");
+    removeChild(static_cast<Entity*>(children->objectAtIndex(index)), doCleanup);
 }
 
-void SpriteBatch::removeAllChildrenWithCleanup(bool doCleanup)
+void SpriteBatch::removeAllChildren(bool cleanup)
 {
-    // Invalidate atlas index. issue #569
-    // useSelfRender should be performed on all descendants. issue #1216
-    for(const auto &sprite: _descendants) {
-        sprite->setBatchNode(nullptr);
+    // Invalidate atlas index.
+    // useSelfRender should be performed on all descendants.
+    for (auto it = _descendants.begin(); it != _descendants.end(); ++it)
+    {
+        (*it)->setBatchNode(nullptr);
     }
 
-    Node::removeAllChildrenWithCleanup(doCleanup);
+    Entity::removeAllChildren(cleanup);
 
     _descendants.clear();
     _textureAtlas->removeAllQuads();
+    _reorderPending = false;
 }
 
 //override sortAllChildren
-void SpriteBatch::sortAllChildren()
+void SpriteBatch::sortAllChildren(bool immediate)
 {
-    if (_reorderChildDirty)
+    if (!immediate)
     {
-        std::sort(std::begin(_children), std::end(_children), nodeComparisonLess);
-
-        //sorted now check all children
-        if (!_children.empty())
-        {
-            //first sort all children recursively based on zOrder
-            for(const auto &child: _children) {
-                child->sortAllChildren();
-            }
-
-            ssize_t index=0;
-
-            //fast dispatch, give every child a new atlasIndex based on their relative zOrder (keep parent -> child relations intact)
-            // and at the same time reorder descendants and the quads to the right index
-            for(const auto &child: _children) {
-                Sprite* sp = static_cast<Sprite*>(child);
-                updateAtlasIndex(sp, &index);
-            }
-        }
-
-        _reorderChildDirty=false;
+        _reorderPending = true;
+        Entity::sortAllChildren(false);
+        return;
     }
-}
 
-void SpriteBatch::updateAtlasIndex(Sprite* sprite, ssize_t* curIndex)
-{
-    auto& array = sprite->getChildren();
-    auto count = array.size();
-    
-    ssize_t oldIndex = 0;
-
-    if( count == 0 )
+    if (children != nullptr && this->childrenSortPending)
     {
-        oldIndex = sprite->getAtlasIndex();
-        sprite->setAtlasIndex(*curIndex);
-        sprite->setOrderOfArrival(0);
-        if (oldIndex != *curIndex){
-            swap(oldIndex, *curIndex);
-        }
-        (*curIndex)++;
+        Entity::sortAllChildren(true);
     }
-    else
-    {
-        bool needNewIndex=true;
-
-        if (array.at(0)->getLocalZOrder() >= 0)
-        {
-            //all children are in front of the parent
-            oldIndex = sprite->getAtlasIndex();
-            sprite->setAtlasIndex(*curIndex);
-            sprite->setOrderOfArrival(0);
-            if (oldIndex != *curIndex)
-            {
-                swap(oldIndex, *curIndex);
-            }
-            (*curIndex)++;
-
-            needNewIndex = false;
-        }
-
-        for(const auto &child: array) {
-            Sprite* sp = static_cast<Sprite*>(child);
-            if (needNewIndex && sp->getLocalZOrder() >= 0)
-            {
-                oldIndex = sprite->getAtlasIndex();
-                sprite->setAtlasIndex(*curIndex);
-                sprite->setOrderOfArrival(0);
-                if (oldIndex != *curIndex) {
-                    this->swap(oldIndex, *curIndex);
-                }
-                (*curIndex)++;
-                needNewIndex = false;
-            }
-            
-            updateAtlasIndex(sp, curIndex);
-        }
 
-        if (needNewIndex)
-        {//all children have a zOrder < 0)
-            oldIndex = sprite->getAtlasIndex();
-            sprite->setAtlasIndex(*curIndex);
-            sprite->setOrderOfArrival(0);
-            if (oldIndex != *curIndex) {
-                swap(oldIndex, *curIndex);
-            }
-            (*curIndex)++;
-        }
+    if (_reorderPending)
+    {
+        rebuildAtlasOrder();
+        _reorderPending = false;
     }
 }
 
-void SpriteBatch::swap(ssize_t oldIndex, ssize_t newIndex)
-{
-    CCASSERT(oldIndex>=0 && oldIndex < (int)_descendants.size() && newIndex >=0 && newIndex < (int)_descendants.size(), "Invalid index");
-
-    V3F_C4B_T2F_Quad* quads = _textureAtlas->getQuads();
-    std::swap( quads[oldIndex], quads[newIndex] );
-
-    //update the index of other swapped item
-
-    auto oldIt = std::next( _descendants.begin(), oldIndex );
-    auto newIt = std::next( _descendants.begin(), newIndex );
-
-    (*newIt)->setAtlasIndex(oldIndex);
-//    (*oldIt)->setAtlasIndex(newIndex);
-
-    std::swap( *oldIt, *newIt );
-}
-
-void SpriteBatch::reorderBatch(bool reorder)
+void SpriteBatch::collectDescendants(Sprite* sprite, std::vector<Sprite*>& order)
 {
-    _reorderChildDirty=reorder;
-}
+    Array* array = sprite->getChildren();
+    int count = (array != nullptr) ? array->count() : 0;
 
-void SpriteBatch::draw(Renderer *renderer, const Mat4 &transform, uint32_t flags)
-{
-    // Optimization: Fast Dispatch
-    if( _textureAtlas->getTotalQuads() == 0 )
+    if (count == 0)
     {
+        order.push_back(sprite);
         return;
     }
 
-    for (const auto &child : _children)
-    {
-#if CC_USE_PHYSICS
-        auto physicsBody = child->getPhysicsBody();
-        if (physicsBody)
-        {
-            child->updateTransformFromPhysics(transform, flags);
-        }
-#endif
-        child->updateTransform();
-    }
+    sprite->sortAllChildren(true);
 
-    _batchCommand.init(_globalZOrder, getGLProgram(), _blendFunc, _textureAtlas, transform, flags);
-    renderer->addCommand(&_batchCommand);
-}
+    Entity** data = (Entity**)array->data->arr;
+    int i = 0;
 
-void SpriteBatch::increaseAtlasCapacity()
-{
-    // if we're going beyond the current TextureAtlas's capacity,
-    // all the previously initialized sprites will need to redo their texture coords
-    // this is likely computationally expensive
-    ssize_t quantity = (_textureAtlas->getCapacity() + 1) * 4 / 3;
+    //children behind the parent
+    for (; i < count && data[i]->getZOrder() < 0; i++)
+    {
+        collectDescendants(static_cast<Sprite*>(data[i]), order);
+    }
 
-    CCLOG("cocos2d: SpriteBatch: resizing TextureAtlas capacity from [%d] to [%d].",
-        static_cast<int>(_textureAtlas->getCapacity()),
-        static_cast<int>(quantity));
+    order.push_back(sprite);
 
-    if (! _textureAtlas->resizeCapacity(quantity))
+    //children in front of the parent
+    for (; i < count; i++)
     {
-        // serious problems
-        CCLOGWARN("cocos2d: WARNING: Not enough memory to resize the atlas");
-        CCASSERT(false, "Not enough memory to resize the atlas");
+        collectDescendants(static_cast<Sprite*>(data[i]), order);
     }
 }
 
-ssize_t SpriteBatch::rebuildIndexInOrder(Sprite *parent, ssize_t index)
+void SpriteBatch::rebuildAtlasOrder()
 {
-    CCASSERT(index>=0 && index < _children.size(), "Invalid index");
+    std::vector<Sprite*> order;
+    order.reserve(_descendants.size());
 
-    auto& children = parent->getChildren();
-    for(const auto &child: children) {
-        Sprite* sp = static_cast<Sprite*>(child);
-        if (sp && (sp->getLocalZOrder() < 0))
-        {
-            index = rebuildIndexInOrder(sp, index);
-        }
-    }
-
-    // ignore self (batch node)
-    if (parent != static_cast<Ref*>(this))
+    if (children != nullptr)
     {
-        parent->setAtlasIndex(index);
-        index++;
-    }
-
-    for(const auto &child: children) {
-        Sprite* sp = static_cast<Sprite*>(child);
-        if (sp && (sp->getLocalZOrder() >= 0))
+        Object* child;
+        FK_ARRAY_FOREACH(children, child)
         {
-            index = rebuildIndexInOrder(sp, index);
+            collectDescendants(static_cast<Sprite*>(child), order);
         }
     }
 
-    return index;
-}
+    FKAssert(order.size() == _descendants.size(), "SpriteBatch: descendants out of sync with children");
 
-ssize_t SpriteBatch::highestAtlasIndexInChild(Sprite *sprite)
-{
-    auto& children = sprite->getChildren();
+    // move every quad to the new slot, untouched ranges stay clean
+    V3F_C4F_T2F_Quad* quads = _textureAtlas->getQuads();
+    std::vector<V3F_C4F_T2F_Quad> old(quads, quads + _descendants.size());
 
-    if (children.size() == 0)
+    for (int i = 0; i < (int)order.size(); i++)
     {
-        return sprite->getAtlasIndex();
-    }
-    else
-    {
-        return highestAtlasIndexInChild( static_cast<Sprite*>(children.back()));
+        Sprite* sprite = order[i];
+        if (sprite->getAtlasIndex() != i)
+        {
+            _textureAtlas->updateQuad(&old[sprite->getAtlasIndex()], i);
+            sprite->setAtlasIndex(i);
+        }
     }
+
+    _descendants.swap(order);
 }
 
-ssize_t SpriteBatch::lowestAtlasIndexInChild(Sprite *sprite)
+void SpriteBatch::reorderBatch(bool reorder)
 {
-    auto& children = sprite->getChildren();
-
-    if (children.size() == 0)
-    {
-        return sprite->getAtlasIndex();
-    }
-    else
-    {
-        return lowestAtlasIndexInChild(static_cast<Sprite*>(children.at(0)));
-    }
+    _reorderPending = reorder;
 }
 
-ssize_t SpriteBatch::atlasIndexForChild(Sprite *sprite, int nZ)
+void SpriteBatch::draw(void)
 {
-    auto& siblings = sprite->getParent()->getChildren();
-    auto childIndex = siblings.getIndex(sprite);
-
-    // ignore parent Z if parent is spriteSheet
-    bool ignoreParent = (SpriteBatch*)(sprite->getParent()) == this;
-    Sprite *prev = nullptr;
-    if (childIndex > 0 && childIndex != -1)
+    // Optimization: Fast Dispatch
+    if( _textureAtlas->getTotalQuads() == 0 )
     {
-        prev = static_cast<Sprite*>(siblings.at(childIndex - 1));
+        return;
     }
 
-    // first child of the sprite sheet
-    if (ignoreParent)
-    {
-        if (childIndex == 0)
-        {
-            return 0;
-        }
+    // only the sprites that moved write their quad
+    arrayMakeObjectsPerformSelector(children, updateTransform, Sprite*);
 
-        return highestAtlasIndexInChild(prev) + 1;
-    }
+    _batchCommand.init(vertexZ, _glProgram, _blendFunc, _textureAtlas, worldMatrix);
+    Renderer::getInstance()->addCommand(&_batchCommand);
+}
 
-    // parent is a Sprite, so, it must be taken into account
+void SpriteBatch::increaseAtlasCapacity()
+{
+    // if we're going beyond the current TextureAtlas's capacity,
+    // the atlas is reallocated and fully uploaded in next draw
+    int quantity = (_textureAtlas->getCapacity() + 1) * 4 / 3;
 
-    // first child of an Sprite ?
-    if (childIndex == 0)
-    {
-        Sprite *p = static_cast<Sprite*>(sprite->getParent());
+    FKLOG("flakor: SpriteBatch: resizing TextureAtlas capacity from [%d] to [%d].",
+        _textureAtlas->getCapacity(), quantity);
 
-        // less than parent and brothers
-        if (nZ < 0)
-        {
-            return p->getAtlasIndex();
-        }
-        else
-        {
-            return p->getAtlasIndex() + 1;
-        }
-    }
-    else
+    if (! _textureAtlas->resizeCapacity(quantity))
     {
-        // previous & sprite belong to the same branch
-        if ((prev->getLocalZOrder() < 0 && nZ < 0) || (prev->getLocalZOrder() >= 0 && nZ >= 0))
-        {
-            return highestAtlasIndexInChild(prev) + 1;
-        }
-
-        // else (previous < 0 and sprite >= 0 )
-        Sprite *p = static_cast<Sprite*>(sprite->getParent());
-        return p->getAtlasIndex() + 1;
+        // serious problems
+        FKLOG("flakor: WARNING: Not enough memory to resize the atlas");
+        FKAssert(false, "Not enough memory to resize the atlas");
     }
-
-    // Should not happen. Error calculating Z on SpriteSheet
-    CCASSERT(0, "should not run here");
-    return 0;
 }
 
 // addChild helper, faster than insertChild
 void SpriteBatch::appendChild(Sprite* sprite)
 {
-    _reorderChildDirty=true;
+    // the sprite may belong before existing ones, the atlas order is fixed in next visit
+    _reorderPending = true;
     sprite->setBatchNode(this);
     sprite->setDirty(true);
 
@@ -525,45 +371,46 @@ void SpriteBatch::appendChild(Sprite* sprite)
 
     sprite->setAtlasIndex(index);
 
-    V3F_C4B_T2F_Quad quad = sprite->getQuad();
-    _textureAtlas->insertQuad(&quad, index);
+    // the real quad is written by updateTransform(), this only reserves the slot
+    _textureAtlas->insertQuad(&sprite->getQuad(), index);
 
     // add children recursively
-    auto& children = sprite->getChildren();
-    for(const auto &child: children) {
-        appendChild(static_cast<Sprite*>(child));
+    Array* array = sprite->getChildren();
+    if (array != nullptr)
+    {
+        Object* child;
+        FK_ARRAY_FOREACH(array, child)
+        {
+            appendChild(static_cast<Sprite*>(child));
+        }
     }
 }
 
 void SpriteBatch::removeSpriteFromAtlas(Sprite *sprite)
 {
+    int index = sprite->getAtlasIndex();
+    FKAssert(index >= 0 && index < (int)_descendants.size() && _descendants[index] == sprite, "SpriteBatch: sprite is not in the atlas");
+
     // remove from TextureAtlas
-    _textureAtlas->removeQuadAtIndex(sprite->getAtlasIndex());
+    _textureAtlas->removeQuadAtIndex(index);
 
-    // Cleanup sprite. It might be reused (issue #569)
+    // Cleanup sprite. It might be reused
     sprite->setBatchNode(nullptr);
 
-    auto it = std::find(_descendants.begin(), _descendants.end(), sprite );
-    if( it != _descendants.end() )
+    for (int i = index + 1; i < (int)_descendants.size(); i++)
     {
-        auto next = std::next(it);
-
-        Sprite *spr = nullptr;
-        for(; next != _descendants.end(); ++next) {
-            spr = *next;
-            spr->setAtlasIndex( spr->getAtlasIndex() - 1 );
-        }
-
-        _descendants.erase(it);
+        _descendants[i]->setAtlasIndex(i - 1);
     }
+    _descendants.erase(_descendants.begin() + index);
 
     // remove children recursively
-    auto& children = sprite->getChildren();
-    for(const auto &obj: children) {
-        Sprite* child = static_cast<Sprite*>(obj);
-        if (child)
+    Array* array = sprite->getChildren();
+    if (array != nullptr)
+    {
+        Object* child;
+        FK_ARRAY_FOREACH(array, child)
         {
-            removeSpriteFromAtlas(child);
+            removeSpriteFromAtlas(static_cast<Sprite*>(child));
         }
     }
 }
@@ -573,16 +420,14 @@ void SpriteBatch::updateBlendFunc()
     if (! _textureAtlas->getTexture()->hasPremultipliedAlpha())
     {
         _blendFunc = BlendFunc::ALPHA_NON_PREMULTIPLIED;
-        setOpacityModifyRGB(false);
     }
     else
     {
         _blendFunc = BlendFunc::ALPHA_PREMULTIPLIED;
-        setOpacityModifyRGB(true);
     }
 }
 
-// CocosNodeTexture protocol
+// ITexture protocol
 void SpriteBatch::setBlendFunc(const BlendFunc &blendFunc)
 {
     _blendFunc = blendFunc;
@@ -604,88 +449,9 @@ void SpriteBatch::setTexture(Texture2D *texture)
     updateBlendFunc();
 }
 
-
-// SpriteSheet Extension
-//implementation SpriteSheet (TMXTiledMapExtension)
-
-void SpriteBatch::insertQuadFromSprite(Sprite *sprite, ssize_t index)
-{
-    CCASSERT( sprite != nullptr, "Argument must be non-nullptr");
-    CCASSERT( dynamic_cast<Sprite*>(sprite), "CCSpriteBatch only supports Sprites as children");
-
-    // make needed room
-    while(index >= _textureAtlas->getCapacity() || _textureAtlas->getCapacity() == _textureAtlas->getTotalQuads())
-    {
-        this->increaseAtlasCapacity();
-    }
-    //
-    // update the quad directly. Don't add the sprite to the scene graph
-    //
-    sprite->setBatchNode(this);
-    sprite->setAtlasIndex(index);
-
-    V3F_C4B_T2F_Quad quad = sprite->getQuad();
-    _textureAtlas->insertQuad(&quad, index);
-
-    // FIXME:: updateTransform will update the textureAtlas too, using updateQuad.
-    // FIXME:: so, it should be AFTER the insertQuad
-    sprite->setDirty(true);
-    sprite->updateTransform();
-}
-
-void SpriteBatch::updateQuadFromSprite(Sprite *sprite, ssize_t index)
-{
-    CCASSERT(sprite != nullptr, "Argument must be non-nil");
-    CCASSERT(dynamic_cast<Sprite*>(sprite) != nullptr, "CCSpriteBatch only supports Sprites as children");
-    
-    // make needed room
-    while (index >= _textureAtlas->getCapacity() || _textureAtlas->getCapacity() == _textureAtlas->getTotalQuads())
-    {
-        this->increaseAtlasCapacity();
-    }
-    
-    //
-    // update the quad directly. Don't add the sprite to the scene graph
-    //
-    sprite->setBatchNode(this);
-    sprite->setAtlasIndex(index);
-    
-    sprite->setDirty(true);
-    
-    // UpdateTransform updates the textureAtlas quad
-    sprite->updateTransform();
-}
-
-SpriteBatch * SpriteBatch::addSpriteWithoutQuad(Sprite*child, int z, int aTag)
-{
-    CCASSERT( child != nullptr, "Argument must be non-nullptr");
-    CCASSERT( dynamic_cast<Sprite*>(child), "CCSpriteBatch only supports Sprites as children");
-
-    // quad index is Z
-    child->setAtlasIndex(z);
-
-    // FIXME:: optimize with a binary search
-    auto it = _descendants.begin();
-    for (; it != _descendants.end(); ++it)
-    {
-        if((*it)->getAtlasIndex() >= z)
-            break;
-    }
-
-    _descendants.insert(it, child);
-
-    // IMPORTANT: Call super, and not self. Avoid adding it to the texture atlas array
-    Node::addChild(child, z, aTag);
-
-    //#issue 1262 don't use lazy sorting, tiles are added as quads not as sprites, so sprites need to be added in order
-    reorderBatch(false);
-
-    return this;
-}
-
-std::string SpriteBatch::getDescription() const
+String* SpriteBatch::toString() const
 {
-    return StringUtils::format("<SpriteBatch | tag = %d>", _tag);
+    return String::createWithFormat("<SpriteBatch | Tag = %d, Quads = %d>", tag, _textureAtlas->getTotalQuads());
 }
 
 FLAKOR_NS_END
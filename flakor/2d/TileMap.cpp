@@ -0,0 +1,438 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "macros.h"
+#include "base/lang/Str.h"
+#include "2d/TileMap.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureAtlas.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/renderer/Renderer.h"
+
+FLAKOR_NS_BEGIN
+
+TileMap* TileMap::createWithTexture(Texture2D* tileset, const Size& tileSize, int columns, int rows,
+        int chunkSize/* = DEFAULT_CHUNK_SIZE*/)
+{
+    TileMap *map = new (std::nothrow) TileMap();
+    if (map && map->initWithTexture(tileset, tileSize, columns, rows, chunkSize))
+    {
+        map->autorelease();
+        return map;
+    }
+    FK_SAFE_DELETE(map);
+    return nullptr;
+}
+
+TileMap* TileMap::create(const std::string& tilesetImage, const Size& tileSize, int columns, int rows,
+        int chunkSize/* = DEFAULT_CHUNK_SIZE*/)
+{
+    TileMap *map = new (std::nothrow) TileMap();
+    if (map && map->initWithFile(tilesetImage, tileSize, columns, rows, chunkSize))
+    {
+        map->autorelease();
+        return map;
+    }
+    FK_SAFE_DELETE(map);
+    return nullptr;
+}
+
+TileMap::TileMap()
+: _texture(nullptr)
+, _blendFunc(BlendFunc::ALPHA_PREMULTIPLIED)
+, _glProgram(nullptr)
+, _tileSize(SizeZero)
+, _columns(0)
+, _rows(0)
+, _chunkSize(DEFAULT_CHUNK_SIZE)
+, _chunkColumns(0)
+, _chunkRows(0)
+, _maxBakedChunks(DEFAULT_MAX_BAKED_CHUNKS)
+, _drawFrame(0)
+, _drawnChunks(0)
+{
+}
+
+TileMap::~TileMap()
+{
+    releaseAllChunks();
+    FK_SAFE_RELEASE(_texture);
+}
+
+bool TileMap::initWithTexture(Texture2D *tileset, const Size& tileSize, int columns, int rows, int chunkSize)
+{
+    FKAssert(tileset != nullptr, "TileMap: tileset must be non-nil");
+    FKAssert(tileSize.width > 0 && tileSize.height > 0, "TileMap: invalid tile size");
+    FKAssert(columns > 0 && rows > 0, "TileMap: invalid map size");
+    FKAssert(chunkSize > 0, "TileMap: invalid chunk size");
+
+    if (!Entity::init())
+    {
+        return false;
+    }
+
+    setTexture(tileset);
+    _glProgram = ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR);
+
+    // one chunk is one atlas, its quad indices must fit in GLushort
+    int maxChunkSize = (int)sqrtf((float)TextureAtlas::MAX_CAPACITY);
+    _chunkSize = MIN(chunkSize, maxChunkSize);
+    _tileSize = tileSize;
+    _columns = columns;
+    _rows = rows;
+    _chunkColumns = (columns + _chunkSize - 1) / _chunkSize;
+    _chunkRows = (rows + _chunkSize - 1) / _chunkSize;
+
+    _tiles.assign(columns * rows, EMPTY_TILE);
+
+    Chunk empty;
+    empty.atlas = nullptr;
+    empty.tileCount = 0;
+    empty.lastDrawn = 0;
+    _chunks.assign(_chunkColumns * _chunkRows, empty);
+
+    setContentSize(SizeMake(columns * tileSize.width, rows * tileSize.height));
+    return true;
+}
+
+bool TileMap::initWithFile(const std::string& tilesetImage, const Size& tileSize, int columns, int rows, int chunkSize)
+{
+    FKAssert(tilesetImage.size()>0, "Invalid filename for TileMap");
+
+    // shared with every entity created from the same file, preloaded textures are found there too
+    Texture2D *texture = TextureManager::getInstance()->loadTexture(tilesetImage);
+    if (texture == nullptr)
+    {
+        return false;
+    }
+
+    return initWithTexture(texture, tileSize, columns, rows, chunkSize);
+}
+
+void TileMap::setTiles(const int* gids)
+{
+    FKAssert(gids != nullptr, "TileMap: gids must be non-nil");
+
+    memcpy(_tiles.data(), gids, _tiles.size() * sizeof(int));
+    // every chunk changed, bake them again when they show up
+    releaseAllChunks();
+    markCacheDirty();
+}
+
+int TileMap::getTile(int column, int row) const
+{
+    FKAssert(column >= 0 && column < _columns && row >= 0 && row < _rows, "TileMap: tile out of range");
+
+    return _tiles[row * _columns + column];
+}
+
+void TileMap::setTile(int column, int row, int gid)
+{
+    FKAssert(column >= 0 && column < _columns && row >= 0 && row < _rows, "TileMap: tile out of range");
+
+    int& tile = _tiles[row * _columns + column];
+    if (tile == gid)
+    {
+        return;
+    }
+
+    Chunk& chunk = _chunks[(row / _chunkSize) * _chunkColumns + column / _chunkSize];
+    if (chunk.atlas != nullptr)
+    {
+        chunk.tileCount += (gid != EMPTY_TILE) - (tile != EMPTY_TILE);
+
+        // the chunk is uploaded from its dirty range, which is just this quad
+        int chunkWidth = MIN(_chunkSize, _columns - (column / _chunkSize) * _chunkSize);
+        int slot = (row % _chunkSize) * chunkWidth + column % _chunkSize;
+        V3F_C4F_T2F_Quad quad;
+        makeQuad(column, row, gid, &quad);
+        chunk.atlas->updateQuad(&quad, slot);
+    }
+    tile = gid;
+    markCacheDirty();
+}
+
+void TileMap::makeQuad(int column, int row, int gid, V3F_C4F_T2F_Quad* quad) const
+{
+    if (gid == EMPTY_TILE)
+    {
+        // no area, the GPU drops it before rasterizing
+        memset(quad, 0, sizeof(*quad));
+        return;
+    }
+
+    float left = column * _tileSize.width;
+    float bottom = (_rows - 1 - row) * _tileSize.height;
+    float right = left + _tileSize.width;
+    float top = bottom + _tileSize.height;
+
+    // tileset rect from the top left, like Sprite texture rects
+    float atlasWidth = (float)_texture->getPixelsWidth();
+    float atlasHeight = (float)_texture->getPixelsHeight();
+    int tilesetColumns = MAX((int)(atlasWidth / _tileSize.width), 1);
+    int index = gid - 1;
+    float u0 = (index % tilesetColumns) * _tileSize.width / atlasWidth;
+    float v0 = (index / tilesetColumns) * _tileSize.height / atlasHeight;
+    float u1 = u0 + _tileSize.width / atlasWidth;
+    float v1 = v0 + _tileSize.height / atlasHeight;
+
+    quad->bl.vertices.x = left;
+    quad->bl.vertices.y = bottom;
+    quad->br.vertices.x = right;
+    quad->br.vertices.y = bottom;
+    quad->tl.vertices.x = left;
+    quad->tl.vertices.y = top;
+    quad->tr.vertices.x = right;
+    quad->tr.vertices.y = top;
+    quad->bl.vertices.z = quad->br.vertices.z = quad->tl.vertices.z = quad->tr.vertices.z = 0.0f;
+
+    quad->bl.texCoords.u = u0;
+    quad->bl.texCoords.v = v1;
+    quad->br.texCoords.u = u1;
+    quad->br.texCoords.v = v1;
+    quad->tl.texCoords.u = u0;
+    quad->tl.texCoords.v = v0;
+    quad->tr.texCoords.u = u1;
+    quad->tr.texCoords.v = v0;
+
+    Color4F white = { 1.0f, 1.0f, 1.0f, 1.0f };
+    quad->bl.colors = quad->br.colors = quad->tl.colors = quad->tr.colors = white;
+}
+
+bool TileMap::bakeChunk(int chunkColumn, int chunkRow)
+{
+    int firstColumn = chunkColumn * _chunkSize;
+    int firstRow = chunkRow * _chunkSize;
+    int width = MIN(_chunkSize, _columns - firstColumn);
+    int height = MIN(_chunkSize, _rows - firstRow);
+
+    TextureAtlas* atlas = TextureAtlas::create(_texture, width * height);
+    if (atlas == nullptr)
+    {
+        return false;
+    }
+
+    // one slot per tile, row by row, so setTile() finds its quad without a lookup
+    Chunk& chunk = _chunks[chunkRow * _chunkColumns + chunkColumn];
+    chunk.tileCount = 0;
+    V3F_C4F_T2F_Quad quad;
+    for (int row = 0; row < height; row++)
+    {
+        for (int column = 0; column < width; column++)
+        {
+            int gid = _tiles[(firstRow + row) * _columns + firstColumn + column];
+            makeQuad(firstColumn + column, firstRow + row, gid, &quad);
+            atlas->updateQuad(&quad, row * width + column);
+            chunk.tileCount += gid != EMPTY_TILE;
+        }
+    }
+
+    atlas->retain();
+    chunk.atlas = atlas;
+    _bakedChunks.push_back(chunkRow * _chunkColumns + chunkColumn);
+    return true;
+}
+
+void TileMap::releaseChunk(Chunk& chunk)
+{
+    FK_SAFE_RELEASE_NULL(chunk.atlas);
+    chunk.tileCount = 0;
+}
+
+void TileMap::releaseAllChunks()
+{
+    for (size_t i = 0; i < _bakedChunks.size(); i++)
+    {
+        releaseChunk(_chunks[_bakedChunks[i]]);
+    }
+    _bakedChunks.clear();
+}
+
+void TileMap::evictChunks()
+{
+    if ((int)_bakedChunks.size() <= _maxBakedChunks)
+    {
+        return;
+    }
+
+    // most recently drawn first, the visible ones are always kept
+    std::vector<Chunk>& chunks = _chunks;
+    std::sort(_bakedChunks.begin(), _bakedChunks.end(), [&chunks](int a, int b) {
+        return chunks[a].lastDrawn > chunks[b].lastDrawn;
+    });
+
+    int keep = (int)_bakedChunks.size();
+    while (keep > _maxBakedChunks && _chunks[_bakedChunks[keep - 1]].lastDrawn != _drawFrame)
+    {
+        keep--;
+        releaseChunk(_chunks[_bakedChunks[keep]]);
+    }
+    _bakedChunks.resize(keep);
+}
+
+bool TileMap::getVisibleChunks(int* firstColumn, int* firstRow, int* lastColumn, int* lastRow) const
+{
+    float left = 0.0f;
+    float bottom = 0.0f;
+    float right = contentSize.width;
+    float top = contentSize.height;
+
+    const Rect& visibleRect = Renderer::getInstance()->getVisibleRect();
+    if (visibleRect.size.width > 0.0f && visibleRect.size.height > 0.0f)
+    {
+        // bounding box of the visible rect in entity space
+        Matrix4 worldToEntity = worldMatrix;
+        worldToEntity.invert();
+        const float* m = worldToEntity.get();
+        float xs[2] = { visibleRect.origin.x, visibleRect.origin.x + visibleRect.size.width };
+        float ys[2] = { visibleRect.origin.y, visibleRect.origin.y + visibleRect.size.height };
+        left = bottom = INFINITY;
+        right = top = -INFINITY;
+        for (int i = 0; i < 4; i++)
+        {
+            float x = xs[i & 1];
+            float y = ys[i >> 1];
+            float ex = m[0] * x + m[4] * y + m[12];
+            float ey = m[1] * x + m[5] * y + m[13];
+            left = MIN(left, ex);
+            right = MAX(right, ex);
+            bottom = MIN(bottom, ey);
+            top = MAX(top, ey);
+        }
+    }
+
+    // tiles under the box, rows count from the top
+    int columnMin = MAX((int)floorf(left / _tileSize.width), 0);
+    int columnMax = MIN((int)floorf(right / _tileSize.width), _columns - 1);
+    int rowMin = MAX(_rows - 1 - (int)floorf(top / _tileSize.height), 0);
+    int rowMax = MIN(_rows - 1 - (int)floorf(bottom / _tileSize.height), _rows - 1);
+    if (columnMin > columnMax || rowMin > rowMax)
+    {
+        return false;
+    }
+
+    *firstColumn = columnMin / _chunkSize;
+    *lastColumn = columnMax / _chunkSize;
+    *firstRow = rowMin / _chunkSize;
+    *lastRow = rowMax / _chunkSize;
+    return true;
+}
+
+void TileMap::draw(void)
+{
+    _drawnChunks = 0;
+    _drawFrame++;
+
+    int firstColumn, firstRow, lastColumn, lastRow;
+    if (!getVisibleChunks(&firstColumn, &firstRow, &lastColumn, &lastRow))
+    {
+        return;
+    }
+
+    // upload the texture if needed, the draw calls themselves are issued by Renderer
+    _texture->loadGL();
+
+    Renderer* renderer = Renderer::getInstance();
+    for (int chunkRow = firstRow; chunkRow <= lastRow; chunkRow++)
+    {
+        for (int chunkColumn = firstColumn; chunkColumn <= lastColumn; chunkColumn++)
+        {
+            Chunk& chunk = _chunks[chunkRow * _chunkColumns + chunkColumn];
+            if (chunk.atlas == nullptr && !bakeChunk(chunkColumn, chunkRow))
+            {
+                continue;
+            }
+
+            chunk.lastDrawn = _drawFrame;
+            if (chunk.tileCount == 0)
+            {
+                continue;
+            }
+            chunk.command.init(vertexZ, _glProgram, _blendFunc, chunk.atlas, worldMatrix);
+            renderer->addCommand(&chunk.command);
+            _drawnChunks++;
+        }
+    }
+
+    evictChunks();
+}
+
+void TileMap::updateBlendFunc()
+{
+    if (! _texture->hasPremultipliedAlpha())
+    {
+        _blendFunc = BlendFunc::ALPHA_NON_PREMULTIPLIED;
+    }
+    else
+    {
+        _blendFunc = BlendFunc::ALPHA_PREMULTIPLIED;
+    }
+}
+
+// ITexture protocol
+void TileMap::setBlendFunc(const BlendFunc &blendFunc)
+{
+    _blendFunc = blendFunc;
+    markCacheDirty();
+}
+
+const BlendFunc& TileMap::getBlendFunc() const
+{
+    return _blendFunc;
+}
+
+Texture2D* TileMap::getTexture() const
+{
+    return _texture;
+}
+
+void TileMap::setTexture(Texture2D *texture)
+{
+    FKAssert(texture != nullptr, "TileMap: texture must be non-nil");
+
+    if (_texture != texture)
+    {
+        FK_SAFE_RETAIN(texture);
+        FK_SAFE_RELEASE(_texture);
+        _texture = texture;
+        // texture coordinates depend on the tileset size
+        releaseAllChunks();
+        markCacheDirty();
+    }
+    updateBlendFunc();
+}
+
+String* TileMap::toString() const
+{
+    return String::createWithFormat("<TileMap | Tag = %d, Tiles = %d x %d, Chunks = %d>", tag, _columns, _rows, (int)_chunks.size());
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,180 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Flakor.org
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+
+#ifndef _FK_TILE_MAP_H_
+#define _FK_TILE_MAP_H_
+
+#include <vector>
+#include <string>
+
+#include "2d/Entity.h"
+#include "base/interface/ITexture.h"
+#include "core/opengl/renderer/BatchCommand.h"
+#include "core/opengl/renderer/RenderTypes.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup entity
+ * @{
+ */
+
+class Texture2D;
+class TextureAtlas;
+class GLProgram;
+
+/** TileMap draws a grid of tiles taken from one tileset texture.
+ *
+ * The map is split into chunks of chunkSize x chunkSize tiles. A chunk is baked into its own
+ * TextureAtlas (static vertex buffer, shared index buffer) the first time it shows up and
+ * is drawn with one BatchCommand afterwards, no quad is rebuilt or uploaded while scrolling.
+ * Only the chunks that intersect Renderer's visible rect are visited, so the cost of a frame
+ * depends on the screen size, not on the size of the map.
+ *
+ * Tiles are gids like in TMX: 0 is an empty tile, n is tile n-1 of the tileset counted from
+ * the top left, row by row. Rows of the map are counted from the top too.
+ * setTile() rewrites one quad and only that range of the chunk is uploaded.
+ *
+ * Baked chunks that scrolled away are released once more than getMaxBakedChunks() are kept.
+ */
+class FK_DLL TileMap : public Entity, public ITexture
+{
+    static const int DEFAULT_CHUNK_SIZE = 32;
+    static const int DEFAULT_MAX_BAKED_CHUNKS = 64;
+
+public:
+    /** gid of a tile that is not drawn */
+    static const int EMPTY_TILE = 0;
+
+    /** Creates an empty TileMap with a tileset texture.
+     *
+     * @param tileset A texture2d, its width and height are multiples of tileSize.
+     * @param tileSize Size of one tile in the tileset and on the map.
+     * @param columns Width of the map in tiles.
+     * @param rows Height of the map in tiles.
+     * @param chunkSize Width and height of a chunk in tiles.
+     * @return Return an autorelease object.
+     */
+    static TileMap* createWithTexture(Texture2D* tileset, const Size& tileSize, int columns, int rows,
+            int chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /** Creates an empty TileMap with a tileset image (.png, .jpeg, .pvr, etc).
+     * The file will be loaded using the ResourceManager.
+     *
+     * @return Return an autorelease object.
+     */
+    static TileMap* create(const std::string& tilesetImage, const Size& tileSize, int columns, int rows,
+            int chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /** Replaces every tile, gids holds columns * rows gids row by row. The chunks are baked again. */
+    void setTiles(const int* gids);
+
+    /** Changes one tile, a baked chunk uploads just this quad. */
+    void setTile(int column, int row, int gid);
+    int getTile(int column, int row) const;
+
+    inline int getColumns() const { return _columns; }
+    inline int getRows() const { return _rows; }
+    inline int getChunkSize() const { return _chunkSize; }
+    inline const Size& getTileSize() const { return _tileSize; }
+
+    /** Upper bound of chunks that keep their buffers, at least the visible ones are always kept. */
+    inline void setMaxBakedChunks(int count) { _maxBakedChunks = count; }
+    inline int getMaxBakedChunks() const { return _maxBakedChunks; }
+
+    /** chunks queued in the last draw */
+    inline int getDrawnChunks() const { return _drawnChunks; }
+
+    //
+    // Overrides
+    //
+    // ITexture
+    virtual Texture2D* getTexture() const override;
+    virtual void setTexture(Texture2D *texture) override;
+    virtual void setBlendFunc(const BlendFunc &blendFunc) override;
+    virtual const BlendFunc& getBlendFunc() const override;
+
+    // Entity
+    virtual void draw(void) override;
+    virtual String* toString() const override;
+
+protected:
+    struct Chunk
+    {
+        /** nullptr until baked */
+        TextureAtlas* atlas;
+        BatchCommand command;
+        /** tiles that are not empty, the chunk isn't drawn when it is 0 */
+        int tileCount;
+        /** value of _drawFrame when it was last queued */
+        int lastDrawn;
+    };
+
+    TileMap();
+    virtual ~TileMap();
+
+    bool initWithTexture(Texture2D *tileset, const Size& tileSize, int columns, int rows, int chunkSize);
+    bool initWithFile(const std::string& tilesetImage, const Size& tileSize, int columns, int rows, int chunkSize);
+
+    /** quad of the tile at column, row in entity space, an empty tile gives a quad with no area */
+    void makeQuad(int column, int row, int gid, V3F_C4F_T2F_Quad* quad) const;
+    /** fill the atlas of a chunk with all its tiles */
+    bool bakeChunk(int chunkColumn, int chunkRow);
+    void releaseChunk(Chunk& chunk);
+    void releaseAllChunks();
+    /** release the chunks drawn longest ago until at most _maxBakedChunks are left */
+    void evictChunks();
+    /** range of chunks [first, last] seen through the visible rect, false if none */
+    bool getVisibleChunks(int* firstColumn, int* firstRow, int* lastColumn, int* lastRow) const;
+    void updateBlendFunc();
+
+    Texture2D* _texture;
+    BlendFunc _blendFunc;
+    GLProgram* _glProgram;
+
+    Size _tileSize;
+    int _columns;
+    int _rows;
+    /** gids, row by row from the top */
+    std::vector<int> _tiles;
+
+    int _chunkSize;
+    int _chunkColumns;
+    int _chunkRows;
+    std::vector<Chunk> _chunks;
+    /** indices into _chunks of the chunks that have an atlas */
+    std::vector<int> _bakedChunks;
+    int _maxBakedChunks;
+
+    int _drawFrame;
+    int _drawnChunks;
+};
+
+// end of entity group
+/** @} */
+
+FLAKOR_NS_END
+
+#endif
@@ -28,6 +28,8 @@ base/element/Color.cpp \
 base/element/Element.cpp \
 base/element/Helper.cpp \
 base/element/Blendfunc.cpp \
+base/config/cpu-features.c \
+base/update/JobSystem.cpp \
 base/update/UpdateThread.cpp \
 math/Camera.cpp \
 math/CArray.cpp \
@@ -43,6 +45,7 @@ core/resource/ImageLoader.cpp \
 core/resource/ResourceManager.cpp \
 core/resource/Scheduler.cpp \
 core/input/Touch.cpp \
+core/input/TouchGrid.cpp \
 core/input/TouchPool.cpp \
 core/input/TouchTarget.cpp \
 core/input/TouchTrigger.cpp \
@@ -53,18 +56,41 @@ core/opengl/GPUInfo.cpp \
 core/opengl/gl3stub.c \
 core/opengl/GLContext.cpp \
 core/opengl/GLProgram.cpp \
+core/opengl/GLStateCache.cpp \
 core/opengl/vbo/VBO.cpp \
+core/opengl/vbo/StreamBuffer.cpp \
+core/opengl/vbo/VAO.cpp \
 core/opengl/shader/Shaders.cpp \
+core/opengl/shader/ShaderCache.cpp \
+core/opengl/shader/ProgramBinaryCache.cpp \
+core/opengl/renderer/BatchCommand.cpp \
+core/opengl/renderer/InstanceCommand.cpp \
+core/opengl/renderer/CacheCommand.cpp \
+core/opengl/renderer/QuadCommand.cpp \
+core/opengl/renderer/Renderer.cpp \
 core/opengl/texture/atitc.cpp \
 core/opengl/texture/etc1.cpp \
 core/opengl/texture/pvr.cpp \
 core/opengl/texture/s3tc.cpp \
 core/opengl/texture/TGAlib.cpp \
 core/opengl/texture/Texture2D.cpp \
+core/opengl/texture/TextureAtlas.cpp \
+core/opengl/texture/FontAtlas.cpp \
+core/opengl/texture/TextureManager.cpp \
+core/opengl/texture/TextureUploader.cpp \
+core/opengl/texture/DynamicAtlas.cpp \
+core/opengl/texture/TextureRegion.cpp \
 tool/utility/TexUtils.cpp \
 2d/Entity.cpp \
 2d/Scene.cpp \
 2d/Sprite.cpp \
+2d/SpriteBatch.cpp \
+2d/InstancedSprites.cpp \
+2d/TileMap.cpp \
+2d/ParticleSystem.cpp \
+2d/Label.cpp \
+2d/ModifierManager.cpp \
+2d/SceneTransition.cpp \
 
 LOCAL_EXPORT_LDLIBS := -lGLESv1_CM \
                        -lGLESv2 \
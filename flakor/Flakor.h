@@ -32,6 +32,12 @@
 #include "2d/Entity.h"
 #include "2d/Scene.h"
 #include "2d/Sprite.h"
+#include "2d/EntityPool.h"
+#include "2d/TileMap.h"
+#include "2d/ParticleSystem.h"
+#include "2d/Label.h"
+#include "2d/ModifierManager.h"
+#include "2d/SceneTransition.h"
 
 //core systems
 //resource
@@ -51,10 +57,16 @@
 #include "core/opengl/GL.h"
 #include "core/opengl/GPUInfo.h"
 #include "core/opengl/GLProgram.h"
+#include "core/opengl/GLStateCache.h"
 #include "core/opengl/shader/Shaders.h"
 #include "core/opengl/vbo/VBO.h"
+#include "core/opengl/vbo/VAO.h"
 //#include "core/opengl/texture/Image.h"
 #include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/TextureUploader.h"
+#include "core/opengl/texture/TextureRegion.h"
+#include "core/opengl/texture/DynamicAtlas.h"
 
 //audio
 #include "core/audio/SimpleAudioEngine.h"
@@ -0,0 +1,43 @@
+#ifndef _FK_IGLYPHRASTERIZER_H_
+#define _FK_IGLYPHRASTERIZER_H_
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Source of glyph bitmaps for FontAtlas: a TrueType rasterizer, a platform text API or a bitmap font.
+ * All metrics are in pixels, y goes up from the baseline.
+ */
+class IGlyphRasterizer
+{
+	public:
+		/** one glyph as an 8-bit coverage mask */
+		struct Bitmap
+		{
+			int width;
+			int height;
+			/** width * height bytes, first row at the top, owned by the rasterizer until the next rasterize() */
+			const unsigned char* pixels;
+			/** from the pen to the left edge of the bitmap */
+			float bearingX;
+			/** from the baseline to the top edge of the bitmap */
+			float bearingY;
+			/** pen move to the next glyph */
+			float advance;
+		};
+
+		virtual ~IGlyphRasterizer() {}
+
+		/** distance between two baselines */
+		virtual float getLineHeight() const = 0;
+		/** from the baseline to the top of the highest glyph */
+		virtual float getAscender() const = 0;
+		/** extra pen move between two glyphs */
+		virtual float getKerning(unsigned int left, unsigned int right) const { return 0.f; }
+
+		/** @return false if the font has no glyph for codepoint */
+		virtual bool rasterize(unsigned int codepoint, Bitmap* bitmap) = 0;
+};
+
+FLAKOR_NS_END
+
+#endif
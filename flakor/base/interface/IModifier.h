@@ -4,42 +4,46 @@
 FLAKOR_NS_BEGIN
 
 template<class T>
-class ModifierListener<T>
-{
+class IModifier;
 
-		// ===========================================================
-		// Methods
-		// ===========================================================
-public:
-		virtual ~ModifierListener() = 0 {};
+template<class T>
+class IModifierListener
+{
+	public:
+		virtual ~IModifierListener() {}
 
-		virtual void onModifierStarted(ModifierInterface<T> pModifier,  T pItem) = 0;
-		virtual void onModifierFinished(ModifierInterface<T> pModifier,  T pItem) = 0;
+		virtual void onModifierStarted(IModifier<T>* modifier, T item) = 0;
+		virtual void onModifierFinished(IModifier<T>* modifier, T item) = 0;
 };
 
 /**
  * Modifier interface that affects Entity's properties
+ *
+ * For custom modifiers, move/scale/rotate/fade tweens run pooled in ModifierManager
+ * without a virtual call per tween.
  */
+template<class T>
 class IModifier
 {
-public:
-	virtual ~IModifier() = 0 {};	
+	public:
+		virtual ~IModifier() {}
 
-	virtual void reset() = 0;
+		virtual void reset() = 0;
 
-	virtual bool isFinished()= 0;
-	virtual bool isAutoUnregisterWhenFinished()= 0;
-	virtual void setAutoUnregisterWhenFinished(boolean removeWhenFinished) = 0;
+		virtual bool isFinished() = 0;
+		virtual bool isAutoUnregisterWhenFinished() = 0;
+		virtual void setAutoUnregisterWhenFinished(bool removeWhenFinished) = 0;
 
-	virtual ModifierInterface<T> deepCopy() = 0;
+		virtual IModifier<T>* deepCopy() = 0;
 
-	virtual float getSecondsElapsed() = 0;
-	virtual float getDuration() = 0;
+		virtual float getSecondsElapsed() = 0;
+		virtual float getDuration() = 0;
 
-	virtual float onUpdate(const float secondsElapsed, const T item)= 0;
+		/** @return the seconds of secondsElapsed that were used */
+		virtual float onUpdate(float secondsElapsed, T item) = 0;
 
-	virtual void addModifierListener(ModifierListener<T> pModifierListener)= 0;
-	virtual bool removeModifierListener(ModifierListener<T> pModifierListener)= 0;
+		virtual void addModifierListener(IModifierListener<T>* listener) = 0;
+		virtual bool removeModifierListener(IModifierListener<T>* listener) = 0;
 };
 
 FLAKOR_NS_END
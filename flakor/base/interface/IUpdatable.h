@@ -10,6 +10,8 @@ typedef std::function<void(float)> UPDATE_FUNC;
 class IUpdatable
 {
 	public:
+		virtual ~IUpdatable() {}
+
 		virtual void onUpdate(float delta) = 0;
 		virtual void reset() = 0;
 };
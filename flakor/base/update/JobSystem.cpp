@@ -0,0 +1,238 @@
+#include "macros.h"
+#include "base/update/JobSystem.h"
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+
+FLAKOR_NS_BEGIN
+
+// keep a core for the GL thread when there are many
+static const int MAX_WORKERS = 7;
+
+JobSystem* JobSystem::s_sharedJobSystem = NULL;
+
+struct WorkerStart
+{
+    JobSystem* system;
+    int index;
+};
+
+JobSystem* JobSystem::getInstance()
+{
+    if (s_sharedJobSystem == NULL)
+    {
+        s_sharedJobSystem = new (std::nothrow) JobSystem();
+    }
+
+    return s_sharedJobSystem;
+}
+
+void JobSystem::destroyInstance()
+{
+    FK_SAFE_DELETE(s_sharedJobSystem);
+}
+
+JobSystem::JobSystem()
+:_workerCount(0)
+,_threads(NULL)
+,_queues(NULL)
+,_queuedJobs(0)
+,_shutdown(false)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    // the calling thread works too while it waits
+    _workerCount = (int)MIN(MAX(cores - 1, 0L), (long)MAX_WORKERS);
+
+    _queues = new WorkQueue[_workerCount + 1];
+    for (int i = 0; i <= _workerCount; i++)
+    {
+        pthread_mutex_init(&_queues[i].lock, NULL);
+    }
+
+    pthread_key_create(&_indexKey, NULL);
+    pthread_mutex_init(&_wakeLock, NULL);
+    pthread_cond_init(&_wakeCond, NULL);
+
+    _threads = new pthread_t[_workerCount];
+    int started = 0;
+    for (int i = 0; i < _workerCount; i++)
+    {
+        WorkerStart* start = new WorkerStart();
+        start->system = this;
+        start->index = i;
+        if (pthread_create(&_threads[started], NULL, JobSystem::workerMain, start) != 0)
+        {
+            FKLOG("JobSystem: failed to start worker %d", i);
+            delete start;
+            break;
+        }
+        started++;
+    }
+    _workerCount = started;
+    FKLOG("JobSystem: %d workers", _workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+    pthread_mutex_lock(&_wakeLock);
+    _shutdown = true;
+    pthread_cond_broadcast(&_wakeCond);
+    pthread_mutex_unlock(&_wakeLock);
+
+    for (int i = 0; i < _workerCount; i++)
+    {
+        pthread_join(_threads[i], NULL);
+    }
+    delete[] _threads;
+
+    for (int i = 0; i <= _workerCount; i++)
+    {
+        pthread_mutex_destroy(&_queues[i].lock);
+    }
+    delete[] _queues;
+
+    pthread_key_delete(_indexKey);
+    pthread_mutex_destroy(&_wakeLock);
+    pthread_cond_destroy(&_wakeCond);
+}
+
+void* JobSystem::workerMain(void* arg)
+{
+    WorkerStart* start = (WorkerStart*)arg;
+    JobSystem* system = start->system;
+    int index = start->index;
+    delete start;
+
+    pthread_setspecific(system->_indexKey, (void*)(intptr_t)(index + 1));
+    system->workerLoop(index);
+    return NULL;
+}
+
+void JobSystem::workerLoop(int index)
+{
+    Job job;
+    while (true)
+    {
+        if (findJob(index, job))
+        {
+            execute(job);
+            continue;
+        }
+
+        pthread_mutex_lock(&_wakeLock);
+        while (_queuedJobs.load() == 0 && !_shutdown)
+        {
+            pthread_cond_wait(&_wakeCond, &_wakeLock);
+        }
+        bool quit = _shutdown;
+        pthread_mutex_unlock(&_wakeLock);
+
+        if (quit)
+        {
+            return;
+        }
+    }
+}
+
+int JobSystem::queueIndex() const
+{
+    // no key for threads that aren't workers, they share the last queue
+    intptr_t key = (intptr_t)pthread_getspecific(_indexKey);
+    return key == 0 ? _workerCount : (int)key - 1;
+}
+
+bool JobSystem::findJob(int index, Job& job)
+{
+    // newest job of our own queue first
+    WorkQueue& own = _queues[index];
+    pthread_mutex_lock(&own.lock);
+    if (!own.jobs.empty())
+    {
+        job = own.jobs.back();
+        own.jobs.pop_back();
+        pthread_mutex_unlock(&own.lock);
+        tookJob();
+        return true;
+    }
+    pthread_mutex_unlock(&own.lock);
+
+    // then the oldest job of somebody else
+    for (int i = 1; i <= _workerCount; i++)
+    {
+        WorkQueue& victim = _queues[(index + i) % (_workerCount + 1)];
+        pthread_mutex_lock(&victim.lock);
+        if (!victim.jobs.empty())
+        {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            pthread_mutex_unlock(&victim.lock);
+            tookJob();
+            return true;
+        }
+        pthread_mutex_unlock(&victim.lock);
+    }
+    return false;
+}
+
+void JobSystem::tookJob()
+{
+    pthread_mutex_lock(&_wakeLock);
+    _queuedJobs--;
+    pthread_mutex_unlock(&_wakeLock);
+}
+
+void JobSystem::execute(const Job& job)
+{
+    job.func(job.data);
+    job.counter->pending--;
+}
+
+void JobSystem::run(JobFunc func, void* data, Counter* counter)
+{
+    FKAssert(func != NULL && counter != NULL, "JobSystem: func and counter must be non-nil");
+
+    Job job;
+    job.func = func;
+    job.data = data;
+    job.counter = counter;
+    counter->pending++;
+
+    if (_workerCount == 0)
+    {
+        execute(job);
+        return;
+    }
+
+    // counted before it is queued, taken after: a worker never sleeps while a job is queued,
+    // at worst it looks once more until the job shows up
+    pthread_mutex_lock(&_wakeLock);
+    _queuedJobs++;
+    pthread_cond_signal(&_wakeCond);
+    pthread_mutex_unlock(&_wakeLock);
+
+    WorkQueue& queue = _queues[queueIndex()];
+    pthread_mutex_lock(&queue.lock);
+    queue.jobs.push_back(job);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+void JobSystem::wait(Counter* counter)
+{
+    int index = queueIndex();
+    Job job;
+    while (counter->pending.load() > 0)
+    {
+        if (findJob(index, job))
+        {
+            execute(job);
+        }
+        else
+        {
+            // the last jobs are running on workers
+            sched_yield();
+        }
+    }
+}
+
+FLAKOR_NS_END
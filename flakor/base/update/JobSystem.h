@@ -0,0 +1,88 @@
+#ifndef _FK_JOB_SYSTEM_H_
+#define _FK_JOB_SYSTEM_H_
+
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Small work-stealing job system used by the update pass.
+ *
+ * One worker per extra core. Every worker owns a queue: it pushes and pops at the back
+ * (the job it just spawned is still in cache) and idle workers steal from the front of the others.
+ * Threads that aren't workers (update thread, GL thread) share one more queue.
+ * wait() doesn't block, the waiting thread runs queued jobs until its counter drops to zero,
+ * so nested jobs can't dead lock.
+ */
+class JobSystem
+{
+    public:
+        typedef void (*JobFunc)(void* data);
+
+        /** counts the unfinished jobs of a batch, wait() on it */
+        struct Counter
+        {
+            std::atomic<int> pending;
+            Counter() : pending(0) {}
+        };
+
+        /** starts the workers on first call */
+        static JobSystem* getInstance();
+        /** stops and joins the workers */
+        static void destroyInstance();
+
+        ~JobSystem();
+
+        /** queue func(data), the counter must outlive the job */
+        void run(JobFunc func, void* data, Counter* counter);
+        /** run queued jobs until every job of the counter is done */
+        void wait(Counter* counter);
+
+        inline int getWorkerCount() const { return _workerCount; }
+
+    protected:
+        struct Job
+        {
+            JobFunc func;
+            void* data;
+            Counter* counter;
+        };
+
+        struct WorkQueue
+        {
+            pthread_mutex_t lock;
+            std::deque<Job> jobs;
+        };
+
+        JobSystem();
+
+        static void* workerMain(void* arg);
+        void workerLoop(int index);
+
+        /** queue of the calling thread */
+        int queueIndex() const;
+        /** pop from own queue, or steal from another one */
+        bool findJob(int index, Job& job);
+        /** a job left the queues, counted under _wakeLock like run() counts it */
+        void tookJob();
+        void execute(const Job& job);
+
+        static JobSystem* s_sharedJobSystem;
+
+        int _workerCount;
+        pthread_t* _threads;
+        // _workerCount worker queues, then the queue of the other threads
+        WorkQueue* _queues;
+        pthread_key_t _indexKey;
+
+        std::atomic<int> _queuedJobs;
+        bool _shutdown;
+        pthread_mutex_t _wakeLock;
+        pthread_cond_t _wakeCond;
+};
+
+FLAKOR_NS_END
+
+#endif
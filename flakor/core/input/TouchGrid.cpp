@@ -0,0 +1,182 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include "macros.h"
+#include "core/input/TouchGrid.h"
+
+FLAKOR_NS_BEGIN
+
+static void eraseEntity(std::vector<Entity*>& list, Entity* entity)
+{
+    auto it = std::find(list.begin(), list.end(), entity);
+    if (it != list.end())
+    {
+        // order doesn't matter, swap with the last one
+        *it = list.back();
+        list.pop_back();
+    }
+}
+
+TouchGrid::TouchGrid(float cellSize)
+: _cellSize(cellSize)
+{
+    FKAssert(cellSize > 0, "TouchGrid: cell size must be > 0");
+}
+
+TouchGrid::~TouchGrid()
+{
+}
+
+int TouchGrid::cellOf(float v) const
+{
+    return (int)floorf(v / _cellSize);
+}
+
+void TouchGrid::link(Entity* entity, const Entry& entry)
+{
+    if (entry.oversized)
+    {
+        _oversized.push_back(entity);
+        return;
+    }
+
+    for (int x = entry.x0; x <= entry.x1; x++)
+    {
+        for (int y = entry.y0; y <= entry.y1; y++)
+        {
+            _cells[keyOf(x, y)].push_back(entity);
+        }
+    }
+}
+
+void TouchGrid::unlink(Entity* entity, const Entry& entry)
+{
+    if (entry.oversized)
+    {
+        eraseEntity(_oversized, entity);
+        return;
+    }
+
+    for (int x = entry.x0; x <= entry.x1; x++)
+    {
+        for (int y = entry.y0; y <= entry.y1; y++)
+        {
+            auto cell = _cells.find(keyOf(x, y));
+            if (cell != _cells.end())
+            {
+                eraseEntity(cell->second, entity);
+                if (cell->second.empty())
+                {
+                    _cells.erase(cell);
+                }
+            }
+        }
+    }
+}
+
+void TouchGrid::update(Entity* entity, const Rect& bounds)
+{
+    Entry entry;
+    entry.bounds = bounds;
+    entry.x0 = cellOf(bounds.getMinX());
+    entry.y0 = cellOf(bounds.getMinY());
+    entry.x1 = cellOf(bounds.getMaxX());
+    entry.y1 = cellOf(bounds.getMaxY());
+    entry.oversized = (int64_t)(entry.x1 - entry.x0 + 1) * (entry.y1 - entry.y0 + 1) > MAX_CELLS;
+
+    auto it = _entries.find(entity);
+    if (it != _entries.end())
+    {
+        Entry& old = it->second;
+        if (old.oversized == entry.oversized
+            && old.x0 == entry.x0 && old.y0 == entry.y0
+            && old.x1 == entry.x1 && old.y1 == entry.y1)
+        {
+            // still in the same cells
+            old.bounds = bounds;
+            return;
+        }
+
+        unlink(entity, old);
+        old = entry;
+    }
+    else
+    {
+        _entries.insert(std::make_pair(entity, entry));
+    }
+
+    link(entity, entry);
+}
+
+void TouchGrid::remove(Entity* entity)
+{
+    auto it = _entries.find(entity);
+    if (it == _entries.end())
+    {
+        return;
+    }
+
+    unlink(entity, it->second);
+    _entries.erase(it);
+}
+
+void TouchGrid::clear()
+{
+    _cells.clear();
+    _entries.clear();
+    _oversized.clear();
+}
+
+bool TouchGrid::contains(Entity* entity) const
+{
+    return _entries.find(entity) != _entries.end();
+}
+
+void TouchGrid::query(const Point& point, std::vector<Entity*>& out) const
+{
+    auto cell = _cells.find(keyOf(cellOf(point.x), cellOf(point.y)));
+    if (cell != _cells.end())
+    {
+        for (auto it = cell->second.begin(); it != cell->second.end(); ++it)
+        {
+            if (_entries.at(*it).bounds.containsPoint(point))
+            {
+                out.push_back(*it);
+            }
+        }
+    }
+
+    for (auto it = _oversized.begin(); it != _oversized.end(); ++it)
+    {
+        if (_entries.at(*it).bounds.containsPoint(point))
+        {
+            out.push_back(*it);
+        }
+    }
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,95 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint
+
+http://www.flakor.org
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+****************************************************************************/
+
+#ifndef _FK_TOUCHGRID_H_
+#define _FK_TOUCHGRID_H_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "base/element/Element.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup input
+ * @{
+ */
+class Entity;
+
+/**
+ * Uniform grid over the world bounds of touchable entities.
+ *
+ * Each entity is stored in every cell its bounds overlap, so a point query only
+ * looks at the entities of one cell. Moving an entity inside the same cells costs O(1),
+ * crossing cells costs O(cells covered). Entities covering more than MAX_CELLS cells
+ * (full screen panels, backgrounds) are kept in a separate list that every query checks.
+ */
+class TouchGrid
+{
+public:
+    static const int DEFAULT_CELL_SIZE = 128;
+    static const int MAX_CELLS = 64;
+
+    TouchGrid(float cellSize = DEFAULT_CELL_SIZE);
+    ~TouchGrid();
+
+    /** add the entity, or move it if it is already in the grid */
+    void update(Entity* entity, const Rect& bounds);
+    void remove(Entity* entity);
+    void clear();
+
+    bool contains(Entity* entity) const;
+    inline size_t count() const { return _entries.size(); }
+
+    /** append the entities whose bounds contain point to out, in no particular order */
+    void query(const Point& point, std::vector<Entity*>& out) const;
+
+protected:
+    struct Entry
+    {
+        Rect bounds;
+        int x0, y0, x1, y1;
+        bool oversized;
+    };
+
+    inline int cellOf(float v) const;
+    inline static int64_t keyOf(int x, int y) { return ((int64_t)x << 32) | (uint32_t)y; }
+
+    void link(Entity* entity, const Entry& entry);
+    void unlink(Entity* entity, const Entry& entry);
+
+    float _cellSize;
+    std::unordered_map<int64_t, std::vector<Entity*> > _cells;
+    std::unordered_map<Entity*, Entry> _entries;
+    std::vector<Entity*> _oversized;
+};
+
+// end of input group
+/// @}
+
+FLAKOR_NS_END
+
+#endif  // _FK_TOUCHGRID_H_
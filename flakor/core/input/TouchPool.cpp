@@ -23,6 +23,9 @@ THE SOFTWARE.
 ****************************************************************************/
 
 
+#include <algorithm>
+
+#include "macros.h"
 #include "core/input/TouchPool.h"
 #include "core/input/Touch.h"
 #include "core/input/TouchTarget.h"
@@ -30,16 +33,59 @@ THE SOFTWARE.
 
 FLAKOR_NS_BEGIN
 
+TouchPool* TouchPool::s_sharedTouchPool = NULL;
 unsigned int TouchPool::_indexBitsUsed = 0;
 
+static bool drawnLater(Entity* a, Entity* b)
+{
+    return a->getVisitOrder() > b->getVisitOrder();
+}
+
+// an entity is only drawn when all of its ancestors show it
+static bool isShown(Entity* entity)
+{
+    if (!entity->isVisible()) {
+        return false;
+    }
+    for (Entity* parent = entity->getParent(); parent != NULL; parent = parent->getParent())
+    {
+        if (!parent->isVisible() || !parent->isChildrenVisible()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TouchPool* TouchPool::getInstance()
+{
+    if (! s_sharedTouchPool)
+    {
+        s_sharedTouchPool = new (std::nothrow) TouchPool();
+    }
+
+    return s_sharedTouchPool;
+}
+
+void TouchPool::destroyInstance()
+{
+    FK_SAFE_DELETE(s_sharedTouchPool);
+}
+
 TouchPool::TouchPool()
-:_splitTouchTrigger(true)
-,_focused(NULL)
+:_focused(NULL)
 ,_firstTouchTarget(NULL)
+,_splitTouchTrigger(true)
 ,_dispatching(false)
 {
     _indexBitsUsed = 0;
     _entities = new std::set<Entity*>;
+    pthread_mutex_init(&_gridMutex, NULL);
+}
+
+TouchPool::~TouchPool()
+{
+    FK_SAFE_DELETE(_entities);
+    pthread_mutex_destroy(&_gridMutex);
 }
 
 int TouchPool::getUnUsedIndex()
@@ -92,6 +138,10 @@ bool TouchPool::registerEntity(Entity* entity)
     auto iterator = _entities->find(entity);
     if (iterator == _entities->end()) {
         auto result = _entities->insert(entity);
+
+        pthread_mutex_lock(&_gridMutex);
+        _grid.update(entity, entity->getWorldBounds());
+        pthread_mutex_unlock(&_gridMutex);
         return result.second;
     }
     
@@ -103,12 +153,55 @@ bool TouchPool::removeEntity(Entity* entity)
     auto iterator = _entities->find(entity);
     if (iterator != _entities->end()) {
         size_t result = _entities->erase(entity);
+
+        pthread_mutex_lock(&_gridMutex);
+        _grid.remove(entity);
+        pthread_mutex_unlock(&_gridMutex);
+
+        if (_focused == entity) {
+            _focused = NULL;
+        }
         return result == 1;
     }
     
     return false;
 }
 
+void TouchPool::updateEntity(Entity* entity)
+{
+    pthread_mutex_lock(&_gridMutex);
+    if (_grid.contains(entity)) {
+        _grid.update(entity, entity->getWorldBounds());
+    }
+    pthread_mutex_unlock(&_gridMutex);
+}
+
+void TouchPool::hitTest(const Point& point, std::vector<Entity*>& out)
+{
+    std::vector<Entity*> candidates;
+    pthread_mutex_lock(&_gridMutex);
+    _grid.query(point, candidates);
+    pthread_mutex_unlock(&_gridMutex);
+
+    size_t first = out.size();
+    for (auto it = candidates.begin(); it != candidates.end(); ++it)
+    {
+        Entity* entity = *it;
+        if (!entity->isTouchable() || !isShown(entity)) {
+            continue;
+        }
+
+        // the AABB is only a bound for rotated or skewed entities
+        Point local = entity->convertToEntitySpace(point);
+        const Size& size = entity->getContentSize();
+        if (local.x >= 0 && local.y >= 0 && local.x <= size.width && local.y <= size.height) {
+            out.push_back(entity);
+        }
+    }
+
+    std::sort(out.begin() + first, out.end(), drawnLater);
+}
+
 bool TouchPool::handleTouch(TouchTrigger::TouchAction action,int num,intptr_t ids[],float xs[],float ys[])
 {
     intptr_t id = 0;
@@ -221,8 +314,12 @@ bool TouchPool::dispatchTouch(TouchTrigger *trigger)
             // Throw away all previous state when starting a new touch gesture.
             // The framework may have dropped the up or cancel event for the previous gesture
             // due to an app switch, ANR, or some other state change.
-            _firstTouchTarget->cancelAndClear(trigger);
-            _firstTouchTarget->clear();
+            if (_firstTouchTarget != NULL)
+            {
+                _firstTouchTarget->cancelAndClear(trigger);
+                _firstTouchTarget->clear();
+            }
+            _focused = NULL;
             /*resetCancelNextUpFlag(this);
              mGroupFlags &= ~FLAG_DISALLOW_INTERCEPT;
              mNestedScrollAxes = SCROLL_AXIS_NONE;*/
@@ -244,13 +341,22 @@ bool TouchPool::dispatchTouch(TouchTrigger *trigger)
                 
                 // Clean up earlier touch targets for this pointer id in case they
                 // have become out of sync.
-                _firstTouchTarget->removePointers(idBitsToAssign);
-                
-                for( std::set<Entity*>::const_iterator i = _entities->begin(); i != _entities->end(); ++i)
+                if (_firstTouchTarget != NULL)
+                {
+                    _firstTouchTarget->removePointers(idBitsToAssign);
+                }
+
+                // only the entities under the finger, top-most first
+                std::vector<Entity*> hits;
+                hitTest(trigger->_touches[0]->getLocation(), hits);
+                for (auto i = hits.begin(); i != hits.end(); ++i)
                 {
                    handled = (*i)->dispatchTouchTrigger(trigger);
                    if(handled)
+                   {
+                       _focused = *i;
                        break;
+                   }
                 }
 
                 if(handled)
@@ -272,13 +378,11 @@ bool TouchPool::dispatchTouch(TouchTrigger *trigger)
      // Dispatch to touch targets.
      if (_firstTouchTarget == NULL)
      {
-            // No touch targets so treat this as an ordinary view.
-             for( std::set<Entity*>::const_iterator i = _entities->begin(); i != _entities->end(); ++i)
-             {
-                handled = (*i)->dispatchTouchTrigger(trigger);
-                if(handled)
-                    break;
-             }
+            // No touch targets, the rest of the gesture goes to the entity that took the down.
+            if (action != TouchTrigger::TouchAction::DOWN && _focused != NULL)
+            {
+                handled = _focused->dispatchTouchTrigger(trigger);
+            }
      }
      else
      {
@@ -323,8 +427,12 @@ bool TouchPool::dispatchTouch(TouchTrigger *trigger)
     if (canceled
         || action == TouchTrigger::TouchAction::UP)
     {
-            _firstTouchTarget->cancelAndClear(trigger);
-            _firstTouchTarget->clear();
+            if (_firstTouchTarget != NULL)
+            {
+                _firstTouchTarget->cancelAndClear(trigger);
+                _firstTouchTarget->clear();
+            }
+            _focused = NULL;
             /*resetCancelNextUpFlag(this);
              mGroupFlags &= ~FLAG_DISALLOW_INTERCEPT;
              mNestedScrollAxes = SCROLL_AXIS_NONE;*/
@@ -332,7 +440,10 @@ bool TouchPool::dispatchTouch(TouchTrigger *trigger)
     else if (split && action == TouchTrigger::TouchAction::UP)
     {
             int idBitsToRemove = trigger->_touches[0]->getID();
-            _firstTouchTarget->removePointers(idBitsToRemove);
+            if (_firstTouchTarget != NULL)
+            {
+                _firstTouchTarget->removePointers(idBitsToRemove);
+            }
     }
     
     return handled;
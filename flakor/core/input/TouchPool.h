@@ -26,9 +26,12 @@ THE SOFTWARE.
 #define _FK_TOUCHPOOL_H_
 
 #include "core/input/TouchTrigger.h"
+#include "core/input/TouchGrid.h"
 #include <stddef.h>
+#include <pthread.h>
 #include <map>
 #include <set>
+#include <vector>
 
 FLAKOR_NS_BEGIN
 
@@ -42,6 +45,7 @@ class Entity;
 class TouchPool
 {
 protected:
+    static TouchPool* s_sharedTouchPool;
     static unsigned int _indexBitsUsed;
     Touch* _touches[TouchTrigger::MAX_TOUCHES];
     // System touch pointer ID (It may not be ascending order number) <-> Ascending order number from 0
@@ -55,18 +59,37 @@ protected:
     
     //registered entity
     std::set<Entity*>* _entities;
+    //world bounds of the registered entities, for hit testing
+    TouchGrid _grid;
+    //the grid is updated while visiting, touches are posted to the GL thread and query it there
+    pthread_mutex_t _gridMutex;
 
 public:
+    /** returns the shared touch pool, Entity registers itself here when it becomes touchable */
+    static TouchPool* getInstance();
+    static void destroyInstance();
+
     TouchPool();
+    ~TouchPool();
 
     int getUnUsedIndex();
     std::vector<Touch*> getAllTouchesVector();
     void removeUsedIndexBit(int index);
     Touch* find(intptr_t pointId);
 
+    /** Entity registers itself while it is touchable and on the stage, between onEnter() and onExit() */
     bool registerEntity(Entity* entity);
     bool removeEntity(Entity* entity);
+    /** a registered entity moved or resized, refresh its grid cells */
+    void updateEntity(Entity* entity);
+
+    /**
+     * Appends the visible touchable entities under point (world coordinates) to out,
+     * top-most (drawn last) first. It reads world transforms, call it on the GL thread between frames.
+     */
+    void hitTest(const Point& point, std::vector<Entity*>& out);
     
+    /** dispatches on the calling thread, the platform Engine posts it to the GL thread */
     bool handleTouch(TouchTrigger::TouchAction action,int count,intptr_t ids[],float xs[],float ys[]);
     bool dispatchTouch(TouchTrigger *trigger);
 };
@@ -39,7 +39,7 @@ typedef char GLchar;
 #define GL_BGRA  0x80E1
 #endif
 
-//declare here while define in CCEGLView_android.cpp
+//declare here while define in core/opengl/vbo/VAO.cpp, loaded by VAO::isSupported()
 extern PFNGLGENVERTEXARRAYSOESPROC glGenVertexArraysOESEXT;
 extern PFNGLBINDVERTEXARRAYOESPROC glBindVertexArrayOESEXT;
 extern PFNGLDELETEVERTEXARRAYSOESPROC glDeleteVertexArraysOESEXT;
@@ -9,7 +9,6 @@ http://www.flakor.org
 #endif
 #include <assert.h>
 #include "macros.h"
-#include "math/uthash.h"
 #include "base/lang/Str.h"
 #include "math/GLMatrix.h"
 
@@ -18,18 +17,50 @@ http://www.flakor.org
 #endif
 
 #include "core/opengl/GLProgram.h"
+#include "core/opengl/GLStateCache.h"
+#include "core/opengl/shader/ProgramBinaryCache.h"
 
 FLAKOR_NS_BEGIN
 
-typedef struct _hashUniformEntry
-{
-    GLvoid*         value;       // value
-    unsigned int    location;    // Key
-    UT_hash_handle  hh;          // hash entry
-} tHashUniformEntry;
+// uniforms at higher locations are set without comparing
+static const GLint MAX_CACHED_UNIFORM_LOCATION = 1024;
+
+// bytes of one element of a uniform type, 0 for types that are never cached
+static unsigned int uniformTypeSize(GLenum type)
+{
+    switch (type)
+    {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_BOOL:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_CUBE:
+            return 4;
+        case GL_FLOAT_VEC2:
+        case GL_INT_VEC2:
+        case GL_BOOL_VEC2:
+            return 8;
+        case GL_FLOAT_VEC3:
+        case GL_INT_VEC3:
+        case GL_BOOL_VEC3:
+            return 12;
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:
+        case GL_BOOL_VEC4:
+        case GL_FLOAT_MAT2:
+            return 16;
+        case GL_FLOAT_MAT3:
+            return 36;
+        case GL_FLOAT_MAT4:
+            return 64;
+        default:
+            return 0;
+    }
+}
 
 const char* GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR = "ShaderPositionTextureColor";
 const char* GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP = "ShaderPositionTextureColor_noMVP";
+const char* GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED = "ShaderPositionTextureColorInstanced";
 const char* GLProgram::SHADER_NAME_POSITION_TEXTURE_ALPHA_TEST = "ShaderPositionTextureColorAlphaTest";
 const char* GLProgram::SHADER_NAME_POSITION_TEXTURE_ALPHA_TEST_NO_MV = "ShaderPositionTextureColorAlphaTest_NoMV";
 const char* GLProgram::SHADER_NAME_POSITION_COLOR = "ShaderPositionColor";
@@ -112,7 +143,12 @@ GLProgram::GLProgram()
 : _programID(0)
 , _vertShaderID(0)
 , _fragShaderID(0)
-, _hashForUniforms(nullptr)
+, _binaryKey()
+, _linkedFromBinary(false)
+, _uniformSlots()
+, _uniformValues()
+, _projectionVersion(0)
+, _hasBuiltinMV(false)
 , _flags()
 {
     memset(_builtInUniforms, 0, sizeof(_builtInUniforms));
@@ -136,17 +172,7 @@ GLProgram::~GLProgram()
 
     if (_programID) 
     {
-        glDeleteProgram(_programID);
-    }
-
-    tHashUniformEntry *current_element, *tmp;
-
-    // Purge uniform hash
-    HASH_ITER(hh, _hashForUniforms, current_element, tmp)
-    {
-        HASH_DEL(_hashForUniforms, current_element);
-        free(current_element->value);
-        free(current_element);
+        fkGLDeleteProgram(_programID);
     }
 }
 
@@ -169,6 +195,20 @@ bool GLProgram::initWithByteArrays(const GLchar* vShaderByteArray, const GLchar*
 
     _vertShaderID = _fragShaderID = 0;
 
+    // a binary of an earlier run skips compile and link
+    _binaryKey = ProgramBinaryCache::getKey(vShaderByteArray, fShaderByteArray);
+    _linkedFromBinary = ProgramBinaryCache::load(_programID, _binaryKey);
+    if (_linkedFromBinary)
+    {
+        return true;
+    }
+    if (!_binaryKey.empty())
+    {
+        // a rejected binary may leave the program in a state link can't recover from
+        fkGLDeleteProgram(_programID);
+        _programID = glCreateProgram();
+    }
+
     if (vShaderByteArray)
     {
         if (!compileShader(&_vertShaderID, GL_VERTEX_SHADER, vShaderByteArray))
@@ -198,7 +238,6 @@ bool GLProgram::initWithByteArrays(const GLchar* vShaderByteArray, const GLchar*
     {
         glAttachShader(_programID, _fragShaderID);
     }
-    _hashForUniforms = nullptr;
     
     CHECK_GL_ERROR_DEBUG();
 
@@ -235,9 +274,6 @@ bool GLProgram::initWithPrecompiledProgramByteArray(const GLchar* vShaderByteArr
 
     haveProgram = PrecompiledShaders::getInstance()->loadProgram(_program, vShaderByteArray, fShaderByteArray);
 
-    CHECK_GL_ERROR_DEBUG();
-    _hashForUniforms = nullptr;
-
     CHECK_GL_ERROR_DEBUG();  
 
     return haveProgram;
@@ -311,6 +347,10 @@ void GLProgram::parseVertexAttribs()
 void GLProgram::parseUniforms()
 {
     _userUniforms.clear();
+    _uniformSlots.clear();
+    _uniformValues.clear();
+    _projectionVersion = 0;
+    _hasBuiltinMV = false;
 
     // Query and store uniforms from the program.
     GLint activeUniforms;
@@ -331,28 +371,43 @@ void GLProgram::parseUniforms()
                 glGetActiveUniform(_programID, i, length, nullptr, &uniform.size, &uniform.type, uniformName);
                 uniformName[length] = '\0';
 
+                // remove possible array '[]' from uniform name
+                if(length > 3)
+                {
+                    char* c = strrchr(uniformName, '[');
+                    if(c)
+                    {
+                        *c = '\0';
+                    }
+                }
+                uniform.location = glGetUniformLocation(_programID, uniformName);
+                GLenum __gl_error_code = glGetError(); 
+                if (__gl_error_code != GL_NO_ERROR) 
+                { 
+                    FKLOG("error: 0x%x", (int)__gl_error_code);
+                } 
+                assert(__gl_error_code == GL_NO_ERROR);
+
+                // a slot for the whole array at the location of its first element, built-ins included
+                unsigned int bytes = uniformTypeSize(uniform.type) * uniform.size;
+                if(uniform.location >= 0 && uniform.location < MAX_CACHED_UNIFORM_LOCATION && bytes > 0)
+                {
+                    if((size_t)uniform.location >= _uniformSlots.size())
+                    {
+                        UniformSlot empty = { 0, 0, false };
+                        _uniformSlots.resize(uniform.location + 1, empty);
+                    }
+                    UniformSlot& slot = _uniformSlots[uniform.location];
+                    slot.offset = (unsigned int)_uniformValues.size();
+                    slot.bytes = bytes;
+                    slot.sent = false;
+                    _uniformValues.resize(_uniformValues.size() + bytes);
+                }
+
                 // Only add uniforms that are not built-in.
                 // The ones that start with 'FK_' are built-ins
                 if(strncmp("FK_", uniformName, 3) != 0) {
-
-                    // remove possible array '[]' from uniform name
-                    if(length > 3)
-                    {
-                        char* c = strrchr(uniformName, '[');
-                        if(c)
-                        {
-                            *c = '\0';
-                        }
-                    }
                     uniform.name = std::string(uniformName);
-                    uniform.location = glGetUniformLocation(_programID, uniformName);
-                    GLenum __gl_error_code = glGetError(); 
-                    if (__gl_error_code != GL_NO_ERROR) 
-                    { 
-                        FKLOG("error: 0x%x", (int)__gl_error_code);
-                    } 
-                    assert(__gl_error_code == GL_NO_ERROR);
-                    
                     _userUniforms[uniform.name] = uniform;
                 }
             }
@@ -517,10 +572,22 @@ bool GLProgram::link()
     }
 #endif
 
+    if (_linkedFromBinary)
+    {
+        // attribute locations were bound when the binary was linked
+        parseVertexAttribs();
+        parseUniforms();
+        return true;
+    }
+
     GLint status = GL_TRUE;
 
     bindPredefinedVertexAttribs();
 
+    if (!_binaryKey.empty())
+    {
+        ProgramBinaryCache::prepareLink(_programID);
+    }
     glLinkProgram(_programID);
 
     parseVertexAttribs();
@@ -538,13 +605,22 @@ bool GLProgram::link()
     
     _vertShaderID = _fragShaderID = 0;
     
+    if (!_binaryKey.empty())
+    {
+        glGetProgramiv(_programID, GL_LINK_STATUS, &status);
+        if (status == GL_TRUE)
+        {
+            ProgramBinaryCache::save(_programID, _binaryKey);
+        }
+    }
+
 #if DEBUG || (FK_TARGET_PLATFORM == FK_PLATFORM_WP8)
     glGetProgramiv(_programID, GL_LINK_STATUS, &status);
     
     if (status == GL_FALSE)
     {
         FKLOG("flakor: ERROR: Failed to link program: %i", _programID);
-        glDeleteProgram(_programID);
+        fkGLDeleteProgram(_programID);
         _programID = 0;
     }
 #endif
@@ -561,7 +637,7 @@ bool GLProgram::link()
 
 void GLProgram::use()
 {
-    glUseProgram(_programID);
+    fkGLUseProgram(_programID);
 }
 
 std::string GLProgram::logForOpenGLObject(GLuint object, GLInfoFunction infoFunc, GLLogFunction logFunc) const
@@ -606,36 +682,28 @@ bool GLProgram::updateUniformLocation(GLint location, const GLvoid* data, unsign
         return false;
     }
 
-    bool updated = true;
-    tHashUniformEntry *element = nullptr;
-    HASH_FIND_INT(_hashForUniforms, &location, element);
-
-    if (! element)
+    if ((size_t)location >= _uniformSlots.size())
     {
-        element = (tHashUniformEntry*)malloc( sizeof(*element) );
-
-        // key
-        element->location = location;
-
-        // value
-        element->value = malloc( bytes );
-        memcpy(element->value, data, bytes );
-
-        HASH_ADD_INT(_hashForUniforms, location, element);
+        // not an active uniform or not cached, always send
+        return true;
     }
-    else
+
+    UniformSlot& slot = _uniformSlots[location];
+    if (bytes > slot.bytes)
     {
-        if (memcmp(element->value, data, bytes) == 0)
-        {
-            updated = false;
-        }
-        else
-        {
-            memcpy(element->value, data, bytes);
-        }
+        // a write past the declared size, the shadow can't tell what GL holds afterwards
+        slot.sent = false;
+        return true;
     }
 
-    return updated;
+    GLubyte* value = &_uniformValues[slot.offset];
+    if (slot.sent && memcmp(value, data, bytes) == 0)
+    {
+        return false;
+    }
+    memcpy(value, data, bytes);
+    slot.sent = true;
+    return true;
 }
 
 GLint GLProgram::getUniformLocationForName(const char* name) const
@@ -842,21 +910,33 @@ void GLProgram::setUniformsForBuiltins()
 
 void GLProgram::setUniformsForBuiltins(const Matrix4 &matrixMV)
 {
-    Matrix4 matrixP;
- 	GLGet(GL_PROJECTION,&matrixP);
+    // the projection is only read back when the stack changed since the last call
+    unsigned int projectionVersion = GLGetVersion(GL_PROJECTION);
+    bool projectionChanged = projectionVersion != _projectionVersion;
+    if (projectionChanged)
+    {
+        GLGet(GL_PROJECTION, &_builtinP);
+        _projectionVersion = projectionVersion;
+    }
+    bool mvChanged = !_hasBuiltinMV || memcmp(_builtinMV.get(), matrixMV.get(), sizeof(GLfloat) * 16) != 0;
+    if (mvChanged)
+    {
+        _builtinMV = matrixMV;
+        _hasBuiltinMV = true;
+    }
 
-    if(_flags.usesP)
-        setUniformLocationWithMatrix4fv(_builtInUniforms[UNIFORM_P_MATRIX], matrixP.get(), 1);
+    if(_flags.usesP && projectionChanged)
+        setUniformLocationWithMatrix4fv(_builtInUniforms[UNIFORM_P_MATRIX], _builtinP.get(), 1);
 
-    if(_flags.usesMV)
-        setUniformLocationWithMatrix4fv(_builtInUniforms[UNIFORM_MV_MATRIX], matrixMV.get(), 1);
+    if(_flags.usesMV && mvChanged)
+        setUniformLocationWithMatrix4fv(_builtInUniforms[UNIFORM_MV_MATRIX], _builtinMV.get(), 1);
 
-    if(_flags.usesMVP) {
-        Matrix4 matrixMVP = matrixP * matrixMV;
+    if(_flags.usesMVP && (projectionChanged || mvChanged)) {
+        Matrix4 matrixMVP = _builtinP * _builtinMV;
         setUniformLocationWithMatrix4fv(_builtInUniforms[UNIFORM_MVP_MATRIX], matrixMVP.get(), 1);
     }
 
-    if (_flags.usesNormal)
+    if (_flags.usesNormal && mvChanged)
     {
         Matrix4 mvInverse = matrixMV;
         mvInverse[12] = mvInverse[13] = mvInverse[14] = 0.0f;
@@ -893,18 +973,13 @@ void GLProgram::reset()
     // it is already deallocated by android
     //GL::deleteProgram(_program);
     _programID = 0;
+    _binaryKey.clear();
+    _linkedFromBinary = false;
 
-    
-    tHashUniformEntry *current_element, *tmp;
-    
-    // Purge uniform hash
-    HASH_ITER(hh, _hashForUniforms, current_element, tmp) 
-    {
-        HASH_DEL(_hashForUniforms, current_element);
-        free(current_element->value);
-        free(current_element);
-    }
-    _hashForUniforms = nullptr;
+    _uniformSlots.clear();
+    _uniformValues.clear();
+    _projectionVersion = 0;
+    _hasBuiltinMV = false;
 }
 
 FLAKOR_NS_END
@@ -2,6 +2,7 @@
 #define _FK_GLPROGRAM_H_
 
 #include <unordered_map>
+#include <vector>
 #include "core/opengl/GL.h"
 #include "base/lang/Object.h"
 #include "math/Matrices.h"
@@ -29,8 +30,6 @@ struct Uniform
     std::string name;
 };
 
-struct _hashUniformEntry;
-
 class GLProgram : public Object
 {
 	public:
@@ -70,6 +69,7 @@ class GLProgram : public Object
     
     static const char* SHADER_NAME_POSITION_TEXTURE_COLOR;
     static const char* SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP;
+    static const char* SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED;
     static const char* SHADER_NAME_POSITION_TEXTURE_ALPHA_TEST;
     static const char* SHADER_NAME_POSITION_TEXTURE_ALPHA_TEST_NO_MV;
     static const char* SHADER_NAME_POSITION_COLOR;
@@ -126,8 +126,28 @@ class GLProgram : public Object
     	GLuint            _vertShaderID;
     	GLuint            _fragShaderID;
 		bool 			  _compiled;
+		// ProgramBinaryCache key of the sources, empty when binaries can't be cached
+		std::string       _binaryKey;
+		// linked by glProgramBinary, link() only has to parse it
+		bool              _linkedFromBinary;
 		GLint             _builtInUniforms[UNIFORM_MAX];
-		struct _hashUniformEntry* _hashForUniforms;
+
+		/** values last sent for a uniform location, a slice of _uniformValues */
+		struct UniformSlot
+		{
+			unsigned int offset;
+			unsigned int bytes;
+			bool         sent;
+		};
+		// indexed by location and sized by parseUniforms(), setting a uniform never allocates
+		std::vector<UniformSlot>   _uniformSlots;
+		std::vector<unsigned char> _uniformValues;
+
+		// GL_PROJECTION version and modelview the P, MV, MVP and normal uniforms were computed from
+		unsigned int      _projectionVersion;
+		bool              _hasBuiltinMV;
+		Matrix4           _builtinP;
+		Matrix4           _builtinMV;
 
 		struct flag_struct {
         unsigned int usesTime:1;
@@ -278,8 +298,13 @@ class GLProgram : public Object
     /** calls glUniformMatrix4fv only if the values are different than the previous call for this same shader program. */
     void setUniformLocationWithMatrix4fv(GLint location, const GLfloat* matrixArray, unsigned int numberOfMatrices);
     
-    /** will update the builtin uniforms if they are different than the previous call for this same shader program. */
+    /** will update the builtin uniforms if they are different than the previous call for this same shader program.
+     *  The matrices are only derived again when the GL_PROJECTION version or the modelview changed.
+     *  The modelview matrix is read from the GL matrix stack. Entities no longer push onto it while visiting,
+     *  so inside Entity::draw() use setUniformsForBuiltins(getWorldMatrix()) instead.
+     */
     void setUniformsForBuiltins();
+    /** same as setUniformsForBuiltins() but takes the modelview matrix directly, e.g. the entity's cached world matrix. */
     void setUniformsForBuiltins(const Matrix4 &modelView);
 
     // Attribute
@@ -0,0 +1,288 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include "macros.h"
+#include "core/opengl/GLStateCache.h"
+
+FLAKOR_NS_BEGIN
+
+// attributes 0 to 7 are tracked, see VERTEX_ATTRIB_FLAG_*, OpenGL ES 2 has at least 8
+static const int MAX_ATTRIBUTES = 8;
+// nothing is ever bound to it, the next call after an invalidate always goes to GL
+static const GLuint UNKNOWN = (GLuint)-1;
+
+static GLuint s_currentProgram = UNKNOWN;
+static GLuint s_activeTextureUnit = UNKNOWN;
+static GLuint s_boundTextures[FK_MAX_ACTIVE_TEXTURE] = { 0 };
+static GLuint s_arrayBuffer = UNKNOWN;
+static GLuint s_elementBuffer = UNKNOWN;
+// 0 disabled, 1 enabled, -1 unknown
+static int s_blendEnabled = -1;
+static GLenum s_blendSrc = UNKNOWN;
+static GLenum s_blendDst = UNKNOWN;
+static bool s_blendAlphaSeparate = false;
+static unsigned int s_attributeFlags = 0;
+static bool s_attributesKnown = false;
+static GLuint s_vertexArray = UNKNOWN;
+// element buffer and attributes of vertex array 0 while another vertex array is bound
+static GLuint s_defaultElementBuffer = UNKNOWN;
+static unsigned int s_defaultAttributeFlags = 0;
+static bool s_defaultAttributesKnown = false;
+static bool s_texturesKnown = false;
+
+static GLStateCounters s_counters = { 0, 0 };
+
+#if FK_ENABLE_GL_STATE_CACHE
+#define FK_STATE_CHANGED(changed) ((changed) ? (s_counters.issued++, true) : (s_counters.skipped++, false))
+#else
+#define FK_STATE_CHANGED(changed) (s_counters.issued++, true)
+#endif
+
+void fkGLInvalidateStateCache(void)
+{
+	s_currentProgram = UNKNOWN;
+	s_activeTextureUnit = UNKNOWN;
+	s_texturesKnown = false;
+	s_arrayBuffer = UNKNOWN;
+	s_elementBuffer = UNKNOWN;
+	s_blendEnabled = -1;
+	s_blendSrc = s_blendDst = UNKNOWN;
+	s_attributesKnown = false;
+	s_vertexArray = UNKNOWN;
+	s_defaultElementBuffer = UNKNOWN;
+	s_defaultAttributesKnown = false;
+}
+
+void fkGLUseProgram(GLuint program)
+{
+	if (FK_STATE_CHANGED(program != s_currentProgram))
+	{
+		s_currentProgram = program;
+		glUseProgram(program);
+	}
+}
+
+void fkGLDeleteProgram(GLuint program)
+{
+	if (program == s_currentProgram)
+	{
+		s_currentProgram = UNKNOWN;
+	}
+	glDeleteProgram(program);
+}
+
+void fkGLBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+	bool enable = !(sfactor == GL_ONE && dfactor == GL_ZERO);
+	if (FK_STATE_CHANGED(s_blendEnabled != (int)enable))
+	{
+		s_blendEnabled = enable;
+		if (enable)
+		{
+			glEnable(GL_BLEND);
+		}
+		else
+		{
+			glDisable(GL_BLEND);
+		}
+	}
+
+	// the factors of a disabled blend don't matter, keep the last ones
+	if (enable && FK_STATE_CHANGED(sfactor != s_blendSrc || dfactor != s_blendDst))
+	{
+		s_blendSrc = sfactor;
+		s_blendDst = dfactor;
+		if (s_blendAlphaSeparate)
+		{
+			glBlendFuncSeparate(sfactor, dfactor, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		else
+		{
+			glBlendFunc(sfactor, dfactor);
+		}
+	}
+}
+
+void fkGLBlendAlphaSeparate(bool separate)
+{
+	if (separate != s_blendAlphaSeparate)
+	{
+		s_blendAlphaSeparate = separate;
+		// the next fkGLBlendFunc() sets the factors again
+		s_blendSrc = s_blendDst = UNKNOWN;
+	}
+}
+
+void fkGLActiveTexture(GLuint unit)
+{
+	if (FK_STATE_CHANGED(unit != s_activeTextureUnit))
+	{
+		s_activeTextureUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+}
+
+void fkGLBindTexture2D(GLuint texture)
+{
+	fkGLBindTexture2DN(0, texture);
+}
+
+void fkGLBindTexture2DN(GLuint unit, GLuint texture)
+{
+	if (unit >= FK_MAX_ACTIVE_TEXTURE)
+	{
+		fkGLActiveTexture(unit);
+		s_counters.issued++;
+		glBindTexture(GL_TEXTURE_2D, texture);
+		return;
+	}
+
+	if (!s_texturesKnown)
+	{
+		for (int i = 0; i < FK_MAX_ACTIVE_TEXTURE; i++)
+		{
+			s_boundTextures[i] = UNKNOWN;
+		}
+		s_texturesKnown = true;
+	}
+
+	if (FK_STATE_CHANGED(s_boundTextures[unit] != texture))
+	{
+		s_boundTextures[unit] = texture;
+		fkGLActiveTexture(unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+}
+
+void fkGLDeleteTexture(GLuint texture)
+{
+	if (s_texturesKnown)
+	{
+		for (int i = 0; i < FK_MAX_ACTIVE_TEXTURE; i++)
+		{
+			if (s_boundTextures[i] == texture)
+			{
+				// GL binds 0 in its place
+				s_boundTextures[i] = 0;
+			}
+		}
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void fkGLBindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* bound = NULL;
+	if (target == GL_ARRAY_BUFFER)
+	{
+		bound = &s_arrayBuffer;
+	}
+	else if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		bound = &s_elementBuffer;
+	}
+
+	if (bound == NULL)
+	{
+		s_counters.issued++;
+		glBindBuffer(target, buffer);
+	}
+	else if (FK_STATE_CHANGED(*bound != buffer))
+	{
+		*bound = buffer;
+		glBindBuffer(target, buffer);
+	}
+}
+
+void fkGLDeleteBuffer(GLuint buffer)
+{
+	if (buffer == s_arrayBuffer)
+	{
+		s_arrayBuffer = 0;
+	}
+	if (buffer == s_elementBuffer)
+	{
+		s_elementBuffer = 0;
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void fkGLEnableVertexAttribs(unsigned int flags)
+{
+	for (int i = 0; i < MAX_ATTRIBUTES; i++)
+	{
+		unsigned int bit = 1u << i;
+		bool enable = (flags & bit) != 0;
+		bool enabled = (s_attributeFlags & bit) != 0;
+		if (FK_STATE_CHANGED(!s_attributesKnown || enable != enabled))
+		{
+			if (enable)
+			{
+				glEnableVertexAttribArray(i);
+			}
+			else
+			{
+				glDisableVertexAttribArray(i);
+			}
+		}
+	}
+	s_attributeFlags = flags;
+	s_attributesKnown = true;
+}
+
+// the tracked element buffer and attributes follow the bound vertex array
+static void switchVertexArrayState(GLuint vertexArray)
+{
+	if (s_vertexArray == 0)
+	{
+		s_defaultElementBuffer = s_elementBuffer;
+		s_defaultAttributeFlags = s_attributeFlags;
+		s_defaultAttributesKnown = s_attributesKnown;
+	}
+	if (vertexArray == 0)
+	{
+		s_elementBuffer = s_defaultElementBuffer;
+		s_attributeFlags = s_defaultAttributeFlags;
+		s_attributesKnown = s_defaultAttributesKnown;
+	}
+	else
+	{
+		s_elementBuffer = UNKNOWN;
+		s_attributesKnown = false;
+	}
+	s_vertexArray = vertexArray;
+}
+
+void fkGLBindVertexArray(GLuint vertexArray)
+{
+	if (FK_STATE_CHANGED(vertexArray != s_vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+		switchVertexArrayState(vertexArray);
+	}
+}
+
+void fkGLDeleteVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == s_vertexArray)
+	{
+		switchVertexArrayState(0);
+	}
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+void fkGLGetStateCounters(GLStateCounters* counters)
+{
+	*counters = s_counters;
+}
+
+void fkGLResetStateCounters(void)
+{
+	s_counters.issued = 0;
+	s_counters.skipped = 0;
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,99 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_GLSTATECACHE_H_
+#define _FK_GLSTATECACHE_H_
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * GL state cache = GL状态缓存，过滤掉不改变状态的GL调用
+ *
+ * Remembers the bound program, the 2D texture of every unit, the array and element buffers,
+ * the blend state and the enabled vertex attributes, and only calls GL when the state changes.
+ * Everything that binds or deletes one of these has to go through the fkGL functions,
+ * a raw GL call leaves the cache wrong. With FK_ENABLE_GL_STATE_CACHE set to 0 every call goes to GL.
+ *
+ * Use it on the GL thread only. After the GL context was lost call fkGLInvalidateStateCache().
+ */
+
+/** most texture units tracked, higher units go to GL uncached */
+#define FK_MAX_ACTIVE_TEXTURE 16
+
+/** bits for fkGLEnableVertexAttribs(), one per GLProgram::VERTEX_ATTRIB_* location */
+enum
+{
+	VERTEX_ATTRIB_FLAG_NONE       = 0,
+
+	VERTEX_ATTRIB_FLAG_POSITION   = 1 << 0,
+	VERTEX_ATTRIB_FLAG_COLOR      = 1 << 1,
+	VERTEX_ATTRIB_FLAG_TEX_COORD  = 1 << 2,
+	VERTEX_ATTRIB_FLAG_TEX_COORD1 = 1 << 3,
+	VERTEX_ATTRIB_FLAG_TEX_COORD2 = 1 << 4,
+	VERTEX_ATTRIB_FLAG_TEX_COORD3 = 1 << 5,
+	VERTEX_ATTRIB_FLAG_NORMAL     = 1 << 6,
+	VERTEX_ATTRIB_FLAG_BLEND_WEIGHT = 1 << 7,
+
+	VERTEX_ATTRIB_FLAG_POS_COLOR_TEX = (VERTEX_ATTRIB_FLAG_POSITION | VERTEX_ATTRIB_FLAG_COLOR | VERTEX_ATTRIB_FLAG_TEX_COORD),
+};
+
+/** calls that reached GL and calls the cache dropped, since the last fkGLResetStateCounters() */
+struct GLStateCounters
+{
+	unsigned int issued;
+	unsigned int skipped;
+};
+
+/** forget the cached state, the next call of every kind goes to GL */
+void fkGLInvalidateStateCache(void);
+
+/** glUseProgram() when program isn't in use yet */
+void fkGLUseProgram(GLuint program);
+/** glDeleteProgram(), clears the cached program when it was in use */
+void fkGLDeleteProgram(GLuint program);
+
+/** blending with sfactor and dfactor, (GL_ONE, GL_ZERO) disables GL_BLEND */
+void fkGLBlendFunc(GLenum sfactor, GLenum dfactor);
+/**
+ * while on, fkGLBlendFunc() blends alpha with (GL_ONE, GL_ONE_MINUS_SRC_ALPHA) whatever the factors of the color are.
+ * For render targets drawn premultiplied later, their alpha would be multiplied twice otherwise
+ */
+void fkGLBlendAlphaSeparate(bool separate);
+
+/** glActiveTexture(GL_TEXTURE0 + unit) */
+void fkGLActiveTexture(GLuint unit);
+/** binds texture to GL_TEXTURE_2D of unit 0 */
+void fkGLBindTexture2D(GLuint texture);
+/** binds texture to GL_TEXTURE_2D of unit, leaves unit active */
+void fkGLBindTexture2DN(GLuint unit, GLuint texture);
+/** glDeleteTextures(), clears the units it was bound to */
+void fkGLDeleteTexture(GLuint texture);
+
+/** glBindBuffer() for GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER */
+void fkGLBindBuffer(GLenum target, GLuint buffer);
+/** glDeleteBuffers(), clears the targets it was bound to */
+void fkGLDeleteBuffer(GLuint buffer);
+
+/** enables the attributes in flags and disables the other tracked ones (locations 0 to 7) */
+void fkGLEnableVertexAttribs(unsigned int flags);
+
+/**
+ * glBindVertexArray(), only when vertex array objects are supported (VAO::isSupported()).
+ * Element buffer and enabled attributes belong to the vertex array, the ones of vertex array 0 are
+ * remembered while another one is bound.
+ */
+void fkGLBindVertexArray(GLuint vertexArray);
+/** glDeleteVertexArrays(), falls back to vertex array 0 when it was bound */
+void fkGLDeleteVertexArray(GLuint vertexArray);
+
+void fkGLGetStateCounters(GLStateCounters* counters);
+void fkGLResetStateCounters(void);
+
+FLAKOR_NS_END
+
+#endif
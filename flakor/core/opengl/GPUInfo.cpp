@@ -21,6 +21,8 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ****************************************************************************/
+#include <stdio.h>
+
 #include "targetMacros.h"
 #include "core/opengl/GL.h"
 #include "core/opengl/GPUInfo.h"
@@ -36,6 +38,7 @@ GPUInfo::GPUInfo()
 , _maxModelviewStackDepth(0)
 , _supportsPVRTC(false)
 , _supportsETC1(false)
+, _supportsETC2(false)
 , _supportsS3TC(false)
 , _supportsATITC(false)
 , _supportsNPOT(false)
@@ -45,6 +48,9 @@ GPUInfo::GPUInfo()
 , _maxSamplesAllowed(0)
 , _maxTextureUnits(0)
 , _glExtensions(nullptr)
+, _glVendor()
+, _glRenderer()
+, _glVersion()
 , _maxDirLightInShader(1)
 , _maxPointLightInShader(1)
 , _maxSpotLightInShader(1)
@@ -103,6 +109,12 @@ void GPUInfo::gatherGPUInfo()
 	//_valueDict["gl.vendor"] = Value((const char*)glGetString(GL_VENDOR));
 	//_valueDict["gl.renderer"] = Value((const char*)glGetString(GL_RENDERER));
 	//_valueDict["gl.version"] = Value((const char*)glGetString(GL_VERSION));
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	_glVendor = vendor ? vendor : "";
+	_glRenderer = renderer ? renderer : "";
+	_glVersion = version ? version : "";
 
     _glExtensions = (char *)glGetString(GL_EXTENSIONS);
 
@@ -119,6 +131,10 @@ void GPUInfo::gatherGPUInfo()
     
     _supportsETC1 = checkForGLExtension("GL_OES_compressed_ETC1_RGB8_texture");
     //_valueDict["gl.supports_ETC1"] = Value(_supportsETC1);
+
+    // ETC2 is core in OpenGL ES 3, and ETC1 data is valid ETC2 data
+    int major = 0;
+    _supportsETC2 = sscanf(_glVersion.c_str(), "OpenGL ES %d", &major) == 1 && major >= 3;
     
     _supportsS3TC = checkForGLExtension("GL_EXT_texture_compression_s3tc");
     //_valueDict["gl.supports_S3TC"] = Value(_supportsS3TC);
@@ -199,12 +215,17 @@ bool GPUInfo::supportsETC() const
 {
     //GL_ETC1_RGB8_OES is not defined in old opengl version
 #ifdef GL_ETC1_RGB8_OES
-    return _supportsETC1;
+    return _supportsETC1 || _supportsETC2;
 #else
     return false;
 #endif
 }
 
+bool GPUInfo::supportsETC2() const
+{
+    return _supportsETC2;
+}
+
 bool GPUInfo::supportsS3TC() const
 {
     return _supportsS3TC;
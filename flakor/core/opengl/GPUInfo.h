@@ -57,8 +57,11 @@ public:
     /** Whether or not PVR Texture Compressed is supported */
 	bool supportsPVRTC() const;
     
-     /** Whether or not ETC Texture Compressed is supported */
+     /** Whether or not ETC Texture Compressed is supported, through the extension or ETC2 */
     bool supportsETC() const;
+
+    /** Whether or not ETC2 is supported (OpenGL ES 3), ETC1 textures are uploaded as ETC2 then */
+    bool supportsETC2() const;
     
     /** Whether or  not S3TC Texture Compressed is supported */
     bool supportsS3TC() const;
@@ -91,6 +94,11 @@ public:
      */
     int getMaxSupportSpotLightInShader() const;
 
+    /** GL_VENDOR, GL_RENDERER and GL_VERSION strings, empty before gatherGPUInfo() */
+    const std::string& getGLVendor() const { return _glVendor; }
+    const std::string& getGLRenderer() const { return _glRenderer; }
+    const std::string& getGLVersion() const { return _glVersion; }
+
     /** returns whether or not an OpenGL is supported */
     bool checkForGLExtension(const std::string &searchName) const;
 
@@ -121,6 +129,7 @@ protected:
     GLint           _maxModelviewStackDepth;
     bool            _supportsPVRTC;
     bool            _supportsETC1;
+    bool            _supportsETC2;
     bool            _supportsS3TC;
     bool            _supportsATITC;
     bool            _supportsNPOT;
@@ -130,6 +139,9 @@ protected:
     GLint           _maxSamplesAllowed;
     GLint           _maxTextureUnits;
     char *          _glExtensions;
+    std::string     _glVendor;
+    std::string     _glRenderer;
+    std::string     _glVersion;
     int             _maxDirLightInShader; //max support directional light in shader
     int             _maxPointLightInShader; // max support point light in shader
     int             _maxSpotLightInShader; // max support spot light in shader
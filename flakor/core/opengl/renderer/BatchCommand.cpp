@@ -0,0 +1,52 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include "macros.h"
+#include "core/opengl/renderer/BatchCommand.h"
+#include "core/opengl/texture/TextureAtlas.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/GLStateCache.h"
+
+FLAKOR_NS_BEGIN
+
+BatchCommand::BatchCommand()
+: RenderCommand(BATCH_COMMAND)
+, _program(nullptr)
+, _blendFunc(BlendFunc::DISABLE)
+, _textureAtlas(nullptr)
+, _mv(nullptr)
+{
+}
+
+BatchCommand::~BatchCommand()
+{
+}
+
+void BatchCommand::init(float globalZ, GLProgram* program, const BlendFunc& blendFunc,
+		TextureAtlas* atlas, const Matrix4& mv)
+{
+	FKAssert(program != nullptr, "BatchCommand: program must be non-nil");
+	FKAssert(atlas != nullptr, "BatchCommand: atlas must be non-nil");
+
+	_globalZ = globalZ;
+	_program = program;
+	_blendFunc = blendFunc;
+	_textureAtlas = atlas;
+	_mv = &mv;
+}
+
+void BatchCommand::execute()
+{
+	_program->use();
+	_program->setUniformsForBuiltins(*_mv);
+
+	// (GL_ONE, GL_ZERO) disables blending
+	fkGLBlendFunc(_blendFunc.src, _blendFunc.dst);
+
+	_textureAtlas->drawQuadsGL();
+}
+
+FLAKOR_NS_END
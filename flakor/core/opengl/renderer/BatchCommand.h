@@ -0,0 +1,68 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_BATCHCOMMAND_H_
+#define _FK_BATCHCOMMAND_H_
+
+#include "targetMacros.h"
+#include "core/opengl/renderer/RenderCommand.h"
+#include "base/element/Blendfunc.h"
+#include "math/Matrices.h"
+
+FLAKOR_NS_BEGIN
+
+class GLProgram;
+class TextureAtlas;
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/**
+ * BatchCommand draws all the quads of a TextureAtlas with one glDrawElements.
+ * Unlike QuadCommand the quads are not copied, the atlas keeps them in its own vertex buffer
+ * and only uploads the range that changed, so big static batches (tile layers) cost almost nothing.
+ *
+ * The atlas and the model view matrix must stay alive until Renderer::render() is done.
+ */
+class BatchCommand : public RenderCommand
+{
+	public:
+		BatchCommand();
+		virtual ~BatchCommand();
+
+		/**
+		 * @param globalZ   commands are sorted by it before drawing
+		 * @param program   shared program, see ShaderCache
+		 * @param blendFunc blend function
+		 * @param atlas     quads in batch space and the texture
+		 * @param mv        batch to world matrix
+		 */
+		void init(float globalZ, GLProgram* program, const BlendFunc& blendFunc,
+				TextureAtlas* atlas, const Matrix4& mv);
+
+		inline GLProgram* getGLProgram() const { return _program; }
+		inline const BlendFunc& getBlendFunc() const { return _blendFunc; }
+		inline TextureAtlas* getTextureAtlas() const { return _textureAtlas; }
+		inline const Matrix4& getModelView() const { return *_mv; }
+
+	GL_METHOD:
+		/** set program, matrices and blend func and draw the atlas */
+		void execute();
+
+	protected:
+		GLProgram* _program;
+		BlendFunc _blendFunc;
+		TextureAtlas* _textureAtlas;
+		const Matrix4* _mv;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
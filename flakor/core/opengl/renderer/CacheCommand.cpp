@@ -0,0 +1,208 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "macros.h"
+#include "core/opengl/renderer/CacheCommand.h"
+#include "core/opengl/renderer/Renderer.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/GPUInfo.h"
+#include "math/GLMatrix.h"
+
+FLAKOR_NS_BEGIN
+
+int CacheCommand::s_generation = 0;
+
+CacheCommand::CacheCommand()
+: RenderCommand(CACHE_COMMAND)
+, _commands()
+, _texture(nullptr)
+, _fbo(0)
+, _pixelsWidth(0)
+, _pixelsHeight(0)
+, _generation(-1)
+, _rendered(false)
+, _complete(false)
+, _projection()
+, _quadCommand()
+{
+	memset(&_quad, 0, sizeof(_quad));
+}
+
+CacheCommand::~CacheCommand()
+{
+	if (_fbo != 0 && _generation == s_generation)
+	{
+		glDeleteFramebuffers(1, &_fbo);
+	}
+	if (_texture != nullptr && _generation != s_generation)
+	{
+		// don't let the destructor delete a name of the new context
+		_texture->invalidateGL();
+	}
+	FK_SAFE_RELEASE(_texture);
+}
+
+void CacheCommand::invalidateSharedGL()
+{
+	s_generation++;
+}
+
+bool CacheCommand::isValid() const
+{
+	return _rendered && _generation == s_generation;
+}
+
+void CacheCommand::init(float globalZ, const Size& size, const Matrix4& worldMatrix)
+{
+	_globalZ = globalZ;
+	_commands.clear();
+	_rendered = false;
+
+	// one texel per screen pixel at the scale the owner has now
+	const float* m = worldMatrix.get();
+	float scaleX = sqrtf(m[0] * m[0] + m[1] * m[1]);
+	float scaleY = sqrtf(m[4] * m[4] + m[5] * m[5]);
+	int maxSize = GPUInfo::getInstance()->getMaxTextureSize();
+	int pixelsWidth = MIN(MAX((int)ceilf(size.width * scaleX), 1), maxSize);
+	int pixelsHeight = MIN(MAX((int)ceilf(size.height * scaleY), 1), maxSize);
+
+	if (pixelsWidth != _pixelsWidth || pixelsHeight != _pixelsHeight || _generation != s_generation)
+	{
+		_pixelsWidth = pixelsWidth;
+		_pixelsHeight = pixelsHeight;
+		setupGL();
+	}
+
+	// content rect onto the normalized device square, flat in z so that vertexZ can't clip anything
+	Matrix4 ortho;
+	ortho[0] = size.width > 0.f ? 2.f / size.width : 0.f;
+	ortho[5] = size.height > 0.f ? 2.f / size.height : 0.f;
+	ortho[10] = 0.f;
+	ortho[12] = -1.f;
+	ortho[13] = -1.f;
+	Matrix4 worldToEntity = worldMatrix;
+	worldToEntity.invert();
+	_projection = ortho * worldToEntity;
+
+	// the texture covers the content rect, texture and GL both start at the bottom left
+	Color4F white = { 1.f, 1.f, 1.f, 1.f };
+	_quad.bl.vertices.x = 0.f;
+	_quad.bl.vertices.y = 0.f;
+	_quad.br.vertices.x = size.width;
+	_quad.br.vertices.y = 0.f;
+	_quad.tl.vertices.x = 0.f;
+	_quad.tl.vertices.y = size.height;
+	_quad.tr.vertices.x = size.width;
+	_quad.tr.vertices.y = size.height;
+	_quad.bl.texCoords.u = 0.f;
+	_quad.bl.texCoords.v = 0.f;
+	_quad.br.texCoords.u = 1.f;
+	_quad.br.texCoords.v = 0.f;
+	_quad.tl.texCoords.u = 0.f;
+	_quad.tl.texCoords.v = 1.f;
+	_quad.tr.texCoords.u = 1.f;
+	_quad.tr.texCoords.v = 1.f;
+	_quad.bl.colors = _quad.br.colors = _quad.tl.colors = _quad.tr.colors = white;
+}
+
+bool CacheCommand::setupGL()
+{
+	if (_generation != s_generation)
+	{
+		// the names of the lost context are gone already
+		_fbo = 0;
+		if (_texture != nullptr)
+		{
+			_texture->invalidateGL();
+		}
+		_generation = s_generation;
+	}
+
+	if (_texture == nullptr)
+	{
+		_texture = new (std::nothrow) Texture2D();
+		if (_texture == nullptr)
+		{
+			return false;
+		}
+	}
+	_complete = false;
+	if (!_texture->initRenderTargetGL(_pixelsWidth, _pixelsHeight))
+	{
+		return false;
+	}
+
+	if (_fbo == 0)
+	{
+		glGenFramebuffers(1, &_fbo);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture->getTextureID(), 0);
+	_complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	// visiting, nothing but the screen is bound
+	glBindFramebuffer(GL_FRAMEBUFFER, Renderer::getInstance()->getScreenFramebufferGL());
+
+	if (!_complete)
+	{
+		FKLOG("CacheCommand: framebuffer %dx%d is incomplete", _pixelsWidth, _pixelsHeight);
+	}
+	return _complete;
+}
+
+void CacheCommand::drawTexture(float globalZ, const Matrix4& mv)
+{
+	if (!_complete)
+	{
+		return;
+	}
+
+	GLProgram* program = ShaderCache::getInstance()->getGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR);
+	_quadCommand.init(globalZ, _texture->getTextureID(), program, BlendFunc::ALPHA_PREMULTIPLIED, &_quad, 1, mv);
+	Renderer::getInstance()->addCommand(&_quadCommand);
+}
+
+bool CacheCommand::beginGL()
+{
+	if (!_complete || _generation != s_generation)
+	{
+		_commands.clear();
+		return false;
+	}
+
+	bindGL();
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	GLMode(GL_PROJECTION);
+	GLPush();
+	GLLoad(&_projection);
+	return true;
+}
+
+void CacheCommand::endGL()
+{
+	GLMode(GL_PROJECTION);
+	GLPop();
+	GLMode(GL_MODELVIEW);
+
+	_commands.clear();
+	_rendered = true;
+}
+
+void CacheCommand::bindGL()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glViewport(0, 0, _pixelsWidth, _pixelsHeight);
+	// the children blend their color as usual, the texture ends up premultiplied for drawTexture()
+	fkGLBlendAlphaSeparate(true);
+}
+
+FLAKOR_NS_END
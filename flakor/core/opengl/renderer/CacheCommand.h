@@ -0,0 +1,107 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_CACHECOMMAND_H_
+#define _FK_CACHECOMMAND_H_
+
+#include <vector>
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+#include "core/opengl/renderer/RenderCommand.h"
+#include "core/opengl/renderer/QuadCommand.h"
+#include "core/opengl/renderer/RenderTypes.h"
+#include "base/element/Element.h"
+#include "math/Matrices.h"
+
+FLAKOR_NS_BEGIN
+
+class Texture2D;
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/**
+ * CacheCommand renders a subtree into a texture once, then the texture is drawn as one quad.
+ *
+ * Between Renderer::beginCapture() and Renderer::endCapture() the commands of the subtree go
+ * into this command instead of the frame queue. When Renderer meets the command it draws them
+ * into the framebuffer of the texture, with a projection that maps the content rect of the owner
+ * onto the whole texture. The owner queues drawTexture() right after, every frame, captured or not.
+ *
+ * The texture is premultiplied, the cached subtree should use premultiplied blending too.
+ * After the GL context was lost isValid() is false until the next capture.
+ */
+class CacheCommand : public RenderCommand
+{
+	public:
+		CacheCommand();
+		virtual ~CacheCommand();
+
+		/** whether the texture holds the last capture, false before the first capture is rendered or after a context loss */
+		bool isValid() const;
+
+		/**
+		 * Prepare the texture for a new capture, call it right before Renderer::beginCapture().
+		 * Entities visit on the GL thread, the texture is created or resized here so that its quad can be queued at once.
+		 * @param globalZ     commands are sorted by it before drawing
+		 * @param size        content rect (0, 0, size) in entity space that is cached
+		 * @param worldMatrix entity to world matrix of the owner when it is captured
+		 */
+		void init(float globalZ, const Size& size, const Matrix4& worldMatrix);
+
+		/** queue the quad that draws the texture over the content rect */
+		void drawTexture(float globalZ, const Matrix4& mv);
+
+		/** commands captured since init(), Renderer draws them into the texture and clears them */
+		inline std::vector<RenderCommand*>& getCommands() { return _commands; }
+		inline Texture2D* getTexture() const { return _texture; }
+
+	GL_METHOD:
+		/**
+		 * bind the framebuffer and clear it, set viewport and projection for the captured commands.
+		 * Returns false and drops the commands when the framebuffer can't be drawn to.
+		 */
+		bool beginGL();
+		/** restore the projection, Renderer binds the target the cache is drawn to again */
+		void endGL();
+		/** bind the framebuffer with its viewport, alpha is blended for a premultiplied texture */
+		void bindGL();
+
+		/** forget the framebuffers of every command after the GL context was lost */
+		static void invalidateSharedGL();
+
+	protected:
+		/** (re)creates texture and framebuffer for the current size and GL context */
+		bool setupGL();
+
+		std::vector<RenderCommand*> _commands;
+
+		Texture2D* _texture;
+		GLuint _fbo;
+		int _pixelsWidth;
+		int _pixelsHeight;
+		int _generation;
+		bool _rendered;
+		bool _complete;
+
+		/** world space to the normalized device square of the texture */
+		Matrix4 _projection;
+
+		V3F_C4F_T2F_Quad _quad;
+		QuadCommand _quadCommand;
+
+		// bumped by invalidateSharedGL(), a command whose generation differs owns a dead framebuffer
+		static int s_generation;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
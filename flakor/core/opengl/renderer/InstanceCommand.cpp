@@ -0,0 +1,159 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <stddef.h>
+
+#include "macros.h"
+#include "core/opengl/renderer/InstanceCommand.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/GLStateCache.h"
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+#include "core/opengl/GLContext.h"
+// loaded by gl3stubInit(), gl3stub.h itself clashes with the OES macros of GL.h
+extern "C" {
+extern GL_APICALL void (* GL_APIENTRY glDrawArraysInstanced) (GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+extern GL_APICALL void (* GL_APIENTRY glVertexAttribDivisor) (GLuint index, GLuint divisor);
+}
+#elif FK_TARGET_PLATFORM == FK_PLATFORM_IOS
+#include "core/opengl/GPUInfo.h"
+#define glDrawArraysInstanced       glDrawArraysInstancedEXT
+#define glVertexAttribDivisor       glVertexAttribDivisorEXT
+#endif
+
+FLAKOR_NS_BEGIN
+
+GLuint InstanceCommand::s_quadVBO = 0;
+int InstanceCommand::s_generation = 0;
+
+bool InstanceCommand::isSupported()
+{
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+	return GLContext::GetInstance()->GetGLVersion() >= 3.0f;
+#elif FK_TARGET_PLATFORM == FK_PLATFORM_IOS
+	return GPUInfo::getInstance()->checkForGLExtension("GL_EXT_instanced_arrays");
+#else
+	return false;
+#endif
+}
+
+InstanceCommand::InstanceCommand()
+: RenderCommand(INSTANCE_COMMAND)
+, _textureID(0)
+, _program(nullptr)
+, _blendFunc(BlendFunc::DISABLE)
+, _instances(nullptr)
+, _count(0)
+, _mv(nullptr)
+, _instanceVBO(0)
+, _bufferCapacity(0)
+, _bufferGeneration(-1)
+, _dirty(true)
+{
+}
+
+InstanceCommand::~InstanceCommand()
+{
+	if (_instanceVBO != 0 && _bufferGeneration == s_generation)
+	{
+		fkGLDeleteBuffer(_instanceVBO);
+	}
+}
+
+void InstanceCommand::init(float globalZ, GLuint textureID, GLProgram* program, const BlendFunc& blendFunc,
+		const SpriteInstance* instances, int count, const Matrix4& mv)
+{
+	FKAssert(program != nullptr, "InstanceCommand: program must be non-nil");
+	FKAssert(instances != nullptr || count == 0, "InstanceCommand: instances must be non-nil");
+
+	_globalZ = globalZ;
+	_textureID = textureID;
+	_program = program;
+	_blendFunc = blendFunc;
+	_instances = instances;
+	_count = count;
+	_mv = &mv;
+}
+
+void InstanceCommand::invalidateSharedGL()
+{
+	s_quadVBO = 0;
+	s_generation++;
+}
+
+void InstanceCommand::execute()
+{
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID || FK_TARGET_PLATFORM == FK_PLATFORM_IOS
+	if (_count <= 0)
+	{
+		return;
+	}
+
+	if (s_quadVBO == 0)
+	{
+		static const GLfloat corners[] = { 0.f, 0.f,  1.f, 0.f,  0.f, 1.f,  1.f, 1.f };
+		glGenBuffers(1, &s_quadVBO);
+		fkGLBindBuffer(GL_ARRAY_BUFFER, s_quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	}
+
+	if (_instanceVBO == 0 || _bufferGeneration != s_generation)
+	{
+		glGenBuffers(1, &_instanceVBO);
+		_bufferCapacity = 0;
+		_bufferGeneration = s_generation;
+		_dirty = true;
+	}
+
+	fkGLBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+	if (_dirty)
+	{
+		if (_count > _bufferCapacity)
+		{
+			// grow with some room, crowds usually keep growing
+			_bufferCapacity = _count + _count / 4;
+			glBufferData(GL_ARRAY_BUFFER, _bufferCapacity * sizeof(SpriteInstance), nullptr, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, _count * sizeof(SpriteInstance), _instances);
+		_dirty = false;
+	}
+
+	_program->use();
+	_program->setUniformsForBuiltins(*_mv);
+
+	fkGLBindTexture2D(_textureID);
+
+	// (GL_ONE, GL_ZERO) disables blending
+	fkGLBlendFunc(_blendFunc.src, _blendFunc.dst);
+
+	// per instance: transform, translation, texture rect, color
+	fkGLEnableVertexAttribs(VERTEX_ATTRIB_FLAG_POSITION | VERTEX_ATTRIB_FLAG_COLOR |
+			VERTEX_ATTRIB_FLAG_TEX_COORD1 | VERTEX_ATTRIB_FLAG_TEX_COORD2 | VERTEX_ATTRIB_FLAG_TEX_COORD3);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD1, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (GLvoid*)offsetof(SpriteInstance, a));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD2, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (GLvoid*)offsetof(SpriteInstance, tx));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD3, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (GLvoid*)offsetof(SpriteInstance, uvOrigin));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteInstance), (GLvoid*)offsetof(SpriteInstance, color));
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_TEX_COORD1, 1);
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_TEX_COORD2, 1);
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_TEX_COORD3, 1);
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_COLOR, 1);
+
+	// per vertex: corner of the unit quad
+	fkGLBindBuffer(GL_ARRAY_BUFFER, s_quadVBO);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)_count);
+
+	// the other commands share the color attribute and don't expect a divisor
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_TEX_COORD1, 0);
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_TEX_COORD2, 0);
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_TEX_COORD3, 0);
+	glVertexAttribDivisor(GLProgram::VERTEX_ATTRIB_COLOR, 0);
+	// the extra attributes are disabled by the next fkGLEnableVertexAttribs()
+#endif
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,92 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_INSTANCECOMMAND_H_
+#define _FK_INSTANCECOMMAND_H_
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+#include "core/opengl/renderer/RenderCommand.h"
+#include "core/opengl/renderer/RenderTypes.h"
+#include "base/element/Blendfunc.h"
+#include "math/Matrices.h"
+
+FLAKOR_NS_BEGIN
+
+class GLProgram;
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/**
+ * InstanceCommand draws many sprites with one glDrawArraysInstanced:
+ * a static unit quad shared by every command, plus one SpriteInstance per sprite
+ * in the command's own vertex buffer. The CPU never expands instances into quads,
+ * and the instance buffer is only uploaded when the owner marked it dirty.
+ *
+ * It needs OpenGL ES 3 (or GL_EXT_instanced_arrays on iOS), check isSupported()
+ * and fall back to QuadCommand otherwise.
+ * The instances and the model view matrix must stay alive until Renderer::render() is done.
+ */
+class InstanceCommand : public RenderCommand
+{
+	public:
+		/** whether the GL context can draw instanced, GLContext must be initialized */
+		static bool isSupported();
+
+		InstanceCommand();
+		virtual ~InstanceCommand();
+
+		/**
+		 * @param globalZ   commands are sorted by it before drawing
+		 * @param textureID GL texture name, it must be loaded already
+		 * @param program   GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED or a compatible one
+		 * @param blendFunc blend function
+		 * @param instances per instance attributes
+		 * @param count     number of instances
+		 * @param mv        entity to world matrix
+		 */
+		void init(float globalZ, GLuint textureID, GLProgram* program, const BlendFunc& blendFunc,
+				const SpriteInstance* instances, int count, const Matrix4& mv);
+
+		/** the instances changed, upload them again in next execute() */
+		inline void setDirty() { _dirty = true; }
+
+		inline int getInstanceCount() const { return _count; }
+
+	GL_METHOD:
+		/** upload the instances if needed, set program, texture and blend func and draw */
+		void execute();
+
+		/** forget the GL buffers of every command after the GL context was lost */
+		static void invalidateSharedGL();
+
+	protected:
+		GLuint _textureID;
+		GLProgram* _program;
+		BlendFunc _blendFunc;
+		const SpriteInstance* _instances;
+		int _count;
+		const Matrix4* _mv;
+
+		GLuint _instanceVBO;
+		int _bufferCapacity;
+		int _bufferGeneration;
+		bool _dirty;
+
+		// corners of the unit quad in triangle strip order
+		static GLuint s_quadVBO;
+		// bumped by invalidateSharedGL(), a command whose generation differs owns a dead buffer
+		static int s_generation;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
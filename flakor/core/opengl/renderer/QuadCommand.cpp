@@ -0,0 +1,41 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include "macros.h"
+#include "core/opengl/renderer/QuadCommand.h"
+
+FLAKOR_NS_BEGIN
+
+QuadCommand::QuadCommand()
+: RenderCommand(QUAD_COMMAND)
+, _textureID(0)
+, _program(nullptr)
+, _blendFunc(BlendFunc::DISABLE)
+, _quads(nullptr)
+, _quadCount(0)
+, _mv(nullptr)
+{
+}
+
+QuadCommand::~QuadCommand()
+{
+}
+
+void QuadCommand::init(float globalZ, GLuint textureID, GLProgram* program, const BlendFunc& blendFunc,
+		const V3F_C4F_T2F_Quad* quads, int quadCount, const Matrix4& mv)
+{
+	FKAssert(program != nullptr, "QuadCommand: program must be non-nil");
+
+	_globalZ = globalZ;
+	_textureID = textureID;
+	_program = program;
+	_blendFunc = blendFunc;
+	_quads = quads;
+	_quadCount = quadCount;
+	_mv = &mv;
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,80 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_QUADCOMMAND_H_
+#define _FK_QUADCOMMAND_H_
+
+#include "core/opengl/GL.h"
+#include "core/opengl/renderer/RenderTypes.h"
+#include "core/opengl/renderer/RenderCommand.h"
+#include "base/element/Blendfunc.h"
+#include "math/Matrices.h"
+
+FLAKOR_NS_BEGIN
+
+class GLProgram;
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/**
+ * QuadCommand records the quads an entity wants to draw in this frame.
+ * It doesn't issue any GL call. Renderer merges consecutive commands with the same
+ * (program, texture, blend func) into one vertex buffer and one draw call.
+ *
+ * The command keeps pointers to the quads and the model view matrix,
+ * both must stay alive until Renderer::render() is done, usually they are members of the entity.
+ */
+class QuadCommand : public RenderCommand
+{
+	public:
+		QuadCommand();
+		virtual ~QuadCommand();
+
+		/**
+		 * @param globalZ   commands are sorted by it before drawing, commands with the same z keep visiting order
+		 * @param textureID GL texture name, it must be loaded already
+		 * @param program   shared program, see ShaderCache
+		 * @param blendFunc blend function
+		 * @param quads     quads in entity space
+		 * @param quadCount number of quads
+		 * @param mv        entity to world matrix
+		 */
+		void init(float globalZ, GLuint textureID, GLProgram* program, const BlendFunc& blendFunc,
+				const V3F_C4F_T2F_Quad* quads, int quadCount, const Matrix4& mv);
+
+		/** whether the two commands can be drawn in one draw call */
+		inline bool canBatchWith(const QuadCommand* other) const
+		{
+			return other != nullptr
+				&& _textureID == other->_textureID
+				&& _program == other->_program
+				&& _blendFunc == other->_blendFunc;
+		}
+
+		inline GLuint getTextureID() const { return _textureID; }
+		inline GLProgram* getGLProgram() const { return _program; }
+		inline const BlendFunc& getBlendFunc() const { return _blendFunc; }
+		inline const V3F_C4F_T2F_Quad* getQuads() const { return _quads; }
+		inline int getQuadCount() const { return _quadCount; }
+		inline const Matrix4& getModelView() const { return *_mv; }
+
+	protected:
+		GLuint _textureID;
+		GLProgram* _program;
+		BlendFunc _blendFunc;
+		const V3F_C4F_T2F_Quad* _quads;
+		int _quadCount;
+		const Matrix4* _mv;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
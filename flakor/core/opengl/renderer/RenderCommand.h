@@ -0,0 +1,53 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_RENDERCOMMAND_H_
+#define _FK_RENDERCOMMAND_H_
+
+#include "base/lang/Object.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/**
+ * Base of everything that can be queued into Renderer.
+ * Renderer sorts the queue by global z and switches on the type to draw each command.
+ */
+class RenderCommand
+{
+	public:
+		enum Type
+		{
+			/** quads copied into the Renderer's vertex buffer and merged with neighbours, see QuadCommand */
+			QUAD_COMMAND,
+			/** a TextureAtlas drawn from its own buffers with one draw call, see BatchCommand */
+			BATCH_COMMAND,
+			/** sprites drawn with glDrawArraysInstanced from per instance attributes, see InstanceCommand */
+			INSTANCE_COMMAND,
+			/** commands of a subtree drawn into a texture, see CacheCommand */
+			CACHE_COMMAND
+		};
+
+		inline Type getType() const { return _type; }
+		inline float getGlobalZ() const { return _globalZ; }
+
+	protected:
+		RenderCommand(Type type) : _type(type), _globalZ(0.f) {}
+		virtual ~RenderCommand() {}
+
+		Type _type;
+		float _globalZ;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
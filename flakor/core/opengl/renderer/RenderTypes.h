@@ -0,0 +1,96 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_RENDERTYPES_H_
+#define _FK_RENDERTYPES_H_
+
+#include "core/opengl/GL.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/** vertex position */
+struct Vertex3F
+{
+	GLfloat x;
+	GLfloat y;
+	GLfloat z;
+};
+
+/** vertex color, premultiplied or not depends on the texture */
+struct Color4F
+{
+	GLfloat r;
+	GLfloat g;
+	GLfloat b;
+	GLfloat a;
+};
+
+/** packed vertex color, normalized to [0, 1] by GL */
+struct Color4B
+{
+	GLubyte r;
+	GLubyte g;
+	GLubyte b;
+	GLubyte a;
+};
+
+/** texture coordinates */
+struct Tex2F
+{
+	GLfloat u;
+	GLfloat v;
+};
+
+/**
+ * Interleaved vertex used by sprites: position 3 + color 4 + texCoords 2 floats,
+ * the same layout as Sprite::VERTEX_SIZE.
+ */
+struct V3F_C4F_T2F
+{
+	Vertex3F vertices;
+	Color4F  colors;
+	Tex2F    texCoords;
+};
+
+/**
+ * 4 vertices of a quad in triangle strip order
+ *   tl___tr
+ *   |     |
+ *   bl___br
+ */
+struct V3F_C4F_T2F_Quad
+{
+	V3F_C4F_T2F bl;
+	V3F_C4F_T2F br;
+	V3F_C4F_T2F tl;
+	V3F_C4F_T2F tr;
+};
+
+/**
+ * Per instance attributes of an instanced sprite, 44 bytes instead of the 144 of a quad.
+ * A corner (x, y) of the unit quad lands at (a*x + c*y + tx, b*x + d*y + ty),
+ * so the 2x2 part carries rotation, scale and the size of the sprite.
+ * Its texture coordinate is uvOrigin + (x, y) * uvSize, uvOrigin is the coordinate of the bottom left corner.
+ */
+struct SpriteInstance
+{
+	GLfloat a, b, c, d;
+	GLfloat tx, ty;
+	Tex2F   uvOrigin;
+	Tex2F   uvSize;
+	Color4B color;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
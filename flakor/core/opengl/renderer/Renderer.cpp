@@ -0,0 +1,390 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <algorithm>
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "targetMacros.h"
+#include "core/opengl/renderer/Renderer.h"
+#include "core/opengl/renderer/QuadCommand.h"
+#include "core/opengl/renderer/BatchCommand.h"
+#include "core/opengl/renderer/InstanceCommand.h"
+#include "core/opengl/renderer/CacheCommand.h"
+#include "core/opengl/texture/TextureAtlas.h"
+#include "core/opengl/texture/DynamicAtlas.h"
+#include "core/opengl/texture/FontAtlas.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/TextureUploader.h"
+#include "core/opengl/vbo/StreamBuffer.h"
+#include "core/opengl/vbo/VAO.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/GLStateCache.h"
+
+FLAKOR_NS_BEGIN
+
+static bool compareRenderCommand(const RenderCommand* a, const RenderCommand* b)
+{
+	return a->getGlobalZ() < b->getGlobalZ();
+}
+
+Renderer* Renderer::s_sharedRenderer = nullptr;
+
+Renderer* Renderer::getInstance()
+{
+	if (! s_sharedRenderer)
+	{
+		s_sharedRenderer = new (std::nothrow) Renderer();
+	}
+
+	return s_sharedRenderer;
+}
+
+void Renderer::destroyInstance()
+{
+	FK_SAFE_RELEASE_NULL(s_sharedRenderer);
+}
+
+Renderer::Renderer()
+: _queue()
+, _screenFramebuffer(-1)
+, _verts(nullptr)
+, _indices(nullptr)
+, _vertexStream(nullptr)
+, _indicesVBO(0)
+, _buffersCreated(false)
+, _quadVAO(nullptr)
+, _batchCommand(nullptr)
+, _filledQuads(0)
+, _drawnBatches(0)
+, _drawnQuads(0)
+, _visibleRect(RectZero)
+{
+	_viewport[0] = _viewport[1] = _viewport[2] = _viewport[3] = 0;
+	_queue.reserve(256);
+	_vertexStream = new StreamBuffer(STREAM_BATCHES * VBO_SIZE * sizeof(V3F_C4F_T2F));
+
+	_verts = (V3F_C4F_T2F *)malloc(VBO_SIZE * sizeof(V3F_C4F_T2F));
+	_indices = (GLushort *)malloc(STREAM_QUADS * 6 * sizeof(GLushort));
+
+	// the index pattern never changes, upload it once
+	for (int i = 0; i < STREAM_QUADS; i++)
+	{
+		_indices[i*6+0] = (GLushort)(i*4+0);
+		_indices[i*6+1] = (GLushort)(i*4+1);
+		_indices[i*6+2] = (GLushort)(i*4+2);
+		_indices[i*6+3] = (GLushort)(i*4+3);
+		_indices[i*6+4] = (GLushort)(i*4+2);
+		_indices[i*6+5] = (GLushort)(i*4+1);
+	}
+
+	_quadVAO = VAO::createPosColorTex();
+	FK_SAFE_RETAIN(_quadVAO);
+}
+
+Renderer::~Renderer()
+{
+	if (_buffersCreated)
+	{
+		fkGLDeleteBuffer(_indicesVBO);
+	}
+	FK_SAFE_RELEASE(_quadVAO);
+	FK_SAFE_DELETE(_vertexStream);
+	free(_verts);
+	free(_indices);
+}
+
+void Renderer::addCommand(RenderCommand* command)
+{
+	FKAssert(command != nullptr, "Renderer: command must be non-nil");
+	if (!_captures.empty())
+	{
+		_captures.back()->getCommands().push_back(command);
+		return;
+	}
+	_queue.push_back(command);
+}
+
+void Renderer::beginCapture(CacheCommand* cache)
+{
+	FKAssert(cache != nullptr, "Renderer: cache must be non-nil");
+	_captures.push_back(cache);
+}
+
+void Renderer::endCapture()
+{
+	FKAssert(!_captures.empty(), "Renderer: endCapture without beginCapture");
+	_captures.pop_back();
+}
+
+void Renderer::clean()
+{
+	_queue.clear();
+	_captures.clear();
+	_batchCommand = nullptr;
+	_filledQuads = 0;
+}
+
+void Renderer::invalidateGL()
+{
+	_indicesVBO = 0;
+	_buffersCreated = false;
+	_screenFramebuffer = -1;
+	_vertexStream->invalidateGL();
+	// the new context starts with GL defaults
+	fkGLInvalidateStateCache();
+
+	VAO::invalidateSharedGL();
+	TextureAtlas::invalidateSharedGL();
+	InstanceCommand::invalidateSharedGL();
+	CacheCommand::invalidateSharedGL();
+	TextureUploader::getInstance()->invalidateGL();
+	DynamicAtlas::getInstance()->invalidateGL();
+	FontAtlas::invalidateGL();
+	TextureManager::getInstance()->invalidateGL();
+}
+
+GLStateCounters Renderer::getStateCounters() const
+{
+	GLStateCounters counters;
+	fkGLGetStateCounters(&counters);
+	return counters;
+}
+
+void Renderer::setProjection(const Matrix4& projection)
+{
+	// unproject the corners of the normalized device square
+	Matrix4 inverse = projection;
+	inverse.invert();
+
+	Vector4 lb = inverse * Vector4(-1.f, -1.f, 0.f, 1.f);
+	Vector4 rt = inverse * Vector4(1.f, 1.f, 0.f, 1.f);
+	if (lb.w != 0.f && rt.w != 0.f)
+	{
+		lb /= lb.w;
+		rt /= rt.w;
+	}
+
+	float x = std::min(lb.x, rt.x);
+	float y = std::min(lb.y, rt.y);
+	_visibleRect = RectMake(x, y, fabsf(rt.x - lb.x), fabsf(rt.y - lb.y));
+}
+
+bool Renderer::checkVisibility(const Rect& worldBounds) const
+{
+	if (_visibleRect.size.width <= 0.f || _visibleRect.size.height <= 0.f)
+	{
+		return true;
+	}
+
+	return _visibleRect.intersectsRect(worldBounds);
+}
+
+void Renderer::setViewport(int x, int y, int width, int height)
+{
+	_viewport[0] = x;
+	_viewport[1] = y;
+	_viewport[2] = width;
+	_viewport[3] = height;
+}
+
+GLuint Renderer::getScreenFramebufferGL()
+{
+	if (_screenFramebuffer < 0)
+	{
+		// 0 on Android, a framebuffer of the view on iOS
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &_screenFramebuffer);
+	}
+	return (GLuint)_screenFramebuffer;
+}
+
+void Renderer::bindTargetGL()
+{
+	if (!_targets.empty())
+	{
+		_targets.back()->bindGL();
+		return;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, getScreenFramebufferGL());
+	glViewport(_viewport[0], _viewport[1], _viewport[2], _viewport[3]);
+	fkGLBlendAlphaSeparate(false);
+}
+
+void Renderer::setupBuffersGL()
+{
+	glGenBuffers(1, &_indicesVBO);
+
+	fkGLBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indicesVBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, STREAM_QUADS * 6 * sizeof(GLushort), _indices, GL_STATIC_DRAW);
+
+	_buffersCreated = true;
+}
+
+void Renderer::render()
+{
+	_drawnBatches = _drawnQuads = 0;
+	fkGLResetStateCounters();
+
+	// queued textures go up within the upload budget, before the commands that may draw them
+	TextureUploader::getInstance()->updateGL();
+	DynamicAtlas::getInstance()->updateGL();
+	// the commands were visited, what they don't draw may be evicted
+	TextureManager::getInstance()->enforceBudgetGL();
+
+	if (_queue.empty())
+	{
+		return;
+	}
+
+	if (!_buffersCreated)
+	{
+		setupBuffersGL();
+	}
+
+	renderQueue(_queue);
+}
+
+void Renderer::renderQueue(std::vector<RenderCommand*>& queue)
+{
+	// stable: commands with the same z keep the order they were visited
+	std::stable_sort(queue.begin(), queue.end(), compareRenderCommand);
+
+	for (auto it = queue.begin(); it != queue.end(); ++it)
+	{
+		if ((*it)->getType() == RenderCommand::BATCH_COMMAND)
+		{
+			// keep the order: quads queued before the atlas are drawn first
+			flushGL();
+
+			BatchCommand* batch = static_cast<BatchCommand*>(*it);
+			batch->execute();
+			_drawnBatches++;
+			_drawnQuads += batch->getTextureAtlas()->getTotalQuads();
+			continue;
+		}
+
+		if ((*it)->getType() == RenderCommand::INSTANCE_COMMAND)
+		{
+			flushGL();
+
+			InstanceCommand* instances = static_cast<InstanceCommand*>(*it);
+			instances->execute();
+			_drawnBatches++;
+			_drawnQuads += instances->getInstanceCount();
+			continue;
+		}
+
+		if ((*it)->getType() == RenderCommand::CACHE_COMMAND)
+		{
+			flushGL();
+
+			// the captured commands into the texture, its quad follows in this queue
+			CacheCommand* cache = static_cast<CacheCommand*>(*it);
+			if (cache->beginGL())
+			{
+				_targets.push_back(cache);
+				renderQueue(cache->getCommands());
+				_targets.pop_back();
+				cache->endGL();
+				bindTargetGL();
+			}
+			continue;
+		}
+
+		QuadCommand* command = static_cast<QuadCommand*>(*it);
+		int start = 0;
+		int remaining = command->getQuadCount();
+
+		// a command bigger than the room left is split across batches
+		while (remaining > 0)
+		{
+			if (!command->canBatchWith(_batchCommand) || _filledQuads == MAX_QUADS)
+			{
+				flushGL();
+				_batchCommand = command;
+			}
+
+			int count = std::min(remaining, MAX_QUADS - _filledQuads);
+			fillQuads(command, start, count);
+			start += count;
+			remaining -= count;
+		}
+	}
+	flushGL();
+
+	queue.clear();
+}
+
+void Renderer::fillQuads(const QuadCommand* command, int start, int count)
+{
+	const float* m = command->getModelView().get();
+	const V3F_C4F_T2F* src = (const V3F_C4F_T2F *)(command->getQuads() + start);
+
+	V3F_C4F_T2F* dst = _verts + _filledQuads * 4;
+	for (int i = 0; i < count * 4; i++)
+	{
+		const Vertex3F& v = src[i].vertices;
+		dst[i].vertices.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12];
+		dst[i].vertices.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13];
+		dst[i].vertices.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14];
+		dst[i].colors = src[i].colors;
+		dst[i].texCoords = src[i].texCoords;
+	}
+	_filledQuads += count;
+}
+
+void Renderer::flushGL()
+{
+	if (_filledQuads == 0 || _batchCommand == nullptr)
+	{
+		return;
+	}
+
+	GLProgram* program = _batchCommand->getGLProgram();
+	program->use();
+	// vertices are already in world space
+	program->setUniformsForBuiltins(Matrix4());
+
+	fkGLBindTexture2D(_batchCommand->getTextureID());
+
+	const BlendFunc& blend = _batchCommand->getBlendFunc();
+	// (GL_ONE, GL_ZERO) disables blending
+	fkGLBlendFunc(blend.src, blend.dst);
+
+	GLintptr base = _vertexStream->append(_verts, _filledQuads * 4 * sizeof(V3F_C4F_T2F));
+
+	if (VAO::isSupported())
+	{
+		// batches are whole quads, so the ring offset is a whole quad too: the layout stays at 0
+		// and the indices of the quads the batch was written to are drawn
+		FKAssert(base % (4 * sizeof(V3F_C4F_T2F)) == 0, "Renderer: batch isn't quad aligned in the ring");
+		GLintptr firstIndex = base / (4 * sizeof(V3F_C4F_T2F)) * 6;
+		_quadVAO->bind(_vertexStream->getBufferID(), _indicesVBO);
+		glDrawElements(GL_TRIANGLES, (GLsizei)_filledQuads * 6, GL_UNSIGNED_SHORT, (GLvoid*)(firstIndex * sizeof(GLushort)));
+		VAO::unbind();
+	}
+	else
+	{
+		// the batch starts at the ring offset, indices stay relative to it
+		fkGLEnableVertexAttribs(VERTEX_ATTRIB_FLAG_POS_COLOR_TEX);
+		glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(V3F_C4F_T2F), (GLvoid*)(base + offsetof(V3F_C4F_T2F, vertices)));
+		glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(V3F_C4F_T2F), (GLvoid*)(base + offsetof(V3F_C4F_T2F, colors)));
+		glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(V3F_C4F_T2F), (GLvoid*)(base + offsetof(V3F_C4F_T2F, texCoords)));
+
+		fkGLBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indicesVBO);
+		glDrawElements(GL_TRIANGLES, (GLsizei)_filledQuads * 6, GL_UNSIGNED_SHORT, 0);
+	}
+
+	_drawnBatches++;
+	_drawnQuads += _filledQuads;
+
+	_filledQuads = 0;
+	_batchCommand = nullptr;
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,162 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_RENDERER_H_
+#define _FK_RENDERER_H_
+
+#include <vector>
+
+#include "base/lang/Object.h"
+#include "base/element/Element.h"
+#include "core/opengl/GL.h"
+#include "core/opengl/GLStateCache.h"
+#include "core/opengl/renderer/RenderTypes.h"
+#include "math/Matrices.h"
+
+FLAKOR_NS_BEGIN
+
+class RenderCommand;
+class QuadCommand;
+class CacheCommand;
+class StreamBuffer;
+class VAO;
+
+/**
+ * @addtogroup renderer
+ * @{
+ */
+
+/**
+ * Renderer collects the quad commands recorded by entities while visiting the scene,
+ * and draws them at the end of the frame.
+ * Consecutive commands that share program, texture and blend func are transformed
+ * into one big vertex buffer and drawn with one glDrawElements,
+ * so thousands of sprites from the same atlas only cost a few draw calls.
+ * A BatchCommand breaks the current batch and draws its TextureAtlas in place,
+ * an InstanceCommand does the same with one instanced draw call.
+ * A CacheCommand draws the commands captured for it into its texture first.
+ */
+class Renderer : public Object
+{
+	public:
+		/** max vertices in one batch, indices are GLushort */
+		static const int VBO_SIZE = 16384;
+		/** max quads in one batch */
+		static const int MAX_QUADS = VBO_SIZE / 4;
+		/** the vertex ring holds this many full batches before it is orphaned */
+		static const int STREAM_BATCHES = 2;
+		/** quads in the vertex ring, the index buffer covers all of them (32768 vertices, still GLushort) */
+		static const int STREAM_QUADS = STREAM_BATCHES * MAX_QUADS;
+
+		/** returns the shared instance of Renderer */
+		static Renderer* getInstance();
+
+		/** purge the shared instance */
+		static void destroyInstance();
+
+		virtual ~Renderer();
+
+		/** queue a command for this frame, it is drawn in render() */
+		void addCommand(RenderCommand* command);
+
+		/** drop all the queued commands without drawing them */
+		void clean();
+
+		/**
+		 * Send the commands added until endCapture() to cache instead of the frame queue.
+		 * Captures nest, the cache itself still has to be added to the enclosing queue.
+		 */
+		void beginCapture(CacheCommand* cache);
+		void endCapture();
+
+		/** draw calls issued in the last frame */
+		inline int getDrawnBatches() const { return _drawnBatches; }
+		/** quads drawn in the last frame */
+		inline int getDrawnQuads() const { return _drawnQuads; }
+		/** GL state changes issued and skipped by the state cache since the last frame started rendering */
+		GLStateCounters getStateCounters() const;
+
+		/**
+		 * Set the world space rect seen on screen, entities outside of it are not drawn.
+		 * An empty rect turns culling off.
+		 */
+		inline void setVisibleRect(const Rect& rect) { _visibleRect = rect; }
+		inline const Rect& getVisibleRect() const { return _visibleRect; }
+
+		/** derive the visible rect from the 2D projection matrix, call it whenever the projection changes */
+		void setProjection(const Matrix4& projection);
+
+		/** whether a world space box intersects the visible rect, always true while culling is off */
+		bool checkVisibility(const Rect& worldBounds) const;
+
+		/** the viewport of the screen, call it with glViewport(). It is restored after drawing into a CacheCommand */
+		void setViewport(int x, int y, int width, int height);
+
+	GL_METHOD:
+		/**
+		 * Sort the queued commands by global z, merge compatible neighbours and draw them.
+		 * The queue is empty after this call.
+		 */
+		void render();
+
+		/**
+		 * forget GL buffers after the GL context was lost, they are created again in next render().
+		 * The buffers shared by every TextureAtlas and InstanceCommand are forgotten too, and the textures of TextureManager.
+		 */
+		void invalidateGL();
+
+		/** the framebuffer the platform draws the screen to, asked from GL once per context */
+		GLuint getScreenFramebufferGL();
+
+	protected:
+		Renderer();
+
+		void setupBuffersGL();
+		/** sort, merge and draw the commands of a queue, then empty it */
+		void renderQueue(std::vector<RenderCommand*>& queue);
+		/** append quads [start, start+count) of a command in world space to the batch buffer */
+		void fillQuads(const QuadCommand* command, int start, int count);
+		/** draw the quads filled so far and start a new batch */
+		void flushGL();
+		/** bind the framebuffer of the innermost target being drawn, or the screen, with its viewport */
+		void bindTargetGL();
+
+		static Renderer* s_sharedRenderer;
+
+		std::vector<RenderCommand*> _queue;
+		/** captures in progress, the last one receives the added commands */
+		std::vector<CacheCommand*> _captures;
+		/** caches render() is drawing into, the last one is bound */
+		std::vector<CacheCommand*> _targets;
+
+		/** -1 until asked for in the current context */
+		GLint _screenFramebuffer;
+		GLint _viewport[4];
+
+		V3F_C4F_T2F* _verts;
+		GLushort* _indices;
+		/** batches are appended one after the other, no draw waits for the previous one */
+		StreamBuffer* _vertexStream;
+		GLuint _indicesVBO;
+		bool _buffersCreated;
+		/** V3F_C4F_T2F layout over the vertex ring, a batch selects its quads through the index offset */
+		VAO* _quadVAO;
+
+		/** first command of the batch being filled, gives program, texture and blend func */
+		QuadCommand* _batchCommand;
+		int _filledQuads;
+
+		int _drawnBatches;
+		int _drawnQuads;
+
+		Rect _visibleRect;
+};
+
+// end of renderer group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,242 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "targetMacros.h"
+#include "macros.h"
+#include "core/opengl/shader/ProgramBinaryCache.h"
+#include "core/opengl/GPUInfo.h"
+#include "core/resource/ResourceManager.h"
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+#include "core/opengl/GLContext.h"
+// loaded by gl3stubInit(), gl3stub.h itself clashes with the OES macros of GL.h
+extern "C" {
+extern GL_APICALL void (* GL_APIENTRY glGetProgramBinary) (GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, GLvoid* binary);
+extern GL_APICALL void (* GL_APIENTRY glProgramBinary) (GLuint program, GLenum binaryFormat, const GLvoid* binary, GLsizei length);
+extern GL_APICALL void (* GL_APIENTRY glProgramParameteri) (GLuint program, GLenum pname, GLint value);
+}
+#endif
+
+// same values for OpenGL ES 3 and GL_OES_get_program_binary
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT_FK   0x8257
+#define GL_PROGRAM_BINARY_LENGTH_FK             0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS_FK        0x87FE
+
+FLAKOR_NS_BEGIN
+
+typedef void (GL_APIENTRY *GetProgramBinaryFunc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, GLvoid* binary);
+typedef void (GL_APIENTRY *ProgramBinaryFunc)(GLuint program, GLenum binaryFormat, const GLvoid* binary, GLsizei length);
+typedef void (GL_APIENTRY *ProgramParameteriFunc)(GLuint program, GLenum pname, GLint value);
+
+static bool s_checked = false;
+static GetProgramBinaryFunc s_getProgramBinary = nullptr;
+static ProgramBinaryFunc s_programBinary = nullptr;
+// only OpenGL ES 3 has the retrievable hint, the extension always keeps the binary
+static ProgramParameteriFunc s_programParameteri = nullptr;
+
+static const uint32_t BINARY_MAGIC = 0x42504b46; // "FKPB"
+// a cached program larger than this is a broken file
+static const uint32_t MAX_BINARY_LENGTH = 4 * 1024 * 1024;
+
+struct BinaryHeader
+{
+	uint32_t magic;
+	uint32_t format;
+	uint32_t length;
+};
+
+// 64 bit FNV-1a, the hash only names files
+static uint64_t hashBytes(uint64_t hash, const char* bytes, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char* str)
+{
+	// the terminator separates the strings, "ab"+"c" and "a"+"bc" differ
+	return hashBytes(hash, str, strlen(str) + 1);
+}
+
+bool ProgramBinaryCache::isSupported()
+{
+	if (!s_checked)
+	{
+		s_checked = true;
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+		if (GLContext::GetInstance()->GetGLVersion() >= 3.0f && glGetProgramBinary != NULL && glProgramBinary != NULL)
+		{
+			s_getProgramBinary = (GetProgramBinaryFunc)glGetProgramBinary;
+			s_programBinary = (ProgramBinaryFunc)glProgramBinary;
+			s_programParameteri = (ProgramParameteriFunc)glProgramParameteri;
+		}
+		else if (GPUInfo::getInstance()->checkForGLExtension("GL_OES_get_program_binary"))
+		{
+			s_getProgramBinary = (GetProgramBinaryFunc)eglGetProcAddress("glGetProgramBinaryOES");
+			s_programBinary = (ProgramBinaryFunc)eglGetProcAddress("glProgramBinaryOES");
+		}
+#endif
+		// some drivers expose the entry points but no format to store
+		GLint formats = 0;
+		if (s_getProgramBinary != nullptr && s_programBinary != nullptr)
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_FK, &formats);
+		}
+		if (formats <= 0)
+		{
+			s_getProgramBinary = nullptr;
+			s_programBinary = nullptr;
+			s_programParameteri = nullptr;
+		}
+		FKLOG("flakor: program binary cache %s", s_programBinary != nullptr ? "enabled" : "not supported");
+	}
+	return s_programBinary != nullptr;
+}
+
+std::string ProgramBinaryCache::getKey(const GLchar* vert, const GLchar* frag)
+{
+	if (vert == nullptr || frag == nullptr || !isSupported())
+	{
+		return std::string();
+	}
+	const char* dataPath = ResourceManager::thisManager()->internalDataPath;
+	if (dataPath == nullptr || dataPath[0] == '\0')
+	{
+		return std::string();
+	}
+
+	GPUInfo* info = GPUInfo::getInstance();
+	unsigned int version = FORMAT_VERSION;
+	uint64_t hash = 14695981039346656037ULL;
+	hash = hashBytes(hash, (const char*)&version, sizeof(version));
+	hash = hashString(hash, vert);
+	hash = hashString(hash, frag);
+	hash = hashString(hash, info->getGLVendor().c_str());
+	hash = hashString(hash, info->getGLRenderer().c_str());
+	hash = hashString(hash, info->getGLVersion().c_str());
+
+	char key[17];
+	snprintf(key, sizeof(key), "%08x%08x", (unsigned int)(hash >> 32), (unsigned int)(hash & 0xffffffff));
+	return std::string(key);
+}
+
+std::string ProgramBinaryCache::getPath(const std::string& key)
+{
+	std::string path = ResourceManager::thisManager()->internalDataPath;
+	path += "/program_";
+	path += key;
+	path += ".bin";
+	return path;
+}
+
+bool ProgramBinaryCache::load(GLuint program, const std::string& key)
+{
+	if (key.empty() || !isSupported())
+	{
+		return false;
+	}
+
+	std::string path = getPath(key);
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	BinaryHeader header;
+	std::vector<char> binary;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& header.magic == BINARY_MAGIC
+		&& header.length > 0 && header.length <= MAX_BINARY_LENGTH;
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, header.length, file) == header.length;
+	}
+	fclose(file);
+
+	GLint status = GL_FALSE;
+	if (valid)
+	{
+		s_programBinary(program, (GLenum)header.format, binary.data(), (GLsizei)header.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+	}
+
+	if (status != GL_TRUE)
+	{
+		// an unknown format raises an error, don't leave it to the next check
+		while (glGetError() != GL_NO_ERROR) {}
+		FKLOG("flakor: program binary %s was rejected, compiling from source", path.c_str());
+		remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+
+void ProgramBinaryCache::prepareLink(GLuint program)
+{
+	if (s_programParameteri != nullptr)
+	{
+		s_programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT_FK, GL_TRUE);
+	}
+}
+
+void ProgramBinaryCache::save(GLuint program, const std::string& key)
+{
+	if (key.empty() || !isSupported())
+	{
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_FK, &length);
+	if (length <= 0 || (uint32_t)length > MAX_BINARY_LENGTH)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	s_getProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+	{
+		return;
+	}
+
+	BinaryHeader header;
+	header.magic = BINARY_MAGIC;
+	header.format = format;
+	header.length = (uint32_t)written;
+
+	// write aside and rename, a process killed while writing leaves no half file behind
+	std::string path = getPath(key);
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		FKLOG("flakor: can't write program binary %s", tmpPath.c_str());
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(binary.data(), 1, written, file) == (size_t)written;
+	ok = fclose(file) == 0 && ok;
+	if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		remove(tmpPath.c_str());
+	}
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,66 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_PROGRAMBINARYCACHE_H_
+#define _FK_PROGRAMBINARYCACHE_H_
+
+#include <string>
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * @addtogroup shaders
+ * @{
+ */
+
+/**
+ * ProgramBinaryCache keeps linked programs on disk so that the next start, or the next
+ * GL context after a loss, loads them with glProgramBinary instead of compiling them again.
+ *
+ * Binaries are stored under ResourceManager::internalDataPath, one file per program, named
+ * by a hash of both shader sources and the GL_VENDOR/GL_RENDERER/GL_VERSION strings of GPUInfo,
+ * a driver update simply misses the old files. It works with OpenGL ES 3 or GL_OES_get_program_binary;
+ * without them, without a data path, or when the driver rejects a binary, getKey() or load()
+ * fails and GLProgram compiles from source as before.
+ *
+ * Bump FORMAT_VERSION when the header GLProgram::compileShader() puts in front of every source changes.
+ */
+class ProgramBinaryCache
+{
+	public:
+		static const unsigned int FORMAT_VERSION = 1;
+
+	GL_METHOD:
+		/** whether the context can load and retrieve program binaries, checked once after gatherGPUInfo() */
+		static bool isSupported();
+
+		/** file key for a pair of sources, empty when the cache can't be used */
+		static std::string getKey(const GLchar* vert, const GLchar* frag);
+
+		/**
+		 * load the binary stored for key into a new program.
+		 * @return true when the program is linked, false leaves the program unusable and removes a stale file
+		 */
+		static bool load(GLuint program, const std::string& key);
+
+		/** call before glLinkProgram so that the driver keeps the binary retrievable */
+		static void prepareLink(GLuint program);
+
+		/** store the binary of a program that was just linked from source */
+		static void save(GLuint program, const std::string& key);
+
+	protected:
+		static std::string getPath(const std::string& key);
+};
+
+// end of shaders group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
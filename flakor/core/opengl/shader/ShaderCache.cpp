@@ -0,0 +1,170 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include "targetMacros.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "core/opengl/shader/Shaders.h"
+#include "core/opengl/GLProgram.h"
+
+FLAKOR_NS_BEGIN
+
+ShaderCache* ShaderCache::s_sharedShaderCache = nullptr;
+
+ShaderCache* ShaderCache::getInstance()
+{
+    if (! s_sharedShaderCache)
+    {
+        s_sharedShaderCache = new (std::nothrow) ShaderCache();
+    }
+
+    return s_sharedShaderCache;
+}
+
+void ShaderCache::destroyInstance()
+{
+    FK_SAFE_RELEASE_NULL(s_sharedShaderCache);
+}
+
+ShaderCache::ShaderCache()
+: _programs()
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+    for (auto it = _programs.begin(); it != _programs.end(); ++it)
+    {
+        FK_SAFE_RELEASE(it->second);
+    }
+    _programs.clear();
+}
+
+GLProgram* ShaderCache::getGLProgram(const std::string &key)
+{
+    auto it = _programs.find(key);
+    if (it != _programs.end())
+    {
+        return it->second;
+    }
+
+    const GLchar* vert = nullptr;
+    const GLchar* frag = nullptr;
+    if (!getBuiltinSources(key, &vert, &frag))
+    {
+        FKLOG("flakor: ShaderCache: unknown program %s", key.c_str());
+        return nullptr;
+    }
+
+    GLProgram* program = GLProgram::createWithByteArrays(vert, frag);
+    if (program != nullptr)
+    {
+        setupBuiltinUniforms(key, program);
+        addGLProgram(program, key);
+    }
+    return program;
+}
+
+void ShaderCache::addGLProgram(GLProgram* program, const std::string &key)
+{
+    FKAssert(program != nullptr, "GLProgram must be non-nil");
+
+    auto it = _programs.find(key);
+    if (it != _programs.end())
+    {
+        if (it->second == program)
+        {
+            return;
+        }
+        FK_SAFE_RELEASE(it->second);
+    }
+
+    program->retain();
+    _programs[key] = program;
+}
+
+bool ShaderCache::getBuiltinSources(const std::string &key, const GLchar** vert, const GLchar** frag)
+{
+    if (key == GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR)
+    {
+        *vert = Shader::PositionTextureColor_vert;
+        *frag = Shader::PositionTextureColor_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP)
+    {
+        *vert = Shader::PositionTextureColor_noMVP_vert;
+        *frag = Shader::PositionTextureColor_noMVP_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_INSTANCED)
+    {
+        // same fragment stage, only the vertex stage reads instances
+        *vert = Shader::PositionTextureColorInstanced_vert;
+        *frag = Shader::PositionTextureColor_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_POSITION_COLOR)
+    {
+        *vert = Shader::PositionColor_vert;
+        *frag = Shader::PositionColor_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_POSITION_TEXTURE)
+    {
+        *vert = Shader::PositionTexture_vert;
+        *frag = Shader::PositionTexture_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_POSITION_TEXTURE_A8_COLOR)
+    {
+        *vert = Shader::PositionTextureA8Color_vert;
+        *frag = Shader::PositionTextureA8Color_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_LABEL_NORMAL)
+    {
+        *vert = Shader::Label_vert;
+        *frag = Shader::LabelNormal_frag;
+    }
+    else if (key == GLProgram::SHADER_NAME_LABEL_DISTANCEFIELD_NORMAL)
+    {
+        *vert = Shader::Label_vert;
+        *frag = Shader::LabelDistanceFieldNormal_frag;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::setupBuiltinUniforms(const std::string &key, GLProgram* program)
+{
+    // labels carry their color in the vertices so that they batch, the uniform tint stays white
+    if (key == GLProgram::SHADER_NAME_LABEL_NORMAL || key == GLProgram::SHADER_NAME_LABEL_DISTANCEFIELD_NORMAL)
+    {
+        program->use();
+        program->setUniformLocationWith4f(program->getUniformLocationForName("u_textColor"), 1.f, 1.f, 1.f, 1.f);
+    }
+}
+
+void ShaderCache::reloadGL()
+{
+    for (auto it = _programs.begin(); it != _programs.end(); ++it)
+    {
+        const GLchar* vert = nullptr;
+        const GLchar* frag = nullptr;
+        if (!getBuiltinSources(it->first, &vert, &frag))
+        {
+            continue;
+        }
+
+        GLProgram* program = it->second;
+        program->reset();
+        if (program->initWithByteArrays(vert, frag))
+        {
+            program->link();
+            program->updateUniforms();
+            setupBuiltinUniforms(it->first, program);
+        }
+    }
+}
+
+FLAKOR_NS_END
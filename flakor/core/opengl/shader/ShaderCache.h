@@ -0,0 +1,74 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_SHADERCACHE_H_
+#define _FK_SHADERCACHE_H_
+
+#include <string>
+#include <unordered_map>
+
+#include "base/lang/Object.h"
+#include "core/opengl/GL.h"
+
+FLAKOR_NS_BEGIN
+
+class GLProgram;
+
+/**
+ * @addtogroup shaders
+ * @{
+ */
+
+/**
+ * ShaderCache keeps one GLProgram per shader name so that entities share programs.
+ * Renderer can only merge quad commands that use the same program,
+ * so sprites must not create their own program.
+ */
+class ShaderCache : public Object
+{
+	public:
+		/** returns the shared instance of ShaderCache */
+		static ShaderCache* getInstance();
+
+		/** purge the shared instance */
+		static void destroyInstance();
+
+		virtual ~ShaderCache();
+
+		/**
+		 * Returns the program registered with the key.
+		 * Built-in programs (GLProgram::SHADER_NAME_*) are compiled lazily on first use,
+		 * so this must be called in GL thread.
+		 * @return the program, or nullptr if the key is unknown
+		 */
+		GLProgram* getGLProgram(const std::string &key);
+
+		/** adds a program to the cache, the program is retained */
+		void addGLProgram(GLProgram* program, const std::string &key);
+
+	GL_METHOD:
+		/**
+		 * Recompile the built-in programs in place after the GL context was lost,
+		 * so pointers held by entities stay valid.
+		 */
+		void reloadGL();
+
+	protected:
+		ShaderCache();
+		/** finds the sources of a built-in program, returns false if key isn't built-in */
+		static bool getBuiltinSources(const std::string &key, const GLchar** vert, const GLchar** frag);
+		/** set the uniforms a built-in program expects but no entity sets, after each link */
+		static void setupBuiltinUniforms(const std::string &key, GLProgram* program);
+
+		static ShaderCache* s_sharedShaderCache;
+		std::unordered_map<std::string, GLProgram*> _programs;
+};
+
+// end of shaders group
+/// @}
+
+FLAKOR_NS_END
+
+#endif
@@ -29,6 +29,7 @@ FLAKOR_NS_BEGIN
 //
 #include "ccShader_PositionTextureColor.frag"
 #include "ccShader_PositionTextureColor.vert"
+#include "ccShader_PositionTextureColor_instanced.vert"
 
 //
 #include "ccShader_PositionTextureColorAlphaTest.frag"
@@ -33,6 +33,8 @@ class Shader
 	static const GLchar * PositionTextureColor_frag;
 	static const GLchar * PositionTextureColor_vert;
 
+	static const GLchar * PositionTextureColorInstanced_vert;
+
 	static const GLchar * PositionTextureColor_noMVP_frag;
 	static const GLchar * PositionTextureColor_noMVP_vert;
 
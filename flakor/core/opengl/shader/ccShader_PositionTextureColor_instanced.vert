@@ -0,0 +1,31 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+// a_position is a corner of the unit quad, the rest changes once per instance, see SpriteInstance
+const char* Shader::PositionTextureColorInstanced_vert = STRINGIFY(
+attribute vec2 a_position;
+attribute vec4 a_texCoord1;
+attribute vec2 a_texCoord2;
+attribute vec4 a_texCoord3;
+attribute vec4 a_color;
+
+\n#ifdef GL_ES\n
+varying lowp vec4 v_fragmentColor;
+varying mediump vec2 v_texCoord;
+\n#else\n
+varying vec4 v_fragmentColor;
+varying vec2 v_texCoord;
+\n#endif\n
+
+void main()
+{
+    vec2 position = vec2(a_texCoord1.x * a_position.x + a_texCoord1.z * a_position.y,
+                         a_texCoord1.y * a_position.x + a_texCoord1.w * a_position.y) + a_texCoord2;
+    gl_Position = FK_MVPMatrix * vec4(position, 0.0, 1.0);
+    v_fragmentColor = a_color;
+    v_texCoord = a_texCoord3.xy + a_position * a_texCoord3.zw;
+}
+);
@@ -0,0 +1,489 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "targetMacros.h"
+#include "macros.h"
+#include "core/opengl/GL.h"
+#include "core/opengl/texture/DynamicAtlas.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureRegion.h"
+#include "core/resource/Image.h"
+#include "tool/utility/TexUtils.h"
+
+FLAKOR_NS_BEGIN
+
+DynamicAtlas* DynamicAtlas::s_sharedDynamicAtlas = nullptr;
+
+DynamicAtlas* DynamicAtlas::getInstance()
+{
+	if (s_sharedDynamicAtlas == nullptr)
+	{
+		s_sharedDynamicAtlas = new (std::nothrow) DynamicAtlas();
+	}
+	return s_sharedDynamicAtlas;
+}
+
+void DynamicAtlas::destroyInstance()
+{
+	FK_SAFE_DELETE(s_sharedDynamicAtlas);
+}
+
+DynamicAtlas::DynamicAtlas()
+: _entries()
+, _pages()
+, _pending()
+, _maxImageSize(DEFAULT_MAX_IMAGE_SIZE)
+, _maxPages(DEFAULT_MAX_PAGES)
+{
+}
+
+DynamicAtlas::~DynamicAtlas()
+{
+	for (auto& it : _entries)
+	{
+		it.second.region->release();
+		it.second.image->release();
+	}
+	_entries.clear();
+	for (size_t i = 0; i < _pages.size(); i++)
+	{
+		_pages[i]->texture->release();
+		delete _pages[i];
+	}
+	_pages.clear();
+}
+
+int DynamicAtlas::getPageCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)_pages.size();
+}
+
+bool DynamicAtlas::canPack(Image* image) const
+{
+	if (_maxImageSize <= 0 || image == nullptr || image->getData() == nullptr)
+	{
+		return false;
+	}
+	if (image->isCompressed() || image->getNumberOfMipmaps() > 1)
+	{
+		return false;
+	}
+
+	int width = image->getWidth();
+	int height = image->getHeight();
+	if (width <= 0 || height <= 0 || width > _maxImageSize || height > _maxImageSize
+		|| width + 2 * PADDING > PAGE_SIZE || height + 2 * PADDING > PAGE_SIZE)
+	{
+		return false;
+	}
+
+	// the formats TexUtils converts to RGBA8888
+	PixelFormat format = image->getRenderFormat();
+	return format == PixelFormat::RGBA8888 || format == PixelFormat::RGB888
+		|| format == PixelFormat::I8 || format == PixelFormat::AI88;
+}
+
+TextureRegion* DynamicAtlas::addImage(const std::string& uri, Image* image)
+{
+	if (!canPack(image))
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _entries.find(uri);
+	if (it != _entries.end())
+	{
+		return it->second.region;
+	}
+
+	int width = image->getWidth() + 2 * PADDING;
+	int height = image->getHeight() + 2 * PADDING;
+	// the blend function of a sprite follows its texture, a page holds one kind of image
+	bool premultiplied = image->hasPremultipliedAlpha();
+
+	Page* page = nullptr;
+	Slot slot;
+	for (size_t i = 0; page == nullptr && i < _pages.size(); i++)
+	{
+		if (_pages[i]->premultiplied == premultiplied && insert(_pages[i], width, height, &slot))
+		{
+			page = _pages[i];
+		}
+	}
+	// slots given back leave the free space in pieces, rebuild the pages that have the room in total
+	for (size_t i = 0; page == nullptr && i < _pages.size(); i++)
+	{
+		Page* candidate = _pages[i];
+		if (candidate->premultiplied == premultiplied && PAGE_SIZE * PAGE_SIZE - candidate->usedArea >= width * height)
+		{
+			rebuild(candidate);
+			if (insert(candidate, width, height, &slot))
+			{
+				page = candidate;
+			}
+		}
+	}
+	if (page == nullptr && (int)_pages.size() < _maxPages)
+	{
+		page = createPage(premultiplied);
+		if (page != nullptr && !insert(page, width, height, &slot))
+		{
+			page = nullptr;
+		}
+	}
+	if (page == nullptr)
+	{
+		return nullptr;
+	}
+
+	Rect rect((float)(slot.x + PADDING), (float)(slot.y + PADDING), (float)image->getWidth(), (float)image->getHeight());
+	TextureRegion* region = TextureRegion::createWithTexture(page->texture, FK_RECT_PIXELS_TO_POINTS(rect));
+	if (region == nullptr)
+	{
+		page->usedArea -= width * height;
+		rebuild(page);
+		return nullptr;
+	}
+
+	Entry entry;
+	entry.image = image;
+	entry.region = region;
+	entry.page = page;
+	entry.slot = slot;
+	entry.uploaded = false;
+	image->retain();
+	region->retain();
+	_entries[uri] = entry;
+	_pending.push_back(uri);
+	page->regionCount++;
+	return region;
+}
+
+TextureRegion* DynamicAtlas::getRegion(const std::string& uri)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _entries.find(uri);
+	return it != _entries.end() ? it->second.region : nullptr;
+}
+
+void DynamicAtlas::removeRegion(const std::string& uri)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _entries.find(uri);
+	if (it != _entries.end())
+	{
+		removeEntry(it->second);
+		_entries.erase(it);
+	}
+}
+
+void DynamicAtlas::removeUnusedRegions()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<Page*> touched;
+	for (auto it = _entries.begin(); it != _entries.end();)
+	{
+		if (it->second.region->retainCount() == 1)
+		{
+			Page* page = it->second.page;
+			if (std::find(touched.begin(), touched.end(), page) == touched.end())
+			{
+				touched.push_back(page);
+			}
+			removeEntry(it->second);
+			it = _entries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (size_t i = 0; i < touched.size(); i++)
+	{
+		if (touched[i]->regionCount > 0)
+		{
+			rebuild(touched[i]);
+		}
+	}
+	removeEmptyPages();
+}
+
+void DynamicAtlas::updateGL()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_pending.empty())
+	{
+		return;
+	}
+
+	// RGBA8888 rows, the last texture may have left another alignment
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (size_t i = 0; i < _pending.size(); i++)
+	{
+		auto it = _entries.find(_pending[i]);
+		// removed before its copy
+		if (it == _entries.end() || it->second.uploaded)
+		{
+			continue;
+		}
+		uploadGL(it->second);
+		it->second.uploaded = true;
+	}
+	_pending.clear();
+}
+
+void DynamicAtlas::invalidateGL()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (size_t i = 0; i < _pages.size(); i++)
+	{
+		// allocated again by the next loadGL()
+		_pages[i]->texture->invalidateGL();
+	}
+	_pending.clear();
+	for (auto& it : _entries)
+	{
+		it.second.uploaded = false;
+		_pending.push_back(it.first);
+	}
+}
+
+bool DynamicAtlas::insert(Page* page, int width, int height, Slot* slot)
+{
+	// best short side fit
+	int best = -1;
+	int bestShortSide = PAGE_SIZE + 1;
+	int bestLongSide = PAGE_SIZE + 1;
+	for (size_t i = 0; i < page->freeSlots.size(); i++)
+	{
+		const Slot& space = page->freeSlots[i];
+		if (space.width < width || space.height < height)
+		{
+			continue;
+		}
+		int leftoverX = space.width - width;
+		int leftoverY = space.height - height;
+		int shortSide = MIN(leftoverX, leftoverY);
+		int longSide = MAX(leftoverX, leftoverY);
+		if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide))
+		{
+			best = (int)i;
+			bestShortSide = shortSide;
+			bestLongSide = longSide;
+		}
+	}
+	if (best < 0)
+	{
+		return false;
+	}
+
+	slot->x = page->freeSlots[best].x;
+	slot->y = page->freeSlots[best].y;
+	slot->width = width;
+	slot->height = height;
+	placeSlot(page->freeSlots, *slot);
+	page->usedArea += width * height;
+	return true;
+}
+
+void DynamicAtlas::rebuild(Page* page)
+{
+	Slot whole = { 0, 0, PAGE_SIZE, PAGE_SIZE };
+	page->freeSlots.assign(1, whole);
+	for (auto& it : _entries)
+	{
+		if (it.second.page == page)
+		{
+			placeSlot(page->freeSlots, it.second.slot);
+		}
+	}
+}
+
+void DynamicAtlas::placeSlot(std::vector<Slot>& freeSlots, const Slot& used)
+{
+	size_t count = freeSlots.size();
+	for (size_t i = 0; i < count;)
+	{
+		// a copy, the pieces are appended to the same vector
+		Slot space = freeSlots[i];
+		if (used.x >= space.x + space.width || used.x + used.width <= space.x
+			|| used.y >= space.y + space.height || used.y + used.height <= space.y)
+		{
+			i++;
+			continue;
+		}
+
+		// the parts of space above, below, left and right of used
+		if (used.y > space.y)
+		{
+			Slot piece = { space.x, space.y, space.width, used.y - space.y };
+			freeSlots.push_back(piece);
+		}
+		if (used.y + used.height < space.y + space.height)
+		{
+			Slot piece = { space.x, used.y + used.height, space.width, space.y + space.height - used.y - used.height };
+			freeSlots.push_back(piece);
+		}
+		if (used.x > space.x)
+		{
+			Slot piece = { space.x, space.y, used.x - space.x, space.height };
+			freeSlots.push_back(piece);
+		}
+		if (used.x + used.width < space.x + space.width)
+		{
+			Slot piece = { used.x + used.width, space.y, space.x + space.width - used.x - used.width, space.height };
+			freeSlots.push_back(piece);
+		}
+
+		freeSlots.erase(freeSlots.begin() + i);
+		count--;
+	}
+	pruneSlots(freeSlots);
+}
+
+void DynamicAtlas::pruneSlots(std::vector<Slot>& freeSlots)
+{
+	for (size_t i = 0; i < freeSlots.size(); i++)
+	{
+		for (size_t j = i + 1; j < freeSlots.size();)
+		{
+			const Slot& a = freeSlots[i];
+			const Slot& b = freeSlots[j];
+			if (b.x >= a.x && b.y >= a.y && b.x + b.width <= a.x + a.width && b.y + b.height <= a.y + a.height)
+			{
+				freeSlots.erase(freeSlots.begin() + j);
+			}
+			else if (a.x >= b.x && a.y >= b.y && a.x + a.width <= b.x + b.width && a.y + a.height <= b.y + b.height)
+			{
+				freeSlots.erase(freeSlots.begin() + i);
+				j = i + 1;
+			}
+			else
+			{
+				j++;
+			}
+		}
+	}
+}
+
+DynamicAtlas::Page* DynamicAtlas::createPage(bool premultiplied)
+{
+	Texture2D* texture = new (std::nothrow) Texture2D();
+	if (texture == nullptr)
+	{
+		return nullptr;
+	}
+	if (!texture->initWithSize(PixelFormat::RGBA8888, PAGE_SIZE, PAGE_SIZE))
+	{
+		texture->release();
+		return nullptr;
+	}
+	texture->setPremultipliedAlpha(premultiplied);
+
+	Page* page = new (std::nothrow) Page();
+	if (page == nullptr)
+	{
+		texture->release();
+		return nullptr;
+	}
+	Slot whole = { 0, 0, PAGE_SIZE, PAGE_SIZE };
+	page->texture = texture;
+	page->freeSlots.assign(1, whole);
+	page->usedArea = 0;
+	page->regionCount = 0;
+	page->premultiplied = premultiplied;
+	_pages.push_back(page);
+	return page;
+}
+
+void DynamicAtlas::removeEntry(Entry& entry)
+{
+	Page* page = entry.page;
+	page->freeSlots.push_back(entry.slot);
+	pruneSlots(page->freeSlots);
+	page->usedArea -= entry.slot.width * entry.slot.height;
+	page->regionCount--;
+
+	entry.region->release();
+	entry.image->release();
+	entry.region = nullptr;
+	entry.image = nullptr;
+}
+
+void DynamicAtlas::removeEmptyPages()
+{
+	for (size_t i = 0; i < _pages.size();)
+	{
+		Page* page = _pages[i];
+		if (page->regionCount > 0)
+		{
+			i++;
+			continue;
+		}
+		page->texture->release();
+		delete page;
+		_pages.erase(_pages.begin() + i);
+	}
+}
+
+void DynamicAtlas::uploadGL(const Entry& entry)
+{
+	Texture2D* texture = entry.page->texture;
+	// allocates a new page, or one lost with the context
+	texture->loadGL();
+
+	Image* image = entry.image;
+	unsigned char* data = nullptr;
+	ssize_t dataLen = 0;
+	PixelFormat format = TexUtils::convertDataToFormat(image->getData(), image->getDataLen(), image->getRenderFormat(),
+			PixelFormat::RGBA8888, &data, &dataLen);
+	if (format != PixelFormat::RGBA8888)
+	{
+		FKLOG("DynamicAtlas: can't convert an image to RGBA8888");
+		if (data != image->getData())
+		{
+			free(data);
+		}
+		return;
+	}
+
+	// repeat the edge pixels into the padding
+	int width = image->getWidth();
+	int height = image->getHeight();
+	int paddedWidth = entry.slot.width;
+	int paddedHeight = entry.slot.height;
+	std::vector<unsigned char> padded(paddedWidth * paddedHeight * 4);
+	for (int y = 0; y < paddedHeight; y++)
+	{
+		int srcY = MIN(MAX(y - PADDING, 0), height - 1);
+		const unsigned char* src = data + srcY * width * 4;
+		unsigned char* dst = &padded[y * paddedWidth * 4];
+		for (int x = 0; x < PADDING; x++)
+		{
+			memcpy(dst + x * 4, src, 4);
+		}
+		memcpy(dst + PADDING * 4, src, width * 4);
+		for (int x = PADDING + width; x < paddedWidth; x++)
+		{
+			memcpy(dst + x * 4, src + (width - 1) * 4, 4);
+		}
+	}
+	if (data != image->getData())
+	{
+		free(data);
+	}
+
+	texture->updateWithDataGL(padded.data(), entry.slot.x, entry.slot.y, paddedWidth, paddedHeight);
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,142 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_DYNAMICATLAS_H_
+#define _FK_DYNAMICATLAS_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "targetMacros.h"
+
+FLAKOR_NS_BEGIN
+
+class Texture2D;
+class TextureRegion;
+class Image;
+
+/**
+ * DynamicAtlas = 运行时图集，把小图打包进共享的纹理页
+ *
+ * Small images loaded by uri are packed into shared PAGE_SIZE x PAGE_SIZE RGBA8888 pages when
+ * they are loaded, so sprites of unrelated image files share a texture and Renderer batches them.
+ * TextureManager::loadRegion() asks the atlas first, Sprite::create("bundle://x.png") ends up here.
+ *
+ * Pages are packed with MaxRects (best short side fit). Every image gets an extruded border of
+ * PADDING pixels, linear filtering at its edges doesn't bleed into the neighbours. The pixels are
+ * copied into the page by updateGL(), which Renderer::render() runs before drawing.
+ *
+ * The atlas holds one reference on every region and keeps the image for as long, to copy it again
+ * after the GL context was lost. removeUnusedRegions() evicts what nothing else holds. A packed region
+ * never moves, sprites keep its texture coordinates: when a page fragments, its free space is rebuilt
+ * from the regions left, and a page without regions is dropped.
+ */
+class DynamicAtlas
+{
+	public:
+		static const int PAGE_SIZE = 2048;
+		/** extruded border around every image, in pixels */
+		static const int PADDING = 1;
+		/** images larger than this on either side keep a texture of their own */
+		static const int DEFAULT_MAX_IMAGE_SIZE = 512;
+		/** pages of a new atlas, 16 MB of GPU memory each */
+		static const int DEFAULT_MAX_PAGES = 4;
+
+		static DynamicAtlas* getInstance();
+		static void destroyInstance();
+
+		/** 0 turns packing off */
+		inline void setMaxImageSize(int size) { _maxImageSize = size; }
+		inline int getMaxImageSize() const { return _maxImageSize; }
+
+		inline void setMaxPages(int pages) { _maxPages = pages; }
+		inline int getMaxPages() const { return _maxPages; }
+
+		int getPageCount();
+
+		/** whether image can go into a page: decoded, uncompressed, no mipmaps and small enough */
+		bool canPack(Image* image) const;
+
+		/** packs image under uri, NULL when it can't be packed or the pages are full */
+		TextureRegion* addImage(const std::string& uri, Image* image);
+		/** the region packed under uri or NULL */
+		TextureRegion* getRegion(const std::string& uri);
+
+		/** gives the space of uri back to its page, only when nothing shows the region anymore */
+		void removeRegion(const std::string& uri);
+		/** evicts the regions that nothing but the atlas holds, rebuilds the free space of their pages, drops empty pages */
+		void removeUnusedRegions();
+
+	GL_METHOD:
+		/** allocates new pages and copies the images packed since the last call into them */
+		void updateGL();
+
+		/** forget the pages after the GL context was lost, every image is copied again */
+		void invalidateGL();
+
+	protected:
+		DynamicAtlas();
+		~DynamicAtlas();
+
+		struct Slot
+		{
+			int x;
+			int y;
+			int width;
+			int height;
+		};
+
+		struct Page
+		{
+			Texture2D* texture;
+			/** maximal free rectangles */
+			std::vector<Slot> freeSlots;
+			int usedArea;
+			int regionCount;
+			bool premultiplied;
+		};
+
+		struct Entry
+		{
+			Image* image;
+			TextureRegion* region;
+			Page* page;
+			/** with the padding */
+			Slot slot;
+			bool uploaded;
+		};
+
+		/** splits the free slots overlapping used, keeps only the maximal ones */
+		static void placeSlot(std::vector<Slot>& freeSlots, const Slot& used);
+		static void pruneSlots(std::vector<Slot>& freeSlots);
+
+		/** a slot of width x height in page, false when there is no room */
+		bool insert(Page* page, int width, int height, Slot* slot);
+		/** packs the slots of the regions left again into an empty page */
+		void rebuild(Page* page);
+		Page* createPage(bool premultiplied);
+		void removeEntry(Entry& entry);
+		/** drops pages without regions */
+		void removeEmptyPages();
+		/** copies the image of entry into its page */
+		void uploadGL(const Entry& entry);
+
+		std::unordered_map<std::string, Entry> _entries;
+		std::vector<Page*> _pages;
+		/** uris packed but not copied into their page yet */
+		std::vector<std::string> _pending;
+		int _maxImageSize;
+		int _maxPages;
+		// images are packed where entities are created, the GL thread for the factory of SceneTransition, copied on the GL thread
+		std::mutex _mutex;
+
+		static DynamicAtlas* s_sharedDynamicAtlas;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,256 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "core/opengl/texture/FontAtlas.h"
+#include "core/opengl/texture/Texture2D.h"
+
+FLAKOR_NS_BEGIN
+
+// empty pixels between glyphs so that linear filtering doesn't bleed
+static const int GLYPH_PADDING = 1;
+
+int FontAtlas::s_generation = 0;
+
+FontAtlas* FontAtlas::create(IGlyphRasterizer* rasterizer, bool distanceField, int pageSize)
+{
+    FontAtlas* atlas = new (std::nothrow) FontAtlas();
+    if (atlas && atlas->initWithRasterizer(rasterizer, distanceField, pageSize))
+    {
+        atlas->autorelease();
+        return atlas;
+    }
+    FK_SAFE_DELETE(atlas);
+    return nullptr;
+}
+
+FontAtlas::FontAtlas()
+: _rasterizer(nullptr)
+, _distanceField(false)
+, _texture(nullptr)
+, _pixels(nullptr)
+, _pageSize(0)
+, _shelfX(0)
+, _shelfY(0)
+, _shelfHeight(0)
+, _full(false)
+, _dirtyTop(0)
+, _dirtyBottom(0)
+, _generation(s_generation)
+{
+}
+
+FontAtlas::~FontAtlas()
+{
+    for (auto it = _glyphs.begin(); it != _glyphs.end(); ++it)
+    {
+        delete it->second;
+    }
+    FK_SAFE_RELEASE(_texture);
+    free(_pixels);
+}
+
+bool FontAtlas::initWithRasterizer(IGlyphRasterizer* rasterizer, bool distanceField, int pageSize)
+{
+    FKAssert(rasterizer != nullptr, "FontAtlas: rasterizer must be non-nil");
+    FKAssert(pageSize > 0, "FontAtlas: invalid page size");
+
+    _pixels = (unsigned char *)calloc(pageSize * pageSize, 1);
+    _texture = new (std::nothrow) Texture2D();
+    if (_pixels == nullptr || _texture == nullptr)
+    {
+        return false;
+    }
+
+    // the texture keeps pointing at _pixels, which is how it reloads after a context loss
+    _texture->initWithData(_pixels, pageSize * pageSize, PixelFormat::A8, pageSize, pageSize, SizeMake(pageSize, pageSize));
+
+    _rasterizer = rasterizer;
+    _distanceField = distanceField;
+    _pageSize = pageSize;
+    return true;
+}
+
+const FontAtlas::Glyph* FontAtlas::getGlyph(unsigned int codepoint)
+{
+    auto it = _glyphs.find(codepoint);
+    if (it != _glyphs.end())
+    {
+        return it->second;
+    }
+
+    IGlyphRasterizer::Bitmap bitmap;
+    memset(&bitmap, 0, sizeof(bitmap));
+    if (!_rasterizer->rasterize(codepoint, &bitmap))
+    {
+        _glyphs[codepoint] = nullptr;
+        return nullptr;
+    }
+
+    Glyph* glyph = new Glyph();
+    memset(glyph, 0, sizeof(*glyph));
+    glyph->advance = bitmap.advance;
+
+    // blanks only move the pen
+    if (bitmap.width > 0 && bitmap.height > 0 && bitmap.pixels != nullptr)
+    {
+        int border = _distanceField ? DISTANCE_FIELD_SPREAD : 0;
+        int w = bitmap.width + border * 2;
+        int h = bitmap.height + border * 2;
+        int x, y;
+        if (!allocate(w, h, &x, &y))
+        {
+            // don't cache it, a later atlas may have room
+            delete glyph;
+            return nullptr;
+        }
+
+        if (_distanceField)
+        {
+            blitDistanceField(bitmap, x, y);
+        }
+        else
+        {
+            blit(bitmap, x, y);
+        }
+
+        float size = (float)_pageSize;
+        glyph->u0 = x / size;
+        glyph->v0 = y / size;
+        glyph->u1 = (x + w) / size;
+        glyph->v1 = (y + h) / size;
+        glyph->x = bitmap.bearingX - border;
+        glyph->y = bitmap.bearingY + border - h;
+        glyph->width = (float)w;
+        glyph->height = (float)h;
+
+        if (_dirtyTop >= _dirtyBottom)
+        {
+            _dirtyTop = y;
+            _dirtyBottom = y + h;
+        }
+        else
+        {
+            _dirtyTop = MIN(_dirtyTop, y);
+            _dirtyBottom = MAX(_dirtyBottom, y + h);
+        }
+    }
+
+    _glyphs[codepoint] = glyph;
+    return glyph;
+}
+
+bool FontAtlas::allocate(int w, int h, int* x, int* y)
+{
+    if (_full || w > _pageSize || h > _pageSize)
+    {
+        return false;
+    }
+
+    if (_shelfX + w > _pageSize)
+    {
+        _shelfY += _shelfHeight + GLYPH_PADDING;
+        _shelfX = 0;
+        _shelfHeight = 0;
+    }
+    if (_shelfY + h > _pageSize)
+    {
+        FKLOG("flakor: FontAtlas: the %dx%d texture is full", _pageSize, _pageSize);
+        _full = true;
+        return false;
+    }
+
+    *x = _shelfX;
+    *y = _shelfY;
+    _shelfX += w + GLYPH_PADDING;
+    _shelfHeight = MAX(_shelfHeight, h);
+    return true;
+}
+
+void FontAtlas::blit(const IGlyphRasterizer::Bitmap& bitmap, int x, int y)
+{
+    for (int row = 0; row < bitmap.height; row++)
+    {
+        memcpy(&_pixels[(y + row) * _pageSize + x], &bitmap.pixels[row * bitmap.width], bitmap.width);
+    }
+}
+
+void FontAtlas::blitDistanceField(const IGlyphRasterizer::Bitmap& bitmap, int x, int y)
+{
+    // brute force within the spread: done once per glyph, glyphs are small
+    const int spread = DISTANCE_FIELD_SPREAD;
+    const int w = bitmap.width + spread * 2;
+    const int h = bitmap.height + spread * 2;
+    const float maxDistance = sqrtf(2.f) * spread;
+
+    for (int row = 0; row < h; row++)
+    {
+        for (int column = 0; column < w; column++)
+        {
+            int sx = column - spread;
+            int sy = row - spread;
+            bool inside = sx >= 0 && sx < bitmap.width && sy >= 0 && sy < bitmap.height
+                    && bitmap.pixels[sy * bitmap.width + sx] >= 128;
+
+            // nearest pixel on the other side of the outline
+            int best = spread * spread * 2 + 1;
+            for (int dy = -spread; dy <= spread; dy++)
+            {
+                int ny = sy + dy;
+                for (int dx = -spread; dx <= spread; dx++)
+                {
+                    int nx = sx + dx;
+                    bool other = nx >= 0 && nx < bitmap.width && ny >= 0 && ny < bitmap.height
+                            && bitmap.pixels[ny * bitmap.width + nx] >= 128;
+                    if (other != inside)
+                    {
+                        best = MIN(best, dx * dx + dy * dy);
+                    }
+                }
+            }
+
+            // 0.5 is the outline, the shaders smoothstep around it
+            float distance = MIN(sqrtf((float)best) - 0.5f, maxDistance);
+            float value = 0.5f + (inside ? distance : -distance) / (2.f * maxDistance);
+            value = MIN(MAX(value, 0.f), 1.f);
+            _pixels[(y + row) * _pageSize + x + column] = (unsigned char)(value * 255.f + 0.5f);
+        }
+    }
+}
+
+void FontAtlas::invalidateGL()
+{
+    s_generation++;
+}
+
+void FontAtlas::uploadGL()
+{
+    if (_generation != s_generation)
+    {
+        // forget the dead texture name, that drops the borrowed levels too, and point it at the whole page again
+        _texture->invalidateGL();
+        _texture->initWithData(_pixels, _pageSize * _pageSize, PixelFormat::A8, _pageSize, _pageSize, SizeMake(_pageSize, _pageSize));
+        _generation = s_generation;
+    }
+
+    bool created = _texture->getTextureID() != 0;
+    // the first upload, or the one after a context loss, sends the whole page
+    _texture->loadGL();
+
+    if (created && _dirtyTop < _dirtyBottom)
+    {
+        // whole rows: GLES2 has no GL_UNPACK_ROW_LENGTH
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        _texture->updateWithDataGL(&_pixels[_dirtyTop * _pageSize], 0, _dirtyTop, _pageSize, _dirtyBottom - _dirtyTop);
+    }
+    _dirtyTop = _dirtyBottom = 0;
+}
+
+FLAKOR_NS_END
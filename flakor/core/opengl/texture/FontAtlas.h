@@ -0,0 +1,103 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_FONTATLAS_H_
+#define _FK_FONTATLAS_H_
+
+#include <unordered_map>
+
+#include "base/lang/Object.h"
+#include "base/interface/IGlyphRasterizer.h"
+#include "core/opengl/GL.h"
+
+FLAKOR_NS_BEGIN
+
+class Texture2D;
+
+/**
+ * FontAtlas = 动态字形图集
+ *
+ * Glyphs are rasterized the first time they are asked for and packed on shelves into one A8 texture,
+ * after that getGlyph() is a hash lookup. The pixels stay in memory: new glyphs only mark their rows
+ * dirty and uploadGL() sends those rows with glTexSubImage2D, a text made of known glyphs uploads nothing.
+ *
+ * With distance field on, every glyph is stored as a signed distance field with a border of
+ * DISTANCE_FIELD_SPREAD pixels, for the SHADER_NAME_LABEL_DISTANCEFIELD_* programs.
+ * The rasterizer isn't retained and must outlive the atlas.
+ */
+class FontAtlas : public Object
+{
+public:
+    static const int DEFAULT_PAGE_SIZE = 1024;
+    static const int DISTANCE_FIELD_SPREAD = 6;
+
+    /** where a glyph is in the texture and how it sits on the baseline */
+    struct Glyph
+    {
+        /** texture rect, v0 is the top */
+        float u0, v0, u1, v1;
+        /** bottom left of the quad from the pen on the baseline, and its size */
+        float x, y, width, height;
+        float advance;
+    };
+
+    /** creates an atlas with a square texture of pageSize pixels */
+    static FontAtlas* create(IGlyphRasterizer* rasterizer, bool distanceField, int pageSize = DEFAULT_PAGE_SIZE);
+
+    FontAtlas();
+    virtual ~FontAtlas();
+
+    bool initWithRasterizer(IGlyphRasterizer* rasterizer, bool distanceField, int pageSize);
+
+    /** the glyph of codepoint, rasterized on first use. nullptr if the font lacks it or the texture is full */
+    const Glyph* getGlyph(unsigned int codepoint);
+
+    inline float getKerning(unsigned int left, unsigned int right) const { return _rasterizer->getKerning(left, right); }
+    inline float getLineHeight() const { return _rasterizer->getLineHeight(); }
+    inline float getAscender() const { return _rasterizer->getAscender(); }
+    inline bool isDistanceField() const { return _distanceField; }
+    inline Texture2D* getTexture() const { return _texture; }
+
+GL_METHOD:
+    /** upload the texture, or just the rows that got new glyphs */
+    void uploadGL();
+    /** the GL context was lost, every atlas uploads its whole page from _pixels again. Renderer::invalidateGL() runs it */
+    static void invalidateGL();
+
+protected:
+    /** find room for a w x h block, false if the texture is full */
+    bool allocate(int w, int h, int* x, int* y);
+    /** copy a coverage mask to the page, as is or as a distance field */
+    void blit(const IGlyphRasterizer::Bitmap& bitmap, int x, int y);
+    void blitDistanceField(const IGlyphRasterizer::Bitmap& bitmap, int x, int y);
+
+    IGlyphRasterizer* _rasterizer;
+    bool _distanceField;
+    Texture2D* _texture;
+
+    /** _pageSize * _pageSize A8 pixels, the texture reloads from them after a context loss */
+    unsigned char* _pixels;
+    int _pageSize;
+
+    // shelf packing: glyphs fill a row left to right, the next row starts under the highest one
+    int _shelfX;
+    int _shelfY;
+    int _shelfHeight;
+    bool _full;
+
+    /** rows [_dirtyTop, _dirtyBottom) changed since the last upload */
+    int _dirtyTop;
+    int _dirtyBottom;
+    /** the texture is from an older context when it differs from s_generation */
+    int _generation;
+    static int s_generation;
+
+    /** nullptr for codepoints the font doesn't have, they are not asked twice */
+    std::unordered_map<unsigned int, Glyph*> _glyphs;
+};
+
+FLAKOR_NS_END
+
+#endif
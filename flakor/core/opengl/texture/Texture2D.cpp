@@ -1,10 +1,17 @@
+#include <string.h>
+#include <vector>
+
 #include "macros.h"
 #include "core/opengl/GL.h"
 #include "core/opengl/GPUInfo.h"
 #include "core/opengl/GLProgram.h"
 #include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureManager.h"
 #include "core/resource/Image.h"
 #include "tool/utility/TexUtils.h"
+#include "core/opengl/GLStateCache.h"
+
+#define GL_COMPRESSED_RGB8_ETC2_FK 0x9274
 
 FLAKOR_NS_BEGIN
 
@@ -70,8 +77,19 @@ const PixelFormatInfoMap Texture2D::_pixelFormatInfoTables(TexturePixelFormatInf
 // Default is: RGBA8888 (32-bit textures)
 static PixelFormat g_defaultAlphaPixelFormat = PixelFormat::DEFAULT;
 
+unsigned int Texture2D::s_frame = 0;
+
 Texture2D::Texture2D()
 : _pixelFormat(PixelFormat::DEFAULT)
+, _paramDirty(false)
+, _dataDirty(false)
+, _clearDataAfterLoad(false)
+, _info(NULL)
+, _mipmapsNum(1)
+, _ownsInfo(false)
+, _ownsData(false)
+, _lastUsedFrame(0)
+, _evicted(false)
 , _pixelsWidth(0)
 , _pixelsHeight(0)
 , _textureID(0)
@@ -79,11 +97,6 @@ Texture2D::Texture2D()
 , _maxT(0.0)
 , _hasPremultipliedAlpha(false)
 , _antialiasEnabled(true)
-, _info(NULL)
-, _mipmapsNum(1)
-, _paramDirty(false)
-, _dataDirty(false)
-, _clearDataAfterLoad(false)
 {
 	_texParams.minFilter = GL_LINEAR;
     _texParams.magFilter = GL_LINEAR;
@@ -95,8 +108,9 @@ Texture2D::~Texture2D()
 {
 	if(_textureID)
 	{
-		glDeleteTextures(1,&_textureID);
+		fkGLDeleteTexture(_textureID);
 	}
+	releaseData();
 }
 
 bool Texture2D::initWithData(const void *data,ssize_t dataLen, PixelFormat pixelFormat,int width,int height,const Size& size)
@@ -104,7 +118,9 @@ bool Texture2D::initWithData(const void *data,ssize_t dataLen, PixelFormat pixel
 	FKAssert(dataLen>0 && width>0 && height>0, "Invalid size");
 
     //if data has no mipmaps, we will consider it has only one mipmap
+    releaseData();
     _info = new MipmapInfo();
+    _ownsInfo = true;
     _info->address = (unsigned char*)data;
     _info->len = static_cast<int>(dataLen);
     _mipmapsNum = 1;
@@ -117,6 +133,22 @@ bool Texture2D::initWithData(const void *data,ssize_t dataLen, PixelFormat pixel
     return true;
 }
 
+bool Texture2D::initWithSize(PixelFormat pixelFormat, int pixelsWidth, int pixelsHeight)
+{
+    FKAssert(pixelsWidth > 0 && pixelsHeight > 0, "Invalid size");
+
+    auto it = _pixelFormatInfoTables.find(pixelFormat);
+    if (it == _pixelFormatInfoTables.end() || it->second.compressed)
+    {
+        FKLOG("Flakor: WARNING: can't create an empty texture of pixelformat: %lx", (unsigned long)pixelFormat);
+        return false;
+    }
+
+    // glTexImage2D allocates the texture when the data address is NULL
+    int dataLen = pixelsWidth * pixelsHeight * it->second.bpp / 8;
+    return initWithData(NULL, dataLen, pixelFormat, pixelsWidth, pixelsHeight, Size((float)pixelsWidth, (float)pixelsHeight));
+}
+
 // implementation Texture2D (Image)
 bool Texture2D::initWithImage(Image *image)
 {
@@ -158,6 +190,7 @@ bool Texture2D::initWithImage(Image *image, PixelFormat format)
         }
         
         _pixelFormat = image->getRenderFormat();
+        releaseData();
         _info = image->getMipmaps();
         _pixelsWidth = imageWidth;
         _pixelsHeight = imageHeight;
@@ -183,6 +216,8 @@ bool Texture2D::initWithImage(Image *image, PixelFormat format)
         pixelFormat = TexUtils::convertDataToFormat(tempData, tempDataLen, renderFormat, pixelFormat, &outTempData, &outTempDataLen);
         
         initWithData(outTempData, outTempDataLen, pixelFormat, imageWidth, imageHeight, imageSize);
+        // converted into a buffer of its own
+        _ownsData = (outTempData != tempData);
         
         // set the premultiplied tag
         _hasPremultipliedAlpha = image->hasPremultipliedAlpha();
@@ -192,6 +227,75 @@ bool Texture2D::initWithImage(Image *image, PixelFormat format)
 }
 
 
+int Texture2D::getDataLen() const
+{
+    int len = 0;
+    for (int i = 0; _info != NULL && i < _mipmapsNum; ++i)
+    {
+        len += _info[i].len;
+    }
+    return len;
+}
+
+void Texture2D::copyData(unsigned char* dst) const
+{
+    for (int i = 0; _info != NULL && i < _mipmapsNum; ++i)
+    {
+        memcpy(dst, _info[i].address, _info[i].len);
+        dst += _info[i].len;
+    }
+}
+
+void Texture2D::releaseData()
+{
+    if (_ownsInfo)
+    {
+        if (_ownsData)
+        {
+            free(_info->address);
+        }
+        delete _info;
+    }
+    _info = NULL;
+    _ownsInfo = false;
+    _ownsData = false;
+}
+
+int Texture2D::getGPUBytes() const
+{
+    auto it = _pixelFormatInfoTables.find(_pixelFormat);
+    if (_textureID == 0 || it == _pixelFormatInfoTables.end())
+    {
+        return 0;
+    }
+
+    const PixelFormatInfo& info = it->second;
+    int bytes = 0;
+    int width = _pixelsWidth;
+    int height = _pixelsHeight;
+    // -1: generateMipmapGL() made the levels down to 1x1
+    for (int i = 0; i < _mipmapsNum || _mipmapsNum == -1; ++i)
+    {
+        int levelWidth = width;
+        int levelHeight = height;
+        if (info.compressed)
+        {
+            // compressed levels are stored in whole 4x4 blocks, PVRTC needs at least 8 pixels a side
+            levelWidth = MAX((levelWidth + 3) & ~3, info.bpp == 2 ? 16 : 8);
+            levelHeight = MAX((levelHeight + 3) & ~3, 8);
+        }
+        bytes += levelWidth * levelHeight * info.bpp / 8;
+
+        if (width == 1 && height == 1)
+        {
+            break;
+        }
+        width = MAX(width >> 1, 1);
+        height = MAX(height >> 1, 1);
+    }
+    return bytes;
+}
+
 /** Gets the pixel format of the texture */
 PixelFormat Texture2D::getPixelFormat() const
 {
@@ -339,12 +443,12 @@ bool Texture2D::loadWithMipmapsGL(MipmapInfo* mipmaps, int mipmapsNum, PixelForm
 
     if(_textureID != 0)
     {
-        glDeleteTextures(1,&_textureID);
+        fkGLDeleteTexture(_textureID);
         _textureID = 0;
     }
 
     glGenTextures(1, &_textureID);
-    glBindTexture(GL_TEXTURE_2D, _textureID);
+    fkGLBindTexture2D(_textureID);
 
     if (mipmapsNum == 1)
     {
@@ -373,6 +477,13 @@ bool Texture2D::loadWithMipmapsGL(MipmapInfo* mipmaps, int mipmapsNum, PixelForm
 
     CHECK_GL_ERROR_DEBUG(); // clean possible GL error
     
+    // ES 3 decodes ETC1 as ETC2, the OES extension may be missing there
+    GLenum internalFormat = info.internalFormat;
+    if (pixelFormat == PixelFormat::ETC && GPUInfo::getInstance()->supportsETC2())
+    {
+        internalFormat = GL_COMPRESSED_RGB8_ETC2_FK;
+    }
+
     // Specify OpenGL texture image
     int width = pixelsWidth;
     int height = pixelsHeight;
@@ -384,7 +495,7 @@ bool Texture2D::loadWithMipmapsGL(MipmapInfo* mipmaps, int mipmapsNum, PixelForm
 
         if (info.compressed)
         {
-            glCompressedTexImage2D(GL_TEXTURE_2D, i, info.internalFormat, (GLsizei)width, (GLsizei)height, 0, datalen, data);
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, (GLsizei)width, (GLsizei)height, 0, datalen, data);
         }
         else
         {
@@ -412,8 +523,6 @@ bool Texture2D::loadWithMipmapsGL(MipmapInfo* mipmaps, int mipmapsNum, PixelForm
     _maxS = 1;
     _maxT = 1;
 
-    _hasPremultipliedAlpha = false;
-
     // shader
     //setGLProgram(GLProgram::SHADER_NAME_POSITION_TEXTURE);
     return true;
@@ -423,7 +532,7 @@ bool Texture2D::updateWithDataGL(const void *data,int offsetX,int offsetY,int wi
 {
     if (_textureID)
     {
-        glBindTexture(GL_TEXTURE_2D,_textureID);
+        fkGLBindTexture2D(_textureID);
         const PixelFormatInfo& info = _pixelFormatInfoTables.at(_pixelFormat);
         glTexSubImage2D(GL_TEXTURE_2D,0,offsetX,offsetY,width,height,info.format, info.type,data);
 
@@ -435,7 +544,7 @@ bool Texture2D::updateWithDataGL(const void *data,int offsetX,int offsetY,int wi
 void Texture2D::generateMipmapGL()
 {
     FKAssert(_pixelsWidth == FK_NextPOT(_pixelsWidth) && _pixelsHeight == FK_NextPOT(_pixelsHeight), "Mipmap texture only works in POT textures");
-    glBindTexture(GL_TEXTURE_2D,_textureID);
+    fkGLBindTexture2D(_textureID);
     glGenerateMipmap(GL_TEXTURE_2D);
     if(_mipmapsNum == 1)
     {
@@ -445,34 +554,135 @@ void Texture2D::generateMipmapGL()
 
 void Texture2D::loadGL()
 {
-    if(_paramDirty)
+    _lastUsedFrame = s_frame;
+
+    bool generateMipmaps = false;
+    if (_evicted)
+    {
+        // TextureManager deleted it to stay within its budget, the image is loaded again
+        _evicted = false;
+        generateMipmaps = (_mipmapsNum == -1);
+        if (!TextureManager::getInstance()->reloadTexture(this))
+        {
+            // the old levels may point into an image that is gone
+            releaseData();
+            _dataDirty = false;
+        }
+    }
+
+    // called for every draw, upload only once
+    if (_dataDirty) {
+        if (loadWithMipmapsGL(_info, _mipmapsNum, _pixelFormat, _pixelsWidth, _pixelsHeight))
+        {
+            _dataDirty = false;
+            if (generateMipmaps)
+            {
+                generateMipmapGL();
+            }
+        }
+    }
+
+    if(_paramDirty && _textureID != 0)
     {
-        glBindTexture( GL_TEXTURE_2D,_textureID );
+        fkGLBindTexture2D(_textureID);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _texParams.minFilter );
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _texParams.magFilter );
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _texParams.wrapS );
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _texParams.wrapT );
+        _paramDirty = false;
     }
-    
-    if (_dataDirty) {
-        loadWithMipmapsGL(_info, _mipmapsNum, _pixelFormat, _pixelsWidth, _pixelsHeight);
+}
+
+bool Texture2D::loadFromUnpackBufferGL(GLintptr offset)
+{
+    if (!_dataDirty)
+    {
+        return true;
     }
+
+    // with a pixel unpack buffer bound the addresses are offsets into it
+    std::vector<MipmapInfo> levels(_mipmapsNum);
+    for (int i = 0; i < _mipmapsNum; ++i)
+    {
+        levels[i].address = (unsigned char*)offset;
+        levels[i].len = _info[i].len;
+        offset += _info[i].len;
+    }
+    if (!loadWithMipmapsGL(levels.data(), _mipmapsNum, _pixelFormat, _pixelsWidth, _pixelsHeight))
+    {
+        return false;
+    }
+    _dataDirty = false;
+    // parameters
+    loadGL();
+    return true;
 }
 
 void Texture2D::deleteGL()
 {
 	if(_textureID)
 	{
-		glDeleteTextures(1,&_textureID);
+		fkGLDeleteTexture(_textureID);
 	}
 	
 	_textureID = 0;
 }
 
+void Texture2D::evictGL()
+{
+	deleteGL();
+	releaseData();
+	_dataDirty = false;
+	_evicted = true;
+}
+
+bool Texture2D::initRenderTargetGL(int pixelsWidth, int pixelsHeight)
+{
+    FKAssert(pixelsWidth > 0 && pixelsHeight > 0, "Invalid size");
+
+    MipmapInfo empty;
+    if (!loadWithMipmapsGL(&empty, 1, PixelFormat::RGBA8888, pixelsWidth, pixelsHeight))
+    {
+        return false;
+    }
+
+    _pixelFormat = PixelFormat::RGBA8888;
+    _pixelsWidth = pixelsWidth;
+    _pixelsHeight = pixelsHeight;
+    _dataDirty = false;
+    _hasPremultipliedAlpha = true;
+    return true;
+}
+
+void Texture2D::invalidateGL(bool managed)
+{
+	_textureID = 0;
+	if (_info == NULL)
+	{
+		// evicted, or a render target that is drawn again
+		return;
+	}
+	// reload from the data still kept in memory, a texture of initWithSize() is allocated again
+	_dataDirty = true;
+	if (!_ownsData && _info->address != NULL)
+	{
+		// the pixels belong to an image that may have been freed or decoded again since
+		if (managed)
+		{
+			_evicted = true;
+			return;
+		}
+		// nobody can load them again, an empty texture is better than reading freed memory
+		FKLOG("Texture2D: the pixels of an unmanaged texture went with the GL context, initialize it again");
+		releaseData();
+		_dataDirty = false;
+	}
+}
+
 void Texture2D::bindGL()
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D,_textureID);
+	_lastUsedFrame = s_frame;
+	fkGLBindTexture2D(_textureID);
 }
 
 const PixelFormatInfoMap& Texture2D::getPixelFormatInfoMap()
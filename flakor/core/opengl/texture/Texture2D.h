@@ -110,6 +110,19 @@ class Texture2D : public Object
     
         MipmapInfo *_info;
         int _mipmapsNum;
+        /** _info was allocated by initWithData(), its pixels were converted from the image */
+        bool _ownsInfo;
+        bool _ownsData;
+
+        /** the frame of the last loadGL() or bindGL(), see getFrame() */
+        unsigned int _lastUsedFrame;
+        /** deleted by evictGL(), the next loadGL() reloads it through TextureManager */
+        bool _evicted;
+
+        static unsigned int s_frame;
+
+        /** frees the pixel data the texture owns */
+        void releaseData();
 
 		/** width in pixels */
 		int _pixelsWidth;
@@ -161,6 +174,9 @@ class Texture2D : public Object
         bool initWithImage(Image * image, PixelFormat format);
     
         bool initWithData(const void *data,ssize_t dataLen,PixelFormat pixelFormat,int width,int height,const Size& size);
+
+        /** a texture without pixel data, the first loadGL() allocates it and updateWithDataGL() fills it */
+        bool initWithSize(PixelFormat pixelFormat, int pixelsWidth, int pixelsHeight);
     
         /** Update with texture data*/
         bool updateWithDataGL(const void *data,int offsetX,int offsetY,int width,int height);
@@ -194,8 +210,26 @@ class Texture2D : public Object
         void setMaxT(GLfloat maxT);
     
         bool hasPremultipliedAlpha();
+        /** for pixels written later with updateWithDataGL(), like the pages of DynamicAtlas */
+        inline void setPremultipliedAlpha(bool premultiplied) { _hasPremultipliedAlpha = premultiplied; }
     
         bool hasMipmaps() const;
+
+        /** true until the pixel data is uploaded */
+        inline bool isDataDirty() const { return _dataDirty; }
+        /** bytes of pixel data of all mipmap levels */
+        int getDataLen() const;
+        /** copies the pixel data of all mipmap levels back to back into dst, getDataLen() bytes */
+        void copyData(unsigned char* dst) const;
+
+        /** bytes the texture takes in video memory, 0 while it isn't uploaded */
+        int getGPUBytes() const;
+        inline unsigned int getLastUsedFrame() const { return _lastUsedFrame; }
+        inline bool isEvicted() const { return _evicted; }
+
+        /** the frame textures stamp when they are used, TextureManager advances it once per frame */
+        static inline unsigned int getFrame() { return s_frame; }
+        static inline void nextFrame() { s_frame++; }
     
     GL_METHOD:
 
@@ -204,11 +238,27 @@ class Texture2D : public Object
 
 		void bindGL();
         void loadGL();
+		/** like loadGL(), but the pixel data comes from the bound GL_PIXEL_UNPACK_BUFFER, laid out by copyData() at offset */
+		bool loadFromUnpackBufferGL(GLintptr offset);
         /** Generates mipmap images for the texture.
     	It only works if the texture size is POT (power of 2).
     	*/
         void generateMipmapGL();
 		void deleteGL();
+		/** deletes the texture and frees its pixel data, the next loadGL() loads the image again */
+		void evictGL();
+
+		/**
+		 * (Re)creates the texture as an empty RGBA8888 render target of the given size, to be attached to a framebuffer.
+		 * What is drawn into it with premultiplied blending is premultiplied.
+		 */
+		bool initRenderTargetGL(int pixelsWidth, int pixelsHeight);
+		/**
+		 * forget the texture name after the GL context was lost, without deleting it.
+		 * The next loadGL() uploads the pixel data the texture owns. A texture showing the data of an image
+		 * is reloaded through TextureManager like an evicted one when it is managed by it, otherwise it is left empty
+		 */
+		void invalidateGL(bool managed = false);
 
 	public:
 		static const PixelFormatInfoMap& getPixelFormatInfoMap();
@@ -6,4 +6,368 @@
 //  Copyright (c) 2015 Saint Hsu. All rights reserved.
 //
 
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "macros.h"
 #include "TextureAtlas.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/GLStateCache.h"
+#include "core/opengl/vbo/VAO.h"
+
+FLAKOR_NS_BEGIN
+
+GLuint TextureAtlas::s_indicesVBO = 0;
+int TextureAtlas::s_indicesCapacity = 0;
+int TextureAtlas::s_generation = 0;
+
+TextureAtlas* TextureAtlas::create(Texture2D* texture, int capacity)
+{
+    TextureAtlas* atlas = new (std::nothrow) TextureAtlas();
+    if (atlas && atlas->initWithTexture(texture, capacity))
+    {
+        atlas->autorelease();
+        return atlas;
+    }
+    FK_SAFE_DELETE(atlas);
+    return nullptr;
+}
+
+TextureAtlas::TextureAtlas()
+: _totalQuads(0)
+, _capacity(0)
+, _texture(nullptr)
+, _quads(nullptr)
+, _bufferVBO(0)
+, _bufferCapacity(0)
+, _bufferGeneration(-1)
+, _vao(nullptr)
+, _dirtyStart(1)
+, _dirtyEnd(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    if (_bufferVBO != 0 && _bufferGeneration == s_generation)
+    {
+        fkGLDeleteBuffer(_bufferVBO);
+    }
+    free(_quads);
+    FK_SAFE_RELEASE(_vao);
+    FK_SAFE_RELEASE(_texture);
+}
+
+bool TextureAtlas::initWithTexture(Texture2D* texture, int capacity)
+{
+    FKAssert(capacity >= 0, "TextureAtlas: capacity must be >= 0");
+
+    setTexture(texture);
+    _totalQuads = 0;
+    return resizeCapacity(capacity);
+}
+
+void TextureAtlas::setTexture(Texture2D* texture)
+{
+    if (_texture != texture)
+    {
+        FK_SAFE_RETAIN(texture);
+        FK_SAFE_RELEASE(_texture);
+        _texture = texture;
+    }
+}
+
+void TextureAtlas::markDirty(int start, int end)
+{
+    if (start > end)
+    {
+        return;
+    }
+
+    if (_dirtyStart > _dirtyEnd)
+    {
+        _dirtyStart = start;
+        _dirtyEnd = end;
+    }
+    else
+    {
+        _dirtyStart = std::min(_dirtyStart, start);
+        _dirtyEnd = std::max(_dirtyEnd, end);
+    }
+}
+
+void TextureAtlas::updateQuad(const V3F_C4F_T2F_Quad* quad, int index)
+{
+    FKAssert(index >= 0 && index < _capacity, "TextureAtlas: updateQuadWithTexture: Invalid index");
+
+    _totalQuads = std::max(index + 1, _totalQuads);
+    _quads[index] = *quad;
+
+    markDirty(index, index);
+}
+
+void TextureAtlas::insertQuad(const V3F_C4F_T2F_Quad* quad, int index)
+{
+    insertQuads(quad, index, 1);
+}
+
+void TextureAtlas::insertQuads(const V3F_C4F_T2F_Quad* quads, int index, int amount)
+{
+    FKAssert(index >= 0 && index <= _totalQuads, "TextureAtlas: insertQuads: Invalid index");
+
+    if (amount <= 0)
+    {
+        return;
+    }
+
+    if (_totalQuads + amount > _capacity)
+    {
+        // grow by a third, like most containers do, to keep appends amortized O(1)
+        int capacity = std::max(_totalQuads + amount, (_capacity + 1) * 4 / 3);
+        capacity = std::min(capacity, (int)MAX_CAPACITY);
+        if (capacity < _totalQuads + amount || !resizeCapacity(capacity))
+        {
+            FKLOG("flakor: TextureAtlas: can't grow capacity to %d quads", _totalQuads + amount);
+            return;
+        }
+    }
+
+    int remaining = _totalQuads - index;
+    if (remaining > 0)
+    {
+        memmove(&_quads[index + amount], &_quads[index], sizeof(_quads[0]) * remaining);
+    }
+    memcpy(&_quads[index], quads, sizeof(_quads[0]) * amount);
+
+    _totalQuads += amount;
+    markDirty(index, _totalQuads - 1);
+}
+
+void TextureAtlas::moveQuad(int oldIndex, int newIndex)
+{
+    FKAssert(oldIndex >= 0 && oldIndex < _totalQuads, "TextureAtlas: moveQuad: Invalid oldIndex");
+    FKAssert(newIndex >= 0 && newIndex < _totalQuads, "TextureAtlas: moveQuad: Invalid newIndex");
+
+    if (oldIndex == newIndex)
+    {
+        return;
+    }
+
+    V3F_C4F_T2F_Quad quad = _quads[oldIndex];
+    if (oldIndex < newIndex)
+    {
+        memmove(&_quads[oldIndex], &_quads[oldIndex + 1], sizeof(_quads[0]) * (newIndex - oldIndex));
+    }
+    else
+    {
+        memmove(&_quads[newIndex + 1], &_quads[newIndex], sizeof(_quads[0]) * (oldIndex - newIndex));
+    }
+    _quads[newIndex] = quad;
+
+    markDirty(std::min(oldIndex, newIndex), std::max(oldIndex, newIndex));
+}
+
+void TextureAtlas::removeQuadAtIndex(int index)
+{
+    removeQuadsAtIndex(index, 1);
+}
+
+void TextureAtlas::removeQuadsAtIndex(int index, int amount)
+{
+    FKAssert(index >= 0 && amount >= 0 && index + amount <= _totalQuads, "TextureAtlas: removeQuadsAtIndex: index + amount out of bounds");
+
+    int remaining = _totalQuads - (index + amount);
+    if (remaining > 0)
+    {
+        memmove(&_quads[index], &_quads[index + amount], sizeof(_quads[0]) * remaining);
+    }
+
+    _totalQuads -= amount;
+    // quads past _totalQuads are never drawn, only the shifted ones need an upload
+    markDirty(index, _totalQuads - 1);
+}
+
+void TextureAtlas::setTotalQuads(int count)
+{
+    FKAssert(count >= 0 && count <= _capacity, "TextureAtlas: setTotalQuads: Invalid count");
+
+    _totalQuads = count;
+    _dirtyStart = 1;
+    _dirtyEnd = 0;
+    markDirty(0, count - 1);
+}
+
+void TextureAtlas::removeAllQuads()
+{
+    _totalQuads = 0;
+    _dirtyStart = 1;
+    _dirtyEnd = 0;
+}
+
+bool TextureAtlas::resizeCapacity(int capacity)
+{
+    FKAssert(capacity >= 0, "TextureAtlas: capacity must be >= 0");
+
+    if (capacity == _capacity && _quads != nullptr)
+    {
+        return true;
+    }
+
+    if (capacity > MAX_CAPACITY)
+    {
+        FKLOG("flakor: TextureAtlas: capacity %d is bigger than %d", capacity, MAX_CAPACITY);
+        return false;
+    }
+
+    // realloc(ptr, 0) may return NULL, keep at least one quad
+    int allocated = std::max(capacity, 1);
+    V3F_C4F_T2F_Quad* quads = (V3F_C4F_T2F_Quad *)realloc(_quads, allocated * sizeof(_quads[0]));
+    if (quads == nullptr)
+    {
+        FKLOG("flakor: TextureAtlas: not enough memory to resize the capacity to %d", capacity);
+        return false;
+    }
+
+    if (capacity > _capacity)
+    {
+        memset(&quads[_capacity], 0, (capacity - _capacity) * sizeof(_quads[0]));
+    }
+
+    _quads = quads;
+    _capacity = capacity;
+    _totalQuads = std::min(_totalQuads, _capacity);
+
+    // the GL buffer is reallocated with the whole content in next draw
+    _dirtyStart = 1;
+    _dirtyEnd = 0;
+
+    return true;
+}
+
+void TextureAtlas::invalidateSharedGL()
+{
+    // the handles died with the context, don't delete them
+    s_indicesVBO = 0;
+    s_indicesCapacity = 0;
+    s_generation++;
+}
+
+void TextureAtlas::setupSharedIndicesGL(int capacity)
+{
+    if (s_indicesVBO != 0 && s_indicesCapacity >= capacity)
+    {
+        return;
+    }
+
+    // round up so a few growing atlases don't rebuild the buffer every time
+    int newCapacity = 256;
+    while (newCapacity < capacity)
+    {
+        newCapacity <<= 1;
+    }
+    newCapacity = std::min(newCapacity, (int)MAX_CAPACITY);
+
+    GLushort* indices = (GLushort *)malloc(newCapacity * 6 * sizeof(GLushort));
+    for (int i = 0; i < newCapacity; i++)
+    {
+        indices[i*6+0] = (GLushort)(i*4+0);
+        indices[i*6+1] = (GLushort)(i*4+1);
+        indices[i*6+2] = (GLushort)(i*4+2);
+        indices[i*6+3] = (GLushort)(i*4+3);
+        indices[i*6+4] = (GLushort)(i*4+2);
+        indices[i*6+5] = (GLushort)(i*4+1);
+    }
+
+    if (s_indicesVBO == 0)
+    {
+        glGenBuffers(1, &s_indicesVBO);
+    }
+    fkGLBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_indicesVBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, newCapacity * 6 * sizeof(GLushort), indices, GL_STATIC_DRAW);
+
+    free(indices);
+    s_indicesCapacity = newCapacity;
+}
+
+void TextureAtlas::setupVBOGL()
+{
+    if (_bufferVBO != 0 && _bufferGeneration == s_generation)
+    {
+        fkGLDeleteBuffer(_bufferVBO);
+    }
+
+    glGenBuffers(1, &_bufferVBO);
+    if (_vao != nullptr)
+    {
+        _vao->setDirty();
+    }
+    fkGLBindBuffer(GL_ARRAY_BUFFER, _bufferVBO);
+    glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(_quads[0]), _quads, GL_DYNAMIC_DRAW);
+
+    _bufferCapacity = _capacity;
+    _bufferGeneration = s_generation;
+    _dirtyStart = 1;
+    _dirtyEnd = 0;
+}
+
+void TextureAtlas::uploadDirtyGL()
+{
+    fkGLBindBuffer(GL_ARRAY_BUFFER, _bufferVBO);
+
+    if (_dirtyStart > _dirtyEnd)
+    {
+        return;
+    }
+
+    int end = std::min(_dirtyEnd, _totalQuads - 1);
+    if (_dirtyStart <= end)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, _dirtyStart * sizeof(_quads[0]),
+                (end - _dirtyStart + 1) * sizeof(_quads[0]), &_quads[_dirtyStart]);
+    }
+
+    _dirtyStart = 1;
+    _dirtyEnd = 0;
+}
+
+void TextureAtlas::drawQuadsGL()
+{
+    drawQuadsGL(_totalQuads, 0);
+}
+
+void TextureAtlas::drawQuadsGL(int count, int start)
+{
+    if (count <= 0 || _texture == nullptr)
+    {
+        return;
+    }
+
+    FKAssert(start >= 0 && start + count <= _totalQuads, "TextureAtlas: drawQuadsGL: range out of bounds");
+
+    _texture->loadGL();
+    fkGLBindTexture2D(_texture->getTextureID());
+
+    if (_bufferVBO == 0 || _bufferGeneration != s_generation || _bufferCapacity != _capacity)
+    {
+        setupVBOGL();
+    }
+    else
+    {
+        uploadDirtyGL();
+    }
+    setupSharedIndicesGL(_capacity);
+
+    if (_vao == nullptr)
+    {
+        _vao = VAO::createPosColorTex();
+        FK_SAFE_RETAIN(_vao);
+    }
+    // specified once per buffer, the attributes are only set up again without VAO support
+    _vao->bind(_bufferVBO, s_indicesVBO);
+    glDrawElements(GL_TRIANGLES, (GLsizei)count * 6, GL_UNSIGNED_SHORT, (GLvoid*)(start * 6 * sizeof(GLushort)));
+    VAO::unbind();
+}
+
+FLAKOR_NS_END
@@ -10,27 +10,118 @@
 #define _FK_TEXTUREATLATS_
 
 #include "base/lang/Object.h"
+#include "core/opengl/GL.h"
+#include "core/opengl/renderer/RenderTypes.h"
 
 FLAKOR_NS_BEGIN
 
 class Texture2D;
+class VAO;
 
+/**
+ * TextureAtlas keeps an array of quads that share one texture and draws them with one glDrawElements.
+ *
+ * - quads live in a client side array and in a GL vertex buffer of the same capacity
+ * - only the range of quads touched since the last draw is uploaded (glBufferSubData)
+ * - the index buffer (0,1,2,3,2,1 per quad) never changes, one buffer is shared by every atlas
+ *
+ * The capacity grows on demand, but a quad index must fit in GLushort so it is limited to MAX_CAPACITY.
+ */
 class TextureAtlas : public Object
 {
 public:
+    /** indices are GLushort, 4 vertices per quad */
+    static const int MAX_CAPACITY = 65536 / 4;
+
+    /** creates an atlas with a texture and room for capacity quads */
+    static TextureAtlas* create(Texture2D* texture, int capacity);
+
     TextureAtlas();
-    ~TextureAtlas();
-    
+    virtual ~TextureAtlas();
+
+    /** initializes an atlas with a texture and room for capacity quads, the texture is retained */
+    bool initWithTexture(Texture2D* texture, int capacity);
+
+    /** overwrite the quad at index, index must be < totalQuads, or == totalQuads to append */
+    void updateQuad(const V3F_C4F_T2F_Quad* quad, int index);
+
+    /** insert a quad at index, the quads after it are moved one position. Capacity grows if needed */
+    void insertQuad(const V3F_C4F_T2F_Quad* quad, int index);
+
+    /** insert amount quads at index */
+    void insertQuads(const V3F_C4F_T2F_Quad* quads, int index, int amount);
+
+    /** move the quad at oldIndex to newIndex, the quads in between are shifted */
+    void moveQuad(int oldIndex, int newIndex);
+
+    /** remove the quad at index, the quads after it are moved one position */
+    void removeQuadAtIndex(int index);
+
+    /** remove amount quads starting at index */
+    void removeQuadsAtIndex(int index, int amount);
+
+    /** remove every quad, the capacity is kept */
+    void removeAllQuads();
+
+    /**
+     * Change the capacity, quads beyond the new capacity are dropped.
+     * @return false if out of memory or capacity is larger than MAX_CAPACITY
+     */
+    bool resizeCapacity(int capacity);
+
+    /** mark quads [start, end] for upload, use it after writing through getQuads() */
+    void markDirty(int start, int end);
+
+    /** the first count quads were all written through getQuads(), draw and upload exactly those */
+    void setTotalQuads(int count);
+
+    inline int getTotalQuads() const { return _totalQuads; }
+    inline int getCapacity() const { return _capacity; }
+    inline Texture2D* getTexture() const { return _texture; }
+    void setTexture(Texture2D* texture);
+
+    /** quads for reading, call markDirty() for any quad you change */
+    inline V3F_C4F_T2F_Quad* getQuads() { return _quads; }
+
+    /** forget every atlas' GL buffers after the GL context was lost, they are created again when drawn */
+    static void invalidateSharedGL();
+
+GL_METHOD:
+    /** upload the dirty range and draw all the quads */
+    void drawQuadsGL();
+
+    /** upload the dirty range and draw count quads starting at start */
+    void drawQuadsGL(int count, int start);
+
 protected:
+    void setupVBOGL();
+    void uploadDirtyGL();
+    static void setupSharedIndicesGL(int capacity);
+
     /** quantity of quads that are going to be drawn */
-    size_t _totalQuads;
+    int _totalQuads;
     /** quantity of quads that can be stored with the current texture atlas size */
-    size_t _capacity;
+    int _capacity;
     /** Texture of the texture atlas */
     Texture2D* _texture;
     /** Quads that are going to be rendered */
-    V3F_C4B_T2F_Quad* _quads;
-    
+    V3F_C4F_T2F_Quad* _quads;
+
+    /** vertex buffer, its size is _bufferCapacity quads */
+    GLuint _bufferVBO;
+    int _bufferCapacity;
+    /** context generation the buffer belongs to, see invalidateSharedGL() */
+    int _bufferGeneration;
+    /** quad layout over _bufferVBO and the shared indices, created on the first draw */
+    VAO* _vao;
+
+    /** dirty range of quads, empty when _dirtyStart > _dirtyEnd */
+    int _dirtyStart;
+    int _dirtyEnd;
+
+    static GLuint s_indicesVBO;
+    static int s_indicesCapacity;
+    static int s_generation;
 };
 
 
@@ -0,0 +1,296 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+
+#include "macros.h"
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureRegion.h"
+#include "core/opengl/texture/DynamicAtlas.h"
+#include "core/opengl/texture/TextureUploader.h"
+#include "core/resource/ResourceManager.h"
+#include "core/resource/Image.h"
+
+FLAKOR_NS_BEGIN
+
+TextureManager* TextureManager::s_sharedTextureManager = nullptr;
+
+TextureManager* TextureManager::getInstance()
+{
+	if (s_sharedTextureManager == nullptr)
+	{
+		s_sharedTextureManager = new (std::nothrow) TextureManager();
+	}
+	return s_sharedTextureManager;
+}
+
+void TextureManager::destroyInstance()
+{
+	FK_SAFE_DELETE(s_sharedTextureManager);
+}
+
+TextureManager::TextureManager()
+: _textures()
+, _budget(DEFAULT_BUDGET)
+{
+}
+
+TextureManager::~TextureManager()
+{
+	for (auto& entry : _textures)
+	{
+		entry.second->release();
+	}
+	_textures.clear();
+}
+
+Texture2D* TextureManager::getTexture(const std::string& uri)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _textures.find(uri);
+	return it != _textures.end() ? it->second : nullptr;
+}
+
+Texture2D* TextureManager::loadTexture(const std::string& uri)
+{
+	Texture2D* texture = getTexture(uri);
+	if (texture != nullptr)
+	{
+		return texture;
+	}
+
+	Image* image = loadImage(uri);
+	if (image == nullptr)
+	{
+		return nullptr;
+	}
+	return createTexture(uri, image);
+}
+
+TextureRegion* TextureManager::loadRegion(const std::string& uri)
+{
+	// preloaded, or too large for the atlas
+	Texture2D* texture = getTexture(uri);
+	if (texture == nullptr)
+	{
+		DynamicAtlas* atlas = DynamicAtlas::getInstance();
+		TextureRegion* region = atlas->getRegion(uri);
+		if (region != nullptr)
+		{
+			return region;
+		}
+
+		Image* image = loadImage(uri);
+		if (image == nullptr)
+		{
+			return nullptr;
+		}
+		region = atlas->addImage(uri, image);
+		if (region != nullptr)
+		{
+			return region;
+		}
+		texture = createTexture(uri, image);
+		if (texture == nullptr)
+		{
+			return nullptr;
+		}
+	}
+
+	Rect rect = RectZero;
+	rect.size = texture->getContentSize();
+	return TextureRegion::createWithTexture(texture, rect);
+}
+
+Image* TextureManager::loadImage(const std::string& uri)
+{
+	Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource(uri.c_str(), ResourceManager::IMAGE_NAME));
+	if (image == nullptr)
+	{
+		return nullptr;
+	}
+	// a preload of SceneTransition may be decoding it on a loader thread, that load is waited for and reused,
+	// decoded before by a preload that hasn't reached the GPU yet is used as it is
+	if (ResourceManager::thisManager()->waitForLoad(image) != LOADED || image->getData() == nullptr)
+	{
+		image->load(false);
+	}
+	return image;
+}
+
+Texture2D* TextureManager::createTexture(const std::string& uri, Image* image)
+{
+	Texture2D* texture = new (std::nothrow) Texture2D();
+	if (texture == nullptr)
+	{
+		return nullptr;
+	}
+	if (!texture->initWithImage(image))
+	{
+		FKLOG("TextureManager: can't create a texture from %s", uri.c_str());
+		texture->release();
+		return nullptr;
+	}
+	addTexture(uri, texture);
+	// the manager keeps the only reference
+	texture->release();
+	return texture;
+}
+
+void TextureManager::addTexture(const std::string& uri, Texture2D* texture)
+{
+	FKAssert(texture != nullptr, "TextureManager: texture can't be NULL");
+	std::lock_guard<std::mutex> lock(_mutex);
+	texture->retain();
+	Texture2D*& cached = _textures[uri];
+	if (cached != nullptr)
+	{
+		cached->release();
+	}
+	cached = texture;
+}
+
+void TextureManager::removeTexture(const std::string& uri)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto it = _textures.find(uri);
+	if (it != _textures.end())
+	{
+		it->second->release();
+		_textures.erase(it);
+	}
+}
+
+void TextureManager::removeUnusedTextures()
+{
+	DynamicAtlas::getInstance()->removeUnusedRegions();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto it = _textures.begin(); it != _textures.end();)
+	{
+		if (it->second->retainCount() == 1)
+		{
+			it->second->release();
+			it = _textures.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+int TextureManager::getGPUBytes()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	int bytes = 0;
+	for (auto& entry : _textures)
+	{
+		bytes += entry.second->getGPUBytes();
+	}
+	return bytes;
+}
+
+void TextureManager::enforceBudgetGL()
+{
+	unsigned int frame = Texture2D::getFrame();
+	// the commands drawn from here on stamp the next frame
+	Texture2D::nextFrame();
+	if (_budget <= 0)
+	{
+		return;
+	}
+
+	TextureUploader* uploader = TextureUploader::getInstance();
+	std::vector<std::pair<std::string, Texture2D*> > victims;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		int bytes = 0;
+		for (auto& entry : _textures)
+		{
+			int textureBytes = entry.second->getGPUBytes();
+			bytes += textureBytes;
+			// the commands of this frame were visited with it, a worker of TextureUploader may still read its data
+			if (textureBytes > 0 && entry.second->getLastUsedFrame() != frame && !uploader->isCopying(entry.second))
+			{
+				victims.push_back(std::make_pair(entry.first, entry.second));
+			}
+		}
+		if (bytes <= _budget)
+		{
+			return;
+		}
+
+		std::sort(victims.begin(), victims.end(), [](const std::pair<std::string, Texture2D*>& a, const std::pair<std::string, Texture2D*>& b) {
+			return a.second->getLastUsedFrame() < b.second->getLastUsedFrame();
+		});
+		size_t count = 0;
+		while (count < victims.size() && bytes > _budget)
+		{
+			bytes -= victims[count++].second->getGPUBytes();
+		}
+		victims.resize(count);
+	}
+
+	// DynamicAtlas locks on its own, outside of the manager
+	for (size_t i = 0; i < victims.size(); i++)
+	{
+		const std::string& uri = victims[i].first;
+		victims[i].second->evictGL();
+		FKLOG("TextureManager: evicted %s, over the budget of %d bytes", uri.c_str(), _budget);
+
+		// the atlas copies its images into its pages again after the context was lost
+		if (DynamicAtlas::getInstance()->getRegion(uri) == nullptr)
+		{
+			Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource(uri.c_str(), ResourceManager::IMAGE_NAME));
+			if (image != nullptr)
+			{
+				image->releaseData();
+			}
+		}
+	}
+}
+
+void TextureManager::invalidateGL()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto& entry : _textures)
+	{
+		entry.second->invalidateGL(true);
+	}
+}
+
+bool TextureManager::reloadTexture(Texture2D* texture)
+{
+	std::string uri;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto& entry : _textures)
+		{
+			if (entry.second == texture)
+			{
+				uri = entry.first;
+				break;
+			}
+		}
+	}
+	if (uri.empty())
+	{
+		return false;
+	}
+
+	Image* image = loadImage(uri);
+	if (image == nullptr || !texture->initWithImage(image))
+	{
+		FKLOG("TextureManager: can't reload the texture of %s", uri.c_str());
+		return false;
+	}
+	return true;
+}
+
+FLAKOR_NS_END
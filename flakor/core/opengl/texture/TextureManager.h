@@ -1,25 +1,93 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
 #ifndef _FK_TEXUREMANAGER_H_
 #define _FK_TEXUREMANAGER_H_
 
-#include <set>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#include "targetMacros.h"
 
 FLAKOR_NS_BEGIN
 
+class Texture2D;
+class TextureRegion;
+class Image;
+
+/**
+ * TextureManager = 纹理缓存，同一个uri只创建一个Texture2D
+ *
+ * Entities created from a file name (Sprite::create("asset://...") and friends) take their texture
+ * from here, so a texture that was preloaded (see SceneTransition) is found instead of decoding
+ * the image again. Sprites ask loadRegion(), which packs small images into DynamicAtlas instead.
+ * The manager holds one reference on every texture it caches.
+ * Textures are deleted on the GL thread, call removeTexture() and removeUnusedTextures() from there.
+ *
+ * The cached textures are kept within a budget of video memory. Once per frame enforceBudgetGL()
+ * adds up their bytes and, while they are over the budget, evicts the least recently used ones that
+ * weren't drawn in the frame: the texture is deleted and its decoded image freed. The Texture2D object
+ * stays where it is, its next loadGL() decodes the image through ResourceManager and uploads it again.
+ * The pages of DynamicAtlas aren't counted, setMaxPages() caps them.
+ */
 class TextureManager
 {
 	public:
+		/** bytes of video memory of a new manager */
+		static const int DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+		static TextureManager* getInstance();
+		static void destroyInstance();
+
+		/** 0 turns eviction off */
+		inline void setBudget(int bytes) { _budget = bytes; }
+		inline int getBudget() const { return _budget; }
+		/** bytes of video memory the cached textures take */
+		int getGPUBytes();
+
+		/** the cached texture of uri, the image is loaded synchronously when it isn't cached yet */
+		Texture2D* loadTexture(const std::string& uri);
+		/**
+		 * the region showing uri: a texture cached here, or else a small image packed into a page of DynamicAtlas,
+		 * or else a new texture cached here. NULL when the image can't be loaded
+		 */
+		TextureRegion* loadRegion(const std::string& uri);
+		/** the cached texture of uri or NULL */
+		Texture2D* getTexture(const std::string& uri);
+		/** caches texture under uri, replaces the texture cached there before */
+		void addTexture(const std::string& uri, Texture2D* texture);
+
+		void removeTexture(const std::string& uri);
+		/** releases the textures that nothing but the manager holds, and the unused regions of DynamicAtlas */
+		void removeUnusedTextures();
+
+	GL_METHOD:
+		/** evicts the least recently used textures until the cached ones fit the budget, Renderer::render() runs it every frame */
+		void enforceBudgetGL();
+		/** initializes an evicted texture from its image again, its loadGL() calls this */
+		bool reloadTexture(Texture2D* texture);
+		/** forgets the names of the cached textures after the GL context was lost, Renderer::invalidateGL() runs it */
+		void invalidateGL();
 
-		loadTexture(Texture2D* texture);
-		reloadTexture();
-		unloadTexture(Texture2D* texture);
 	protected:
+		TextureManager();
+		~TextureManager();
+
+		/** the image of uri, decoded synchronously when it isn't yet, waits for a decode already running on a loader thread */
+		Image* loadImage(const std::string& uri);
+		/** caches a texture of image under uri */
+		Texture2D* createTexture(const std::string& uri, Image* image);
 
 		std::unordered_map<std::string, Texture2D*> _textures;
+		int _budget;
+		// SceneTransition builds scenes and adds its preloads on the GL thread, the update thread may load textures meanwhile
+		std::mutex _mutex;
 
-		std::set<Texture2D> texturesLoaded;
-		std::set<Texture2D> texturesToBeLoaded;
-		std::set<Texture2D> texturesToUnloaded;
-}
+		static TextureManager* s_sharedTextureManager;
+};
 
 FLAKOR_NS_END
 
@@ -22,7 +22,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ****************************************************************************/
 #include "targetMacros.h"
-#include "2d/TextureRegion.h"
+#include "macros.h"
+#include "core/opengl/texture/TextureRegion.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/TextureManager.h"
 
 FLAKOR_NS_BEGIN
 
@@ -30,38 +33,50 @@ FLAKOR_NS_BEGIN
 
 TextureRegion* TextureRegion::create(const std::string& filename, const Rect& rect)
 {
-    TextureRegion *TextureRegion = new (std::nothrow) TextureRegion();
-    TextureRegion->initWithTextureFilename(filename, rect);
-    TextureRegion->autorelease();
-
-    return TextureRegion;
+    TextureRegion *region = new (std::nothrow) TextureRegion();
+    if (region && region->initWithTextureFilename(filename, rect))
+    {
+        region->autorelease();
+        return region;
+    }
+    FK_SAFE_DELETE(region);
+    return nullptr;
 }
 
 TextureRegion* TextureRegion::createWithTexture(Texture2D *texture, const Rect& rect)
 {
-    TextureRegion *TextureRegion = new (std::nothrow) TextureRegion();
-    TextureRegion->initWithTexture(texture, rect);
-    TextureRegion->autorelease();
-    
-    return TextureRegion;
+    TextureRegion *region = new (std::nothrow) TextureRegion();
+    if (region && region->initWithTexture(texture, rect))
+    {
+        region->autorelease();
+        return region;
+    }
+    FK_SAFE_DELETE(region);
+    return nullptr;
 }
 
 TextureRegion* TextureRegion::createWithTexture(Texture2D* texture, const Rect& rect, bool rotated, const Point& offset, const Size& originalSize)
 {
-    TextureRegion *TextureRegion = new (std::nothrow) TextureRegion();
-    TextureRegion->initWithTexture(texture, rect, rotated, offset, originalSize);
-    TextureRegion->autorelease();
-
-    return TextureRegion;
+    TextureRegion *region = new (std::nothrow) TextureRegion();
+    if (region && region->initWithTexture(texture, rect, rotated, offset, originalSize))
+    {
+        region->autorelease();
+        return region;
+    }
+    FK_SAFE_DELETE(region);
+    return nullptr;
 }
 
 TextureRegion* TextureRegion::create(const std::string& filename, const Rect& rect, bool rotated, const Point& offset, const Size& originalSize)
 {
-    TextureRegion *TextureRegion = new (std::nothrow) TextureRegion();
-    TextureRegion->initWithTextureFilename(filename, rect, rotated, offset, originalSize);
-    TextureRegion->autorelease();
-
-    return TextureRegion;
+    TextureRegion *region = new (std::nothrow) TextureRegion();
+    if (region && region->initWithTextureFilename(filename, rect, rotated, offset, originalSize))
+    {
+        region->autorelease();
+        return region;
+    }
+    FK_SAFE_DELETE(region);
+    return nullptr;
 }
 
 TextureRegion::TextureRegion(void)
@@ -184,7 +199,7 @@ Texture2D* TextureRegion::getTexture(void)
     }
 
     if( _textureFilename.length() > 0 ) {
-        return Director::getInstance()->getTextureCache()->addImage(_textureFilename.c_str());
+        return TextureManager::getInstance()->loadTexture(_textureFilename);
     }
     // no texture or texture filename
     return NULL;
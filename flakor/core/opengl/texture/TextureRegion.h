@@ -25,7 +25,9 @@ THE SOFTWARE.
 #ifndef _FK_TEXTUREREGION_H_
 #define _FK_TEXTUREREGION_H_
 
-#include "2d/Entity.h"
+#include <string>
+
+#include "base/lang/Object.h"
 #include "base/element/Element.h"
 
 FLAKOR_NS_BEGIN
@@ -104,7 +106,7 @@ public:
     void setTexture(Texture2D* pobTexture);
 
     const Point& getOffset(void) const;
-    void setOffset(const Vec2& offsets);
+    void setOffset(const Point& offsets);
 
     // Overrides
 	virtual TextureRegion *clone() const override;
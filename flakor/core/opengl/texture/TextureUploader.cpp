@@ -0,0 +1,297 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+
+#include <stdint.h>
+
+#include "targetMacros.h"
+#include "macros.h"
+#include "core/opengl/texture/TextureUploader.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/GLStateCache.h"
+#include "2d/Entity.h"
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+#include "core/opengl/GLContext.h"
+// loaded by gl3stubInit(), gl3stub.h itself clashes with the OES macros of GL.h
+#undef glUnmapBuffer
+extern "C" {
+extern GL_APICALL GLvoid* (* GL_APIENTRY glMapBufferRange) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+extern GL_APICALL GLboolean (* GL_APIENTRY glUnmapBuffer) (GLenum target);
+extern GL_APICALL struct __GLsync* (* GL_APIENTRY glFenceSync) (GLenum condition, GLbitfield flags);
+extern GL_APICALL GLenum (* GL_APIENTRY glClientWaitSync) (struct __GLsync* sync, GLbitfield flags, uint64_t timeout);
+extern GL_APICALL void (* GL_APIENTRY glDeleteSync) (struct __GLsync* sync);
+}
+#endif
+
+#define GL_PIXEL_UNPACK_BUFFER_FK           0x88EC
+#define GL_MAP_WRITE_BIT_FK                 0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT_FK     0x0008
+#define GL_SYNC_GPU_COMMANDS_COMPLETE_FK    0x9117
+#define GL_TIMEOUT_EXPIRED_FK               0x911B
+
+FLAKOR_NS_BEGIN
+
+TextureUploader* TextureUploader::s_sharedTextureUploader = nullptr;
+
+TextureUploader* TextureUploader::getInstance()
+{
+	if (s_sharedTextureUploader == nullptr)
+	{
+		s_sharedTextureUploader = new (std::nothrow) TextureUploader();
+	}
+	return s_sharedTextureUploader;
+}
+
+void TextureUploader::destroyInstance()
+{
+	FK_SAFE_DELETE(s_sharedTextureUploader);
+}
+
+TextureUploader::TextureUploader()
+: _queue()
+, _mapped()
+, _inFlight()
+, _budget(DEFAULT_BUDGET)
+, _pixelBuffers(-1)
+{
+}
+
+TextureUploader::~TextureUploader()
+{
+	// the callbacks won't run anymore, the GL objects go with the context
+	for (size_t i = 0; i < _queue.size(); i++)
+	{
+		_queue[i].texture->release();
+	}
+	for (size_t i = 0; i < _mapped.size(); i++)
+	{
+		JobSystem::getInstance()->wait(&_mapped[i].copy->counter);
+		delete _mapped[i].copy;
+		_mapped[i].texture->release();
+	}
+	for (size_t i = 0; i < _inFlight.size(); i++)
+	{
+		_inFlight[i].texture->release();
+	}
+}
+
+void TextureUploader::upload(Texture2D* texture, const Callback& callback)
+{
+	FKAssert(texture != nullptr, "TextureUploader: texture can't be NULL");
+
+	Upload upload;
+	upload.texture = texture;
+	upload.callback = callback;
+	upload.buffer = 0;
+	upload.copy = nullptr;
+	upload.fence = nullptr;
+	texture->retain();
+	_queue.push_back(upload);
+
+	// updateGL() runs from Renderer::render(), make sure there is a next frame
+	Entity::markSceneDirty();
+}
+
+bool TextureUploader::usesPixelBuffers()
+{
+	if (_pixelBuffers < 0)
+	{
+		bool supported = false;
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+		supported = GLContext::GetInstance()->GetGLVersion() >= 3.0f
+			&& glMapBufferRange != NULL && glUnmapBuffer != NULL
+			&& glFenceSync != NULL && glClientWaitSync != NULL && glDeleteSync != NULL;
+#endif
+		_pixelBuffers = supported ? 1 : 0;
+		FKLOG("flakor: texture uploads %s", supported ? "through pixel unpack buffers" : "direct");
+	}
+	return _pixelBuffers == 1;
+}
+
+void TextureUploader::updateGL()
+{
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+	// transfers the GPU finished, their buffers can go
+	for (size_t i = 0; i < _inFlight.size();)
+	{
+		Upload& upload = _inFlight[i];
+		if (glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED_FK)
+		{
+			i++;
+			continue;
+		}
+		glDeleteSync(upload.fence);
+		fkGLDeleteBuffer(upload.buffer);
+		complete(upload);
+		_inFlight.erase(_inFlight.begin() + i);
+	}
+#endif
+
+	// buffers mapped in an earlier frame whose copy is done, upload from them
+	for (size_t i = 0; i < _mapped.size();)
+	{
+		Upload& upload = _mapped[i];
+		if (upload.copy->counter.pending.load() > 0)
+		{
+			i++;
+			continue;
+		}
+		Upload staged = upload;
+		_mapped.erase(_mapped.begin() + i);
+		if (stageGL(staged))
+		{
+			_inFlight.push_back(staged);
+			continue;
+		}
+		staged.texture->loadGL();
+		complete(staged);
+	}
+
+	int spent = 0;
+	while (!_queue.empty() && (spent == 0 || spent < _budget))
+	{
+		Upload upload = _queue.front();
+		_queue.pop_front();
+
+		Texture2D* texture = upload.texture;
+		if (texture->isDataDirty())
+		{
+			spent += texture->getDataLen();
+			if (usesPixelBuffers() && mapGL(upload))
+			{
+				_mapped.push_back(upload);
+				continue;
+			}
+			texture->loadGL();
+		}
+		// uploaded directly, or drawn and loaded before its turn
+		complete(upload);
+	}
+
+	if (isBusy())
+	{
+		Entity::markSceneDirty();
+	}
+}
+
+bool TextureUploader::isCopying(Texture2D* texture) const
+{
+	for (size_t i = 0; i < _mapped.size(); i++)
+	{
+		if (_mapped[i].texture == texture)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void TextureUploader::copyJob(void* data)
+{
+	Copy* copy = (Copy*)data;
+	copy->texture->copyData(copy->dst);
+}
+
+bool TextureUploader::mapGL(Upload& upload)
+{
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+	Texture2D* texture = upload.texture;
+	int len = texture->getDataLen();
+	if (len <= 0)
+	{
+		return false;
+	}
+
+	glGenBuffers(1, &upload.buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER_FK, upload.buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER_FK, len, NULL, GL_STREAM_DRAW);
+	void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER_FK, 0, len, GL_MAP_WRITE_BIT_FK | GL_MAP_INVALIDATE_BUFFER_BIT_FK);
+	// the buffer stays mapped while unbound, glTexImage2D of other textures reads client memory meanwhile
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER_FK, 0);
+	if (dst == NULL)
+	{
+		fkGLDeleteBuffer(upload.buffer);
+		upload.buffer = 0;
+		return false;
+	}
+
+	// the copy of a big texture takes longer than the frame should, a worker does it
+	upload.copy = new Copy();
+	upload.copy->texture = texture;
+	upload.copy->dst = (unsigned char*)dst;
+	JobSystem::getInstance()->run(&TextureUploader::copyJob, upload.copy, &upload.copy->counter);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool TextureUploader::stageGL(Upload& upload)
+{
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+	delete upload.copy;
+	upload.copy = nullptr;
+
+	Texture2D* texture = upload.texture;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER_FK, upload.buffer);
+	// drawn before its turn: loadFromUnpackBufferGL() has nothing to do and the fence signals right away
+	bool loaded = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_FK) == GL_TRUE
+		&& texture->loadFromUnpackBufferGL(0);
+	// while it is bound every glTexImage2D reads from the buffer instead of client memory
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER_FK, 0);
+
+	if (loaded)
+	{
+		upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE_FK, 0);
+		if (upload.fence != nullptr)
+		{
+			return true;
+		}
+	}
+
+	// the driver keeps a deleted buffer until the transfer read it
+	fkGLDeleteBuffer(upload.buffer);
+	upload.buffer = 0;
+	return false;
+#else
+	return false;
+#endif
+}
+
+void TextureUploader::complete(const Upload& upload)
+{
+	// upload is an element of a queue, the callback may queue another one before the release
+	Texture2D* texture = upload.texture;
+	Callback callback = upload.callback;
+	if (callback)
+	{
+		callback(texture);
+	}
+	texture->release();
+	// the texture usually shows up on screen
+	Entity::markSceneDirty();
+}
+
+void TextureUploader::invalidateGL()
+{
+	// the new context may have another version
+	_pixelBuffers = -1;
+	// the mappings went with the context, nothing may write into them after this returns
+	for (size_t i = 0; i < _mapped.size(); i++)
+	{
+		JobSystem::getInstance()->wait(&_mapped[i].copy->counter);
+		delete _mapped[i].copy;
+		complete(_mapped[i]);
+	}
+	_mapped.clear();
+	for (size_t i = 0; i < _inFlight.size(); i++)
+	{
+		complete(_inFlight[i]);
+	}
+	_inFlight.clear();
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,116 @@
+/****************************************************************************
+Copyright (c) 2013-2014 Saint Hsu(saint@aliyun.com)
+
+http://www.flakor.org
+****************************************************************************/
+#ifndef _FK_TEXTUREUPLOADER_H_
+#define _FK_TEXTUREUPLOADER_H_
+
+#include <deque>
+#include <vector>
+#include <functional>
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+#include "base/update/JobSystem.h"
+
+FLAKOR_NS_BEGIN
+
+class Texture2D;
+
+/**
+ * TextureUploader moves the glTexImage2D of new textures out of the frame that needs them.
+ *
+ * upload() queues a texture whose pixel data is in memory. updateGL(), run by Renderer::render()
+ * at the start of every frame, uploads no more than the budget of bytes per frame (but at least
+ * one texture, so big ones get through) and keeps frames coming until the queue is empty.
+ *
+ * With OpenGL ES 3 an upload goes through a pixel unpack buffer in three steps spread over frames:
+ * updateGL() maps the buffer and a JobSystem worker copies the pixel data into it, a later updateGL()
+ * unmaps it and issues glTexImage2D from the buffer, the driver transfers it while the frames go on
+ * and a fence tells when it is done. Without ES 3 the texture is uploaded directly, still within
+ * the budget. Either way the callback of upload() runs inside updateGL() on the GL thread once the
+ * upload completed.
+ *
+ * A texture is usable as soon as updateGL() issued its upload. Drawing it before that uploads it
+ * right there with loadGL(), as without the uploader. Its pixel data has to stay valid until then,
+ * TextureManager doesn't evict a texture while isCopying() it.
+ */
+class TextureUploader
+{
+	public:
+		typedef std::function<void(Texture2D*)> Callback;
+
+		/** bytes per frame of a new uploader */
+		static const int DEFAULT_BUDGET = 2 * 1024 * 1024;
+
+		static TextureUploader* getInstance();
+		static void destroyInstance();
+
+		inline void setBudget(int bytesPerFrame) { _budget = bytesPerFrame; }
+		inline int getBudget() const { return _budget; }
+
+		/** whether textures are queued or in flight */
+		inline bool isBusy() const { return !_queue.empty() || !_mapped.empty() || !_inFlight.empty(); }
+		/** whether a worker may still read the pixel data of texture */
+		bool isCopying(Texture2D* texture) const;
+
+	GL_METHOD:
+		/** queues texture, it is retained until callback ran */
+		void upload(Texture2D* texture, const Callback& callback = nullptr);
+
+		/** completes the uploads whose fence signaled, then uploads from the queue within the budget */
+		void updateGL();
+
+		/** forget buffers and fences after the GL context was lost, waits for the copies, the uploads in flight complete */
+		void invalidateGL();
+
+	protected:
+		TextureUploader();
+		~TextureUploader();
+
+		/** the job of a worker, copies the pixel data into the mapped buffer */
+		struct Copy
+		{
+			Texture2D* texture;
+			unsigned char* dst;
+			JobSystem::Counter counter;
+		};
+
+		struct Upload
+		{
+			Texture2D* texture;
+			Callback callback;
+			/** pixel unpack buffer, mapped and in flight only */
+			GLuint buffer;
+			/** mapped only, deleted once the buffer is unmapped */
+			Copy* copy;
+			/** in flight only */
+			struct __GLsync* fence;
+		};
+
+		static void copyJob(void* data);
+
+		/** whether uploads go through pixel unpack buffers, checked once */
+		bool usesPixelBuffers();
+		/** maps a pixel unpack buffer and hands the copy to a worker, false when the texture has to be loaded directly */
+		bool mapGL(Upload& upload);
+		/** unmaps the filled buffer and uploads from it, false when the texture has to be loaded directly */
+		bool stageGL(Upload& upload);
+		/** runs the callback and releases the texture, called on the GL thread */
+		void complete(const Upload& upload);
+
+		std::deque<Upload> _queue;
+		// mapped, a worker copies into the buffer
+		std::vector<Upload> _mapped;
+		std::vector<Upload> _inFlight;
+		int _budget;
+		// -1 until usesPixelBuffers() checked the context
+		int _pixelBuffers;
+
+		static TextureUploader* s_sharedTextureUploader;
+};
+
+FLAKOR_NS_END
+
+#endif
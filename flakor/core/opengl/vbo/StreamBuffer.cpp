@@ -0,0 +1,119 @@
+/****************************************************************************
+Copyright (c) 2013-2014 saint
+
+http://www.flakor.org for english
+http://www.feike.org for chinese
+****************************************************************************/
+#include <string.h>
+
+#include "targetMacros.h"
+#include "macros.h"
+#include "core/opengl/vbo/StreamBuffer.h"
+#include "core/opengl/GLStateCache.h"
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+#include "core/opengl/GLContext.h"
+// loaded by gl3stubInit(), gl3stub.h itself clashes with the OES macros of GL.h
+#undef glUnmapBuffer
+extern "C" {
+extern GL_APICALL GLvoid* (* GL_APIENTRY glMapBufferRange) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+extern GL_APICALL GLboolean (* GL_APIENTRY glUnmapBuffer) (GLenum target);
+}
+#define GL_MAP_WRITE_BIT_FK             0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT_FK  0x0004
+#define GL_MAP_UNSYNCHRONIZED_BIT_FK    0x0020
+#elif FK_TARGET_PLATFORM == FK_PLATFORM_IOS
+#include "core/opengl/GPUInfo.h"
+#define glMapBufferRange                glMapBufferRangeEXT
+#define GL_MAP_WRITE_BIT_FK             GL_MAP_WRITE_BIT_EXT
+#define GL_MAP_INVALIDATE_RANGE_BIT_FK  GL_MAP_INVALIDATE_RANGE_BIT_EXT
+#define GL_MAP_UNSYNCHRONIZED_BIT_FK    GL_MAP_UNSYNCHRONIZED_BIT_EXT
+#endif
+
+FLAKOR_NS_BEGIN
+
+StreamBuffer::StreamBuffer(int capacity)
+:_bufferID(0)
+,_capacity(capacity)
+,_offset(0)
+,_mapRange(false)
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	if(_bufferID != 0)
+	{
+		fkGLDeleteBuffer(_bufferID);
+	}
+}
+
+void StreamBuffer::invalidateGL()
+{
+	_bufferID = 0;
+	_offset = 0;
+}
+
+void StreamBuffer::setupGL()
+{
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+	_mapRange = GLContext::GetInstance()->GetGLVersion() >= 3.0f && glMapBufferRange != NULL;
+#elif FK_TARGET_PLATFORM == FK_PLATFORM_IOS
+	_mapRange = GPUInfo::getInstance()->checkForGLExtension("GL_EXT_map_buffer_range");
+#endif
+
+	glGenBuffers(1, &_bufferID);
+	fkGLBindBuffer(GL_ARRAY_BUFFER, _bufferID);
+	orphanGL();
+}
+
+void StreamBuffer::orphanGL()
+{
+	glBufferData(GL_ARRAY_BUFFER, _capacity, NULL, GL_STREAM_DRAW);
+	_offset = 0;
+}
+
+GLintptr StreamBuffer::append(const void* data, int size)
+{
+	FKAssert(size <= _capacity, "StreamBuffer: append is larger than the ring");
+
+	if(_bufferID == 0)
+	{
+		setupGL();
+	}
+	else
+	{
+		fkGLBindBuffer(GL_ARRAY_BUFFER, _bufferID);
+	}
+
+	if(_offset + size > _capacity)
+	{
+		orphanGL();
+	}
+
+	GLintptr offset = _offset;
+	bool written = false;
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID || FK_TARGET_PLATFORM == FK_PLATFORM_IOS
+	if(_mapRange)
+	{
+		// nothing in flight reads this range, no need to wait for the GPU
+		void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+				GL_MAP_WRITE_BIT_FK | GL_MAP_INVALIDATE_RANGE_BIT_FK | GL_MAP_UNSYNCHRONIZED_BIT_FK);
+		if(dst != NULL)
+		{
+			memcpy(dst, data, size);
+			written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+		}
+	}
+#endif
+	if(!written)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	}
+
+	// keep the next range aligned for the attribute pointers
+	_offset += (size + 15) & ~15;
+	return offset;
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,60 @@
+/****************************************************************************
+Copyright (c) 2013-2014 saint
+
+http://www.flakor.org for english
+http://www.feike.org for chinese
+****************************************************************************/
+#ifndef _FK_STREAMBUFFER_H_
+#define _FK_STREAMBUFFER_H_
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+
+FLAKOR_NS_BEGIN
+
+/**
+ * StreamBuffer = 流式顶点缓冲，给每帧都变化的几何数据使用
+ *
+ * One big GL_ARRAY_BUFFER used as a ring: every append() writes behind the previous one,
+ * so the GPU can still read the earlier ranges while the CPU fills the next.
+ * When the ring is full the storage is orphaned (glBufferData with NULL) and writing starts
+ * at 0 again, the driver hands out fresh memory instead of waiting for the draws in flight.
+ *
+ * With OpenGL ES 3 (GL_EXT_map_buffer_range on iOS) ranges are written through an
+ * unsynchronized glMapBufferRange, otherwise with glBufferSubData.
+ */
+class StreamBuffer
+{
+	public:
+		/** capacity in bytes, one append can't be larger */
+		explicit StreamBuffer(int capacity);
+		~StreamBuffer();
+
+		inline int getCapacity() const { return _capacity; }
+		/** the GL buffer, 0 before the first append() */
+		inline GLuint getBufferID() const { return _bufferID; }
+
+	GL_METHOD:
+		/**
+		 * copy size bytes into the ring and leave the buffer bound to GL_ARRAY_BUFFER.
+		 * @return byte offset of the copy, add it to the attribute offsets of glVertexAttribPointer
+		 */
+		GLintptr append(const void* data, int size);
+
+		/** forget the GL buffer after the GL context was lost, it is created again in next append() */
+		void invalidateGL();
+
+	protected:
+		void setupGL();
+		/** new storage for the whole ring, the old one lives until the draws using it are done */
+		void orphanGL();
+
+		GLuint _bufferID;
+		int _capacity;
+		int _offset;
+		bool _mapRange;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -1,109 +1,162 @@
 #include "targetMacros.h"
-#include "core/opengl/VBO/VBO.h"
-#include "core/opengl/VBO/VAO.h"
+#include "macros.h"
+#include "core/opengl/vbo/VAO.h"
+#include "core/opengl/GLStateCache.h"
+#include "core/opengl/GPUInfo.h"
 #include "core/opengl/GLProgram.h"
+#include "core/opengl/renderer/RenderTypes.h"
 
-#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+// declared by GL.h, the OES entry points are only reachable through eglGetProcAddress
+PFNGLGENVERTEXARRAYSOESPROC glGenVertexArraysOESEXT = NULL;
+PFNGLBINDVERTEXARRAYOESPROC glBindVertexArrayOESEXT = NULL;
+PFNGLDELETEVERTEXARRAYSOESPROC glDeleteVertexArraysOESEXT = NULL;
+#endif
 
 FLAKOR_NS_BEGIN
 
-VAO::VAO():
-sizePerVertex(0),
-vertexNumber(0),
-indiceNumber(0),
-arrayID(VBO::HARDWARE_BUFFER_ID_INVALID),
-vertexs(NULL),
-indices(NULL),
-autoDispose(true),
-dirty(true),
-dispose(false),
-attrCount(0),
-VBOAttributes(NULL)
-{}
-
-VAO* VAO::create(int sizePerVertex,unsigned int vertexNumber,unsigned int indiceNumber)
-{
-    VAO* vao = new VAO();
-    if (vao != NULL) {
-        vao->sizePerVertex = sizePerVertex;
-        vao->vertexNumber = vertexNumber;
-        vao->indiceNumber = indiceNumber;
-    }
-    return vao;
-}
+int VAO::s_generation = 0;
 
-bool VAO::isAutoDispose()
-{
-    return autoDispose;
-}
+// -1 until isSupported() checked the context
+static int s_supported = -1;
 
-int VAO::getArrayID()
+VAO* VAO::create(int stride)
 {
-    return arrayID;
+	VAO* vao = new (std::nothrow) VAO();
+	if (vao && vao->init(stride))
+	{
+		vao->autorelease();
+		return vao;
+	}
+	FK_SAFE_DELETE(vao);
+	return nullptr;
 }
 
-bool VAO::isLoaded()
+VAO* VAO::createPosColorTex()
 {
-    return arrayID != VBO::HARDWARE_BUFFER_ID_INVALID;
+	VAO* vao = create(sizeof(V3F_C4F_T2F));
+	if (vao)
+	{
+		vao->addAttribute(VBOAttribute(GLProgram::ATTRIBUTE_NAME_POSITION, GLProgram::VERTEX_ATTRIB_POSITION, offsetof(V3F_C4F_T2F, vertices), 3, GL_FLOAT));
+		vao->addAttribute(VBOAttribute(GLProgram::ATTRIBUTE_NAME_COLOR, GLProgram::VERTEX_ATTRIB_COLOR, offsetof(V3F_C4F_T2F, colors), 4, GL_FLOAT));
+		vao->addAttribute(VBOAttribute(GLProgram::ATTRIBUTE_NAME_TEX_COORD, GLProgram::VERTEX_ATTRIB_TEX_COORD, offsetof(V3F_C4F_T2F, texCoords), 2, GL_FLOAT));
+	}
+	return vao;
 }
 
-void VAO::setNotLoaded()
+VAO::VAO()
+: _arrayID(0)
+, _vertexBuffer(0)
+, _indexBuffer(0)
+, _stride(0)
+, _attributeCount(0)
+, _flags(0)
+, _generation(-1)
 {
-    
 }
 
-void VAO::unload()
+VAO::~VAO()
 {
-    
+	if (_arrayID != 0 && _generation == s_generation)
+	{
+		fkGLDeleteVertexArray(_arrayID);
+	}
 }
 
-bool VAO::isDirty()
+bool VAO::init(int stride)
 {
-    return dirty;
+	_stride = stride;
+	_attributeCount = 0;
+	_flags = 0;
+	return stride > 0;
 }
 
-void VAO::setDirty()
+void VAO::addAttribute(const VBOAttribute& attribute)
 {
-    
-}
+	FKAssert(_attributeCount < MAX_ATTRIBUTES, "VAO: too many attributes");
+	FKAssert(attribute._location >= 0 && attribute._location < MAX_ATTRIBUTES, "VAO: location isn't tracked by GLStateCache");
 
-int VAO::getSizePerVertex() const
-{
-    return sizePerVertex;
+	_attributes[_attributeCount++] = attribute;
+	_flags |= 1u << attribute._location;
+	setDirty();
 }
 
-int VAO::getVertexNumber() const
+bool VAO::isSupported()
 {
-    return vertexNumber;
+	if (s_supported < 0)
+	{
+		bool supported = GPUInfo::getInstance()->supportsShareableVAO();
+#if FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID
+		if (supported && glGenVertexArraysOESEXT == NULL)
+		{
+			glGenVertexArraysOESEXT = (PFNGLGENVERTEXARRAYSOESPROC)eglGetProcAddress("glGenVertexArraysOES");
+			glBindVertexArrayOESEXT = (PFNGLBINDVERTEXARRAYOESPROC)eglGetProcAddress("glBindVertexArrayOES");
+			glDeleteVertexArraysOESEXT = (PFNGLDELETEVERTEXARRAYSOESPROC)eglGetProcAddress("glDeleteVertexArraysOES");
+		}
+		supported = supported && glGenVertexArraysOESEXT != NULL && glBindVertexArrayOESEXT != NULL && glDeleteVertexArraysOESEXT != NULL;
+#endif
+		s_supported = supported ? 1 : 0;
+		FKLOG("flakor: vertex array objects %s", supported ? "enabled" : "not supported");
+	}
+	return s_supported == 1;
 }
 
-void VAO::onBufferData()
+void VAO::invalidateSharedGL()
 {
-    
+	s_generation++;
 }
 
-void VAO::bind()
+void VAO::bind(GLuint vertexBuffer, GLuint indexBuffer)
 {
-	glBindVertexArray(arrayID);
+	if (!isSupported())
+	{
+		specifyGL(vertexBuffer, indexBuffer);
+		return;
+	}
+
+	if (_generation != s_generation)
+	{
+		// the name belonged to the lost context
+		_arrayID = 0;
+		_generation = s_generation;
+	}
+	if (_arrayID == 0)
+	{
+		glGenVertexArrays(1, &_arrayID);
+		setDirty();
+	}
+
+	fkGLBindVertexArray(_arrayID);
+	if (vertexBuffer != _vertexBuffer || indexBuffer != _indexBuffer)
+	{
+		specifyGL(vertexBuffer, indexBuffer);
+		_vertexBuffer = vertexBuffer;
+		_indexBuffer = indexBuffer;
+	}
 }
 
-void VAO::setUsage(GLenum usage)
+void VAO::unbind()
 {
-    
+	if (isSupported())
+	{
+		fkGLBindVertexArray(0);
+	}
 }
 
-void setVertexData(int index,int size,float data[])
+void VAO::specifyGL(GLuint vertexBuffer, GLuint indexBuffer)
 {
-    
+	fkGLBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	fkGLEnableVertexAttribs(_flags);
+	for (int i = 0; i < _attributeCount; i++)
+	{
+		const VBOAttribute& attribute = _attributes[i];
+		glVertexAttribPointer(attribute._location, attribute._size, attribute._type, attribute._normalized,
+				_stride, (GLvoid*)(intptr_t)attribute._offset);
+	}
+	fkGLBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 }
 
-void setIndexData(GLushort *data,int length)
-{
-    
-}
-
-//draw VAO
-void draw(GLenum mode, int count);
-void draw(GLenum mode, int count, int offset);
-
 FLAKOR_NS_END
@@ -2,7 +2,7 @@
  VAO Vertex Array Object-VAO，VAO是一个对象，其中包含一个或者更多的Vertex Buffer Objects
  glGenVertexArrays 创建一个Vertex Array Object,
  然后使用glBindVertexArray绑定VAO，一旦VAO绑定后，
- 使glGenBuffers 创建一个Vertex Buffer Object, 
+ 使glGenBuffers 创建一个Vertex Buffer Object,
  当然仍然需要使用glBindBuffer绑定VBO；
     顺序如下：
     1. Generate Vertex Array Object
@@ -15,98 +15,81 @@
 
 #include "base/lang/Object.h"
 #include "core/opengl/GL.h"
-
+#include "core/opengl/vbo/VBO.h"
 
 FLAKOR_NS_BEGIN
 
-struct VBOAttribute;
-
 /**
- *VAO = Vertex Array Object
+ * VAO = Vertex Array Object
+ *
+ * A vertex layout (the attributes of one vertex) over a vertex buffer and an index buffer.
+ * With vertex array objects the layout is specified once per pair of buffers and every later
+ * bind() is a single glBindVertexArray. Without them (GPUInfo::supportsShareableVAO() is false)
+ * bind() specifies the attributes again, like drawing without a VAO.
+ *
+ * Element buffer and enabled attributes belong to the bound vertex array: call unbind() after
+ * drawing, so that code specifying attributes itself doesn't change the layout of this one.
  */
 class VAO : public Object
 {
-protected:
-	unsigned int sizePerVertex;
-	unsigned int vertexNumber;
-    unsigned int indiceNumber;
-    
-	GLuint arrayID;
-	GLuint bufferID[2];//0: vertex  1: indices
-	GLenum usage[2];//0: vertex  1: indices
-
-	float *vertexs;
-	GLushort *indices;
-
-    int attrCount;
-    VBOAttribute** VBOAttributes;
-
-	//是否画完自动废弃。
-	bool autoDispose;
-	bool dirty;
-    //
-	bool dispose;
-
-public:
-	static VAO* create(int sizePerVertex,unsigned int vertexNumber,unsigned int indiceNumber);
-
-    VAO();
-    
-        /**
-         * 是否使用后自动销毁
-         * @return true if auto
-         */
-        bool isAutoDispose();
-
-        /**
-         * 获取该VAO对应的显卡arrayID
-         * @return int arrayID
-         */
-        int getArrayID();
-        /**
-         * 是否已载入显卡
-         * @return true if loaded
-         */
-        bool isLoaded();
-        /**
-         * 标记VBO对象没有载入显卡硬件。如果要再次使用此VBO，将重载
-         * Mark this {@link VertexBufferObject} as not not loaded to hardware.
-         * It will reload itself to hardware when it gets used again.
-         */
-        void setNotLoaded();
-        /**
-         * 从显卡上卸载下来
-         * @param glState Opengle 状态
-         */
-        void unload();
-
-        /**
-         * 是否VBO数据已过期
-         * @return true if its dirty
-         */
-        bool isDirty();
-
-        /**
-         * 标记数据已过期
-         * Mark this {@link VertexBufferObject} dirty so it gets updated on the hardware.
-         */
-        void setDirty();
-
-        int getSizePerVertex() const;
-        int getVertexNumber() const;
-
-		void bind();
-        virtual void onBufferData();
-		void setUsage(GLenum usage);
-        void setVertexData(int index,int size,float data[]);
-		void setIndexData(GLushort *data,int length);
-
-        //draw VAO
-        void draw(GLenum mode, int count);
-        void draw(GLenum mode, int count, int offset);
+	public:
+		/** GLStateCache tracks the attribute locations 0 to 7 */
+		static const int MAX_ATTRIBUTES = 8;
+
+		/** an empty layout of stride bytes per vertex, add the attributes with addAttribute() */
+		static VAO* create(int stride);
+		/** the V3F_C4F_T2F quad layout at the position, color and tex coord locations of GLProgram */
+		static VAO* createPosColorTex();
+
+		VAO();
+		virtual ~VAO();
+
+		bool init(int stride);
+
+		/** adds an attribute, its offset counts from the start of a vertex */
+		void addAttribute(const VBOAttribute& attribute);
+
+		/**
+		 * specify the layout again on the next bind(), call it after a buffer was deleted and created again:
+		 * the new buffer may get the old name while the vertex array still points to the deleted one
+		 */
+		inline void setDirty() { _vertexBuffer = _indexBuffer = 0; }
+
+		inline int getStride() const { return _stride; }
+		inline int getAttributeCount() const { return _attributeCount; }
+
+	GL_METHOD:
+		/** whether vertex array objects are used, checked once */
+		static bool isSupported();
+
+		/** makes the layout current over vertexBuffer and indexBuffer */
+		void bind(GLuint vertexBuffer, GLuint indexBuffer);
+		/** back to vertex array 0 */
+		static void unbind();
+
+		/** forget the vertex arrays of every VAO after the GL context was lost */
+		static void invalidateSharedGL();
+
+	protected:
+		/** binds the buffers and specifies the attributes into the bound vertex array */
+		void specifyGL(GLuint vertexBuffer, GLuint indexBuffer);
+
+		GLuint _arrayID;
+		/** buffers the vertex array was specified with */
+		GLuint _vertexBuffer;
+		GLuint _indexBuffer;
+
+		int _stride;
+		int _attributeCount;
+		/** VERTEX_ATTRIB_FLAG_* of the attributes */
+		unsigned int _flags;
+		VBOAttribute _attributes[MAX_ATTRIBUTES];
+
+		int _generation;
+		// bumped by invalidateSharedGL(), a VAO whose generation differs owns a dead vertex array
+		static int s_generation;
 };
 
 FLAKOR_NS_END
 
 #endif
-
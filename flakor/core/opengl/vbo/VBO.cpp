@@ -1,6 +1,7 @@
 #include "targetMacros.h"
 #include "core/opengl/vbo/VBO.h"
 #include "core/opengl/GLProgram.h"
+#include "core/opengl/GLStateCache.h"
 
 #include <stdlib.h>
 
@@ -146,7 +147,7 @@ VBOManager* VBO::getVBOManager()
 
 void VBO::bind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER,bufferID);
+	fkGLBindBuffer(GL_ARRAY_BUFFER,bufferID);
 }
 
 void VBO::setUsage(GLenum usage)
@@ -171,14 +172,14 @@ void VBO::onBufferData()
 	if(!isLoaded())
 	{
 		glGenBuffers(1,&bufferID);
-		glBindBuffer(GL_ARRAY_BUFFER,bufferID);
+		fkGLBindBuffer(GL_ARRAY_BUFFER,bufferID);
 
 		glBufferData(GL_ARRAY_BUFFER,size,bufferData,usage);
         dirty = false;
 	}
 	else
 	{
-		glBindBuffer(GL_ARRAY_BUFFER,bufferID);
+		fkGLBindBuffer(GL_ARRAY_BUFFER,bufferID);
 		if(dirty)
 			glBufferSubData(GL_ARRAY_BUFFER,0,size,bufferData);
 	}
@@ -187,11 +188,16 @@ void VBO::onBufferData()
 void VBO::enableAndPointer()
 {
 	int i;
+	unsigned int flags = VERTEX_ATTRIB_FLAG_NONE;
+	for(i=0;i<count;i++)
+	{
+		flags |= 1u << VBOAttributes[i]->_location;
+	}
+	fkGLEnableVertexAttribs(flags);
+
 	for(i=0;i<count;i++)
 	{
 		VBOAttribute *attri = VBOAttributes[i];
-        FKLOG("%s index: %d",attri->_name,attri->_location);
-		glEnableVertexAttribArray(attri->_location);
 		glVertexAttribPointer(attri->_location,attri->_size,GL_FLOAT,attri->_normalized,sizePerVertex*sizeof(float),reinterpret_cast<GLvoid*>(attri->_offset));
 	}
 }
@@ -3,6 +3,7 @@
 #include "core/opengl/GPUInfo.h"
 #include "core/resource/Image.h"
 #include "core/resource/Uri.h"
+#include "tool/utility/TexUtils.h"
 
 #include <vector>
 #include <string>
@@ -32,6 +33,11 @@ namespace
     
     static bool _PVRHaveAlphaPremultiplied = false;
     
+    static bool _softwareDecodedTo16Bit = true;
+    
+    // DynamicAtlas::DEFAULT_MAX_IMAGE_SIZE, read on the loader threads
+    static int _softwareDecoded8BitMaxSize = 512;
+    
     // Values taken from PVRTexture.h from http://www.imgtec.com
     enum class PVR2TextureFlag
     {
@@ -399,11 +405,27 @@ Image::~Image()
 {
     if(_unpack)
     {
-        for (unsigned int i = 0; i < _numberOfMipmaps; ++i)
+        for (int i = 0; i < _numberOfMipmaps; ++i)
+            FK_SAFE_DELETE_ARRAY(_mipmaps[i].address);
+    }
+    else
+        FK_SAFE_FREE(_data);
+}
+
+void Image::releaseData()
+{
+    if(_unpack)
+    {
+        for (int i = 0; i < _numberOfMipmaps; ++i)
             FK_SAFE_DELETE_ARRAY(_mipmaps[i].address);
     }
     else
         FK_SAFE_FREE(_data);
+
+    _data = nullptr;
+    _dataLen = 0;
+    _unpack = false;
+    _numberOfMipmaps = 0;
 }
 
 bool Image::load(bool aync)
@@ -496,6 +518,17 @@ bool Image::initWithImageData(const unsigned char * data, ssize_t dataLen)
             }
         }
         
+        // half the memory and upload of what the GPU couldn't take compressed. A single level small enough
+        // for DynamicAtlas stays at 8 bit per channel, the pages can't take 16 bit pixels and a texture
+        // of its own would cost it the batching with the other small images
+        if (ret && _softwareDecodedTo16Bit && isSoftwareDecoded())
+        {
+            if (_numberOfMipmaps > 1 || _width > _softwareDecoded8BitMaxSize || _height > _softwareDecoded8BitMaxSize)
+            {
+                packTo16Bit();
+            }
+        }
+        
         if(unpackedData != data)
         {
             free(unpackedData);
@@ -2283,5 +2316,118 @@ void Image::setPVRImagesHavePremultipliedAlpha(bool haveAlphaPremultiplied)
     _PVRHaveAlphaPremultiplied = haveAlphaPremultiplied;
 }
 
+void Image::setSoftwareDecodedTo16Bit(bool enabled)
+{
+    _softwareDecodedTo16Bit = enabled;
+}
+
+void Image::setSoftwareDecoded8BitMaxSize(int size)
+{
+    _softwareDecoded8BitMaxSize = size;
+}
+
+bool Image::isSoftwareDecoded()
+{
+    switch (_fileType)
+    {
+        case Format::ETC:
+        case Format::S3TC:
+        case Format::ATITC:
+            return !isCompressed();
+        case Format::PVR:
+            // only the software decoders unpack the levels, a PVR of RGBA8888 is kept as it is
+            return _unpack;
+        default:
+            return false;
+    }
+}
+
+void Image::packTo16Bit()
+{
+    if (_renderFormat != PixelFormat::RGBA8888 && _renderFormat != PixelFormat::RGB888)
+    {
+        return;
+    }
+
+    // a single level of ETC and S3TC is only in _data
+    bool single = !_unpack && _numberOfMipmaps <= 1;
+    unsigned char* level = single ? _data : _mipmaps[0].address;
+    ssize_t levelLen = single ? _dataLen : _mipmaps[0].len;
+
+    // the smaller levels are filtered from level 0, it decides about alpha
+    bool opaque = true;
+    if (_renderFormat == PixelFormat::RGBA8888)
+    {
+        for (ssize_t i = 3; i < levelLen && opaque; i += 4)
+        {
+            opaque = level[i] == 0xff;
+        }
+    }
+    PixelFormat format = opaque ? PixelFormat::RGB565 : PixelFormat::RGBA4444;
+
+    unsigned char* outData = nullptr;
+    ssize_t outDataLen = 0;
+    if (single)
+    {
+        TexUtils::convertDataToFormat(_data, _dataLen, _renderFormat, format, &outData, &outDataLen);
+        free(_data);
+        _data = outData;
+        _dataLen = outDataLen;
+        if (_numberOfMipmaps == 1)
+        {
+            // S3TC and ATITC point their only level into _data
+            _mipmaps[0].address = _data;
+            _mipmaps[0].len = static_cast<int>(_dataLen);
+        }
+        _renderFormat = format;
+        return;
+    }
+
+    // the levels are back to back in _data, or each in an array of its own when unpacked
+    unsigned char* packed = nullptr;
+    ssize_t packedLen = 0;
+    if (!_unpack)
+    {
+        int bytesPerPixel = (_renderFormat == PixelFormat::RGBA8888) ? 4 : 3;
+        for (int i = 0; i < _numberOfMipmaps; ++i)
+        {
+            packedLen += _mipmaps[i].len / bytesPerPixel * 2;
+        }
+        packed = static_cast<unsigned char*>(malloc(packedLen));
+        packedLen = 0;
+    }
+    for (int i = 0; i < _numberOfMipmaps; ++i)
+    {
+        TexUtils::convertDataToFormat(_mipmaps[i].address, _mipmaps[i].len, _renderFormat, format, &outData, &outDataLen);
+        if (_unpack)
+        {
+            delete [] _mipmaps[i].address;
+            _mipmaps[i].address = new unsigned char[outDataLen];
+            memcpy(_mipmaps[i].address, outData, outDataLen);
+        }
+        else
+        {
+            _mipmaps[i].address = packed + packedLen;
+            memcpy(_mipmaps[i].address, outData, outDataLen);
+        }
+        _mipmaps[i].len = static_cast<int>(outDataLen);
+        packedLen += outDataLen;
+        free(outData);
+    }
+    if (!_unpack)
+    {
+        free(_data);
+        _data = packed;
+        _dataLen = packedLen;
+    }
+    else
+    {
+        // _data of an unpacked image is its level 0, deleted above
+        _data = _mipmaps[0].address;
+        _dataLen = _mipmaps[0].len;
+    }
+    _renderFormat = format;
+}
+
 FLAKOR_NS_END
 
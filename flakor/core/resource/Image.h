@@ -120,6 +120,9 @@ public:
     inline MipmapInfo*       getMipmaps()            { return _mipmaps; }
     inline bool              hasPremultipliedAlpha() { return _hasPremultipliedAlpha; }
 
+    /** frees the decoded pixels, load() decodes the file again */
+    void                     releaseData();
+
     int                      getBitPerPixel();
     bool                     hasAlpha();
     bool                     isCompressed();
@@ -141,6 +144,17 @@ public:
      */
     static void setPVRImagesHavePremultipliedAlpha(bool haveAlphaPremultiplied);
 
+    /** packs compressed images the GPU can't take into RGB565, or RGBA4444 with alpha, after the
+     software decoder made RGBA8888 or RGB888 of them. Enabled by default.
+     A single level small enough for DynamicAtlas isn't packed, the atlas pages are RGBA8888
+     */
+    static void setSoftwareDecodedTo16Bit(bool enabled);
+
+    /** a single level no larger than size on both sides isn't packed to 16 bit. 512 by default, the default
+     max image size of DynamicAtlas. Set it with DynamicAtlas::setMaxImageSize() before images load
+     */
+    static void setSoftwareDecoded8BitMaxSize(int size);
+
 protected:
 
 	/*
@@ -181,6 +195,11 @@ protected:
     
     void premultipliedAlpha();
     
+    /** whether a compressed file was decoded by software, the GPU doesn't support its format */
+    bool isSoftwareDecoded();
+    /** converts the pixels of every level to RGB565, or to RGBA4444 when level 0 isn't opaque */
+    void packTo16Bit();
+    
 protected:
     /**
      @brief Determine how many mipmaps can we have.
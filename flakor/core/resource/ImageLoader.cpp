@@ -21,17 +21,15 @@ bool ImageLoader::load(Resource* res)
 {
 	Image* img = NULL;
 
-	ResourceState state = res->getState();
-	if(state == LOADING) return false;
-	
+	// ResourceManager doesn't hand out a resource twice while it is LOADING
 	img = dynamic_cast<Image*>(res);
 	if(img)
 	{
-		if(state == LOADED) img->unload();
+		// loaded before, the image stays managed, only its pixels are decoded again
+		if(res->getState() == LOADED) img->releaseData();
 		Uri* uri = img->getUri();
 		BitData* data = BitData::createFromUri(uri);
-		img->initWithImageData(data->getBytes(), data->getSize());
-		return true;
+		return img->initWithImageData(data->getBytes(), data->getSize());
 	}
 	
 	return false;
@@ -42,26 +42,20 @@ void* LoaderThread::run(void* thread)
     
     while(thr->isRunning())
     {
-        if(mgr->waitLoads >= 1)
+        pthread_mutex_lock(&mgr->mutex);
+        Resource* res = mgr->getWaitingRes();
+        while(res == NULL)
         {
+            // sleep until load() queues a resource
+            pthread_cond_wait(&mgr->queueCond, &mgr->mutex);
+            res = mgr->getWaitingRes();
+        }
+        pthread_mutex_unlock(&mgr->mutex);
 
-            pthread_mutex_lock(&mgr->mutex);
-			Resource* res = mgr->getWaitingRes();
-			pthread_mutex_unlock(&mgr->mutex);
-
-			if(res == NULL) FKLOG("LOADER FAIL");
-            ILoader* loader = res->getLoader();
-			
-			loader->load(res);
-			res->schedule();
+        ILoader* loader = res->getLoader();
 
-            mgr->waitLoads--;
-            
-        }
-        else
-        {
-            usleep(80);
-        }
+        mgr->finishLoad(res, loader->load(res));
+        res->schedule();
     }
     
     return NULL;
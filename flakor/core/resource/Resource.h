@@ -60,7 +60,7 @@ class Resource : public Object
 		ResourceListener* getListener();
 		void setListener(ResourceListener* listener);
 
-		inline void doCallback(){_callback(this);};
+		inline void doCallback(){ if(_callback) _callback(this); };
 		inline void setCallback(const std::function<void(Resource*)>& callback) {_callback = callback;};
 		void schedule();
 };
@@ -21,10 +21,17 @@ AAssetManager* ResourceManager::assetManager = NULL;
 static ResourceManager* resMgr = NULL;
 
 ResourceManager::ResourceManager()
-:running(false)
+:internalDataPath(NULL)
+,externalDataPath(NULL)
+,running(false)
+,waitLoads(0)
 ,threadNum(0)
 ,threads(NULL)
 {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+    pthread_cond_init(&loadedCond, NULL);
+    pthread_cond_init(&queueCond, NULL);
     //_loaders = new std::map<const char*,ILoader*>();
     _pendingResource = Array::createWithCapacity(4);
     _pendingResource->retain();
@@ -108,8 +115,14 @@ Resource *ResourceManager::getResourceById(int uid)
 
 Resource *ResourceManager::getWaitingRes()
 {
+    // called by the loader threads with mutex locked
+    if (_resourceQueue.empty())
+    {
+        return NULL;
+    }
     Resource * res = _resourceQueue.front();
     _resourceQueue.pop();
+    waitLoads--;
     
     return res;
 }
@@ -140,30 +153,81 @@ bool ResourceManager::load(Resource* res, bool asyn)
 {
    if(asyn)
    {
-        //add to loadTaskQueue
+        //add to loadTaskQueue, the loader threads pop it
+       pthread_mutex_lock(&mutex);
+       if(res->getState() == LOADING)
+       {
+           // queued already
+           pthread_mutex_unlock(&mutex);
+           return true;
+       }
+       res->setState(LOADING);
        _resourceQueue.push(res);
        waitLoads++;
+       pthread_cond_signal(&queueCond);
+       pthread_mutex_unlock(&mutex);
        if (threads == NULL) {
            
-           threadNum = 1;
-           threads = (LoaderThread**)malloc(sizeof(LoaderThread *)*1);
-           threads[0] = LoaderThread::create();
-           threads[0]->start();
+           // decoding is cpu bound, a second thread halves the wait for a batch of images
+           threadNum = LOADER_THREADS;
+           threads = (LoaderThread**)malloc(sizeof(LoaderThread *)*threadNum);
+           for (int i = 0; i < threadNum; i++)
+           {
+               threads[i] = LoaderThread::create();
+               threads[i]->start();
+           }
            
        }
        return true;
    }
    else
    {
+      pthread_mutex_lock(&mutex);
+      bool waited = false;
+      while(res->getState() == LOADING)
+      {
+          // a loader thread has it, decoding it here too would write the same data twice
+          pthread_cond_wait(&loadedCond, &mutex);
+          waited = true;
+      }
+      ResourceState state = res->getState();
+      pthread_mutex_unlock(&mutex);
+      if(waited)
+      {
+          return state == LOADED;
+      }
+
       _pendingResource->removeObject(res);
       _loadingResource->addObject(res);
 
 	  FKLOG("res->getType %s",res->getType());
 	  ILoader* loader = _loaders[res->getType()];
-      return loader->load(res);
+      bool loaded = loader->load(res);
+      finishLoad(res, loaded);
+      return loaded;
    }
 }
 
+ResourceState ResourceManager::waitForLoad(Resource* res)
+{
+    pthread_mutex_lock(&mutex);
+    while(res->getState() == LOADING)
+    {
+        pthread_cond_wait(&loadedCond, &mutex);
+    }
+    ResourceState state = res->getState();
+    pthread_mutex_unlock(&mutex);
+    return state;
+}
+
+void ResourceManager::finishLoad(Resource* res, bool loaded)
+{
+    pthread_mutex_lock(&mutex);
+    res->setState(loaded ? LOADED : FAILED);
+    pthread_cond_broadcast(&loadedCond);
+    pthread_mutex_unlock(&mutex);
+}
+
 bool ResourceManager::unload(Resource* res)
 {
     res->unload();
@@ -4,6 +4,7 @@
 #define _FK_RESOURCE_MANAGER_H_
 
 #include "target.h"
+#include "core/resource/Resource.h"
 #include <unordered_set>
 #include <map>
 #include <queue>
@@ -49,6 +50,8 @@ class ResourceManager
         static const char* SOUND_NAME;
     
         static const int MAX_RESOURCE = 1024*5;
+        /** threads started by the first asynchronous load */
+        static const int LOADER_THREADS = 2;
         static int uniqueID; //uid begin with 1
     
         /**
@@ -63,6 +66,10 @@ class ResourceManager
 
         pthread_mutex_t mutex;
         pthread_cond_t cond;
+        /** signalled with mutex when a loader thread finished a resource */
+        pthread_cond_t loadedCond;
+        /** signalled with mutex when a resource is queued for the loader threads */
+        pthread_cond_t queueCond;
 		bool running;
 
         int msgread;
@@ -84,7 +91,15 @@ class ResourceManager
         Resource *getResourceById(int id);
 		Resource *getWaitingRes();
 
+        /**
+         * a synchronous load of a resource that is queued or decoding on a loader thread
+         * waits for that load instead of decoding it a second time
+         */
         bool load(Resource* res,bool asyn);
+        /** blocks while res is queued or decoding on a loader thread, the state it ended in */
+        ResourceState waitForLoad(Resource* res);
+        /** sets the state of res after its loader ran and wakes the synchronous loads waiting for it */
+        void finishLoad(Resource* res,bool loaded);
         bool unload(Resource* res);
         bool reload(Resource* res,bool asyn);
 
@@ -1,6 +1,7 @@
 #include "targetMacros.h"
 #include "core/resource/Scheduler.h"
 #include "core/resource/Resource.h"
+#include "2d/Entity.h"
 
 FLAKOR_NS_BEGIN
 
@@ -9,11 +10,13 @@ static Scheduler* sch = NULL;
 Scheduler::Scheduler()
 {
 	_queue = new std::queue<Resource*>();
+	pthread_mutex_init(&_mutex, NULL);
 }
 
 Scheduler::~Scheduler()
 {
 	delete(_queue);
+	pthread_mutex_destroy(&_mutex);
 }
 
 
@@ -28,19 +31,43 @@ Scheduler* Scheduler::thisScheduler()
 
 void Scheduler::update(float delta)
 {
-	Resource* res = NULL;
-	for(int i=0;i < _queue->size(); i++)
+	// take what is loaded so far, callbacks run without the lock
+	std::queue<Resource*> loaded;
+	std::queue<std::function<void()> > tasks;
+	pthread_mutex_lock(&_mutex);
+	std::swap(loaded, *_queue);
+	std::swap(tasks, _tasks);
+	pthread_mutex_unlock(&_mutex);
+
+	while(!loaded.empty())
 	{
-		res = _queue->front();
+		Resource* res = loaded.front();
+		loaded.pop();
 		res->doCallback();
-		_queue->pop();
+		// loaded resources usually end up on screen
+		Entity::markSceneDirty();
+	}
+
+	while(!tasks.empty())
+	{
+		tasks.front()();
+		tasks.pop();
+		Entity::markSceneDirty();
 	}
-    
 }
 
 void Scheduler::schedule(Resource* res)
 {
+	pthread_mutex_lock(&_mutex);
 	_queue->push(res);
+	pthread_mutex_unlock(&_mutex);
+}
+
+void Scheduler::schedule(const std::function<void()>& task)
+{
+	pthread_mutex_lock(&_mutex);
+	_tasks.push(task);
+	pthread_mutex_unlock(&_mutex);
 }
 	
 FLAKOR_NS_END
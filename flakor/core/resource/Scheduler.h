@@ -2,6 +2,8 @@
 #define _FK_SCHEDULER_H_
 
 #include <queue>
+#include <functional>
+#include <pthread.h>
 
 FLAKOR_NS_BEGIN
 
@@ -18,8 +20,13 @@ class Scheduler
 		void update(float delta);//in GL thread
 
 		void schedule(Resource* res);//in load thread
+		/** runs task on the GL thread in the next update(), callable from any thread */
+		void schedule(const std::function<void()>& task);
 	protected:
 		std::queue<Resource*>* _queue;
+		std::queue<std::function<void()> > _tasks;
+		// schedule() is called by the loader threads
+		pthread_mutex_t _mutex;
 };
 
 FLAKOR_NS_END
@@ -48,9 +48,13 @@ THE SOFTWARE.
  In order to use them, you have to use the following functions, instead of the the GL ones:
     - fkGLUseProgram() instead of glUseProgram()
     - fkGLDeleteProgram() instead of glDeleteProgram()
-    - fkGLBlendFunc() instead of glBlendFunc()
+    - fkGLBlendFunc() instead of glBlendFunc() and glEnable/glDisable(GL_BLEND)
+    - fkGLBindTexture2D() instead of glActiveTexture() and glBindTexture()
+    - fkGLBindBuffer() instead of glBindBuffer()
+    - fkGLEnableVertexAttribs() instead of glEnableVertexAttribArray()
+ (see core/opengl/GLStateCache.h)
 
- If this functionality is disabled, then fkGLUseProgram(), fkGLDeleteProgram(), fkGLBlendFunc() will call the GL ones, without using the cache.
+ If this functionality is disabled, then the fkGL functions will call the GL ones, without using the cache.
 
  It is recommended to enable whenever possible to improve speed.
  If you are migrating your code from GL ES 1.1, then keep it disabled. Once all your code works as expected, turn it on.
@@ -141,29 +141,29 @@ On iPhone it returns 2 if RetinaDisplay is On. Otherwise it returns 1
     RectMake( (__rect_in_points_points__).origin.x * FK_CONTENT_SCALE_FACTOR(), (__rect_in_points_points__).origin.y * FK_CONTENT_SCALE_FACTOR(),    \
             (__rect_in_points_points__).size.width * FK_CONTENT_SCALE_FACTOR(), (__rect_in_points_points__).size.height * FK_CONTENT_SCALE_FACTOR() )
 
-/** @def CC_POINT_PIXELS_TO_POINTS
+/** @def FK_POINT_PIXELS_TO_POINTS
  Converts a rect in pixels to points
  */
-#define CC_POINT_PIXELS_TO_POINTS(__pixels__)                                                                        \
-CCPointMake( (__pixels__).x / CC_CONTENT_SCALE_FACTOR(), (__pixels__).y / CC_CONTENT_SCALE_FACTOR())
+#define FK_POINT_PIXELS_TO_POINTS(__pixels__)                                                                        \
+PointMake( (__pixels__).x / FK_CONTENT_SCALE_FACTOR(), (__pixels__).y / FK_CONTENT_SCALE_FACTOR())
 
-/** @def CC_POINT_POINTS_TO_PIXELS
+/** @def FK_POINT_POINTS_TO_PIXELS
  Converts a rect in points to pixels
  */
-#define CC_POINT_POINTS_TO_PIXELS(__points__)                                                                        \
-CCPointMake( (__points__).x * CC_CONTENT_SCALE_FACTOR(), (__points__).y * CC_CONTENT_SCALE_FACTOR())
+#define FK_POINT_POINTS_TO_PIXELS(__points__)                                                                        \
+PointMake( (__points__).x * FK_CONTENT_SCALE_FACTOR(), (__points__).y * FK_CONTENT_SCALE_FACTOR())
 
-/** @def CC_POINT_PIXELS_TO_POINTS
+/** @def FK_POINT_PIXELS_TO_POINTS
  Converts a rect in pixels to points
  */
-#define CC_SIZE_PIXELS_TO_POINTS(__size_in_pixels__)                                                                        \
-CCSizeMake( (__size_in_pixels__).width / CC_CONTENT_SCALE_FACTOR(), (__size_in_pixels__).height / CC_CONTENT_SCALE_FACTOR())
+#define FK_SIZE_PIXELS_TO_POINTS(__size_in_pixels__)                                                                        \
+SizeMake( (__size_in_pixels__).width / FK_CONTENT_SCALE_FACTOR(), (__size_in_pixels__).height / FK_CONTENT_SCALE_FACTOR())
 
-/** @def CC_POINT_POINTS_TO_PIXELS
+/** @def FK_POINT_POINTS_TO_PIXELS
  Converts a rect in points to pixels
  */
-#define CC_SIZE_POINTS_TO_PIXELS(__size_in_points__)                                                                        \
-CCSizeMake( (__size_in_points__).width * CC_CONTENT_SCALE_FACTOR(), (__size_in_points__).height * CC_CONTENT_SCALE_FACTOR())
+#define FK_SIZE_POINTS_TO_PIXELS(__size_in_points__)                                                                        \
+SizeMake( (__size_in_points__).width * FK_CONTENT_SCALE_FACTOR(), (__size_in_points__).height * FK_CONTENT_SCALE_FACTOR())
 
 
 #ifndef FLT_EPSILON
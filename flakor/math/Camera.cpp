@@ -67,6 +67,11 @@ void Camera::restore(void)
 }
 
 void Camera::locate(void)
+{
+    GLMultiply( &getLookupMatrix() );
+}
+
+const Matrix4& Camera::getLookupMatrix(void)
 {
     if (m_bDirty)
     {
@@ -74,11 +79,14 @@ void Camera::locate(void)
         Vector3 center= Vector3(m_fCenterX, m_fCenterY, m_fCenterZ );
 
         Vector3 up= Vector3(m_fUpX, m_fUpY, m_fUpZ);
-        m_lookupMatrix.lookAt(eye, center, up);
+        //Matrix4::lookAt returns a heap allocated matrix
+        Matrix4& lookAt = Matrix4::lookAt(eye, center, up);
+        m_lookupMatrix = lookAt;
+        delete &lookAt;
 
         m_bDirty = false;
     }
-    GLMultiply( &m_lookupMatrix );
+    return m_lookupMatrix;
 }
 
 float Camera::getZEye(void)
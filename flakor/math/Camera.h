@@ -102,6 +102,8 @@ public:
     void restore(void);
     /** Sets the camera using gluLookAt using its eye, center and up_vector */
     void locate(void);
+    /** Returns the gluLookAt matrix, recomputing it if the camera is dirty */
+    const Matrix4& getLookupMatrix(void);
     /** sets the eye values in points 
      *  @js setEye
      */
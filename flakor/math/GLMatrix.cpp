@@ -10,6 +10,12 @@ MatrixStack* textureStack;
 
 MatrixStack* currentStack = NULL;
 
+// versions of the tops of the stacks, 0 is never handed out
+static unsigned int modelviewVersion = 1;
+static unsigned int projectionVersion = 1;
+static unsigned int textureVersion = 1;
+static unsigned int* currentVersion = &modelviewVersion;
+
 static unsigned char initialized = 0;
 
 #ifdef __cplusplus
@@ -29,7 +35,11 @@ void lazyInitialize()
         textureStack = new MatrixStack();
 
         currentStack = modelviewStack;
+        currentVersion = &modelviewVersion;
         initialized = 1;
+        modelviewVersion++;
+        projectionVersion++;
+        textureVersion++;
 
         //Make sure that each stack has the identity matrix
         modelviewStack->push(identity);
@@ -46,12 +56,15 @@ void GLMode(StackMode mode)
     {
         case GL_MODELVIEW:
             currentStack = modelviewStack;
+            currentVersion = &modelviewVersion;
         break;
         case GL_PROJECTION:
             currentStack = projectionStack;
+            currentVersion = &projectionVersion;
         break;
         case GL_TEXTURE:
             currentStack = textureStack;
+            currentVersion = &textureVersion;
         break;
         default:
             assert(0 && "Invalid matrix mode specified"); //TODO: Proper error handling
@@ -75,6 +88,7 @@ void GLPop(void)
     assert(initialized && "Cannot Pop empty matrix stack");
     //No need to lazy initialize, you shouldn't be popping first anyway!
     currentStack->pop(NULL);
+    (*currentVersion)++;
 }
 
 void GLLoadIdentity()
@@ -82,6 +96,7 @@ void GLLoadIdentity()
     lazyInitialize();
 
     currentStack->top->identity(); //Replace the top matrix with the identity matrix
+    (*currentVersion)++;
 }
 
 void GLFreeAll()
@@ -101,13 +116,16 @@ void GLMultiply(const Matrix4* in)
 {
     lazyInitialize();
     *currentStack->top = (*currentStack->top)*(*in);
+    (*currentVersion)++;
 }
 
 void GLLoad(Matrix4* in)
 {
     lazyInitialize();
 	
-    in->set(currentStack->top->get(),COLUMN_MAJOR);
+    //Replace the top matrix with the given one
+    currentStack->top->set(in->get(),COLUMN_MAJOR);
+    (*currentVersion)++;
 }
 
 void GLGet(StackMode mode, Matrix4* out)
@@ -134,6 +152,22 @@ void GLGet(StackMode mode, Matrix4* out)
     }
 }
 
+unsigned int GLGetVersion(StackMode mode)
+{
+    switch(mode)
+    {
+        case GL_MODELVIEW:
+            return modelviewVersion;
+        case GL_PROJECTION:
+            return projectionVersion;
+        case GL_TEXTURE:
+            return textureVersion;
+        default:
+            assert(0 && "Invalid matrix mode specified");
+            return 0;
+    }
+}
+
 void GLTranslatef(float x, float y, float z)
 {
     Matrix4 *translation = new Matrix4();
@@ -143,6 +177,7 @@ void GLTranslatef(float x, float y, float z)
 
     //Multiply the rotation matrix by the current matrix
     *currentStack->top = (*currentStack->top)*(*translation);
+    (*currentVersion)++;
 }
 
 void GLRotatef(float angle, float x, float y, float z)
@@ -156,6 +191,7 @@ void GLRotatef(float angle, float x, float y, float z)
 
     //Multiply the rotation matrix by the current matrix
     *currentStack->top = (*currentStack->top)*(*rotation);
+    (*currentVersion)++;
 }
 
 void GLScalef(float x, float y, float z)
@@ -164,6 +200,7 @@ void GLScalef(float x, float y, float z)
     scaling->scale(x, y, z);
 
     *currentStack->top = (*currentStack->top)*(*scaling);
+    (*currentVersion)++;
 }
 
 #ifdef __cplusplus
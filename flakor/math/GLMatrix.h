@@ -25,6 +25,8 @@ void GLFreeAll();
 void GLMultiply(const Matrix4* in);
 void GLLoad(Matrix4* in);
 void GLGet(StackMode mode, Matrix4* out);
+/** bumped on every change of the stack's top, a cached copy of GLGet() is current while the version is the same */
+unsigned int GLGetVersion(StackMode mode);
 void GLTranslatef(float x, float y, float z);
 
 void GLRotatef(float angle, float x, float y, float z);
@@ -430,9 +430,9 @@ Matrix4& Matrix4::translate(const Vector3& v)
  */
 Matrix4& Matrix4::translate(float x, float y, float z)
 {
-    m[0] += m[3]*x;   m[3] += m[7]*x;   m[2] += m[11]*x;   m[3] += m[15]*x;
-    m[1] += m[3]*y;   m[4] += m[7]*y;   m[6] += m[11]*y;   m[7] += m[15]*y;
-    m[2] += m[3]*z;   m[5] += m[7]*z;   m[10]+= m[11]*z;   m[11]+= m[15]*z;
+    m[0] += m[3]*x;   m[4] += m[7]*x;   m[8] += m[11]*x;   m[12]+= m[15]*x;
+    m[1] += m[3]*y;   m[5] += m[7]*y;   m[9] += m[11]*y;   m[13]+= m[15]*y;
+    m[2] += m[3]*z;   m[6] += m[7]*z;   m[10]+= m[11]*z;   m[14]+= m[15]*z;
     return *this;
 }
 
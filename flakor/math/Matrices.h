@@ -911,7 +911,7 @@ inline Point Matrix4::operator*(const Point& rhs) const
 
 inline Matrix4 Matrix4::operator*(const Matrix4& n) const
 {
-    return Matrix4(m[0]*n[0]  + m[4]*n[1]  + m[8]*n[2]  + m[12]*n[3],   m[0]*n[4]  + m[4]*n[5]  + m[8]*n[6]  + m[12]*n[7],   m[0]*n[8]  + m[4]*n[9]  + m[8]*n[10]  + m[12]*n[11],   m[0]*n[12]  + m[4]*n[13]  + m[8]*n[14]  + m[3]*n[15],
+    return Matrix4(m[0]*n[0]  + m[4]*n[1]  + m[8]*n[2]  + m[12]*n[3],   m[0]*n[4]  + m[4]*n[5]  + m[8]*n[6]  + m[12]*n[7],   m[0]*n[8]  + m[4]*n[9]  + m[8]*n[10]  + m[12]*n[11],   m[0]*n[12]  + m[4]*n[13]  + m[8]*n[14]  + m[12]*n[15],
                    m[1]*n[0]  + m[5]*n[1]  + m[9]*n[2]  + m[13]*n[3],   m[1]*n[4]  + m[5]*n[5]  + m[9]*n[6]  + m[13]*n[7],   m[1]*n[8]  + m[5]*n[9]  + m[9]*n[10]  + m[13]*n[11],   m[1]*n[12]  + m[5]*n[13]  + m[9]*n[14]  + m[13]*n[15],
                    m[2]*n[0]  + m[6]*n[1]  + m[10]*n[2] + m[14]*n[3],  m[2]*n[4]  + m[6]*n[5]  + m[10]*n[6] + m[14]*n[7],  m[2]*n[8]  + m[6]*n[9]  + m[10]*n[10] + m[14]*n[11],  m[2]*n[12]  + m[6]*n[13]  + m[10]*n[14] + m[14]*n[15],
                    m[3]*n[0] + m[7]*n[1] + m[11]*n[2] + m[15]*n[3],  m[3]*n[4] + m[7]*n[5] + m[11]*n[6] + m[15]*n[7],  m[3]*n[8] + m[7]*n[9] + m[11]*n[10] + m[15]*n[11],  m[3]*n[12] + m[7]*n[13] + m[11]*n[14] + m[15]*n[15]);
@@ -149,6 +149,8 @@ void Application::onExecCmd(int32_t cmd)
                 this->engine->initDisplay();
                 LOGW("game create!!!");
                 ResourceManager::setAssetManager(this->app->activity->assetManager);
+                ResourceManager::thisManager()->internalDataPath = this->app->activity->internalDataPath;
+                ResourceManager::thisManager()->externalDataPath = this->app->activity->externalDataPath;
                 this->game->create();
                 this->drawFrame();
                 this->state = STATE_RUNNING;
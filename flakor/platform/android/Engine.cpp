@@ -6,12 +6,20 @@
 #include "core/resource/ResourceManager.h"
 #include "core/input/TouchPool.h"
 #include "base/update/UpdateThread.h"
+#include "base/update/JobSystem.h"
 #include "math/GLMatrix.h"
+#include "core/opengl/renderer/Renderer.h"
+#include "core/opengl/shader/ShaderCache.h"
+#include "2d/Entity.h"
+#include "2d/ModifierManager.h"
 
 #include <unistd.h>
 
 #define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, "engine", __VA_ARGS__))
 
+// an idle frame has no Swap to wait for the vsync, sleep about one frame instead of spinning
+#define IDLE_FRAME_USEC 16000
+
 FLAKOR_NS_BEGIN
 
 Engine::Engine()
@@ -24,14 +32,17 @@ Engine::Engine()
 	glContext = GLContext::GetInstance();
 	updateThread = UpdateThread::create(this);
 	pthread_mutex_init(&mutex, NULL);
-	touchPool = new TouchPool();
+	touchPool = TouchPool::getInstance();
 }
 
 Engine::~Engine()
 {
 	FK_SAFE_DELETE(updateThread);
+	ModifierManager::destroyInstance();
+	JobSystem::destroyInstance();
 	FK_SAFE_DELETE(schedule);
-	FK_SAFE_DELETE(touchPool);
+	TouchPool::destroyInstance();
+	touchPool = NULL;
 }
 
 //run in update thread
@@ -59,6 +70,13 @@ void Engine::onTickUpdate()
 			usleep(40);
 	}
 
+	// tweens write entity fields, step them while the draw thread waits
+	ModifierManager::getInstance()->onUpdate(deltaTime);
+	if (this->game != NULL)
+	{
+		// the scene updates its entities, thread safe subtrees on the JobSystem workers
+		this->game->update(deltaTime);
+	}
     //FKLOG("updateThread swap memory!!!");
 	totalUpdated++;
     pthread_mutex_unlock(&mutex);
@@ -80,6 +98,9 @@ int Engine::initDisplay(void)
         {
             //UnloadResources();
             //LoadResources();
+            // context was recreated, GL objects are gone
+            Renderer::getInstance()->invalidateGL();
+            ShaderCache::getInstance()->reloadGL();
         }
     }
 
@@ -99,9 +120,14 @@ void Engine::updateViewport()
 	int32_t height = glContext->GetScreenHeight();
 	//Note that screen size might have been changed
     glViewport( 0, 0, width, height );
+    Renderer::getInstance()->setViewport(0, 0, width, height);
 	Matrix4 pMatrix = Matrix4::orthographic(width,height,-width/2, width/2);
     GLMode(GL_PROJECTION);
     GLMultiply(&pMatrix);
+    // entities outside of the projected rect are culled
+    Renderer::getInstance()->setProjection(pMatrix);
+    // new surface or new size, the last frame is gone
+    Entity::markSceneDirty();
 }
 
 /**
@@ -111,20 +137,33 @@ void Engine::drawFrame()
 {
     
     //FKLOG("DrawThread :frame:%d;update:%d",totalFrames,totalUpdated);
+	pthread_mutex_lock(&mutex);
+	// run what the loader threads handed over every frame, an idle or waiting frame must not hold it back
+	schedule->update(deltaTime);
 	if(totalFrames > totalUpdated)
 	{
-		schedule->update(deltaTime);
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+
+	if (this->game != NULL && !Entity::clearSceneDirty())
+	{
+		// nothing changed, the screen still shows the last frame
+		totalFrames++;
+		pthread_mutex_unlock(&mutex);
+		usleep(IDLE_FRAME_USEC);
 		return;
 	}
 
-	pthread_mutex_lock(&mutex);
     // Just clear the screen with a color.
     glClearColor(1.f, 1.f,1.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	if (this->game != NULL)
 	{
-        //this->game->render();
+        this->game->render();
+        // entities only record commands while visiting, draw them now
+        Renderer::getInstance()->render();
 		totalFrames++;
 	}
 
@@ -174,7 +213,17 @@ void Engine::destroy()
  */
 int32_t Engine::handleTouch(TouchTrigger::TouchAction action,int count,intptr_t ids[],float xs[],float ys[])
 {
-    return touchPool->handleTouch(action,count,ids,xs,ys);
+    // input is polled by the looper of the draw thread, hit testing runs between frames
+    // and the update thread is kept out while listeners touch the scene
+    pthread_mutex_lock(&mutex);
+    bool handled = touchPool->handleTouch(action,count,ids,xs,ys);
+    pthread_mutex_unlock(&mutex);
+    if (handled)
+    {
+        // listeners may have moved things around
+        Entity::markSceneDirty();
+    }
+    return handled ? 1 : 0;
 }
 
 //-------------------------------------------------------------------------
@@ -247,6 +296,8 @@ void Engine::handleCMD(int32_t cmd)
                 this->initDisplay();
                 LOGW("game create!!!");
 				ResourceManager::setAssetManager(this->app->activity->assetManager);
+				ResourceManager::thisManager()->internalDataPath = this->app->activity->internalDataPath;
+				ResourceManager::thisManager()->externalDataPath = this->app->activity->externalDataPath;
                 this->game->create();
                 this->drawFrame();
                 this->state = STATE_RUNNING;
@@ -13,7 +13,11 @@
 #include "core/resource/ResourceManager.h"
 #include "core/input/TouchPool.h"
 #include "base/update/UpdateThread.h"
+#include "base/update/JobSystem.h"
 #include "math/GLMatrix.h"
+#include "core/opengl/renderer/Renderer.h"
+#include "2d/Entity.h"
+#include "2d/ModifierManager.h"
 #import "platform/ios/DrawCaller.h"
 
 FLAKOR_NS_BEGIN
@@ -29,15 +33,18 @@ Engine::Engine()
     schedule = Scheduler::thisScheduler();
     //updateThread = UpdateThread::create(this);
     //pthread_mutex_init(&mutex, NULL);
-    touchPool = new TouchPool();
+    touchPool = TouchPool::getInstance();
     game = Game::thisGame();
 }
 
 Engine::~Engine()
 {
     FK_SAFE_DELETE(updateThread);
+    ModifierManager::destroyInstance();
+    JobSystem::destroyInstance();
     FK_SAFE_DELETE(schedule);
-    FK_SAFE_DELETE(touchPool);
+    TouchPool::destroyInstance();
+    touchPool = NULL;
 }
 
 Engine* Engine::getInstance()
@@ -93,6 +100,8 @@ void Engine::onTickUpdate()
         //FKLOG("updateThread clear memory!!!");
     }
     
+    // tweens write entity fields, step them while the draw thread waits
+    ModifierManager::getInstance()->onUpdate(deltaTime);
     //FKLOG("updateThread swap memory!!!");
     totalUpdated++;
     pthread_mutex_unlock(&mutex);
@@ -105,9 +114,14 @@ void Engine::updateViewport()
     
     //Note that screen size might have been changed
     glViewport( 0, 0, width, height );
+    Renderer::getInstance()->setViewport(0, 0, width, height);
     Matrix4 pMatrix = Matrix4::orthographic(width,height,-width/2, width/2);
     GLMode(GL_PROJECTION);
     GLMultiply(&pMatrix);
+    // entities outside of the projected rect are culled
+    Renderer::getInstance()->setProjection(pMatrix);
+    // new size, the last frame is gone
+    Entity::markSceneDirty();
 }
 
 /**
@@ -124,6 +138,14 @@ void Engine::drawFrame()
     schedule->update(deltaTime);
     
     pthread_mutex_lock(&mutex);
+    if (this->game != NULL && !Entity::clearSceneDirty())
+    {
+        // nothing changed, the layer keeps showing the last frame, the display link paces us
+        totalFrames++;
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
     // Just clear the screen with a color.
     glClearColor(1.f, 1.f,1.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -133,6 +155,8 @@ void Engine::drawFrame()
     {
         
         this->game->render();
+        // entities only record commands while visiting, draw them now
+        Renderer::getInstance()->render();
         totalFrames++;
     }
     
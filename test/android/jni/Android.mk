@@ -21,4 +21,18 @@ LOCAL_STATIC_LIBRARIES := flakor_static
 
 include $(BUILD_SHARED_LIBRARY)
 
+# z order sort benchmark, run it with adb shell, the results go to logcat
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := flakor_sort_benchmark
+
+LOCAL_SRC_FILES := ../../unit/sort_benchmark.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../../flakor \
+                    $(LOCAL_PATH)/../../../flakor/..
+
+LOCAL_STATIC_LIBRARIES := flakor_static
+
+include $(BUILD_EXECUTABLE)
+
 $(call import-module,.)
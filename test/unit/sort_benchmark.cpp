@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "targetMacros.h"
+#include "common.h"
+#include "2d/Entity.h"
+#include "base/lang/Array.h"
+
+using namespace flakor;
+
+// z order sort benchmark: old insertion sort against Entity::sortAllChildren
+// for bulk reorders (every child moves) and incremental ones (1% of the children move)
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void insertionSort(Entity** data, int length)
+{
+	for(int i=1;i<length;i++)
+	{
+		Entity* tmp = data[i];
+		int j=i-1;
+		while(j>=0 && (tmp->getZOrder() < data[j]->getZOrder() ||
+					(tmp->getZOrder() == data[j]->getZOrder() && tmp->getOrderOfArrival() < data[j]->getOrderOfArrival())))
+		{
+			data[j+1] = data[j];
+			j--;
+		}
+		data[j+1] = tmp;
+	}
+}
+
+static void reorder(Entity* parent, int moves, int range)
+{
+	Array* children = parent->getChildren();
+	int count = children->count();
+	for(int i=0;i<moves;i++)
+	{
+		Entity* child = (Entity*)children->objectAtIndex(rand() % count);
+		parent->reorderChild(child, rand() % range);
+	}
+}
+
+static void bench(int count, int moves, int rounds)
+{
+	Entity* parent = Entity::create();
+	for(int i=0;i<count;i++)
+	{
+		parent->addChild(Entity::create(), rand() % count);
+	}
+	parent->sortAllChildren(true);
+
+	double insertion = 0;
+	double sorted = 0;
+	for(int r=0;r<rounds;r++)
+	{
+		reorder(parent, moves, count);
+		Array* children = parent->getChildren();
+		std::vector<Entity*> copy((Entity**)children->data->arr, (Entity**)children->data->arr + count);
+
+		double start = now();
+		insertionSort(copy.data(), count);
+		insertion += now() - start;
+
+		start = now();
+		parent->sortAllChildren(true);
+		sorted += now() - start;
+	}
+
+	// Log rather than FKLOG, the results are wanted in release builds too
+	Log("%6d children, %5d moved: insertion %9.4f ms, sortAllChildren %9.4f ms",
+			count, moves, insertion / rounds, sorted / rounds);
+}
+
+int main(int argc,char** argv)
+{
+	srand(1);
+
+	const int counts[] = { 10, 100, 10000 };
+	for(int i=0;i<3;i++)
+	{
+		int count = counts[i];
+		int rounds = count >= 10000 ? 5 : 1000;
+		// depth sorted scene: everybody moves
+		bench(count, count, rounds);
+		// a few nodes moved
+		bench(count, count / 100 > 0 ? count / 100 : 1, rounds);
+	}
+	return 0;
+}